@@ -25,6 +25,7 @@
 // FreeRTOS includes
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
+#include "freertos/timers.h"
 
 // Disable via sdkconfig
 #if CONFIG_AD2IOT_MQTT_CLIENT
@@ -35,6 +36,16 @@ static const char *TAG = "MQTT";
 
 // esp component includes
 #include "mqtt_client.h"
+#if CONFIG_MQTT_PROTOCOL_5
+#include "mqtt5_client.h"
+#endif
+
+// specific includes
+#include "ad2mqtt_topics.h"
+#include "ad2mqtt_outbox.h"
+#include "ad2mqtt_raw.h"
+#include "ad2mqtt_cbor.h"
+#include "ad2mqtt_cmdq.h"
 
 // enable verbose debug logging
 //#define MQTT_DEBUG
@@ -47,6 +58,21 @@ static const char *TAG = "MQTT";
 #define MQTT_TPREFIX_SUBCMD "tprefix"
 #define MQTT_DPREFIX_SUBCMD "dprefix"
 #define MQTT_SWITCH_SUBCMD  "switch"
+#define MQTT_REFRESH_SUBCMD "refresh"
+#define MQTT_STATS_SUBCMD   "stats"
+#define MQTT_OUTBOX_SUBCMD  "outbox"
+#define MQTT_OUTBOX_BYTES_KEY "outbox_bytes"
+#define MQTT_OUTBOX_COUNT_KEY "outbox_count"
+#define MQTT_RAW_SUBCMD     "raw"
+#define MQTT_RAW_WINDOW_KEY "raw_window"
+#define MQTT_RAW_BYTES_KEY  "raw_bytes"
+#define MQTT_RAW_FORMAT_KEY "raw_format"
+#define MQTT_CBOR_SUBCMD    "cbor"
+#define MQTT_QOS_SUBCMD     "qos"
+#define MQTT_RETAIN_SUBCMD  "retain"
+#define MQTT_CMDRATE_SUBCMD "cmdrate"
+#define MQTT_EXPIRY_SUBCMD  "expiry"
+#define MQTT_PROTOCOL_SUBCMD "protocol"
 
 #define MQTT_CONFIG_SECTION "mqtt"
 #define MQTT_CONFIG_SWITCH_SUFFIX_DESCRIPTION "description"
@@ -59,10 +85,8 @@ static const char *TAG = "MQTT";
     MQTT_CONFIG_SWITCH_SUFFIX_TROUBLE)
 
 // MQTT settings
-#define MQTT_TOPIC_PREFIX "ad2iot"
 #define MQTT_LWT_TOPIC_SUFFIX "will"
 #define MQTT_LWT_MESSAGE "offline"
-#define MQTT_COMMANDS_TOPIC "commands"
 #define MQTT_COMMAND_MAX_DATA_LEN 256
 
 #define EXAMPLE_BROKER_URI "mqtt://mqtt.eclipseprojects.io"
@@ -74,14 +98,159 @@ static std::string mqttclient_DPREFIX = "";
 static std::vector<AD2EventSearch *> mqtt_AD2EventSearches;
 static bool commands_enabled = false;
 
+// Remote commands are queued by the MQTT task and run by the command
+// task. See ad2mqtt_cmdq.h
+#define MQTT_CMDQ_SIZE 8
+static AD2MQTTCommandQueue mqtt_cmdq;
+static SemaphoreHandle_t mqtt_cmdq_mutex = nullptr;
+static TaskHandle_t mqtt_command_task_handle = nullptr;
+
+// Remote command actions and their default 'RATE BURST' limit.
+// Commands per second and bucket size. Keys are cmdrate_<action>.
+static const struct {
+    const char *action;
+    const char *rate;
+} mqtt_command_actions[] = {
+    {"DISARM", "1 3"},
+    {"ARM_STAY", "1 3"},
+    {"ARM_AWAY", "1 3"},
+    {"EXIT", "1 3"},
+    {"CHIME_TOGGLE", "1 2"},
+    {"AUX_ALARM", "1 2"},
+    {"PANIC_ALARM", "1 2"},
+    {"FIRE_ALARM", "1 2"},
+    {"BYPASS", "2 8"},
+    {"SEND_RAW", "5 10"},
+    {"FW_UPDATE_IOT", "0.02 1"},
+    {"FW_UPDATE_AD2", "0.02 1"},
+    {"FW_CONFIG_IOT", "0.1 1"}
+};
+#define MQTT_COMMAND_ACTIONS (sizeof(mqtt_command_actions) / sizeof(mqtt_command_actions[0]))
+
+// All publish topics. Built once before the client starts.
+static AD2MQTTTopicTable mqtt_topics;
+
 // prefix name lines to identy the source. User can change.
 #define NAME_PREFIX "AD2IoT"
 
-// Default MQTT message settings excluding LWT.
+// Default MQTT message settings excluding LWT. Each topic class
+// has its own QoS and retain flag. See mqtt_class_names.
 #define MQTT_DEF_QOS    1 // AT Least Once
 #define MQTT_DEF_RETAIN 1 // Retain
 #define MQTT_DEF_STORE  0 // No local storage
 
+// Configurable topic classes by mqtt_topic_class_t. Keys are
+// <name>_qos and <name>_retain. The device class is fixed.
+static const char *mqtt_class_names[MQTT_CLASS_COUNT] = {
+    nullptr, "partitions", "zones", "switches", "cid", "raw", "discovery", nullptr
+};
+
+// Resend unchanged retained state and discovery after this many seconds.
+#define MQTT_DEF_REFRESH 3600
+
+// Staged outbox limits.
+#define MQTT_DEF_OUTBOX_BYTES 16384
+#define MQTT_DEF_OUTBOX_COUNT 64
+// Staged messages wait while the client outbox holds this many bytes.
+#define MQTT_CLIENT_OUTBOX_LIMIT 4096
+// Outbox counters are published at most this often.
+#define MQTT_OUTBOX_STATS_INTERVAL 60000 // ms
+
+// Publishes are staged in front of the client outbox. See ad2mqtt_outbox.h
+static AD2MQTTOutbox mqtt_outbox;
+static SemaphoreHandle_t mqtt_outbox_mutex = nullptr;
+static SemaphoreHandle_t mqtt_drain_mutex = nullptr;
+static uint32_t mqtt_outbox_stats_lost = 0;
+static uint64_t mqtt_outbox_stats_ms = 0;
+
+// MQTT protocol version. 3 for 3.1.1 or 5.
+#define MQTT_DEF_PROTOCOL 3
+// Kept for the life of the client so the protocol can be changed.
+static esp_mqtt_client_config_t mqtt_client_cfg = {};
+static std::string mqtt_broker_url;
+
+#if CONFIG_MQTT_PROTOCOL_5
+// MQTT 5 topic aliases for QoS 0 topics. At most this many per
+// connection and never more than the broker allows.
+#define MQTT5_TOPIC_ALIASES 32
+// Staged messages older than this carry an age_ms user property.
+#define MQTT5_AGE_PROPERTY_MS 1000
+
+typedef struct mqtt5_stats {
+    uint32_t aliased;       ///< publishes sent with an alias and no topic.
+    uint32_t alias_bytes;   ///< topic bytes not sent.
+    uint32_t expiring;      ///< publishes sent with a message expiry.
+    uint32_t properties;    ///< publishes sent with user properties.
+} mqtt5_stats_t;
+
+static volatile bool mqtt5_active = false;
+// Aliases are only valid for one connection. on_connect bumps the
+// session and the next publish resets the alias table.
+static volatile uint32_t mqtt5_session = 0;
+static uint32_t mqtt5_alias_session = 0;
+static std::vector<uint16_t> mqtt5_aliases; // topic index to alias. 0 none.
+static uint16_t mqtt5_alias_next = 1;
+static bool mqtt5_alias_refused = false;
+static mqtt5_stats_t mqtt5_stats = {};
+#endif
+
+// Raw message stream. Disabled with a window of 0.
+#define MQTT_DEF_RAW_BYTES 1024
+static AD2MQTTRawBatch mqtt_raw;
+static SemaphoreHandle_t mqtt_raw_mutex = nullptr;
+static TimerHandle_t mqtt_raw_timer = nullptr;
+
+// Topic prefixes that publish CBOR in place of JSON. See ad2mqtt_cbor.h
+#define MQTT_CBOR_PARTITIONS 0x01
+#define MQTT_CBOR_ZONES      0x02
+#define MQTT_CBOR_SWITCHES   0x04
+#define MQTT_CBOR_CID        0x08
+static const struct {
+    const char *prefix;
+    uint8_t bit;
+} mqtt_cbor_prefixes[] = {
+    {"partitions", MQTT_CBOR_PARTITIONS},
+    {"zones", MQTT_CBOR_ZONES},
+    {"switches", MQTT_CBOR_SWITCHES},
+    {"cid", MQTT_CBOR_CID}
+};
+static volatile uint8_t mqtt_cbor_mask = 0;
+
+// Home Assistant discovery. Each config document has a slot that holds
+// the hash of the last config the broker acknowledged.
+#define MQTT_DISC_SLOT_FW_VERSION   0
+#define MQTT_DISC_SLOT_FW_UPDATE    1
+#define MQTT_DISC_SLOT_PARTITION    2
+#define MQTT_DISC_PARTITION_CONFIGS 4 // p, ac_power, fire_p, chime_p
+#define MQTT_DISC_SLOT_ZONE         (MQTT_DISC_SLOT_PARTITION + AD2_MAX_PARTITION * MQTT_DISC_PARTITION_CONFIGS)
+#define MQTT_DISC_SLOT_SWITCH       (MQTT_DISC_SLOT_ZONE + AD2_MAX_ZONES)
+
+// Discovery pacing. A few configs per tick and never more than
+// MQTT_DISC_INFLIGHT waiting on the broker.
+#define MQTT_DISC_BURST     4
+#define MQTT_DISC_INTERVAL  100 // ms
+#define MQTT_DISC_INFLIGHT  8
+// Configs not acknowledged in time are sent again next session.
+#define MQTT_DISC_ACK_TIMEOUT 10000 // ms
+
+typedef struct mqtt_discovery_stats {
+    uint32_t published;     ///< configs sent.
+    uint32_t unchanged;     ///< configs skipped. Already acknowledged.
+    uint32_t acked;         ///< configs acknowledged by the broker.
+} mqtt_discovery_stats_t;
+
+static TaskHandle_t mqtt_discovery_task_handle = nullptr;
+static SemaphoreHandle_t mqtt_discovery_mutex = nullptr;
+static volatile bool mqtt_connected = false;
+static std::vector<uint64_t> mqtt_discovery_acked;              // slot to acked hash. 0 none.
+typedef struct mqtt_discovery_pending {
+    int slot;
+    uint64_t hash;
+    uint64_t sent_ms;
+} mqtt_discovery_pending_t;
+static std::map<int, mqtt_discovery_pending_t> mqtt_discovery_pending; // by msg_id.
+static mqtt_discovery_stats_t mqtt_discovery_stats = {};
+
 // LOG settings
 //#define MQTT_EVENT_LOGGING
 
@@ -102,10 +271,470 @@ esp_err_t outbox_set_pending(outbox_handle_t outbox, int msg_id, pending_state_t
 }
 #endif
 
+static void mqtt_publish_outbox_stats();
+
+/**
+ * @brief esp_mqtt_client_enqueue() that also queues QoS 0 messages.
+ * Without store the client discards QoS 0 enqueues.
+ *
+ * The caller must hold mqtt_drain_mutex. MQTT 5 publish properties are
+ * set on the client and used by the next enqueue so every enqueue is
+ * serialized by the one mutex.
+ *
+ * @param [in]topic const char *
+ * @param [in]data const char *
+ * @param [in]len int 0 if nul terminated.
+ * @param [in]qos int
+ * @param [in]retain int
+ *
+ * @return int msg_id. 0 for QoS 0 or -1 on error.
+ */
+static int mqtt_enqueue(const char *topic, const char *data, int len, int qos, int retain)
+{
+#if CONFIG_MQTT_PROTOCOL_5
+    if (mqtt5_active) {
+        // No properties. Clears any left by a failed enqueue.
+        esp_mqtt5_publish_property_config_t property = {};
+        esp_mqtt5_client_set_publish_property(mqtt_client, &property);
+    }
+#endif
+    return esp_mqtt_client_enqueue(mqtt_client, topic, data, len, qos, retain,
+                                   qos == 0 ? true : MQTT_DEF_STORE);
+}
+
+#if CONFIG_MQTT_PROTOCOL_5
+/**
+ * @brief Enqueue a staged message with MQTT 5 properties. The caller
+ * must hold mqtt_drain_mutex.
+ *
+ * QoS 0 topics are given a topic alias. The first publish on the
+ * connection carries the topic and the alias and the rest only the
+ * alias. QoS 1 and 2 always carry the topic as the client may resend
+ * them on a new connection where the alias is unknown. The remaining
+ * expiry of the class is sent so the broker does not deliver stale
+ * events to subscribers that were offline. The event name and the time
+ * the message was staged are sent as user properties.
+ *
+ * @param [in]msg const mqtt_outbox_msg_t & staged message.
+ * @param [in]now_ms uint64_t monotonic time.
+ *
+ * @return int msg_id. 0 for QoS 0 or -1 on error.
+ */
+static int mqtt5_enqueue(const mqtt_outbox_msg_t &msg, uint64_t now_ms)
+{
+    esp_mqtt5_publish_property_config_t property = {};
+    const char *topic = msg.topic->topic;
+    uint64_t age_ms = now_ms - msg.queued_ms;
+
+    // Aliases are only valid for one connection.
+    if (mqtt5_alias_session != mqtt5_session) {
+        mqtt5_alias_session = mqtt5_session;
+        mqtt5_aliases.assign(mqtt_topics.count(), 0);
+        mqtt5_alias_next = 1;
+        mqtt5_alias_refused = false;
+    }
+    uint16_t *alias = nullptr;
+    bool first = false;
+    if (msg.qos == 0) {
+        alias = &mqtt5_aliases[mqtt_topics.index(msg.topic)];
+        if (*alias) {
+            topic = "";
+        } else if (!mqtt5_alias_refused && mqtt5_alias_next <= MQTT5_TOPIC_ALIASES) {
+            *alias = mqtt5_alias_next++;
+            first = true;
+        }
+        property.topic_alias = *alias;
+    }
+
+    // pop() dropped the message if the expiry has passed.
+    if (msg.expiry) {
+        property.message_expiry_interval = msg.expiry - age_ms / 1000;
+    }
+
+    esp_mqtt5_user_property_item_t items[2];
+    uint8_t item_count = 0;
+    std::string age;
+    if (msg.event.length()) {
+        items[item_count++] = {"event", msg.event.c_str()};
+    }
+    if (age_ms >= MQTT5_AGE_PROPERTY_MS) {
+        age = std::to_string(age_ms);
+        items[item_count++] = {"age_ms", age.c_str()};
+    }
+    if (item_count) {
+        esp_mqtt5_client_set_user_property(&property.user_property, items, item_count);
+    }
+
+    esp_err_t err = esp_mqtt5_client_set_publish_property(mqtt_client, &property);
+    if (err != ESP_OK && first) {
+        // More aliases than the broker allows. No new aliases this
+        // connection.
+        mqtt5_alias_refused = true;
+        *alias = 0;
+        mqtt5_alias_next--;
+        first = false;
+        property.topic_alias = 0;
+        err = esp_mqtt5_client_set_publish_property(mqtt_client, &property);
+    }
+    int msg_id = -1;
+    if (err == ESP_OK) {
+        msg_id = esp_mqtt_client_enqueue(mqtt_client, topic, msg.payload.data(), msg.payload.length(),
+                                         msg.qos, msg.retain, msg.qos == 0 ? true : MQTT_DEF_STORE);
+    }
+    if (property.user_property) {
+        esp_mqtt5_client_delete_user_property(property.user_property);
+    }
+
+    if (msg_id == -1) {
+        if (first) {
+            // The broker never saw the alias.
+            *alias = 0;
+            mqtt5_alias_next--;
+        }
+        return msg_id;
+    }
+    if (!*topic) {
+        mqtt5_stats.aliased++;
+        mqtt5_stats.alias_bytes += msg.topic->len;
+    }
+    if (msg.expiry) {
+        mqtt5_stats.expiring++;
+    }
+    if (item_count) {
+        mqtt5_stats.properties++;
+    }
+    return msg_id;
+}
+#endif
+
+/**
+ * @brief Enqueue a staged message with the protocol in use. The caller
+ * must hold mqtt_drain_mutex.
+ *
+ * @param [in]msg const mqtt_outbox_msg_t & staged message.
+ * @param [in]now_ms uint64_t monotonic time.
+ *
+ * @return int msg_id. 0 for QoS 0 or -1 on error.
+ */
+static int mqtt_enqueue_msg(const mqtt_outbox_msg_t &msg, uint64_t now_ms)
+{
+#if CONFIG_MQTT_PROTOCOL_5
+    if (mqtt5_active) {
+        return mqtt5_enqueue(msg, now_ms);
+    }
+#endif
+    return mqtt_enqueue(msg.topic->topic,
+                        msg.payload.data(),
+                        msg.payload.length(),
+                        msg.qos,
+                        msg.retain);
+}
+
+/**
+ * @brief Move staged messages into the client outbox while connected
+ * and the client outbox is below MQTT_CLIENT_OUTBOX_LIMIT.
+ *
+ * Only one task drains at a time so staged messages keep their order.
+ * The MQTT task calls this from the event handler with the client lock
+ * held so it must not wait for mqtt_drain_mutex or it could deadlock
+ * with a task that holds it and is waiting on the client lock. The
+ * task holding it will finish the drain.
+ *
+ * @param [in]wait bool false if called from the MQTT task.
+ */
+static void mqtt_outbox_drain(bool wait = true)
+{
+    if (xSemaphoreTake(mqtt_drain_mutex, wait ? portMAX_DELAY : 0) != pdTRUE) {
+        return;
+    }
+    mqtt_outbox_msg_t msg;
+    while (mqtt_connected &&
+            esp_mqtt_client_get_outbox_size(mqtt_client) < MQTT_CLIENT_OUTBOX_LIMIT) {
+        uint64_t now_ms = hal_uptime_us() / 1000;
+        xSemaphoreTake(mqtt_outbox_mutex, portMAX_DELAY);
+        bool ok = mqtt_outbox.pop(msg, now_ms);
+        xSemaphoreGive(mqtt_outbox_mutex);
+        if (!ok) {
+            break;
+        }
+        // Non blocking.
+        int msg_id = mqtt_enqueue_msg(msg, now_ms);
+        if (msg_id == -1) {
+            xSemaphoreTake(mqtt_outbox_mutex, portMAX_DELAY);
+            mqtt_outbox.dropped();
+            // A state payload was lost. Send the topic next update.
+            if (msg.collapse) {
+                mqtt_topics.invalidate(msg.topic);
+            }
+            xSemaphoreGive(mqtt_outbox_mutex);
+        }
+    }
+    mqtt_publish_outbox_stats();
+    xSemaphoreGive(mqtt_drain_mutex);
+}
+
+/**
+ * @brief Stage a publish in the outbox and drain what the client can take.
+ * QoS, retain and expiry are the options of the topic class.
+ *
+ * @param [in]topic const mqtt_topic_t * table entry.
+ * @param [in]payload const char * payload.
+ * @param [in]prio mqtt_priority_t
+ * @param [in]collapse bool replace a staged payload on the same topic.
+ * @param [in]wait bool false if called from the MQTT task.
+ * @param [in]len size_t payload length. 0 if nul terminated.
+ * @param [in]event const char * event name for MQTT 5 or nullptr.
+ *
+ * @return bool false if dropped.
+ */
+static bool mqtt_publish(const mqtt_topic_t *topic, const char *payload,
+                         mqtt_priority_t prio, bool collapse = true, bool wait = true,
+                         size_t len = 0, const char *event = nullptr)
+{
+    mqtt_class_options_t opt = mqtt_topics.getOptions(topic);
+    uint64_t now_ms = hal_uptime_us() / 1000;
+    xSemaphoreTake(mqtt_outbox_mutex, portMAX_DELAY);
+    bool ok = mqtt_outbox.push(topic, payload, len ? len : strlen(payload),
+                               opt.qos, opt.retain, collapse, prio,
+                               now_ms, opt.expiry, event);
+    if (!ok && collapse) {
+        // A state payload was lost. Send the topic next update.
+        mqtt_topics.invalidate(topic);
+    }
+    xSemaphoreGive(mqtt_outbox_mutex);
+    mqtt_outbox_drain(wait);
+    return ok;
+}
+
+/**
+ * @brief Publish the outbox counters if messages were dropped or
+ * expired since the last report. At most once per
+ * MQTT_OUTBOX_STATS_INTERVAL. The caller must hold mqtt_drain_mutex.
+ */
+static void mqtt_publish_outbox_stats()
+{
+    uint64_t now_ms = hal_uptime_us() / 1000;
+    xSemaphoreTake(mqtt_outbox_mutex, portMAX_DELAY);
+    mqtt_outbox_stats_t os = mqtt_outbox.getStats();
+    xSemaphoreGive(mqtt_outbox_mutex);
+    uint32_t lost = os.dropped + os.expired;
+    if (lost == mqtt_outbox_stats_lost || !mqtt_connected ||
+            (mqtt_outbox_stats_ms && now_ms - mqtt_outbox_stats_ms < MQTT_OUTBOX_STATS_INTERVAL)) {
+        return;
+    }
+    mqtt_outbox_stats_lost = lost;
+    mqtt_outbox_stats_ms = now_ms;
+
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "depth", os.depth);
+    cJSON_AddNumberToObject(root, "bytes", os.bytes);
+    cJSON_AddNumberToObject(root, "peak_bytes", os.peak_bytes);
+    cJSON_AddNumberToObject(root, "queued", os.queued);
+    cJSON_AddNumberToObject(root, "sent", os.sent);
+    cJSON_AddNumberToObject(root, "collapsed", os.collapsed);
+    cJSON_AddNumberToObject(root, "dropped", os.dropped);
+    cJSON_AddNumberToObject(root, "expired", os.expired);
+    char *state = cJSON_Print(root);
+    cJSON_Minify(state);
+
+    // Direct to the client so the report is not dropped with the rest.
+    mqtt_enqueue(mqtt_topics.get(MQTT_TOPIC_OUTBOX)->topic,
+                 state,
+                 0,
+                 MQTT_DEF_QOS,
+                 MQTT_DEF_RETAIN);
+    cJSON_free(state);
+    cJSON_Delete(root);
+}
+
+/**
+ * @brief Publish a retained state payload if it is different from the
+ * last payload sent on the topic or the refresh interval has passed.
+ *
+ * @param [in]topic const mqtt_topic_t * table entry.
+ * @param [in]payload const char * nul terminated payload.
+ * @param [in]prio mqtt_priority_t outbox priority.
+ * @param [in]len size_t payload length. 0 if nul terminated.
+ * @param [in]event const char * event name for MQTT 5 or nullptr.
+ *
+ * @return int 1 if staged, 0 if unchanged or -1 if dropped.
+ */
+static int mqtt_publish_state(const mqtt_topic_t *topic, const char *payload, mqtt_priority_t prio,
+                              size_t len = 0, const char *event = nullptr)
+{
+    uint64_t now_ms = hal_uptime_us() / 1000;
+    if (!len) {
+        len = strlen(payload);
+    }
+    uint64_t hash = AD2MQTTTopicTable::hash64(payload, len);
+
+    // Recorded before staging so a drop or expiry in the outbox after
+    // this forgets it and the next event tries again. Under the outbox
+    // lock with the invalidate calls so the check and record are one step.
+    xSemaphoreTake(mqtt_outbox_mutex, portMAX_DELAY);
+    bool send = mqtt_topics.update(topic, hash, now_ms);
+    xSemaphoreGive(mqtt_outbox_mutex);
+    if (!send) {
+        return 0;
+    }
+    // Non blocking. We must not block AlarmDecoderParser
+    if (!mqtt_publish(topic, payload, prio, true, true, len, event)) {
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief Parse a list of topic prefixes that publish CBOR.
+ *
+ * @param [in]list const std::string & ex. "partitions zones"
+ * @param [out]mask uint8_t & MQTT_CBOR_* bits.
+ *
+ * @return bool false if a prefix is unknown.
+ */
+static bool mqtt_parse_cbor_prefixes(const std::string &list, uint8_t &mask)
+{
+    mask = 0;
+    std::string word;
+    for (int n = 0; ad2_copy_nth_arg(word, list.c_str(), n) >= 0; n++) {
+        bool found = false;
+        for (auto &p : mqtt_cbor_prefixes) {
+            if (word == p.prefix) {
+                mask |= p.bit;
+                found = true;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Find a configurable topic class by name.
+ *
+ * @param [in]name const std::string & ex. "zones"
+ *
+ * @return int mqtt_topic_class_t or -1 if not found.
+ */
+static int mqtt_find_class(const std::string &name)
+{
+    for (int c = 0; c < MQTT_CLASS_COUNT; c++) {
+        if (mqtt_class_names[c] && name == mqtt_class_names[c]) {
+            return c;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Load the QoS, retain flag and expiry of every topic class from
+ * the config into the topic table. Missing keys keep the table defaults.
+ */
+static void mqtt_load_class_options()
+{
+    for (int c = 0; c < MQTT_CLASS_COUNT; c++) {
+        if (!mqtt_class_names[c]) {
+            continue;
+        }
+        mqtt_class_options_t opt = mqtt_topics.getOptions((mqtt_topic_class_t)c);
+        int qos = opt.qos;
+        bool retain = opt.retain;
+        int expiry = opt.expiry;
+        std::string key = mqtt_class_names[c];
+        ad2_get_config_key_int(MQTT_CONFIG_SECTION, (key + "_" MQTT_QOS_SUBCMD).c_str(), &qos);
+        ad2_get_config_key_bool(MQTT_CONFIG_SECTION, (key + "_" MQTT_RETAIN_SUBCMD).c_str(), &retain);
+        ad2_get_config_key_int(MQTT_CONFIG_SECTION, (key + "_" MQTT_EXPIRY_SUBCMD).c_str(), &expiry);
+        if (qos < 0 || qos > 2) {
+            ESP_LOGE(TAG, "Invalid QoS %i for %s topics.", qos, key.c_str());
+            qos = opt.qos;
+        }
+        if (expiry < 0) {
+            ESP_LOGE(TAG, "Invalid expiry %i for %s topics.", expiry, key.c_str());
+            expiry = opt.expiry;
+        }
+        mqtt_topics.setOptions((mqtt_topic_class_t)c, qos, retain);
+        mqtt_topics.setExpiry((mqtt_topic_class_t)c, expiry);
+    }
+}
+
+/**
+ * @brief Print the QoS, retain flag and expiry of one or all topic classes.
+ *
+ * @param [in]cls int mqtt_topic_class_t or -1 for all.
+ */
+static void mqtt_print_class_options(int cls)
+{
+    for (int c = 0; c < MQTT_CLASS_COUNT; c++) {
+        if (!mqtt_class_names[c] || (cls >= 0 && c != cls)) {
+            continue;
+        }
+        mqtt_class_options_t opt = mqtt_topics.getOptions((mqtt_topic_class_t)c);
+        ad2_printf_host(false, "MQTT %s topics QoS %u retain %s expiry %u seconds.\r\n",
+                        mqtt_class_names[c], opt.qos, opt.retain ? "Y" : "N", (unsigned)opt.expiry);
+    }
+}
+
+/**
+ * @brief Publish a discovery config unless the broker already
+ * acknowledged the same topic and document.
+ *
+ * The mutex is not held across esp_mqtt_client_enqueue(). The event
+ * handler runs with the client lock held and takes the mutex so
+ * holding both here could deadlock. A PUBLISHED event that wins the
+ * race with the insert below leaves the entry pending until it
+ * times out and the config is sent again next session.
+ *
+ * @param [in]slot int discovery slot.
+ * @param [in]topic const std::string & config topic.
+ * @param [in]json const char * config document.
+ */
+static void mqtt_publish_discovery(int slot, const std::string &topic, const char *json)
+{
+    uint64_t hash = AD2MQTTTopicTable::hash64(json, strlen(json));
+    hash = AD2MQTTTopicTable::hash64(topic.c_str(), topic.length(), hash);
+    if (slot < 0 || slot >= (int)mqtt_discovery_acked.size()) {
+        return;
+    }
+    xSemaphoreTake(mqtt_discovery_mutex, portMAX_DELAY);
+    bool unchanged = mqtt_discovery_acked[slot] == hash;
+    if (unchanged) {
+        mqtt_discovery_stats.unchanged++;
+    }
+    xSemaphoreGive(mqtt_discovery_mutex);
+    if (unchanged) {
+        return;
+    }
+
+    // non blocking publish
+    mqtt_class_options_t opt = mqtt_topics.getOptions(MQTT_CLASS_DISCOVERY);
+    xSemaphoreTake(mqtt_drain_mutex, portMAX_DELAY);
+    int msg_id = mqtt_enqueue(topic.c_str(),
+                              json,
+                              0,
+                              opt.qos,
+                              opt.retain);
+    xSemaphoreGive(mqtt_drain_mutex);
+    if (msg_id == -1) {
+        return;
+    }
+    xSemaphoreTake(mqtt_discovery_mutex, portMAX_DELAY);
+    mqtt_discovery_stats.published++;
+    if (msg_id == 0) {
+        // QoS 0 has no acknowledgement.
+        mqtt_discovery_acked[slot] = hash;
+        mqtt_discovery_stats.acked++;
+    } else {
+        mqtt_discovery_pending[msg_id] = {slot, hash, hal_uptime_us() / 1000};
+    }
+    xSemaphoreGive(mqtt_discovery_mutex);
+}
 
 /**
  * @brief helper to send config json for auto discovery.
  *
+ * @param [in]slot - int - discovery slot MQTT_DISC_SLOT_*
  * @param [in]device_type - const char * - ex. 'binary_sensor'
  * @param [in]device_class - const char * - ex. 'smoke'
  * @param [in]type - const char * - ex. 'zone'
@@ -115,7 +744,7 @@ esp_err_t outbox_set_pending(outbox_handle_t outbox, int msg_id, pending_state_t
  * @param [in]name_append_id - bool - append id to name field
  * @param [in]pairs - std::map<std::string,std::string> - attributes to add to config.
  */
-void mqtt_publish_device_config(const char *device_type, const char *device_class,
+void mqtt_publish_device_config(int slot, const char *device_type, const char *device_class,
                                 const char *ad2type, uint8_t id, bool id_append_id,
                                 const char* name, bool name_append_id,
                                 std::map<std::string, std::string> pairs)
@@ -177,14 +806,7 @@ void mqtt_publish_device_config(const char *device_type, const char *device_clas
     }
     topic += "/config";
 
-    // non blocking publish
-    esp_mqtt_client_enqueue(mqtt_client,
-                            topic.c_str(),
-                            szjson,
-                            0,
-                            MQTT_DEF_QOS,
-                            MQTT_DEF_RETAIN,
-                            MQTT_DEF_STORE);
+    mqtt_publish_discovery(slot, topic, szjson);
 
     // cleanup free memory
     cJSON_free(szjson);
@@ -198,12 +820,12 @@ void mqtt_publish_device_config(const char *device_type, const char *device_clas
 void mqtt_send_partition_config(AD2PartitionState *s)
 {
 
-    // Partiting number string.
-    std::string szpid = std::to_string(s->partition);
-
     // Base topic for device
-    std::string topic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-    topic += mqttclient_UUID;
+    const std::string &topic = mqtt_topics.base();
+    const mqtt_topic_t *state_topic = mqtt_topics.partition(s->partition);
+    if (!state_topic) {
+        return;
+    }
 
     // alarm_control_panel
     std::string command_template = ad2_string_printf("{ \"partition\": %i, \"action\": \"{{ action }}\", \"code\": \"{{ code }}\"}", s->partition);
@@ -211,11 +833,12 @@ void mqtt_send_partition_config(AD2PartitionState *s)
     uuid_prefix += "(";
     uuid_prefix += mqttclient_UUID.substr(mqttclient_UUID.size() - 4);
     uuid_prefix += ")";
+    int slot = MQTT_DISC_SLOT_PARTITION + (s->partition - 1) * MQTT_DISC_PARTITION_CONFIGS;
     std::string tmpstr = uuid_prefix + " Partition #";
-    mqtt_publish_device_config("alarm_control_panel", "alarm_control_panel", "p",
+    mqtt_publish_device_config(slot, "alarm_control_panel", "alarm_control_panel", "p",
                                s->partition, true,
     tmpstr.c_str(), true, {{
-            { "state_topic", topic+"/partitions/"+szpid },
+            { "state_topic", state_topic->topic },
             { "value_template", "{% if value_json.alarm_sounding == true or value_json.alarm_event_occurred == true %}triggered{% elif value_json.armed_stay == true %}{% if value_json.entry_delay_off == true %}armed_night{% else %}armed_home{% endif %}{% elif value_json.armed_away == true %}{% if value_json.entry_delay_off == true %}armed_vacation{% elif value_json.entry_delay_off == false %}armed_away{% endif %}{% else %}disarmed{% endif %}" },
             { "command_topic", topic+"/commands"},
             { "command_template", command_template.c_str()},
@@ -231,10 +854,10 @@ void mqtt_send_partition_config(AD2PartitionState *s)
 
     // ac_power
     tmpstr = uuid_prefix + " AC Power";
-    mqtt_publish_device_config("binary_sensor", "power", "ac_power",
+    mqtt_publish_device_config(slot + 1, "binary_sensor", "power", "ac_power",
                                0, false,
     tmpstr.c_str(), false, {{
-            { "state_topic", topic+"/partitions/"+szpid },
+            { "state_topic", state_topic->topic },
             { "value_template", "{% if value_json.ac_power == true %}ON{% else %}OFF{% endif %}" },
             { "availability_topic", topic+"/status"}
         }
@@ -242,10 +865,10 @@ void mqtt_send_partition_config(AD2PartitionState *s)
 
     // partition fire
     tmpstr = uuid_prefix + " Fire Partition #";
-    mqtt_publish_device_config("binary_sensor", "smoke", "fire_p",
+    mqtt_publish_device_config(slot + 2, "binary_sensor", "smoke", "fire_p",
                                s->partition, true,
     tmpstr.c_str(), true, {{
-            { "state_topic", topic+"/partitions/"+szpid },
+            { "state_topic", state_topic->topic },
             { "value_template", "{% if value_json.fire_alarm == true %}ON{% else %}OFF{% endif %}" },
             { "availability_topic", topic+"/status"}
         }
@@ -253,10 +876,10 @@ void mqtt_send_partition_config(AD2PartitionState *s)
 
     // partition chime
     tmpstr = uuid_prefix + " Chime Mode Partition #";
-    mqtt_publish_device_config("binary_sensor", "running", "chime_p",
+    mqtt_publish_device_config(slot + 3, "binary_sensor", "running", "chime_p",
                                s->partition, true,
     tmpstr.c_str(), true, {{
-            { "state_topic", topic+"/partitions/"+szpid },
+            { "state_topic", state_topic->topic },
             { "value_template", "{% if value_json.chime_on == true %}ON{% else %}OFF{% endif %}" },
             { "availability_topic", topic+"/status"}
         }
@@ -267,15 +890,12 @@ void mqtt_send_partition_config(AD2PartitionState *s)
 /**
  * @brief helper to send config json for every partition zones.
  *
+ * @param [in]available_version const char * available firmware version.
+ * @param [in]wait bool false if called from the MQTT task.
  */
-void mqtt_send_fw_version(const char *available_version)
+void mqtt_send_fw_version(const char *available_version, bool wait = true)
 {
-    int msg_id;
     if (mqtt_client != nullptr) {
-        std::string sTopic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-        sTopic+=mqttclient_UUID;
-        sTopic+="/fw_version";
-
         cJSON *root = cJSON_CreateObject();
         cJSON_AddStringToObject(root, "installed", FIRMWARE_VERSION);
         cJSON_AddStringToObject(root, "available", available_version);
@@ -284,13 +904,7 @@ void mqtt_send_fw_version(const char *available_version)
         cJSON_Minify(state);
 
         // Non blocking. We must not block AlarmDecoderParser
-        msg_id = esp_mqtt_client_enqueue(mqtt_client,
-                                         sTopic.c_str(),
-                                         state,
-                                         0,
-                                         MQTT_DEF_QOS,
-                                         MQTT_DEF_RETAIN,
-                                         MQTT_DEF_STORE);
+        mqtt_publish(mqtt_topics.get(MQTT_TOPIC_FW_VERSION), state, MQTT_PRIO_STATE, true, wait);
 
         cJSON_free(state);
         cJSON_Delete(root);
@@ -298,36 +912,120 @@ void mqtt_send_fw_version(const char *available_version)
 }
 
 /**
- * @brief helper to send config json for every configured [zone N].
+ * @brief helper to send config json for a configured [zone N].
  *
- * TODO: This and other mqtt_client_enqueue calls will stack up
- * a lot of memory for larger systems. This should instead be
- * put into an efficient task list to be processed over time
- * as resources are available. In this design it saves all of the
- * JSON data and more for each enqueue.
+ * @param [in]zn int zone 1-AD2_MAX_ZONES.
  */
-void mqtt_send_configured_zone_configs()
+void mqtt_send_zone_config(int zn)
 {
     // set base topic for zones sub topic
-    std::string topic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-    topic += mqttclient_UUID;
+    const std::string &topic = mqtt_topics.base();
+
+    std::string _type;
+    if ( AD2Parse.getZoneType(zn, _type) ) {
+        std::string _alpha;
+        if ( AD2Parse.getZoneString(zn, _alpha) ) {
+            mqtt_publish_device_config(MQTT_DISC_SLOT_ZONE + zn - 1,
+                                       "binary_sensor", _type.c_str(), "zone_",
+                                       zn, true,
+            _alpha.c_str(), false, {{
+                    { "state_topic", mqtt_topics.zone(zn)->topic },
+                    { "value_template", "{% if value_json.state == 'CLOSE' %}OFF{% else %}ON{% endif %}" },
+                    { "availability_topic", topic+"/status"}
+                }
+            });
+        }
+    }
+}
 
-    for (int zn = 1; zn <= AD2_MAX_ZONES; zn++) {
-        std::string _type;
-        if ( AD2Parse.getZoneType(zn, _type) ) {
-            std::string _alpha;
-            if ( AD2Parse.getZoneString(zn, _alpha) ) {
-                mqtt_publish_device_config("binary_sensor", _type.c_str(), "zone_",
-                                           zn, true,
-                _alpha.c_str(), false, {{
-                        { "state_topic", topic+"/zones/"+std::to_string(zn) },
-                        { "value_template", "{% if value_json.state == 'CLOSE' %}OFF{% else %}ON{% endif %}" },
-                        { "availability_topic", topic+"/status"}
-                    }
-                });
-            }
+/**
+ * @brief helper to send the device firmware configs.
+ */
+void mqtt_send_device_configs()
+{
+    const std::string &topic = mqtt_topics.base();
+
+    std::string uuid_prefix = NAME_PREFIX;
+    uuid_prefix += "(";
+    uuid_prefix += mqttclient_UUID.substr(mqttclient_UUID.size() - 4);
+    uuid_prefix += ")";
+    std::string tmpstr = uuid_prefix + " Firmware";
+
+    mqtt_publish_device_config(MQTT_DISC_SLOT_FW_VERSION, "binary_sensor", "update", "fw_version",
+                               0, false,
+    tmpstr.c_str(), false, {{
+            { "state_topic", topic+"/fw_version" },
+            { "value_template", "{% if value_json.installed != value_json.available %}ON{% else %}OFF{% endif %}" },
+            { "availability_topic", topic+"/status"}
         }
+    });
+
+    tmpstr = uuid_prefix + " Start ad2iot firmware update";
+    mqtt_publish_device_config(MQTT_DISC_SLOT_FW_UPDATE, "button", "update", "fw_update",
+                               0, false,
+    tmpstr.c_str(), false, {{
+            { "availability_topic", topic+"/fw_version" },
+            { "availability_template", "{% if value_json.installed != value_json.available %}online{% else %}offline{% endif %}" },
+            { "command_topic", topic+"/commands" },
+            { "payload_press", "{\"action\": \"FW_UPDATE_IOT\"}" }
+        }
+    });
+}
+
+/**
+ * @brief helper to send config json for a virtual switch.
+ *
+ * @param [in]index size_t position in mqtt_AD2EventSearches.
+ */
+void mqtt_send_switch_config(size_t index)
+{
+    const std::string &topic = mqtt_topics.base();
+    AD2EventSearch *sw = mqtt_AD2EventSearches[index];
+
+    // Grab the topic using the virtual switch ID pre saved into INT_ARG
+    std::string description = "NA";
+    std::string key = std::string(MQTT_SWITCH_SUBCMD);
+    ad2_get_config_key_string(MQTT_CONFIG_SECTION,
+                              MQTT_SWITCH_SUBCMD,
+                              description,
+                              sw->INT_ARG,
+                              MQTT_CONFIG_SWITCH_SUFFIX_DESCRIPTION);
+
+    cJSON * root   = cJSON_Parse(description.c_str());
+
+    // default to type door and generic value_template
+    std::string _type = "door";
+    std::string _name = "N/A";
+    std::string _value_template = "{{value_json.state}}";
+
+    if (root) {
+        cJSON *otype = cJSON_GetObjectItemCaseSensitive(root, "type");
+        if ( cJSON_IsString(otype) ) {
+            _type = otype->valuestring;
+        }
+
+        cJSON *oname = cJSON_GetObjectItemCaseSensitive(root, "name");
+        if ( cJSON_IsString(oname) ) {
+            _name = oname->valuestring;
+        }
+
+        cJSON *ovalue_template = cJSON_GetObjectItemCaseSensitive(root, "value_template");
+        if ( cJSON_IsString(ovalue_template) ) {
+            _value_template = ovalue_template->valuestring;
+        }
+
+        cJSON_Delete(root);
     }
+
+    mqtt_publish_device_config(
+        MQTT_DISC_SLOT_SWITCH + (int)index, "binary_sensor", _type.c_str(), "switch_",
+        sw->INT_ARG, true,
+    _name.c_str(), false, {{
+            { "state_topic", mqtt_topics.sw(sw->INT_ARG)->topic },
+            { "value_template", _value_template.c_str() },
+            { "availability_topic", topic+"/status" }
+        }
+    });
 }
 
 /**
@@ -344,22 +1042,324 @@ void mqtt_on_ad2cfg(std::string *msg, AD2PartitionState *s, void *arg)
     if (mqtt_client != nullptr) {
         // Publish our device HW/FW info.
         cJSON *root = ad2_get_ad2iot_device_info_json();
-        std::string topic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-        topic += mqttclient_UUID;
-        topic += "/info";
         char *state = cJSON_Print(root);
         cJSON_Minify(state);
 
-        // non blocking.
-        esp_mqtt_client_enqueue(mqtt_client,
-                                topic.c_str(),
-                                state,
-                                0,
-                                MQTT_DEF_QOS,
-                                MQTT_DEF_RETAIN,
-                                MQTT_DEF_STORE);
-        cJSON_free(state);
-        cJSON_Delete(root);
+        // non blocking. arg is nullptr when called from the MQTT task.
+        mqtt_publish(mqtt_topics.get(MQTT_TOPIC_INFO), state, MQTT_PRIO_STATE, true, arg != nullptr);
+        cJSON_free(state);
+        cJSON_Delete(root);
+    }
+}
+
+/**
+ * @brief Number of discovery items. Device, partitions, zones and switches.
+ */
+static int mqtt_discovery_items()
+{
+    return 1 + AD2_MAX_PARTITION + AD2_MAX_ZONES + mqtt_AD2EventSearches.size();
+}
+
+/**
+ * @brief Send the discovery configs for one item.
+ *
+ * @param [in]item int 0 to mqtt_discovery_items() - 1.
+ */
+static void mqtt_discovery_send_item(int item)
+{
+    if (item == 0) {
+        mqtt_send_device_configs();
+        return;
+    }
+    item--;
+    if (item < AD2_MAX_PARTITION) {
+        // only partitions configured with the 'partition' command.
+        AD2PartitionState *s = ad2_get_partition_state(item + 1);
+        if (s) {
+            mqtt_send_partition_config(s);
+        }
+        return;
+    }
+    item -= AD2_MAX_PARTITION;
+    if (item < AD2_MAX_ZONES) {
+        mqtt_send_zone_config(item + 1);
+        return;
+    }
+    item -= AD2_MAX_ZONES;
+    if (item < (int)mqtt_AD2EventSearches.size()) {
+        mqtt_send_switch_config(item);
+    }
+}
+
+/**
+ * @brief Forget every acknowledged discovery config so the next walk
+ * sends them all again.
+ */
+static void mqtt_discovery_forget()
+{
+    xSemaphoreTake(mqtt_discovery_mutex, portMAX_DELAY);
+    std::fill(mqtt_discovery_acked.begin(), mqtt_discovery_acked.end(), 0);
+    xSemaphoreGive(mqtt_discovery_mutex);
+}
+
+/**
+ * @brief Discovery task. Woken on every connect and walks every
+ * discovery item a few configs per tick. Configs the broker already
+ * acknowledged with the same content are skipped so a reconnect only
+ * sends what changed. Every refresh interval all configs are sent again
+ * in case the broker lost the retained configs. Stops on disconnect and
+ * starts over on the next connect.
+ *
+ * @param [in]pvParameters currently not used NULL.
+ */
+static void mqtt_discovery_task(void *pvParameters)
+{
+    while (1) {
+        uint32_t refresh_ms = mqtt_topics.getRefresh();
+        TickType_t wait = refresh_ms ? refresh_ms / portTICK_PERIOD_MS : portMAX_DELAY;
+        if (!ulTaskNotifyTake(pdTRUE, wait)) {
+            if (!mqtt_connected) {
+                continue;
+            }
+            // Refresh interval passed.
+            mqtt_discovery_forget();
+        }
+        // Finish a drain the MQTT task could not lock on connect.
+        mqtt_outbox_drain();
+        int item = 0;
+        while (mqtt_connected && item < mqtt_discovery_items()) {
+            // A new session restarts the walk.
+            if (ulTaskNotifyTake(pdTRUE, 0)) {
+                item = 0;
+            }
+
+            // Forget configs that were never acknowledged.
+            uint64_t now_ms = hal_uptime_us() / 1000;
+            xSemaphoreTake(mqtt_discovery_mutex, portMAX_DELAY);
+            for (auto it = mqtt_discovery_pending.begin(); it != mqtt_discovery_pending.end();) {
+                if (now_ms - it->second.sent_ms >= MQTT_DISC_ACK_TIMEOUT) {
+                    it = mqtt_discovery_pending.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            size_t inflight = mqtt_discovery_pending.size();
+            xSemaphoreGive(mqtt_discovery_mutex);
+
+            if (inflight < MQTT_DISC_INFLIGHT) {
+                uint32_t start = mqtt_discovery_stats.published;
+                while (item < mqtt_discovery_items() &&
+                        mqtt_discovery_stats.published - start < MQTT_DISC_BURST) {
+                    mqtt_discovery_send_item(item++);
+                }
+            }
+            vTaskDelay(MQTT_DISC_INTERVAL / portTICK_PERIOD_MS);
+        }
+    }
+}
+
+/**
+ * @brief Find a remote command action.
+ *
+ * @param [in]action const std::string & ex. "DISARM"
+ *
+ * @return int index in mqtt_command_actions or -1 if unknown.
+ */
+static int mqtt_find_command_action(const std::string &action)
+{
+    for (size_t n = 0; n < MQTT_COMMAND_ACTIONS; n++) {
+        if (action == mqtt_command_actions[n].action) {
+            return n;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Parse a command action 'RATE BURST' rate limit setting.
+ *
+ * @param [in]n size_t index in mqtt_command_actions.
+ * @param [in]setting const std::string & 'RATE BURST' or empty for the default.
+ * @param [out]rate float & commands per second. 0 no limit.
+ * @param [out]burst float & bucket size. At least 1.
+ *
+ * @return std::string config key.
+ */
+static std::string mqtt_command_rate(size_t n, const std::string &setting, float &rate, float &burst)
+{
+    std::string arg;
+    std::string value = setting.length() ? setting : mqtt_command_actions[n].rate;
+    ad2_copy_nth_arg(arg, value.c_str(), 0);
+    rate = std::max(0.0f, (float)atof(arg.c_str()));
+    arg = "";
+    ad2_copy_nth_arg(arg, value.c_str(), 1);
+    burst = std::max(1.0f, (float)atof(arg.c_str()));
+    std::string key = std::string(MQTT_CMDRATE_SUBCMD "_") + mqtt_command_actions[n].action;
+    ad2_lcase(key);
+    return key;
+}
+
+/**
+ * @brief Load the rate limit of every command action.
+ */
+static void mqtt_load_command_rates()
+{
+    uint64_t now_us = hal_uptime_us();
+    xSemaphoreTake(mqtt_cmdq_mutex, portMAX_DELAY);
+    mqtt_cmdq.setActions(MQTT_COMMAND_ACTIONS);
+    for (size_t n = 0; n < MQTT_COMMAND_ACTIONS; n++) {
+        float rate, burst;
+        std::string setting;
+        ad2_get_config_key_string(MQTT_CONFIG_SECTION, mqtt_command_rate(n, "", rate, burst).c_str(), setting);
+        mqtt_command_rate(n, setting, rate, burst);
+        mqtt_cmdq.setRate(n, rate, burst, now_us);
+    }
+    xSemaphoreGive(mqtt_cmdq_mutex);
+}
+
+/**
+ * @brief Parse and run one remote command and publish the result on
+ * the responses topic.
+ *
+ * {
+ *   id: {{ optional string or number returned in the response. }},
+ *   partition: {{ number partition ID see ```partition``` command. }},
+ *   code: '{{ string code }}',
+ *   action: '{{ string action }}',
+ *   arg: '{{ string argument }}'
+ * }
+ *
+ * @param [in]cmd mqtt_command_t & received command.
+ */
+static void mqtt_run_command(mqtt_command_t &cmd)
+{
+    uint64_t start_us = hal_uptime_us();
+    const char *result = "ok";
+    cJSON *reply = cJSON_CreateObject();
+    cJSON *root = cJSON_Parse(cmd.payload.c_str());
+    if (root) {
+        cJSON *oid = NULL;
+        cJSON *opart = NULL;
+        cJSON *ocode = NULL;
+        cJSON *oaction = NULL;
+        cJSON *oarg = NULL;
+        oid = cJSON_GetObjectItemCaseSensitive(root, "id");
+        opart = cJSON_GetObjectItemCaseSensitive(root, "partition");
+        ocode = cJSON_GetObjectItemCaseSensitive(root, "code");
+        oaction = cJSON_GetObjectItemCaseSensitive(root, "action");
+        oarg = cJSON_GetObjectItemCaseSensitive(root, "arg");
+
+        int partId = 1; // default partition
+        std::string code = "";
+        std::string action = "";
+        std::string arg = "";
+
+        if ( cJSON_IsNumber(opart) ) {
+            partId = opart->valuedouble;
+        }
+        if ( cJSON_IsString(ocode) ) {
+            code = ocode->valuestring;
+        }
+        if ( cJSON_IsString(oaction) && (oaction->valuestring != NULL) ) {
+            action = oaction->valuestring;
+        }
+        if ( cJSON_IsString(oarg) && (oarg->valuestring != NULL) ) {
+            arg = oarg->valuestring;
+        }
+
+        // Correlation ID is returned as sent.
+        if ( cJSON_IsString(oid) || cJSON_IsNumber(oid) ) {
+            cJSON_AddItemToObject(reply, "id", cJSON_Duplicate(oid, true));
+        }
+        cJSON_AddStringToObject(reply, "action", action.c_str());
+        cJSON_AddNumberToObject(reply, "partition", partId);
+
+        ESP_LOGI(TAG, "partition: %i, code: '%s', action: %s, arg: %s", partId, code.c_str(), action.c_str(), arg.c_str());
+
+        int n = mqtt_find_command_action(action);
+        xSemaphoreTake(mqtt_cmdq_mutex, portMAX_DELAY);
+        bool allowed = n >= 0 && mqtt_cmdq.take(n, start_us);
+        xSemaphoreGive(mqtt_cmdq_mutex);
+
+        if (n < 0) {
+            // unknown command
+            result = "unknown_action";
+        } else if (!allowed) {
+            result = "rate_limited";
+        } else if ( action.compare("DISARM") == 0 ) {
+            ad2_disarm(code, partId);
+        } else if ( action.compare("ARM_STAY") == 0 ) {
+            ad2_arm_stay(code, partId);
+        } else if ( action.compare("ARM_AWAY") == 0 ) {
+            ad2_arm_away(code, partId);
+        } else if ( action.compare("EXIT") == 0 ) {
+            ad2_exit_now(partId);
+        } else if ( action.compare("CHIME_TOGGLE") == 0 ) {
+            ad2_chime_toggle(code, partId);
+        } else if ( action.compare("AUX_ALARM") == 0 ) {
+            ad2_aux_alarm(partId);
+        } else if ( action.compare("PANIC_ALARM") == 0 ) {
+            ad2_panic_alarm(partId);
+        } else if ( action.compare("FIRE_ALARM") == 0 ) {
+            ad2_fire_alarm(partId);
+        } else if ( action.compare("BYPASS") == 0 ) {
+            ad2_bypass_zone(code, partId, std::atoi(arg.c_str()));
+        } else if ( action.compare("SEND_RAW") == 0 ) {
+            ad2_send(arg);
+        } else if ( action.compare("FW_UPDATE_IOT") == 0 ) {
+            hal_do_fwupdate("");
+        } else if ( action.compare("FW_UPDATE_AD2") == 0 ) {
+            ad2_fw_update(arg.c_str());
+        } else if ( action.compare("FW_CONFIG_IOT") == 0 ) {
+            ad2_config_update(arg.c_str());
+        }
+        cJSON_Delete(root);
+    } else {
+        // JSON parse error
+        ESP_LOGI(TAG, "json parse error '%s'", cmd.payload.c_str());
+        result = "parse_error";
+    }
+
+    // Latency is receive to hand off to the AD2 command queue.
+    uint64_t done_us = hal_uptime_us();
+    xSemaphoreTake(mqtt_cmdq_mutex, portMAX_DELAY);
+    if (strcmp(result, "ok") == 0) {
+        mqtt_cmdq.executed(done_us - cmd.received_us);
+    } else if (strcmp(result, "rate_limited") != 0) {
+        mqtt_cmdq.invalid();
+    }
+    xSemaphoreGive(mqtt_cmdq_mutex);
+
+    cJSON_AddStringToObject(reply, "result", result);
+    cJSON_AddNumberToObject(reply, "queue_ms", (start_us - cmd.received_us) / 1000);
+    cJSON_AddNumberToObject(reply, "latency_ms", (done_us - cmd.received_us) / 1000);
+    char *state = cJSON_Print(reply);
+    cJSON_Minify(state);
+    // Every response is kept. Not collapsed.
+    mqtt_publish(mqtt_topics.get(MQTT_TOPIC_RESPONSES), state, MQTT_PRIO_STATE, false);
+    cJSON_free(state);
+    cJSON_Delete(reply);
+}
+
+/**
+ * @brief Remote command task. Runs queued commands in order.
+ *
+ * @param [in]pvParameters void * unused.
+ */
+static void mqtt_command_task(void *pvParameters)
+{
+    mqtt_command_t cmd;
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        while (1) {
+            xSemaphoreTake(mqtt_cmdq_mutex, portMAX_DELAY);
+            bool ok = mqtt_cmdq.pop(cmd);
+            xSemaphoreGive(mqtt_cmdq_mutex);
+            if (!ok) {
+                break;
+            }
+            mqtt_run_command(cmd);
+        }
     }
 }
 
@@ -371,131 +1371,37 @@ void mqtt_on_ad2cfg(std::string *msg, AD2PartitionState *s, void *arg)
  */
 void mqtt_on_connect(esp_mqtt_client_handle_t client)
 {
-    std::string topic;
+#if CONFIG_MQTT_PROTOCOL_5
+    // Topic aliases start over.
+    mqtt5_session++;
+#endif
+
+    // New session. The broker may have lost retained state so send
+    // the next update on every topic even if unchanged.
+    xSemaphoreTake(mqtt_outbox_mutex, portMAX_DELAY);
+    mqtt_topics.invalidate();
+    xSemaphoreGive(mqtt_outbox_mutex);
 
     // Subscribe to command inputs for remote control if enabled.
     if (commands_enabled) {
         ESP_LOGI(TAG, "Warning! MQTT commands subscription enabled. This is NOT secure on public servers!");
-        topic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-        topic += mqttclient_UUID;
-        topic += "/" MQTT_COMMANDS_TOPIC;
         esp_mqtt_client_subscribe(client,
-                                  topic.c_str(),
+                                  mqtt_topics.get(MQTT_TOPIC_COMMANDS)->topic,
                                   MQTT_DEF_QOS);
     }
 
-    // Publish we are Online
-    topic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-    topic += mqttclient_UUID;
-    topic += "/status";
-
+    // Publish we are Online ahead of what was staged while offline.
     // non blocking.
-    esp_mqtt_client_enqueue(mqtt_client,
-                            topic.c_str(),
-                            "online",
-                            0,
-                            MQTT_DEF_QOS,
-                            MQTT_DEF_RETAIN,
-                            MQTT_DEF_STORE);
+    mqtt_publish(mqtt_topics.get(MQTT_TOPIC_STATUS), "online", MQTT_PRIO_ALARM, true, false);
 
     // Publish our device HW/FW info.
     mqtt_on_ad2cfg(nullptr, nullptr, nullptr);
 
     // set available version to current for now. Will be updated if new version available.
-    mqtt_send_fw_version(FIRMWARE_VERSION);
-
-    // Send firmware_update config
-    topic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-    topic += mqttclient_UUID;
-
-    std::string uuid_prefix = NAME_PREFIX;
-    uuid_prefix += "(";
-    uuid_prefix += mqttclient_UUID.substr(mqttclient_UUID.size() - 4);
-    uuid_prefix += ")";
-    std::string tmpstr = uuid_prefix + " Firmware";
-
-    mqtt_publish_device_config("binary_sensor", "update", "fw_version",
-                               0, false,
-    tmpstr.c_str(), false, {{
-            { "state_topic", topic+"/fw_version" },
-            { "value_template", "{% if value_json.installed != value_json.available %}ON{% else %}OFF{% endif %}" },
-            { "availability_topic", topic+"/status"}
-        }
-    });
-
-    tmpstr = uuid_prefix + " Start ad2iot firmware update";
-    mqtt_publish_device_config("button", "update", "fw_update",
-                               0, false,
-    tmpstr.c_str(), false, {{
-            { "availability_topic", topic+"/fw_version" },
-            { "availability_template", "{% if value_json.installed != value_json.available %}online{% else %}offline{% endif %}" },
-            { "command_topic", topic+"/commands" },
-            { "payload_press", "{\"action\": \"FW_UPDATE_IOT\"}" }
-        }
-    });
-
-    // Publish panel config info for home assistant or others for discovery
-    // for each partition that is configured with 'partition' command.
-    for (int n = 1; n <= AD2_MAX_PARTITION; n++) {
-        AD2PartitionState *s = ad2_get_partition_state(n);
-        if (s) {
-            mqtt_send_partition_config(s);
-        }
-    }
-
-    // Send all [zone N] descriptions
-    mqtt_send_configured_zone_configs();
-
-    // Send virtual switches in mqtt_AD2EventSearches
-    topic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-    topic += mqttclient_UUID;
-    for (auto &sw : mqtt_AD2EventSearches) {
-        // Grab the topic using the virtusal switch ID pre saved into INT_ARG
-        std::string description = "NA";
-        std::string key = std::string(MQTT_SWITCH_SUBCMD);
-        ad2_get_config_key_string(MQTT_CONFIG_SECTION,
-                                  MQTT_SWITCH_SUBCMD,
-                                  description,
-                                  sw->INT_ARG,
-                                  MQTT_CONFIG_SWITCH_SUFFIX_DESCRIPTION);
-
-        cJSON * root   = cJSON_Parse(description.c_str());
-
-        // default to type door and generic value_template
-        std::string _type = "door";
-        std::string _name = "N/A";
-        std::string _value_template = "{{value_json.state}}";
-
-        if (root) {
-            cJSON *otype = cJSON_GetObjectItemCaseSensitive(root, "type");
-            if ( cJSON_IsString(otype) ) {
-                _type = otype->valuestring;
-            }
-
-            cJSON *oname = cJSON_GetObjectItemCaseSensitive(root, "name");
-            if ( cJSON_IsString(oname) ) {
-                _name = oname->valuestring;
-            }
-
-            cJSON *ovalue_template = cJSON_GetObjectItemCaseSensitive(root, "value_template");
-            if ( cJSON_IsString(ovalue_template) ) {
-                _value_template = ovalue_template->valuestring;
-            }
-
-            cJSON_Delete(root);
-        }
-
-        mqtt_publish_device_config(
-            "binary_sensor", _type.c_str(), "switch_",
-            sw->INT_ARG, true,
-        _name.c_str(), false, {{
-                { "state_topic", topic+"/switches/"+std::to_string(sw->INT_ARG) },
-                { "value_template", _value_template.c_str() },
-                { "availability_topic", topic+"/status" }
-            }
-        });
-    }
+    mqtt_send_fw_version(FIRMWARE_VERSION, false);
 
+    // Home Assistant discovery configs are paced out by the discovery task.
+    xTaskNotifyGive(mqtt_discovery_task_handle);
 }
 
 /**
@@ -520,12 +1426,18 @@ static void ad2_mqtt_event_handler(void *handler_args, esp_event_base_t base, in
 #if defined(MQTT_EVENT_LOGGING)
         ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
 #endif
+        mqtt_connected = true;
         mqtt_on_connect(client);
         break;
     case MQTT_EVENT_DISCONNECTED:
 #if defined(MQTT_EVENT_LOGGING)
         ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
 #endif
+        // Unacknowledged configs are sent again next session.
+        mqtt_connected = false;
+        xSemaphoreTake(mqtt_discovery_mutex, portMAX_DELAY);
+        mqtt_discovery_pending.clear();
+        xSemaphoreGive(mqtt_discovery_mutex);
         break;
     case MQTT_EVENT_SUBSCRIBED:
 #if defined(MQTT_EVENT_LOGGING)
@@ -541,6 +1453,18 @@ static void ad2_mqtt_event_handler(void *handler_args, esp_event_base_t base, in
 #if defined(MQTT_EVENT_LOGGING)
         ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
 #endif
+        // Client outbox has room.
+        mqtt_outbox_drain(false);
+        xSemaphoreTake(mqtt_discovery_mutex, portMAX_DELAY);
+        {
+            auto it = mqtt_discovery_pending.find(event->msg_id);
+            if (it != mqtt_discovery_pending.end()) {
+                mqtt_discovery_acked[it->second.slot] = it->second.hash;
+                mqtt_discovery_stats.acked++;
+                mqtt_discovery_pending.erase(it);
+            }
+        }
+        xSemaphoreGive(mqtt_discovery_mutex);
         break;
     case MQTT_EVENT_DATA:
 #if defined(MQTT_EVENT_LOGGING)
@@ -552,14 +1476,10 @@ static void ad2_mqtt_event_handler(void *handler_args, esp_event_base_t base, in
         if ( commands_enabled ) {
             // Sanity test topic is the size of ```commands``` topic name.
             // Topic pattern to confirm command
-            std::string topic_path;
-            topic_path = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-            topic_path += mqttclient_UUID;
-            topic_path += "/" MQTT_COMMANDS_TOPIC;
+            const mqtt_topic_t *topic_path = mqtt_topics.get(MQTT_TOPIC_COMMANDS);
 
-            if ( event->topic_len == topic_path.length() ) {
-                std::string topic( event->topic, event->topic_len );
-                if ( topic.compare(topic_path) == 0 ) {
+            if ( event->topic_len == topic_path->len ) {
+                if ( memcmp(event->topic, topic_path->topic, topic_path->len) == 0 ) {
 
                     // We only want fresh messages no recordings.
                     // Check for retain flag skip if true.
@@ -569,78 +1489,15 @@ static void ad2_mqtt_event_handler(void *handler_args, esp_event_base_t base, in
 
                     // sanity check the event_data->data_len
                     if ( event->data_len < MQTT_COMMAND_MAX_DATA_LEN ) {
-                        std::string command( event->data, event->data_len );
-                        // grab the json buffer
-                        // {
-                        //   partition: {{ number partition ID see ```partition``` command. }},
-                        //   code: '{{ string code }}',
-                        //   action: '{{ string action }}',
-                        //   arg: '{{ string argument }}'
-                        // }
-                        cJSON * root   = cJSON_Parse( command.c_str() );
-                        if (root) {
-                            cJSON *opart = NULL;
-                            cJSON *ocode = NULL;
-                            cJSON *oaction = NULL;
-                            cJSON *oarg = NULL;
-                            opart = cJSON_GetObjectItemCaseSensitive(root, "partition");
-                            ocode = cJSON_GetObjectItemCaseSensitive(root, "code");
-                            oaction = cJSON_GetObjectItemCaseSensitive(root, "action");
-                            oarg = cJSON_GetObjectItemCaseSensitive(root, "arg");
-
-                            int partId = 1; // default partition
-                            std::string code = "";
-                            std::string action = "";
-                            std::string arg = "";
-
-                            if ( cJSON_IsNumber(opart) ) {
-                                partId = opart->valuedouble;
-                            }
-                            if ( cJSON_IsString(ocode) ) {
-                                code = ocode->valuestring;
-                            }
-                            if ( cJSON_IsString(oaction) && (oaction->valuestring != NULL) ) {
-                                action = oaction->valuestring;
-                            }
-                            if ( cJSON_IsString(oarg) && (oarg->valuestring != NULL) ) {
-                                arg = oarg->valuestring;
-                            }
-
-                            ESP_LOGI(TAG, "partition: %i, code: '%s', action: %s, arg: %s", partId, code.c_str(), action.c_str(), arg.c_str());
-
-                            if ( action.compare("DISARM") == 0 ) {
-                                ad2_disarm(code, partId);
-                            } else if ( action.compare("ARM_STAY") == 0 ) {
-                                ad2_arm_stay(code, partId);
-                            } else if ( action.compare("ARM_AWAY") == 0 ) {
-                                ad2_arm_away(code, partId);
-                            } else if ( action.compare("EXIT") == 0 ) {
-                                ad2_exit_now(partId);
-                            } else if ( action.compare("CHIME_TOGGLE") == 0 ) {
-                                ad2_chime_toggle(code, partId);
-                            } else if ( action.compare("AUX_ALARM") == 0 ) {
-                                ad2_aux_alarm(partId);
-                            } else if ( action.compare("PANIC_ALARM") == 0 ) {
-                                ad2_panic_alarm(partId);
-                            } else if ( action.compare("FIRE_ALARM") == 0 ) {
-                                ad2_fire_alarm(partId);
-                            } else if ( action.compare("BYPASS") == 0 ) {
-                                ad2_bypass_zone(code, partId, std::atoi(arg.c_str()));
-                            } else if ( action.compare("SEND_RAW") == 0 ) {
-                                ad2_send(arg);
-                            } else if ( action.compare("FW_UPDATE_IOT") == 0 ) {
-                                hal_do_fwupdate("");
-                            } else if ( action.compare("FW_UPDATE_AD2") == 0 ) {
-                                ad2_fw_update(arg.c_str());
-                            } else if ( action.compare("FW_CONFIG_IOT") == 0 ) {
-                                ad2_config_update(arg.c_str());
-                            } else {
-                                // unknown command
-                            }
-                            cJSON_Delete(root);
+                        // Parsed and run on the command task so a burst of
+                        // commands does not hold up keepalive and publishing.
+                        xSemaphoreTake(mqtt_cmdq_mutex, portMAX_DELAY);
+                        bool queued = mqtt_cmdq.push(event->data, event->data_len, hal_uptime_us());
+                        xSemaphoreGive(mqtt_cmdq_mutex);
+                        if (queued) {
+                            xTaskNotifyGive(mqtt_command_task_handle);
                         } else {
-                            // JSON parse error
-                            ESP_LOGI(TAG, "json parse error '%s'", command.c_str());
+                            ESP_LOGE(TAG, "MQTT command queue full. Command dropped.");
                         }
                     } else {
                         ESP_LOGI(TAG, "invalid data len");
@@ -656,6 +1513,19 @@ static void ad2_mqtt_event_handler(void *handler_args, esp_event_base_t base, in
     case MQTT_EVENT_ERROR:
 #if defined(MQTT_EVENT_LOGGING)
         ESP_LOGI(TAG, "MQTT_EVENT_ERROR");
+#endif
+#if CONFIG_MQTT_PROTOCOL_5
+        // A 3.1.1 broker refuses the MQTT 5 CONNECT. Fall back to 3.1.1
+        // for the next connect.
+        if (mqtt5_active && event->error_handle &&
+                event->error_handle->error_type == MQTT_ERROR_TYPE_CONNECTION_REFUSED &&
+                ((int)event->error_handle->connect_return_code == MQTT_CONNECTION_REFUSE_PROTOCOL ||
+                 (int)event->error_handle->connect_return_code == MQTT5_UNSUPPORTED_PROTOCOL_VER)) {
+            ESP_LOGE(TAG, "Broker refused MQTT 5. Using MQTT 3.1.1.");
+            mqtt5_active = false;
+            mqtt_client_cfg.session.protocol_ver = MQTT_PROTOCOL_V_3_1_1;
+            esp_mqtt_set_config(client, &mqtt_client_cfg);
+        }
 #endif
         break;
     default:
@@ -667,6 +1537,87 @@ static void ad2_mqtt_event_handler(void *handler_args, esp_event_base_t base, in
 
 }
 
+/**
+ * @brief Publish a finished raw batch. Never collapsed and never
+ * recorded in the publish-if-changed cache so a lost batch does not
+ * invalidate the state topics. Consumers see the gap in the sequence.
+ *
+ * @param [in]payload std::string & batch payload.
+ */
+static void mqtt_publish_raw(const std::string &payload)
+{
+    if (!mqtt_publish(mqtt_topics.get(MQTT_TOPIC_RAW), payload.data(),
+                      MQTT_PRIO_RAW, false, true, payload.length())) {
+        xSemaphoreTake(mqtt_raw_mutex, portMAX_DELAY);
+        mqtt_raw.dropped();
+        xSemaphoreGive(mqtt_raw_mutex);
+    }
+}
+
+/**
+ * @brief Raw batch window timer. Sends a batch that did not fill its
+ * byte budget before the window ended.
+ *
+ * @param [in]xTimer TimerHandle_t
+ */
+static void mqtt_raw_timer_cb(TimerHandle_t xTimer)
+{
+    std::string payload;
+    xSemaphoreTake(mqtt_raw_mutex, portMAX_DELAY);
+    bool ready = mqtt_raw.flush(hal_uptime_us() / 1000, true, payload);
+    xSemaphoreGive(mqtt_raw_mutex);
+    if (ready) {
+        mqtt_publish_raw(payload);
+    }
+}
+
+/**
+ * @brief ON_RAW_MESSAGE callback. Adds every panel message to the raw
+ * batch and publishes the batch when it is full or its window ended.
+ *
+ * @param [in]msg std::string panel message.
+ * @param [in]s AD2PartitionState *.
+ * @param [in]arg cast as int for event type (ON_RAW_MESSAGE).
+ *
+ */
+void mqtt_on_raw(std::string *msg, AD2PartitionState *s, void *arg)
+{
+    if (mqtt_client == nullptr) {
+        return;
+    }
+    std::string payload;
+    std::string late;
+    std::string held;
+    uint64_t now_ms = hal_uptime_us() / 1000;
+    xSemaphoreTake(mqtt_raw_mutex, portMAX_DELAY);
+    if (!mqtt_raw.enabled()) {
+        xSemaphoreGive(mqtt_raw_mutex);
+        return;
+    }
+    // Timer may be behind. Send the old batch before adding.
+    bool late_ready = mqtt_raw.flush(now_ms, false, late);
+    bool start = mqtt_raw.empty();
+    bool ready = mqtt_raw.add(msg->data(), msg->length(), now_ms, payload);
+    // An oversized line that followed a full batch is its own batch.
+    bool held_ready = mqtt_raw.pop(held);
+    // A new batch starts the window.
+    bool restart = start || (ready && !mqtt_raw.empty());
+    xSemaphoreGive(mqtt_raw_mutex);
+
+    if (restart) {
+        xTimerReset(mqtt_raw_timer, 0);
+    }
+    if (late_ready) {
+        mqtt_publish_raw(late);
+    }
+    if (ready) {
+        mqtt_publish_raw(payload);
+    }
+    if (held_ready) {
+        mqtt_publish_raw(held);
+    }
+}
+
 /**
  * @brief ON_LRR callback for all AlarmDecoder API event subscriptions.
  *
@@ -677,12 +1628,14 @@ static void ad2_mqtt_event_handler(void *handler_args, esp_event_base_t base, in
  */
 void mqtt_on_lrr(std::string *msg, AD2PartitionState *s, void *arg)
 {
-    int msg_id;
-    if (mqtt_client != nullptr) {
-        std::string sTopic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-        sTopic+=mqttclient_UUID;
-        sTopic+="/cid";
-
+    if (mqtt_client != nullptr && (mqtt_cbor_mask & MQTT_CBOR_CID)) {
+        std::string payload;
+        ad2_cbor_lrr_event(payload, *msg);
+        if (!mqtt_publish(mqtt_topics.get(MQTT_TOPIC_CID), payload.data(), MQTT_PRIO_ALARM, false,
+                          true, payload.length())) {
+            ESP_LOGE(TAG, "MQTT outbox full. Contact ID event dropped.");
+        }
+    } else if (mqtt_client != nullptr) {
         cJSON *root = cJSON_CreateObject();
         cJSON_AddStringToObject(root, "event_message", msg->c_str());
 
@@ -690,13 +1643,10 @@ void mqtt_on_lrr(std::string *msg, AD2PartitionState *s, void *arg)
         cJSON_Minify(state);
 
         // Non blocking. We must not block AlarmDecoderParser
-        msg_id = esp_mqtt_client_enqueue(mqtt_client,
-                                         sTopic.c_str(),
-                                         state,
-                                         0,
-                                         MQTT_DEF_QOS,
-                                         MQTT_DEF_RETAIN,
-                                         MQTT_DEF_STORE);
+        // Every event is kept. Not collapsed.
+        if (!mqtt_publish(mqtt_topics.get(MQTT_TOPIC_CID), state, MQTT_PRIO_ALARM, false)) {
+            ESP_LOGE(TAG, "MQTT outbox full. Contact ID event dropped.");
+        }
 
         cJSON_free(state);
         cJSON_Delete(root);
@@ -728,36 +1678,33 @@ void on_new_firmware_cb(std::string *msg, AD2PartitionState *s, void *arg)
 void mqtt_on_zone_change(std::string *msg, AD2PartitionState *s, void *arg)
 {
     int msg_id;
-    if (mqtt_client != nullptr && s) {
-        std::string sTopic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-        sTopic+=mqttclient_UUID;
-        sTopic+="/zones/";
-
-        // Append the zone to the topic string
-        sTopic+=std::to_string((int)s->zone);
-
-        cJSON *root = cJSON_CreateObject();
+    const mqtt_topic_t *topic;
+    if (mqtt_client != nullptr && s && (topic = mqtt_topics.zone((int)s->zone))) {
         std::string buf;
         // grab the verb(FOO) 'ZONE FOO 001'
         ad2_copy_nth_arg(buf, (char *)s->last_event_message.c_str(), 1);
+        std::string zalpha;
+        AD2Parse.getZoneString((int)s->zone, zalpha);
+        bool system = s->zone_states[s->zone].is_system();
+
+        if (mqtt_cbor_mask & MQTT_CBOR_ZONES) {
+            std::string payload;
+            ad2_cbor_zone_state(payload, buf, s->partition, s->address_mask_filter, system, zalpha);
+            mqtt_publish_state(topic, payload.data(), MQTT_PRIO_ZONE, payload.length(), buf.c_str());
+            return;
+        }
+
+        cJSON *root = cJSON_CreateObject();
         cJSON_AddStringToObject(root, "state", buf.c_str());
         cJSON_AddNumberToObject(root, "partition", s->partition);
         cJSON_AddNumberToObject(root, "mask", s->address_mask_filter);
-        cJSON_AddBoolToObject(root, "system", s->zone_states[s->zone].is_system());
-        std::string zalpha;
-        AD2Parse.getZoneString((int)s->zone, zalpha);
+        cJSON_AddBoolToObject(root, "system", system);
         cJSON_AddStringToObject(root, "name", zalpha.c_str());
         char *state = cJSON_Print(root);
         cJSON_Minify(state);
 
-        // Non blocking. We must not block AlarmDecoderParser
-        msg_id = esp_mqtt_client_enqueue(mqtt_client,
-                                         sTopic.c_str(),
-                                         state,
-                                         0,
-                                         MQTT_DEF_QOS,
-                                         MQTT_DEF_RETAIN,
-                                         MQTT_DEF_STORE);
+        // Skipped if the zone state has not changed.
+        msg_id = mqtt_publish_state(topic, state, MQTT_PRIO_ZONE, 0, buf.c_str());
         cJSON_free(state);
         cJSON_Delete(root);
     }
@@ -774,26 +1721,27 @@ void mqtt_on_zone_change(std::string *msg, AD2PartitionState *s, void *arg)
 void mqtt_on_state_change(std::string *msg, AD2PartitionState *s, void *arg)
 {
     int msg_id;
-    if (mqtt_client != nullptr && s) {
-        std::string sTopic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-        sTopic+=mqttclient_UUID;
-        sTopic+="/partitions/";
-        sTopic+=std::to_string(s->partition);
+    const mqtt_topic_t *topic;
+    if (mqtt_client != nullptr && s && (topic = mqtt_topics.partition(s->partition))) {
+        if (mqtt_cbor_mask & MQTT_CBOR_PARTITIONS) {
+            std::string payload;
+            ad2_cbor_partition_state(payload, s, AD2Parse.event_str[(int)arg]);
+            if (mqtt_publish_state(topic, payload.data(), MQTT_PRIO_ALARM, payload.length(),
+                                   AD2Parse.event_str[(int)arg].c_str()) == -1) {
+                ESP_LOGE(TAG, "MQTT outbox full. Partition state dropped.");
+            }
+            return;
+        }
+
         cJSON *root = ad2_get_partition_state_json(s);
         cJSON_AddStringToObject(root, "event", AD2Parse.event_str[(int)arg].c_str());
         char *state = cJSON_Print(root);
         cJSON_Minify(state);
 
-        // Non blocking. We must not block AlarmDecoderParser
-        msg_id = esp_mqtt_client_enqueue(mqtt_client,
-                                         sTopic.c_str(),
-                                         state,
-                                         0,
-                                         MQTT_DEF_QOS,
-                                         MQTT_DEF_RETAIN,
-                                         MQTT_DEF_STORE);
+        // Skipped if the partition state has not changed.
+        msg_id = mqtt_publish_state(topic, state, MQTT_PRIO_ALARM, 0, AD2Parse.event_str[(int)arg].c_str());
         if (msg_id == -1) {
-            ESP_LOGE(TAG, "esp_mqtt_client_enqueue failed.");
+            ESP_LOGE(TAG, "MQTT outbox full. Partition state dropped.");
         }
         cJSON_free(state);
         cJSON_Delete(root);
@@ -814,46 +1762,48 @@ void mqtt_free()
 
 /**
  * @brief Search match callback.
- * Called when the current message matches a AD2EventSearch test.
+ * Called when a shared virtual switch changes state.
  *
- * @param [in]msg std::string new version string.
- * @param [in]s nullptr
+ * @param [in]msg std::string * message that changed the state.
+ * @param [in]es AD2EventSearch * switch.
+ * @param [in]message const std::string & output string for the new state.
  * @param [in]arg nullptr.
  *
  */
-void on_search_match_cb_mqtt(std::string *msg, AD2PartitionState *s, void *arg)
+void on_search_match_cb_mqtt(std::string *msg, AD2EventSearch *es, const std::string &message, void *arg)
 {
-    AD2EventSearch *es = (AD2EventSearch *)arg;
 #if defined(MQTT_DEBUG)
-    ESP_LOGI(TAG, "ON_SEARCH_MATCH_CB: '%s' -> '%s' [switch %i]", msg->c_str(), es->out_message.c_str(), es->INT_ARG);
+    ESP_LOGI(TAG, "ON_SEARCH_MATCH_CB: '%s' -> '%s' [switch %i]", msg->c_str(), message.c_str(), es->INT_ARG);
 #endif
-    std::string message = es->out_message;
 
     // Grab the topic using the virtual switch ID pre saved into INT_ARG
     // publishing event
     int msg_id;
-    if (mqtt_client != nullptr) {
-        std::string sTopic = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-        sTopic+=mqttclient_UUID;
-        sTopic+="/switches/";
-        sTopic+=std::to_string(es->INT_ARG);
-        cJSON *root = cJSON_CreateObject();
-        cJSON_AddStringToObject(root, "state", es->out_message.c_str());
-        char *state = cJSON_Print(root);
-        cJSON_Minify(state);
-
-        // Non blocking. We must not block AlarmDecoderParser
-        msg_id = esp_mqtt_client_enqueue(mqtt_client,
-                                         sTopic.c_str(),
-                                         state,
-                                         0,
-                                         MQTT_DEF_QOS,
-                                         MQTT_DEF_RETAIN,
-                                         MQTT_DEF_STORE);
-
-        if (msg_id) {
-            ESP_LOGI(TAG,"Switch #%i match message '%s'. Sending '%s'", es->INT_ARG, msg->c_str(), es->out_message.c_str());
+    const mqtt_topic_t *topic;
+    if (mqtt_client != nullptr && (topic = mqtt_topics.sw(es->INT_ARG))) {
+        cJSON *root = nullptr;
+        char *state = nullptr;
+        std::string payload;
+        if (mqtt_cbor_mask & MQTT_CBOR_SWITCHES) {
+            ad2_cbor_switch_state(payload, message, es->getSuppressed());
         } else {
+            root = cJSON_CreateObject();
+            cJSON_AddStringToObject(root, "state", message.c_str());
+            // Flap suppression summary. Number of changes folded into this state.
+            if (es->getSuppressed()) {
+                cJSON_AddNumberToObject(root, "suppressed", es->getSuppressed());
+            }
+            state = cJSON_Print(root);
+            cJSON_Minify(state);
+            payload = state;
+        }
+
+        // Skipped if the switch state has not changed.
+        msg_id = mqtt_publish_state(topic, payload.data(), MQTT_PRIO_STATE, payload.length());
+
+        if (msg_id > 0) {
+            ESP_LOGI(TAG,"Switch #%i match message '%s'. Sending '%s'", es->INT_ARG, msg->c_str(), message.c_str());
+        } else if (msg_id == -1) {
             ESP_LOGE(TAG,"Error adding mqtt message.");
         }
 
@@ -873,7 +1823,17 @@ enum {
     MQTT_CMDEN_SUBCMD_ID,
     MQTT_TPREFIX_SUBCMD_ID,
     MQTT_DPREFIX_SUBCMD_ID,
-    MQTT_SWITCH_SUBCMD_ID
+    MQTT_SWITCH_SUBCMD_ID,
+    MQTT_REFRESH_SUBCMD_ID,
+    MQTT_STATS_SUBCMD_ID,
+    MQTT_OUTBOX_SUBCMD_ID,
+    MQTT_RAW_SUBCMD_ID,
+    MQTT_CBOR_SUBCMD_ID,
+    MQTT_QOS_SUBCMD_ID,
+    MQTT_RETAIN_SUBCMD_ID,
+    MQTT_CMDRATE_SUBCMD_ID,
+    MQTT_EXPIRY_SUBCMD_ID,
+    MQTT_PROTOCOL_SUBCMD_ID
 };
 char * MQTT_SUBCMD [] = {
     (char*)MQTT_ENABLE_SUBCMD,
@@ -882,6 +1842,16 @@ char * MQTT_SUBCMD [] = {
     (char*)MQTT_TPREFIX_SUBCMD,
     (char*)MQTT_DPREFIX_SUBCMD,
     (char*)MQTT_SWITCH_SUBCMD,
+    (char*)MQTT_REFRESH_SUBCMD,
+    (char*)MQTT_STATS_SUBCMD,
+    (char*)MQTT_OUTBOX_SUBCMD,
+    (char*)MQTT_RAW_SUBCMD,
+    (char*)MQTT_CBOR_SUBCMD,
+    (char*)MQTT_QOS_SUBCMD,
+    (char*)MQTT_RETAIN_SUBCMD,
+    (char*)MQTT_CMDRATE_SUBCMD,
+    (char*)MQTT_EXPIRY_SUBCMD,
+    (char*)MQTT_PROTOCOL_SUBCMD,
     0 // EOF
 };
 
@@ -988,7 +1958,7 @@ static void _cli_cmd_mqtt_command_router(const char *string)
                 if (ad2_copy_nth_arg(arg, string, 2) >= 0) {
                     ad2_set_config_key_bool(
                         MQTT_CONFIG_SECTION, MQTT_ENABLE_SUBCMD,
-                        (arg[0] == 'Y' || arg[0] ==  'y')
+                        (arg[0] == 'Y' || arg[0] == 'y')
                     );
                     ad2_printf_host(false, "Success setting value. Restart required to take effect.\r\n");
                 }
@@ -1023,9 +1993,9 @@ static void _cli_cmd_mqtt_command_router(const char *string)
                     ad2_set_config_key_bool(
                         MQTT_CONFIG_SECTION,
                         MQTT_CMDEN_SUBCMD,
-                        (arg[0] == 'Y' || arg[0] ==  'y')
+                        (arg[0] == 'Y' || arg[0] == 'y')
                     );
-                    if ((arg[0] == 'Y' || arg[0] ==  'y')) {
+                    if ((arg[0] == 'Y' || arg[0] == 'y')) {
                         ad2_printf_host(false, "Warning! Enabling commands on a public sever will allow anyone to send commands to the panel. Be sure this is only enabled on private servers or servers with publish permissions.\r\n");
                     }
                     ad2_printf_host(false, "Success setting value. Restart required to take effect.\r\n");
@@ -1076,6 +2046,279 @@ static void _cli_cmd_mqtt_command_router(const char *string)
                 _cli_cmd_mqtt_smart_alert_switch(subcmd, string);
                 break;
 
+            /**
+             * MQTT retained state forced refresh interval
+             */
+            case MQTT_REFRESH_SUBCMD_ID:   // 'refresh' sub command
+                if (ad2_copy_nth_arg(arg, string, 2) >= 0) {
+                    int seconds = std::atoi(arg.c_str());
+                    if (seconds < 0) {
+                        ad2_printf_host(false, "Invalid refresh seconds '%s'.\r\n", arg.c_str());
+                        break;
+                    }
+                    ad2_set_config_key_int(MQTT_CONFIG_SECTION, MQTT_REFRESH_SUBCMD, seconds);
+                    mqtt_topics.setRefresh(seconds * 1000);
+                    // Send every discovery config again now.
+                    if (mqtt_discovery_task_handle) {
+                        mqtt_discovery_forget();
+                        xTaskNotifyGive(mqtt_discovery_task_handle);
+                    }
+                    ad2_printf_host(false, "Success setting value.\r\n");
+                }
+                ad2_printf_host(false, "MQTT unchanged state refresh set to %u seconds.\r\n", mqtt_topics.getRefresh() / 1000);
+                break;
+
+            /**
+             * MQTT publish counters
+             */
+            case MQTT_STATS_SUBCMD_ID: { // 'stats' sub command
+                xSemaphoreTake(mqtt_outbox_mutex, portMAX_DELAY);
+                mqtt_publish_stats_t ps = mqtt_topics.getStats();
+                xSemaphoreGive(mqtt_outbox_mutex);
+                ad2_printf_host(false, "MQTT topics(%u) topic bytes(%u)\r\n",
+                                (unsigned)mqtt_topics.count(), (unsigned)mqtt_topics.bytes());
+                ad2_printf_host(false, "MQTT state published(%u) suppressed unchanged(%u) refreshed(%u)\r\n",
+                                ps.published, ps.suppressed, ps.refreshed);
+                xSemaphoreTake(mqtt_discovery_mutex, portMAX_DELAY);
+                mqtt_discovery_stats_t ds = mqtt_discovery_stats;
+                unsigned pending = mqtt_discovery_pending.size();
+                xSemaphoreGive(mqtt_discovery_mutex);
+                ad2_printf_host(false, "MQTT discovery published(%u) unchanged(%u) acknowledged(%u) pending(%u)\r\n",
+                                ds.published, ds.unchanged, ds.acked, pending);
+                xSemaphoreTake(mqtt_outbox_mutex, portMAX_DELAY);
+                mqtt_outbox_stats_t os = mqtt_outbox.getStats();
+                xSemaphoreGive(mqtt_outbox_mutex);
+                ad2_printf_host(false, "MQTT outbox depth(%u) bytes(%u) peak bytes(%u) queued(%u) sent(%u) collapsed(%u) dropped(%u) expired(%u)\r\n",
+                                os.depth, os.bytes, os.peak_bytes, os.queued, os.sent, os.collapsed, os.dropped, os.expired);
+#if CONFIG_MQTT_PROTOCOL_5
+                xSemaphoreTake(mqtt_drain_mutex, portMAX_DELAY);
+                mqtt5_stats_t m5 = mqtt5_stats;
+                xSemaphoreGive(mqtt_drain_mutex);
+                ad2_printf_host(false, "MQTT 5 aliased(%u) topic bytes saved(%u) expiring(%u) user properties(%u)\r\n",
+                                m5.aliased, m5.alias_bytes, m5.expiring, m5.properties);
+#endif
+                if (mqtt_client) {
+                    ad2_printf_host(false, "MQTT client outbox bytes(%i)\r\n", esp_mqtt_client_get_outbox_size(mqtt_client));
+                }
+                xSemaphoreTake(mqtt_raw_mutex, portMAX_DELAY);
+                mqtt_raw_stats_t rs = mqtt_raw.getStats();
+                xSemaphoreGive(mqtt_raw_mutex);
+                ad2_printf_host(false, "MQTT raw lines(%u) batches(%u) bytes(%u) dropped(%u)\r\n",
+                                rs.lines, rs.batches, rs.bytes, rs.dropped);
+                xSemaphoreTake(mqtt_cmdq_mutex, portMAX_DELAY);
+                mqtt_cmdq_stats_t cs = mqtt_cmdq.getStats();
+                xSemaphoreGive(mqtt_cmdq_mutex);
+                ad2_printf_host(false, "MQTT commands received(%u) executed(%u) rate limited(%u) invalid(%u) dropped(%u) depth(%u max %u) latency max(%ums)\r\n",
+                                cs.received, cs.executed, cs.rate_limited, cs.invalid, cs.dropped,
+                                cs.depth, cs.max_depth, cs.latency_max_ms);
+                break;
+            }
+
+            /**
+             * MQTT outbox limits
+             */
+            case MQTT_OUTBOX_SUBCMD_ID: { // 'outbox' sub command
+                int bytes = MQTT_DEF_OUTBOX_BYTES;
+                int count = MQTT_DEF_OUTBOX_COUNT;
+                if (ad2_copy_nth_arg(arg, string, 2) >= 0) {
+                    bytes = std::atoi(arg.c_str());
+                    count = 0;
+                    if (ad2_copy_nth_arg(arg, string, 3) >= 0) {
+                        count = std::atoi(arg.c_str());
+                    }
+                    if (bytes < 1024 || count < 1) {
+                        ad2_printf_host(false, "Invalid outbox limits. Minimum 1024 bytes and 1 message.\r\n");
+                        break;
+                    }
+                    ad2_set_config_key_int(MQTT_CONFIG_SECTION, MQTT_OUTBOX_BYTES_KEY, bytes);
+                    ad2_set_config_key_int(MQTT_CONFIG_SECTION, MQTT_OUTBOX_COUNT_KEY, count);
+                    xSemaphoreTake(mqtt_outbox_mutex, portMAX_DELAY);
+                    mqtt_outbox.setLimits(bytes, count);
+                    xSemaphoreGive(mqtt_outbox_mutex);
+                    ad2_printf_host(false, "Success setting value.\r\n");
+                } else {
+                    ad2_get_config_key_int(MQTT_CONFIG_SECTION, MQTT_OUTBOX_BYTES_KEY, &bytes);
+                    ad2_get_config_key_int(MQTT_CONFIG_SECTION, MQTT_OUTBOX_COUNT_KEY, &count);
+                }
+                ad2_printf_host(false, "MQTT outbox limits %i bytes %i messages.\r\n", bytes, count);
+                break;
+            }
+
+            /**
+             * MQTT raw message stream
+             */
+            case MQTT_RAW_SUBCMD_ID: { // 'raw' sub command
+                int window = 0;
+                int bytes = MQTT_DEF_RAW_BYTES;
+                std::string format = "nl";
+                ad2_get_config_key_int(MQTT_CONFIG_SECTION, MQTT_RAW_WINDOW_KEY, &window);
+                ad2_get_config_key_int(MQTT_CONFIG_SECTION, MQTT_RAW_BYTES_KEY, &bytes);
+                ad2_get_config_key_string(MQTT_CONFIG_SECTION, MQTT_RAW_FORMAT_KEY, format);
+                if (ad2_copy_nth_arg(arg, string, 2) >= 0) {
+                    window = std::atoi(arg.c_str());
+                    if (ad2_copy_nth_arg(arg, string, 3) >= 0) {
+                        bytes = std::atoi(arg.c_str());
+                    }
+                    if (ad2_copy_nth_arg(arg, string, 4) >= 0) {
+                        format = arg;
+                    }
+                    if (window < 0 || bytes < 64 || (format != "nl" && format != "len")) {
+                        ad2_printf_host(false, "Invalid raw settings. window >= 0, bytes >= 64 and format nl or len.\r\n");
+                        break;
+                    }
+                    ad2_set_config_key_int(MQTT_CONFIG_SECTION, MQTT_RAW_WINDOW_KEY, window);
+                    ad2_set_config_key_int(MQTT_CONFIG_SECTION, MQTT_RAW_BYTES_KEY, bytes);
+                    ad2_set_config_key_string(MQTT_CONFIG_SECTION, MQTT_RAW_FORMAT_KEY, format.c_str());
+                    xSemaphoreTake(mqtt_raw_mutex, portMAX_DELAY);
+                    mqtt_raw.setLimits(window, bytes, format == "len" ? MQTT_RAW_LENGTH : MQTT_RAW_NEWLINE);
+                    xSemaphoreGive(mqtt_raw_mutex);
+                    if (mqtt_raw_timer && window) {
+                        xTimerChangePeriod(mqtt_raw_timer, window / portTICK_PERIOD_MS ? window / portTICK_PERIOD_MS : 1, 0);
+                        xTimerStop(mqtt_raw_timer, 0);
+                    }
+                    ad2_printf_host(false, "Success setting value.\r\n");
+                }
+                ad2_printf_host(false, "MQTT raw window %i ms %i bytes format %s.\r\n", window, bytes, format.c_str());
+                break;
+            }
+
+            /**
+             * MQTT CBOR payload topic prefixes
+             */
+            case MQTT_CBOR_SUBCMD_ID: { // 'cbor' sub command
+                std::string prefixes;
+                if (ad2_copy_nth_arg(arg, string, 2, true) >= 0) {
+                    if (arg == "-") {
+                        arg = "";
+                    }
+                    uint8_t mask;
+                    if (!mqtt_parse_cbor_prefixes(arg, mask)) {
+                        ad2_printf_host(false, "Invalid topic prefix in '%s'.\r\n", arg.c_str());
+                        break;
+                    }
+                    ad2_set_config_key_string(MQTT_CONFIG_SECTION, MQTT_CBOR_SUBCMD, arg.c_str());
+                    mqtt_cbor_mask = mask;
+                    ad2_printf_host(false, "Success setting value.\r\n");
+                }
+                ad2_get_config_key_string(MQTT_CONFIG_SECTION, MQTT_CBOR_SUBCMD, prefixes);
+                ad2_printf_host(false, "MQTT CBOR topic prefixes '%s'.\r\n", prefixes.c_str());
+                break;
+            }
+
+            /**
+             * MQTT topic class QoS, retain flag and expiry
+             */
+            case MQTT_QOS_SUBCMD_ID:      // 'qos' sub command
+            case MQTT_RETAIN_SUBCMD_ID:   // 'retain' sub command
+            case MQTT_EXPIRY_SUBCMD_ID: { // 'expiry' sub command
+                int cls = -1;
+                if (ad2_copy_nth_arg(arg, string, 2) >= 0) {
+                    cls = mqtt_find_class(arg);
+                    if (cls < 0) {
+                        ad2_printf_host(false, "Invalid topic class '%s'.\r\n", arg.c_str());
+                        break;
+                    }
+                    if (ad2_copy_nth_arg(arg, string, 3) >= 0) {
+                        mqtt_class_options_t opt = mqtt_topics.getOptions((mqtt_topic_class_t)cls);
+                        std::string key = std::string(mqtt_class_names[cls]) + "_" + MQTT_SUBCMD[i];
+                        if (i == MQTT_QOS_SUBCMD_ID) {
+                            int qos = std::atoi(arg.c_str());
+                            if (arg.length() != 1 || qos < 0 || qos > 2) {
+                                ad2_printf_host(false, "Invalid QoS '%s'. Must be 0, 1 or 2.\r\n", arg.c_str());
+                                break;
+                            }
+                            ad2_set_config_key_int(MQTT_CONFIG_SECTION, key.c_str(), qos);
+                            opt.qos = qos;
+                        } else if (i == MQTT_RETAIN_SUBCMD_ID) {
+                            opt.retain = (arg[0] == 'Y' || arg[0] == 'y');
+                            ad2_set_config_key_bool(MQTT_CONFIG_SECTION, key.c_str(), opt.retain);
+                        } else {
+                            int seconds = std::atoi(arg.c_str());
+                            if (seconds < 0) {
+                                ad2_printf_host(false, "Invalid expiry seconds '%s'.\r\n", arg.c_str());
+                                break;
+                            }
+                            ad2_set_config_key_int(MQTT_CONFIG_SECTION, key.c_str(), seconds);
+                            opt.expiry = seconds;
+                        }
+                        // Staged messages keep the options they were queued with.
+                        mqtt_topics.setOptions((mqtt_topic_class_t)cls, opt.qos, opt.retain);
+                        mqtt_topics.setExpiry((mqtt_topic_class_t)cls, opt.expiry);
+                        ad2_printf_host(false, "Success setting value.\r\n");
+                    }
+                }
+                mqtt_print_class_options(cls);
+                break;
+            }
+
+            /**
+             * MQTT remote command rate limits
+             */
+            case MQTT_CMDRATE_SUBCMD_ID: { // 'cmdrate' sub command
+                std::string setting;
+                float rate, burst;
+                size_t first = 0, last = MQTT_COMMAND_ACTIONS;
+                if (ad2_copy_nth_arg(arg, string, 2) >= 0) {
+                    ad2_ucase(arg);
+                    int n = mqtt_find_command_action(arg);
+                    if (n < 0) {
+                        ad2_printf_host(false, "Unknown action '%s'.\r\n", arg.c_str());
+                        break;
+                    }
+                    first = n;
+                    last = n + 1;
+                    if (ad2_copy_nth_arg(setting, string, 3, true) >= 0) {
+                        std::string key = mqtt_command_rate(n, "", rate, burst);
+                        if (setting.compare("-") == 0) {
+                            ad2_set_config_key_string(MQTT_CONFIG_SECTION, key.c_str(), NULL, -1, NULL, true);
+                            setting = "";
+                        } else {
+                            mqtt_command_rate(n, setting, rate, burst);
+                            setting = ad2_string_printf("%g %g", rate, burst);
+                            ad2_set_config_key_string(MQTT_CONFIG_SECTION, key.c_str(), setting.c_str());
+                        }
+                        mqtt_command_rate(n, setting, rate, burst);
+                        xSemaphoreTake(mqtt_cmdq_mutex, portMAX_DELAY);
+                        mqtt_cmdq.setRate(n, rate, burst, hal_uptime_us());
+                        xSemaphoreGive(mqtt_cmdq_mutex);
+                        ad2_printf_host(false, "Success setting value.\r\n");
+                    }
+                }
+                for (size_t n = first; n < last; n++) {
+                    setting = "";
+                    ad2_get_config_key_string(MQTT_CONFIG_SECTION, mqtt_command_rate(n, "", rate, burst).c_str(), setting);
+                    mqtt_command_rate(n, setting, rate, burst);
+                    ad2_printf_host(false, "MQTT command '%s' rate %g/s burst %g%s\r\n", mqtt_command_actions[n].action,
+                                    rate, burst, setting.length() ? "" : " (default)");
+                }
+                break;
+            }
+
+            /**
+             * MQTT protocol version
+             */
+            case MQTT_PROTOCOL_SUBCMD_ID: { // 'protocol' sub command
+                int protocol = MQTT_DEF_PROTOCOL;
+                if (ad2_copy_nth_arg(arg, string, 2) >= 0) {
+                    if (arg != "3" && arg != "5") {
+                        ad2_printf_host(false, "Invalid protocol '%s'. Must be 3 or 5.\r\n", arg.c_str());
+                        break;
+                    }
+                    ad2_set_config_key_int(MQTT_CONFIG_SECTION, MQTT_PROTOCOL_SUBCMD, std::atoi(arg.c_str()));
+                    ad2_printf_host(false, "Success setting value. Restart required to take effect.\r\n");
+                }
+                ad2_get_config_key_int(MQTT_CONFIG_SECTION, MQTT_PROTOCOL_SUBCMD, &protocol);
+                ad2_printf_host(false, "MQTT protocol set to '%s'.\r\n", protocol == 5 ? "5" : "3.1.1");
+#if CONFIG_MQTT_PROTOCOL_5
+                if (mqtt_client) {
+                    ad2_printf_host(false, "MQTT client using '%s'.\r\n", mqtt5_active ? "5" : "3.1.1");
+                }
+#else
+                ad2_printf_host(false, "MQTT 5 is not enabled in this build.\r\n");
+#endif
+                break;
+            }
+
             }
             // all done
             break;
@@ -1090,8 +2333,15 @@ static struct cli_command mqtt_cmd_list[] = {
     {
         // ### MQTT notification component
         (char*)MQTT_COMMAND,(char*)
-        "Usage: mqtt (enable|url|commands|tprefix|dprefix) [<arg>]\r\n"
+        "Usage: mqtt (enable|url|commands|tprefix|dprefix|refresh) [<arg>]\r\n"
         "Usage: mqtt switch <swid> [delete|-|open|close|trouble] [<arg>]\r\n"
+        "Usage: mqtt outbox [<bytes> <count>]\r\n"
+        "Usage: mqtt raw [<window> [<bytes> [nl|len]]]\r\n"
+        "Usage: mqtt cbor [-|<prefix> ...]\r\n"
+        "Usage: mqtt (qos|retain|expiry) [<class> [<arg>]]\r\n"
+        "Usage: mqtt cmdrate [<action> [<rate> <burst>|-]]\r\n"
+        "Usage: mqtt protocol [3|5]\r\n"
+        "Usage: mqtt stats\r\n"
         "\r\n"
         "    Configuration tool for MQTT notification\r\n"
         "Commands:\r\n"
@@ -1100,6 +2350,29 @@ static struct cli_command mqtt_cmd_list[] = {
         "    commands [Y|N]          Remote command enable flag\r\n"
         "    tprefix [path]          Topic prefix\r\n"
         "    dprefix [path]          Discovery prefix\r\n"
+        "    refresh [seconds]       Resend unchanged state and discovery after seconds\r\n"
+        "                            0 sends every update. Default 3600\r\n"
+        "    outbox [bytes count]    Limit messages waiting to be sent\r\n"
+        "                            Default 16384 bytes and 64 messages\r\n"
+        "    raw [window bytes fmt]  Publish raw panel messages in batches\r\n"
+        "                            window ms per batch. 0 disables. Default 0\r\n"
+        "                            bytes per batch. Default 1024\r\n"
+        "                            nl newline or len length prefixed. Default nl\r\n"
+        "    cbor [- | prefix ...]   Publish CBOR in place of JSON on topics\r\n"
+        "                            partitions zones switches cid. - for none\r\n"
+        "    qos [class [0|1|2]]     QoS of a topic class. Default 1. raw 0\r\n"
+        "    retain [class [Y|N]]    Retain flag of a topic class. Default Y. raw N\r\n"
+        "    expiry [class [secs]]   Drop messages of a topic class not sent\r\n"
+        "                            in secs. 0 never. Default 0\r\n"
+        "                            class partitions zones switches cid raw\r\n"
+        "                            or discovery\r\n"
+        "    cmdrate [action args]   Remote command rate limit by action\r\n"
+        "                            commands per second and bucket size\r\n"
+        "                            args rate burst or - for the default\r\n"
+        "    protocol [3|5]          MQTT 3.1.1 or 5. Default 3\r\n"
+        "                            5 adds topic aliases, message expiry and\r\n"
+        "                            event user properties\r\n"
+        "    stats                   Show publish and outbox counters\r\n"
         "    switch swid SCMD [ARG]  Configure virtual switches\r\n"
         "Sub-Commands:\r\n"
         "    delete | -              Clear switch notification settings\r\n"
@@ -1121,6 +2394,13 @@ static struct cli_command mqtt_cmd_list[] = {
  */
 void mqtt_register_cmds()
 {
+    // Locks used by the CLI even if the client is disabled.
+    mqtt_discovery_mutex = xSemaphoreCreateMutex();
+    mqtt_outbox_mutex = xSemaphoreCreateMutex();
+    mqtt_drain_mutex = xSemaphoreCreateMutex();
+    mqtt_raw_mutex = xSemaphoreCreateMutex();
+    mqtt_cmdq_mutex = xSemaphoreCreateMutex();
+
     // Register MQTT CLI commands
     for (int i = 0; i < ARRAY_SIZE(mqtt_cmd_list); i++) {
         cli_register_command(&mqtt_cmd_list[i]);
@@ -1164,29 +2444,102 @@ void mqtt_startup_task(void *pvParameters)
     }
 
     // load and parse the Broker URL if set.
-    std::string brokerURL;
-    ad2_get_config_key_string(MQTT_CONFIG_SECTION, MQTT_URL_SUBCMD, brokerURL);
-    if (!brokerURL.length()) {
+    ad2_get_config_key_string(MQTT_CONFIG_SECTION, MQTT_URL_SUBCMD, mqtt_broker_url);
+    if (!mqtt_broker_url.length()) {
         // set default
-        brokerURL = EXAMPLE_BROKER_URI;
+        mqtt_broker_url = EXAMPLE_BROKER_URI;
     }
 
-    // Last Will topic
-    std::string LWT_TOPIC = mqttclient_TPREFIX + MQTT_TOPIC_PREFIX "/";
-    LWT_TOPIC+=mqttclient_UUID;
-    LWT_TOPIC+="/status";
+    // Build every publish topic before the client starts and the
+    // event callbacks can publish. Read only from here on.
+    std::vector<int> switches;
+    for (auto &sw : mqtt_AD2EventSearches) {
+        switches.push_back(sw->INT_ARG);
+    }
+    mqtt_topics.build(mqttclient_TPREFIX, mqttclient_UUID, AD2_MAX_PARTITION, AD2_MAX_ZONES, switches);
+
+    // Unchanged retained state is skipped until the refresh interval.
+    int refresh = MQTT_DEF_REFRESH;
+    ad2_get_config_key_int(MQTT_CONFIG_SECTION, MQTT_REFRESH_SUBCMD, &refresh);
+    mqtt_topics.setRefresh(refresh * 1000);
+    ESP_LOGI(TAG, "Topic table %u topics %u bytes.", (unsigned)mqtt_topics.count(), (unsigned)mqtt_topics.bytes());
+
+    // Staged outbox limits.
+    int outbox_bytes = MQTT_DEF_OUTBOX_BYTES;
+    int outbox_count = MQTT_DEF_OUTBOX_COUNT;
+    ad2_get_config_key_int(MQTT_CONFIG_SECTION, MQTT_OUTBOX_BYTES_KEY, &outbox_bytes);
+    ad2_get_config_key_int(MQTT_CONFIG_SECTION, MQTT_OUTBOX_COUNT_KEY, &outbox_count);
+    xSemaphoreTake(mqtt_outbox_mutex, portMAX_DELAY);
+    mqtt_outbox.setLimits(outbox_bytes, outbox_count);
+    mqtt_outbox.setCache(&mqtt_topics);
+    xSemaphoreGive(mqtt_outbox_mutex);
+
+    // QoS and retain flag of each topic class.
+    mqtt_load_class_options();
+
+    // Topic prefixes that publish CBOR.
+    std::string cbor_prefixes;
+    ad2_get_config_key_string(MQTT_CONFIG_SECTION, MQTT_CBOR_SUBCMD, cbor_prefixes);
+    uint8_t cbor_mask;
+    if (mqtt_parse_cbor_prefixes(cbor_prefixes, cbor_mask)) {
+        mqtt_cbor_mask = cbor_mask;
+    } else {
+        ESP_LOGE(TAG, "Invalid CBOR topic prefix in '%s'.", cbor_prefixes.c_str());
+    }
+
+    // Raw message stream.
+    int raw_window = 0;
+    int raw_bytes = MQTT_DEF_RAW_BYTES;
+    std::string raw_format;
+    ad2_get_config_key_int(MQTT_CONFIG_SECTION, MQTT_RAW_WINDOW_KEY, &raw_window);
+    ad2_get_config_key_int(MQTT_CONFIG_SECTION, MQTT_RAW_BYTES_KEY, &raw_bytes);
+    ad2_get_config_key_string(MQTT_CONFIG_SECTION, MQTT_RAW_FORMAT_KEY, raw_format);
+    xSemaphoreTake(mqtt_raw_mutex, portMAX_DELAY);
+    mqtt_raw.setLimits(raw_window, raw_bytes, raw_format == "len" ? MQTT_RAW_LENGTH : MQTT_RAW_NEWLINE);
+    xSemaphoreGive(mqtt_raw_mutex);
+    int raw_ticks = raw_window / portTICK_PERIOD_MS;
+    mqtt_raw_timer = xTimerCreate("MQTT_RAW",
+                                  raw_ticks ? raw_ticks : 1,
+                                  pdFALSE,
+                                  (void *) nullptr,
+                                  (TimerCallbackFunction_t) mqtt_raw_timer_cb);
+
+    // Discovery slots live for the boot so a reconnect only sends
+    // configs that changed.
+    mqtt_discovery_acked.assign(MQTT_DISC_SLOT_SWITCH + mqtt_AD2EventSearches.size(), 0);
+    xTaskCreate(&mqtt_discovery_task, "mqtt discovery", 1024*4, NULL, tskIDLE_PRIORITY+1, &mqtt_discovery_task_handle);
+
+    // Remote commands run here and not on the MQTT task.
+    if (commands_enabled) {
+        mqtt_cmdq.setSize(MQTT_CMDQ_SIZE);
+        mqtt_load_command_rates();
+        xTaskCreate(&mqtt_command_task, "mqtt commands", 1024*4, NULL, tskIDLE_PRIORITY+1, &mqtt_command_task_handle);
+    }
 
     // Build mqtt client config
-    esp_mqtt_client_config_t mqtt_cfg = {};
-    mqtt_cfg.broker.address.uri = brokerURL.c_str();
-    mqtt_cfg.credentials.client_id = mqttclient_UUID.c_str();
-    mqtt_cfg.session.last_will.topic = LWT_TOPIC.c_str();
-    mqtt_cfg.session.last_will.msg = "offline";
-    mqtt_cfg.session.last_will.qos = 1;
-    mqtt_cfg.session.last_will.retain = 1;
+    mqtt_client_cfg.broker.address.uri = mqtt_broker_url.c_str();
+    mqtt_client_cfg.credentials.client_id = mqttclient_UUID.c_str();
+    // Last Will topic
+    mqtt_client_cfg.session.last_will.topic = mqtt_topics.get(MQTT_TOPIC_STATUS)->topic;
+    mqtt_client_cfg.session.last_will.msg = "offline";
+    mqtt_client_cfg.session.last_will.qos = 1;
+    mqtt_client_cfg.session.last_will.retain = 1;
+
+    // MQTT 5 if enabled. A broker that refuses it gets 3.1.1.
+    int protocol = MQTT_DEF_PROTOCOL;
+    ad2_get_config_key_int(MQTT_CONFIG_SECTION, MQTT_PROTOCOL_SUBCMD, &protocol);
+    mqtt_client_cfg.session.protocol_ver = MQTT_PROTOCOL_V_3_1_1;
+    if (protocol == 5) {
+#if CONFIG_MQTT_PROTOCOL_5
+        mqtt_client_cfg.session.protocol_ver = MQTT_PROTOCOL_V_5;
+        mqtt5_active = true;
+#else
+        ESP_LOGE(TAG, "MQTT 5 is not enabled in this build. Using MQTT 3.1.1.");
+#endif
+    }
 
     // Create and start the client.
-    mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
+    mqtt_client = esp_mqtt_client_init(&mqtt_client_cfg);
 
     // register event callback
     esp_mqtt_client_register_event(mqtt_client, (esp_mqtt_event_id_t)ESP_EVENT_ANY_ID, ad2_mqtt_event_handler, NULL);
@@ -1242,6 +2595,7 @@ void mqtt_init()
     AD2Parse.subscribeTo(ON_ZONE_BYPASSED_CHANGE, mqtt_on_state_change, (void *)ON_ZONE_BYPASSED_CHANGE);
     AD2Parse.subscribeTo(ON_EXIT_CHANGE, mqtt_on_state_change, (void *)ON_EXIT_CHANGE);
     AD2Parse.subscribeTo(ON_LRR, mqtt_on_lrr, (void *)ON_LRR);
+    AD2Parse.subscribeTo(ON_RAW_MESSAGE, mqtt_on_raw, (void *)ON_RAW_MESSAGE);
     AD2Parse.subscribeTo(ON_CFG, mqtt_on_ad2cfg, (void *)ON_CFG);
     AD2Parse.subscribeTo(ON_VER, mqtt_on_ad2cfg, (void *)ON_VER);
     // SUbscribe to ON_ZONE_CHANGE events
@@ -1280,104 +2634,17 @@ void mqtt_init()
                 close_output_format.length()
                 || trouble_output_format.length() ) {
 
-            // key switch N
-            std::string key = std::string(AD2SWITCH_CONFIG_SECTION);
-            key += " ";
-            key += std::to_string(swID);
-
-            // Default switch state from global switch settings
-            int defaultState = AD2_STATE_UNKNOWN; // default default to unknown.
-            ad2_get_config_key_int(key.c_str(),
-                                   AD2SWITCH_SK_DEFAULT,
-                                   &defaultState);
-
-            // Auto reset time from global switch settings
-            int autoReset = 0;
-            ad2_get_config_key_int(key.c_str(),
-                                   AD2SWITCH_SK_RESET,
-                                   &autoReset);
-
-            // construct our search object.
-            AD2EventSearch *es1 = new AD2EventSearch((AD2_CMD_ZONE_state_t)defaultState, autoReset);
-
-            // store validated output formats.
-            es1->OPEN_OUTPUT_FORMAT = open_output_format;
-            es1->CLOSE_OUTPUT_FORMAT = close_output_format;
-            es1->TROUBLE_OUTPUT_FORMAT = trouble_output_format;
-
-            // Not used.
-            es1->PTR_ARG = nullptr;
-
-            // save the NVS Virtual SWITCH ID so we can read the data back later.
-            es1->INT_ARG = swID;
-
-            // switch filter settings
-            std::string filter;
-
-            // Get the optional switch types to listen for.
-            std::string types = "";
-            std::vector<std::string> notify_types_v;
-            ad2_get_config_key_string(key.c_str(), AD2SWITCH_SK_TYPES, types);
-            ad2_tokenize(types, ", ", notify_types_v);
-            for (auto &sztype : notify_types_v) {
-                ad2_trim(sztype);
-                auto x = AD2Parse.message_type_id.find(sztype);
-                if(x != std::end(AD2Parse.message_type_id)) {
-                    ad2_message_t mt = (ad2_message_t)AD2Parse.message_type_id.at(sztype);
-                    es1->PRE_FILTER_MESAGE_TYPE.push_back(mt);
-                }
-            }
-
-            // load [switch N] required regex match settings
-            std::string prefilter_regex;
-            ad2_get_config_key_string(key.c_str(), AD2SWITCH_SK_FILTER, prefilter_regex);
-            es1->PRE_FILTER_REGEX = prefilter_regex;
-
-            // Load all regex search patterns for open, close, and trouble sub keys.
-            std::string regex_sk_list = AD2SWITCH_SK_OPEN " "
-                                        AD2SWITCH_SK_CLOSE " "
-                                        AD2SWITCH_SK_TROUBLE;
-
-            std::stringstream ss(regex_sk_list);
-            std::string sk;
-            int sk_index = 0;
-            while (ss >> sk) {
-                for ( int a = 1; a < AD2_MAX_SWITCH_SEARCH_KEYS; a++) {
-                    std::string out = "";
-                    ad2_get_config_key_string(key.c_str(), sk.c_str(), out, a);
-
-                    if ( out.length()) {
-                        if (sk_index == 0) {
-                            es1->OPEN_REGEX_LIST.push_back(out);
-                        }
-                        if (sk_index == 1) {
-                            es1->CLOSE_REGEX_LIST.push_back(out);
-                        }
-                        if (sk_index == 2) {
-                            es1->TROUBLE_REGEX_LIST.push_back(out);
-                        }
-                    }
-                }
-                sk_index++;
-            }
-
-            // Must provide at least one states or it will be skipped.
-            if (es1->OPEN_REGEX_LIST.size() ||
-                    es1->CLOSE_REGEX_LIST.size() ||
-                    es1->TROUBLE_REGEX_LIST.size()) {
-                // Save the search to a list for management.
+            // subscribe to the shared [switch N] for state changes.
+            AD2EventSearch *es1 = ad2_switch_subscribe(swID, on_search_match_cb_mqtt, nullptr,
+                                  open_output_format,
+                                  close_output_format,
+                                  trouble_output_format);
+            if (es1) {
+                // Save the search to a list for topics and discovery.
                 mqtt_AD2EventSearches.push_back(es1);
 
-                // subscribe to the callback for events.
-                AD2Parse.subscribeTo(on_search_match_cb_mqtt, es1);
-
                 // keep track of how many for user feedback.
                 subscribers++;
-
-            } else {
-                // incomplete switch so delete it.
-                delete es1;
-                ESP_LOGE(TAG, "Error in config section [switch %i]. Need at least one open, close, or trouble filter expressions.", swID);
             }
         } else {
             if (open_output_format.length() || close_output_format.length()
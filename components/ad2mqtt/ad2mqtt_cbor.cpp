@@ -0,0 +1,183 @@
+/**
+ *  @file    ad2mqtt_cbor.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Compact CBOR payloads for MQTT state and event topics.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include "ad2mqtt_cbor.h"
+
+/**
+ * @brief Write a CBOR item head. RFC 8949 3.
+ *
+ * @param [in]major uint8_t major type 0-7.
+ * @param [in]v uint64_t argument.
+ */
+void AD2CBORWriter::_head(uint8_t major, uint64_t v)
+{
+    major <<= 5;
+    if (v < 24) {
+        _out += (char)(major | v);
+        return;
+    }
+    int bytes;
+    if (v <= 0xff) {
+        _out += (char)(major | 24);
+        bytes = 1;
+    } else if (v <= 0xffff) {
+        _out += (char)(major | 25);
+        bytes = 2;
+    } else if (v <= 0xffffffffULL) {
+        _out += (char)(major | 26);
+        bytes = 4;
+    } else {
+        _out += (char)(major | 27);
+        bytes = 8;
+    }
+    while (bytes--) {
+        _out += (char)(v >> (bytes * 8));
+    }
+}
+
+/**
+ * @brief partitions/N payload. Same fields as ad2_get_partition_state_json().
+ *
+ * @param [out]out std::string & payload.
+ * @param [in]s AD2PartitionState *
+ * @param [in]event const std::string & event name or empty.
+ */
+void ad2_cbor_partition_state(std::string &out, AD2PartitionState *s, const std::string &event)
+{
+    AD2CBORWriter w(out);
+    size_t extra = event.length() ? 1 : 0;
+    if (!s || s->unknown_state) {
+        w.map(1 + extra);
+        w.key(AD2_CBOR_LAST_ALPHA_MESSAGE);
+        w.text("Unknown", 7);
+    } else {
+        w.map(22 + extra);
+        w.key(AD2_CBOR_READY);
+        w.boolean(s->ready);
+        w.key(AD2_CBOR_ARMED_AWAY);
+        w.boolean(s->armed_away);
+        w.key(AD2_CBOR_ARMED_STAY);
+        w.boolean(s->armed_stay);
+        w.key(AD2_CBOR_BACKLIGHT_ON);
+        w.boolean(s->backlight_on);
+        w.key(AD2_CBOR_PROGRAMMING);
+        w.boolean(s->programming);
+        w.key(AD2_CBOR_ZONE_BYPASSED);
+        w.boolean(s->zone_bypassed);
+        w.key(AD2_CBOR_AC_POWER);
+        w.boolean(s->ac_power);
+        w.key(AD2_CBOR_CHIME_ON);
+        w.boolean(s->chime_on);
+        w.key(AD2_CBOR_ALARM_EVENT_OCCURRED);
+        w.boolean(s->alarm_event_occurred);
+        w.key(AD2_CBOR_ALARM_SOUNDING);
+        w.boolean(s->alarm_sounding);
+        w.key(AD2_CBOR_BATTERY_LOW);
+        w.boolean(s->battery_low);
+        w.key(AD2_CBOR_ENTRY_DELAY_OFF);
+        w.boolean(s->entry_delay_off);
+        w.key(AD2_CBOR_FIRE_ALARM);
+        w.boolean(s->fire_alarm);
+        w.key(AD2_CBOR_SYSTEM_ISSUE);
+        w.boolean(s->system_issue);
+        w.key(AD2_CBOR_PERIMETER_ONLY);
+        w.boolean(s->perimeter_only);
+        w.key(AD2_CBOR_EXIT_NOW);
+        w.boolean(s->exit_now);
+        w.key(AD2_CBOR_SYSTEM_SPECIFIC);
+        w.uint(s->system_specific);
+        w.key(AD2_CBOR_BEEPS);
+        w.uint(s->beeps);
+        w.key(AD2_CBOR_PANEL_TYPE);
+        w.text(&s->panel_type, 1);
+        w.key(AD2_CBOR_LAST_ALPHA_MESSAGE);
+        w.text(s->last_alpha_message);
+        w.key(AD2_CBOR_LAST_NUMERIC_MESSAGES);
+        w.text(s->last_numeric_message);
+        w.key(AD2_CBOR_MASK);
+        w.uint(s->address_mask_filter);
+    }
+    if (extra) {
+        w.key(AD2_CBOR_EVENT);
+        w.text(event);
+    }
+}
+
+/**
+ * @brief zones/N payload.
+ *
+ * @param [out]out std::string & payload.
+ * @param [in]state const std::string & ex. "OPEN"
+ * @param [in]partition int
+ * @param [in]mask uint32_t address mask.
+ * @param [in]system bool system zone.
+ * @param [in]name const std::string & zone alpha.
+ */
+void ad2_cbor_zone_state(std::string &out, const std::string &state, int partition,
+                         uint32_t mask, bool system, const std::string &name)
+{
+    AD2CBORWriter w(out);
+    w.map(5);
+    w.key(AD2_CBOR_STATE);
+    w.text(state);
+    w.key(AD2_CBOR_PARTITION);
+    w.uint(partition);
+    w.key(AD2_CBOR_MASK);
+    w.uint(mask);
+    w.key(AD2_CBOR_SYSTEM);
+    w.boolean(system);
+    w.key(AD2_CBOR_NAME);
+    w.text(name);
+}
+
+/**
+ * @brief switches/N payload.
+ *
+ * @param [out]out std::string & payload.
+ * @param [in]state const std::string & switch output message.
+ * @param [in]suppressed uint32_t flap suppressed count. Omitted if 0.
+ */
+void ad2_cbor_switch_state(std::string &out, const std::string &state, uint32_t suppressed)
+{
+    AD2CBORWriter w(out);
+    w.map(suppressed ? 2 : 1);
+    w.key(AD2_CBOR_STATE);
+    w.text(state);
+    if (suppressed) {
+        w.key(AD2_CBOR_SUPPRESSED);
+        w.uint(suppressed);
+    }
+}
+
+/**
+ * @brief cid event payload.
+ *
+ * @param [out]out std::string & payload.
+ * @param [in]message const std::string & LRR message.
+ */
+void ad2_cbor_lrr_event(std::string &out, const std::string &message)
+{
+    AD2CBORWriter w(out);
+    w.map(1);
+    w.key(AD2_CBOR_EVENT_MESSAGE);
+    w.text(message);
+}
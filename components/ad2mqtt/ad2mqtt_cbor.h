@@ -0,0 +1,119 @@
+/**
+ *  @file    ad2mqtt_cbor.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Compact CBOR payloads for MQTT state and event topics.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef _AD2MQTT_CBOR_H
+#define _AD2MQTT_CBOR_H
+
+#include <stdint.h>
+#include <string>
+
+#include "alarmdecoder_api.h"
+
+/**
+ * Shared CBOR schema. Every topic uses this one table of integer map
+ * keys in place of the JSON key names. Keys 0-23 encode in one byte so
+ * the most used keys are kept below 24. Released values never change.
+ */
+typedef enum {
+    // partitions/N
+    AD2_CBOR_READY = 0,                 ///< "ready"
+    AD2_CBOR_ARMED_AWAY = 1,            ///< "armed_away"
+    AD2_CBOR_ARMED_STAY = 2,            ///< "armed_stay"
+    AD2_CBOR_BACKLIGHT_ON = 3,          ///< "backlight_on"
+    AD2_CBOR_PROGRAMMING = 4,           ///< "programming"
+    AD2_CBOR_ZONE_BYPASSED = 5,         ///< "zone_bypassed"
+    AD2_CBOR_AC_POWER = 6,              ///< "ac_power"
+    AD2_CBOR_CHIME_ON = 7,              ///< "chime_on"
+    AD2_CBOR_ALARM_EVENT_OCCURRED = 8,  ///< "alarm_event_occurred"
+    AD2_CBOR_ALARM_SOUNDING = 9,        ///< "alarm_sounding"
+    AD2_CBOR_BATTERY_LOW = 10,          ///< "battery_low"
+    AD2_CBOR_ENTRY_DELAY_OFF = 11,      ///< "entry_delay_off"
+    AD2_CBOR_FIRE_ALARM = 12,           ///< "fire_alarm"
+    AD2_CBOR_SYSTEM_ISSUE = 13,         ///< "system_issue"
+    AD2_CBOR_PERIMETER_ONLY = 14,       ///< "perimeter_only"
+    AD2_CBOR_EXIT_NOW = 15,             ///< "exit_now"
+    AD2_CBOR_SYSTEM_SPECIFIC = 16,      ///< "system_specific"
+    AD2_CBOR_BEEPS = 17,                ///< "beeps"
+    AD2_CBOR_PANEL_TYPE = 18,           ///< "panel_type"
+    AD2_CBOR_LAST_ALPHA_MESSAGE = 19,   ///< "last_alpha_message"
+    AD2_CBOR_LAST_NUMERIC_MESSAGES = 20,///< "last_numeric_messages"
+    AD2_CBOR_MASK = 21,                 ///< "mask" partitions and zones.
+    AD2_CBOR_EVENT = 22,                ///< "event"
+    // zones/N and switches/N
+    AD2_CBOR_STATE = 23,                ///< "state"
+    // two byte keys
+    AD2_CBOR_PARTITION = 24,            ///< "partition"
+    AD2_CBOR_SYSTEM = 25,               ///< "system"
+    AD2_CBOR_NAME = 26,                 ///< "name"
+    AD2_CBOR_SUPPRESSED = 27,           ///< "suppressed"
+    // cid
+    AD2_CBOR_EVENT_MESSAGE = 28,        ///< "event_message"
+} ad2_cbor_key_t;
+
+/**
+ * Streaming CBOR writer. Appends each item as it is written so no
+ * document tree is built. Only the types the schema uses.
+ */
+class AD2CBORWriter
+{
+public:
+    explicit AD2CBORWriter(std::string &out) : _out(out) {}
+
+    void map(size_t pairs)
+    {
+        _head(5, pairs);
+    }
+    void key(ad2_cbor_key_t k)
+    {
+        _head(0, k);
+    }
+    void uint(uint64_t v)
+    {
+        _head(0, v);
+    }
+    void boolean(bool b)
+    {
+        _out += (char)(b ? 0xf5 : 0xf4);
+    }
+    void text(const char *s, size_t len)
+    {
+        _head(3, len);
+        _out.append(s, len);
+    }
+    void text(const std::string &s)
+    {
+        text(s.data(), s.length());
+    }
+
+protected:
+    void _head(uint8_t major, uint64_t v);
+    std::string &_out;
+};
+
+// Payloads for each topic. Same fields as the JSON payloads.
+void ad2_cbor_partition_state(std::string &out, AD2PartitionState *s, const std::string &event);
+void ad2_cbor_zone_state(std::string &out, const std::string &state, int partition,
+                         uint32_t mask, bool system, const std::string &name);
+void ad2_cbor_switch_state(std::string &out, const std::string &state, uint32_t suppressed);
+void ad2_cbor_lrr_event(std::string &out, const std::string &message);
+
+#endif /* _AD2MQTT_CBOR_H */
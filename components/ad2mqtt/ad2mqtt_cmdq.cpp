@@ -0,0 +1,130 @@
+/**
+ *  @file    ad2mqtt_cmdq.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Bounded MQTT command queue with a rate limit per action.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include <algorithm>
+
+#include "ad2mqtt_cmdq.h"
+
+/**
+ * @brief Queue a command.
+ *
+ * @param [in]data const char * command payload.
+ * @param [in]len size_t
+ * @param [in]now_us uint64_t monotonic time.
+ *
+ * @return bool false if the queue is full.
+ */
+bool AD2MQTTCommandQueue::push(const char *data, size_t len, uint64_t now_us)
+{
+    if (_queue.size() >= _max) {
+        _stats.dropped++;
+        return false;
+    }
+    _queue.push_back({std::string(data, len), now_us});
+    _stats.received++;
+    _stats.depth = _queue.size();
+    _stats.max_depth = std::max(_stats.max_depth, _stats.depth);
+    return true;
+}
+
+/**
+ * @brief Take the oldest command.
+ *
+ * @param [out]cmd mqtt_command_t &
+ *
+ * @return bool false if empty.
+ */
+bool AD2MQTTCommandQueue::pop(mqtt_command_t &cmd)
+{
+    if (_queue.empty()) {
+        return false;
+    }
+    cmd = std::move(_queue.front());
+    _queue.pop_front();
+    _stats.depth = _queue.size();
+    return true;
+}
+
+/**
+ * @brief Size the rate limit table. New actions have no limit.
+ *
+ * @param [in]count size_t number of actions.
+ */
+void AD2MQTTCommandQueue::setActions(size_t count)
+{
+    _buckets.resize(count, {0, 1, 1, 0});
+}
+
+/**
+ * @brief Set the rate limit of an action. The bucket starts full.
+ *
+ * @param [in]action size_t action index.
+ * @param [in]rate float commands per second. 0 no limit.
+ * @param [in]burst float bucket size. At least 1.
+ * @param [in]now_us uint64_t monotonic time.
+ */
+void AD2MQTTCommandQueue::setRate(size_t action, float rate, float burst, uint64_t now_us)
+{
+    if (action >= _buckets.size()) {
+        return;
+    }
+    bucket_t &b = _buckets[action];
+    b.rate = std::max(0.0f, rate);
+    b.burst = std::max(1.0f, burst);
+    b.tokens = b.burst;
+    b.last_us = now_us;
+}
+
+/**
+ * @brief Take a token for an action.
+ *
+ * @param [in]action size_t action index.
+ * @param [in]now_us uint64_t monotonic time.
+ *
+ * @return bool false if the action is over its rate.
+ */
+bool AD2MQTTCommandQueue::take(size_t action, uint64_t now_us)
+{
+    if (action >= _buckets.size() || _buckets[action].rate <= 0) {
+        return true;
+    }
+    bucket_t &b = _buckets[action];
+    b.tokens = std::min(b.burst, b.tokens + (now_us - b.last_us) * b.rate / 1000000.0f);
+    b.last_us = now_us;
+    if (b.tokens < 1.0f) {
+        _stats.rate_limited++;
+        return false;
+    }
+    b.tokens -= 1.0f;
+    return true;
+}
+
+/**
+ * @brief Count a command sent to the AD2 command queue.
+ *
+ * @param [in]latency_us uint64_t receive to execute time.
+ */
+void AD2MQTTCommandQueue::executed(uint64_t latency_us)
+{
+    _stats.executed++;
+    _stats.latency_max_ms = std::max(_stats.latency_max_ms, (uint32_t)(latency_us / 1000));
+}
@@ -0,0 +1,104 @@
+/**
+ *  @file    ad2mqtt_cmdq.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Bounded MQTT command queue with a rate limit per action.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef _AD2MQTT_CMDQ_H
+#define _AD2MQTT_CMDQ_H
+
+#include <stdint.h>
+#include <string>
+#include <deque>
+#include <vector>
+
+/**
+ * One received command. Parsed by the command task.
+ */
+typedef struct mqtt_command {
+    std::string payload;    ///< JSON command document.
+    uint64_t received_us;   ///< time the MQTT task received it.
+} mqtt_command_t;
+
+/**
+ * Command queue counters.
+ */
+typedef struct mqtt_cmdq_stats {
+    uint32_t depth;         ///< commands waiting.
+    uint32_t max_depth;     ///< most commands waiting.
+    uint32_t received;      ///< commands queued.
+    uint32_t dropped;       ///< commands lost to a full queue.
+    uint32_t executed;      ///< commands sent to the AD2 command queue.
+    uint32_t rate_limited;  ///< commands refused by the action rate limit.
+    uint32_t invalid;       ///< parse errors and unknown actions.
+    uint32_t latency_max_ms;///< longest receive to execute time.
+} mqtt_cmdq_stats_t;
+
+/**
+ * MQTT command queue.
+ *
+ * @brief The MQTT task only copies commands in so keepalive and
+ * publish handling never wait on a command. The command task takes
+ * them out in order. Each action has a token bucket that refills at
+ * rate per second up to burst. A command with no token is refused and
+ * not delayed so a busy automation cannot fill the queue. Not thread
+ * safe. The caller must lock.
+ */
+class AD2MQTTCommandQueue
+{
+public:
+    void setSize(size_t max)
+    {
+        _max = max;
+    }
+
+    bool push(const char *data, size_t len, uint64_t now_us);
+    bool pop(mqtt_command_t &cmd);
+
+    // Rate limit by action index. Rate 0 is no limit.
+    void setActions(size_t count);
+    void setRate(size_t action, float rate, float burst, uint64_t now_us);
+    bool take(size_t action, uint64_t now_us);
+
+    void executed(uint64_t latency_us);
+    void invalid()
+    {
+        _stats.invalid++;
+    }
+
+    mqtt_cmdq_stats_t getStats()
+    {
+        return _stats;
+    }
+
+protected:
+    typedef struct bucket {
+        float rate;
+        float burst;
+        float tokens;
+        uint64_t last_us;
+    } bucket_t;
+
+    std::deque<mqtt_command_t> _queue;
+    std::vector<bucket_t> _buckets;
+    size_t _max = 8;
+    mqtt_cmdq_stats_t _stats = {};
+};
+
+#endif /* _AD2MQTT_CMDQ_H */
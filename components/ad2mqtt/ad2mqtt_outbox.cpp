@@ -0,0 +1,158 @@
+/**
+ *  @file    ad2mqtt_outbox.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Bounded MQTT outbox with priorities and per topic collapse.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include "ad2mqtt_outbox.h"
+
+/**
+ * @brief Drop the oldest message in a queue.
+ * A state payload is forgotten in the cache so it is sent again.
+ *
+ * @param [in]q std::deque<mqtt_outbox_msg_t> &
+ */
+void AD2MQTTOutbox::_evict(std::deque<mqtt_outbox_msg_t> &q)
+{
+    _stats.bytes -= _cost(q.front());
+    _stats.depth--;
+    _stats.dropped++;
+    _lost(q.front());
+    q.pop_front();
+}
+
+/**
+ * @brief Stage a message.
+ *
+ * @param [in]topic const mqtt_topic_t * topic table entry.
+ * @param [in]payload const char *
+ * @param [in]len size_t payload length.
+ * @param [in]qos uint8_t
+ * @param [in]retain bool
+ * @param [in]collapse bool replace a staged payload on the same topic.
+ *   Use for state. Not for events that must all be delivered.
+ * @param [in]prio mqtt_priority_t
+ * @param [in]now_ms uint64_t monotonic time.
+ * @param [in]expiry uint32_t seconds before the message is stale. 0 never.
+ * @param [in]event const char * event name or nullptr.
+ *
+ * @return bool false if dropped.
+ */
+bool AD2MQTTOutbox::push(const mqtt_topic_t *topic, const char *payload, size_t len,
+                         uint8_t qos, bool retain, bool collapse, mqtt_priority_t prio,
+                         uint64_t now_ms, uint32_t expiry, const char *event)
+{
+    std::deque<mqtt_outbox_msg_t> &q = _queues[prio];
+
+    // Only the latest state per topic is kept.
+    if (collapse) {
+        for (auto it = q.begin(); it != q.end(); ++it) {
+            mqtt_outbox_msg_t &m = *it;
+            if (m.collapse && m.topic == topic) {
+                if (_max_bytes && _stats.bytes - m.payload.length() + len > _max_bytes) {
+                    // Larger payload needs room. Remove the staged one
+                    // and stage this one like a new message below.
+                    _stats.bytes -= _cost(m);
+                    _stats.depth--;
+                    _stats.collapsed++;
+                    q.erase(it);
+                    break;
+                }
+                _stats.bytes -= m.payload.length();
+                m.payload.assign(payload, len);
+                m.qos = qos;
+                m.retain = retain;
+                m.queued_ms = now_ms;
+                m.expiry = expiry;
+                m.event = event ? event : "";
+                _stats.bytes += len;
+                _stats.collapsed++;
+                _stats.queued++;
+                if (_stats.bytes > _stats.peak_bytes) {
+                    _stats.peak_bytes = _stats.bytes;
+                }
+                return true;
+            }
+        }
+    }
+
+    mqtt_outbox_msg_t msg = {topic, std::string(payload, len), qos, retain, collapse,
+                             now_ms, expiry, event ? event : ""
+                            };
+    size_t cost = _cost(msg);
+    if (_max_bytes && cost > _max_bytes) {
+        _stats.dropped++;
+        _lost(msg);
+        return false;
+    }
+
+    // Make room by dropping the oldest message of the lowest priority
+    // that is not more important than this one.
+    while ((_max_count && _stats.depth + 1 > _max_count) ||
+            (_max_bytes && _stats.bytes + cost > _max_bytes)) {
+        int p = MQTT_PRIO_COUNT - 1;
+        while (p >= (int)prio && _queues[p].empty()) {
+            p--;
+        }
+        if (p < (int)prio) {
+            _stats.dropped++;
+            _lost(msg);
+            return false;
+        }
+        _evict(_queues[p]);
+    }
+
+    q.push_back(std::move(msg));
+    _stats.depth++;
+    _stats.bytes += cost;
+    _stats.queued++;
+    if (_stats.bytes > _stats.peak_bytes) {
+        _stats.peak_bytes = _stats.bytes;
+    }
+    return true;
+}
+
+/**
+ * @brief Take the next message. Highest priority first and oldest
+ * first within a priority. Stale messages are dropped.
+ *
+ * @param [out]msg mqtt_outbox_msg_t &
+ * @param [in]now_ms uint64_t monotonic time.
+ *
+ * @return bool false if empty.
+ */
+bool AD2MQTTOutbox::pop(mqtt_outbox_msg_t &msg, uint64_t now_ms)
+{
+    for (auto &q : _queues) {
+        while (!q.empty()) {
+            _stats.bytes -= _cost(q.front());
+            _stats.depth--;
+            msg = std::move(q.front());
+            q.pop_front();
+            if (msg.expiry && now_ms - msg.queued_ms >= msg.expiry * 1000ULL) {
+                _stats.expired++;
+                _lost(msg);
+                continue;
+            }
+            _stats.sent++;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,142 @@
+/**
+ *  @file    ad2mqtt_outbox.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Bounded MQTT outbox with priorities and per topic collapse.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef _AD2MQTT_OUTBOX_H
+#define _AD2MQTT_OUTBOX_H
+
+#include <stdint.h>
+#include <string>
+#include <deque>
+
+#include "ad2mqtt_topics.h"
+
+/**
+ * Outbox priority. Lower values are sent first and dropped last.
+ */
+typedef enum {
+    MQTT_PRIO_ALARM = 0,    ///< partition state, contact ID and status.
+    MQTT_PRIO_STATE,        ///< switches and device info.
+    MQTT_PRIO_ZONE,         ///< zone state.
+    MQTT_PRIO_RAW,          ///< raw panel messages.
+    MQTT_PRIO_COUNT
+} mqtt_priority_t;
+
+/**
+ * One staged publish.
+ */
+typedef struct mqtt_outbox_msg {
+    const mqtt_topic_t *topic;  ///< topic table entry.
+    std::string payload;
+    uint8_t qos;
+    bool retain;
+    bool collapse;              ///< newer payload on the topic replaces this one.
+    uint64_t queued_ms;         ///< time staged.
+    uint32_t expiry;            ///< seconds before the message is stale. 0 never.
+    std::string event;          ///< event name for MQTT 5 user properties or empty.
+} mqtt_outbox_msg_t;
+
+/**
+ * Outbox counters.
+ */
+typedef struct mqtt_outbox_stats {
+    uint32_t depth;         ///< messages staged.
+    uint32_t bytes;         ///< bytes staged.
+    uint32_t peak_bytes;    ///< most bytes staged.
+    uint32_t queued;        ///< messages accepted.
+    uint32_t sent;          ///< messages handed to the client.
+    uint32_t collapsed;     ///< messages replaced by a newer payload on the same topic.
+    uint32_t dropped;       ///< messages dropped by the limits or the client.
+    uint32_t expired;       ///< messages staged longer than their expiry.
+} mqtt_outbox_stats_t;
+
+/**
+ * Bounded MQTT outbox.
+ *
+ * @brief Publishes are staged here before they are handed to the MQTT
+ * client so the memory used while the broker is slow or unreachable is
+ * limited by a byte budget and a message count. When full the oldest
+ * message of the lowest priority is dropped. A new state payload on a
+ * topic that is still staged replaces the staged payload. Messages
+ * staged longer than their expiry are dropped instead of sent. Not
+ * thread safe. The caller must lock. State payloads that are dropped
+ * or expire are forgotten in the cache so the next update is sent.
+ */
+class AD2MQTTOutbox
+{
+public:
+    void setLimits(size_t max_bytes, size_t max_count)
+    {
+        _max_bytes = max_bytes;
+        _max_count = max_count;
+    }
+    size_t getMaxBytes()
+    {
+        return _max_bytes;
+    }
+    size_t getMaxCount()
+    {
+        return _max_count;
+    }
+
+    // publish-if-changed cache to invalidate when a state payload is lost.
+    void setCache(AD2MQTTTopicTable *cache)
+    {
+        _cache = cache;
+    }
+
+    bool push(const mqtt_topic_t *topic, const char *payload, size_t len,
+              uint8_t qos, bool retain, bool collapse, mqtt_priority_t prio,
+              uint64_t now_ms = 0, uint32_t expiry = 0, const char *event = nullptr);
+    bool pop(mqtt_outbox_msg_t &msg, uint64_t now_ms = 0);
+
+    // the client refused a message after pop().
+    void dropped()
+    {
+        _stats.dropped++;
+    }
+
+    mqtt_outbox_stats_t getStats()
+    {
+        return _stats;
+    }
+
+protected:
+    static size_t _cost(const mqtt_outbox_msg_t &msg)
+    {
+        return sizeof(mqtt_outbox_msg_t) + msg.topic->len + msg.payload.length();
+    }
+    void _evict(std::deque<mqtt_outbox_msg_t> &q);
+    void _lost(const mqtt_outbox_msg_t &msg)
+    {
+        if (_cache && msg.collapse) {
+            _cache->invalidate(msg.topic);
+        }
+    }
+
+    std::deque<mqtt_outbox_msg_t> _queues[MQTT_PRIO_COUNT];
+    size_t _max_bytes = 0;
+    size_t _max_count = 0;
+    AD2MQTTTopicTable *_cache = nullptr;
+    mqtt_outbox_stats_t _stats = {};
+};
+
+#endif /* _AD2MQTT_OUTBOX_H */
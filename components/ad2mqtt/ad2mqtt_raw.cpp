@@ -0,0 +1,133 @@
+/**
+ *  @file    ad2mqtt_raw.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Batch raw AD2 messages into one MQTT payload.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include "ad2mqtt_raw.h"
+
+/**
+ * @brief Set the batch limits. Clears any partial or held batch.
+ *
+ * @param [in]window_ms uint32_t max age of a batch. 0 disables.
+ * @param [in]max_bytes size_t max payload size.
+ * @param [in]format mqtt_raw_format_t
+ */
+void AD2MQTTRawBatch::setLimits(uint32_t window_ms, size_t max_bytes, mqtt_raw_format_t format)
+{
+    _window_ms = window_ms;
+    _max_bytes = max_bytes;
+    _format = format;
+    _body.clear();
+    _held.clear();
+    _body.reserve(max_bytes);
+}
+
+/**
+ * @brief Prefix the sequence number and hand the payload over.
+ *
+ * @param [out]out std::string & finished payload.
+ */
+void AD2MQTTRawBatch::_finish(std::string &out)
+{
+    if (_format == MQTT_RAW_LENGTH) {
+        out.assign(4, '\0');
+        out[0] = (char)(_seq >> 24);
+        out[1] = (char)(_seq >> 16);
+        out[2] = (char)(_seq >> 8);
+        out[3] = (char)_seq;
+    } else {
+        out = std::to_string(_seq);
+        out += '\n';
+    }
+    out += _body;
+    _body.clear();
+    _seq++;
+    _stats.batches++;
+    _stats.bytes += out.length();
+}
+
+/**
+ * @brief Add a raw message line.
+ *
+ * @param [in]line const char * message without line ending.
+ * @param [in]len size_t
+ * @param [in]now_ms uint64_t monotonic time.
+ * @param [out]out std::string & finished payload if true is returned.
+ *
+ * @return bool true if a batch was finished. The batch holds the lines
+ * before this one if this one did not fit or ends with this one if the
+ * budget is now full. If this line did not fit and is over budget on
+ * its own it is finished as a second batch that pop() returns.
+ */
+bool AD2MQTTRawBatch::add(const char *line, size_t len, uint64_t now_ms, std::string &out)
+{
+    // strip the line ending if present.
+    while (len && (line[len - 1] == '\r' || line[len - 1] == '\n')) {
+        len--;
+    }
+    if (len > 0xffff) {
+        len = 0xffff;
+    }
+    // seq header is at most 11 bytes.
+    size_t need = len + (_format == MQTT_RAW_LENGTH ? 2 : 1);
+    bool finished = false;
+    if (!_body.empty() && _body.length() + need + 11 > _max_bytes) {
+        _finish(out);
+        finished = true;
+    }
+
+    if (_body.empty()) {
+        _start_ms = now_ms;
+    }
+    if (_format == MQTT_RAW_LENGTH) {
+        _body += (char)(len >> 8);
+        _body += (char)len;
+        _body.append(line, len);
+    } else {
+        _body.append(line, len);
+        _body += '\n';
+    }
+    _stats.lines++;
+
+    // A single line over budget is sent alone.
+    if (_body.length() + 11 >= _max_bytes) {
+        _finish(finished ? _held : out);
+        finished = true;
+    }
+    return finished;
+}
+
+/**
+ * @brief Finish the batch if the window has passed.
+ *
+ * @param [in]now_ms uint64_t monotonic time.
+ * @param [in]force bool finish now.
+ * @param [out]out std::string & finished payload if true is returned.
+ *
+ * @return bool true if a batch was finished.
+ */
+bool AD2MQTTRawBatch::flush(uint64_t now_ms, bool force, std::string &out)
+{
+    if (_body.empty() || (!force && now_ms - _start_ms < _window_ms)) {
+        return false;
+    }
+    _finish(out);
+    return true;
+}
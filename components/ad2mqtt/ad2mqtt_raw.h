@@ -0,0 +1,114 @@
+/**
+ *  @file    ad2mqtt_raw.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Batch raw AD2 messages into one MQTT payload.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef _AD2MQTT_RAW_H
+#define _AD2MQTT_RAW_H
+
+#include <stdint.h>
+#include <string>
+
+/**
+ * Raw batch payload format.
+ *
+ * newline: "<seq>\n<line>\n<line>\n..."
+ * length:  4 byte big endian seq then for each line a 2 byte big
+ *          endian length and the line.
+ */
+typedef enum {
+    MQTT_RAW_NEWLINE = 0,
+    MQTT_RAW_LENGTH
+} mqtt_raw_format_t;
+
+/**
+ * Raw batch counters.
+ */
+typedef struct mqtt_raw_stats {
+    uint32_t lines;     ///< lines added.
+    uint32_t batches;   ///< payloads finished.
+    uint32_t bytes;     ///< payload bytes finished.
+    uint32_t dropped;   ///< payloads the outbox did not accept.
+} mqtt_raw_stats_t;
+
+/**
+ * Raw message batch.
+ *
+ * @brief Lines are gathered until the window has passed since the first
+ * line or the next line would not fit in the byte budget. Each finished
+ * payload carries a sequence number so consumers can detect gaps. Not
+ * thread safe. The caller must lock.
+ */
+class AD2MQTTRawBatch
+{
+public:
+    void setLimits(uint32_t window_ms, size_t max_bytes, mqtt_raw_format_t format);
+
+    // window of 0 is disabled.
+    bool enabled()
+    {
+        return _window_ms != 0;
+    }
+
+    bool add(const char *line, size_t len, uint64_t now_ms, std::string &out);
+    bool flush(uint64_t now_ms, bool force, std::string &out);
+
+    // a second payload finished by add(). Sent after the one add() returned.
+    bool pop(std::string &out)
+    {
+        if (_held.empty()) {
+            return false;
+        }
+        out.swap(_held);
+        _held.clear();
+        return true;
+    }
+
+    // true if the next add() starts a new batch.
+    bool empty()
+    {
+        return _body.empty();
+    }
+
+    // the outbox refused a finished payload.
+    void dropped()
+    {
+        _stats.dropped++;
+    }
+
+    mqtt_raw_stats_t getStats()
+    {
+        return _stats;
+    }
+
+protected:
+    void _finish(std::string &out);
+
+    std::string _body;
+    std::string _held;
+    uint64_t _start_ms = 0;
+    uint32_t _seq = 0;
+    uint32_t _window_ms = 0;
+    size_t _max_bytes = 1024;
+    mqtt_raw_format_t _format = MQTT_RAW_NEWLINE;
+    mqtt_raw_stats_t _stats = {};
+};
+
+#endif /* _AD2MQTT_RAW_H */
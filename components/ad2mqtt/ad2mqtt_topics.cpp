@@ -0,0 +1,184 @@
+/**
+ *  @file    ad2mqtt_topics.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Precomputed MQTT topic table.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include <string.h>
+#include <algorithm>
+
+#include "ad2mqtt_topics.h"
+
+/**
+ * @brief Append <base>/<suffix> to the topic buffer.
+ *
+ * @param [in]suffix const std::string & ex. "zones/12"
+ * @param [in]c mqtt_topic_class_t
+ */
+void AD2MQTTTopicTable::_add(const std::string &suffix, mqtt_topic_class_t c)
+{
+    _offsets.push_back(_arena.size());
+    _classes.push_back(c);
+    _arena += _base;
+    _arena += "/";
+    _arena += suffix;
+    _arena += '\0';
+}
+
+/**
+ * @brief Build every topic. Not safe to call while other tasks are
+ * using the table.
+ *
+ * @param [in]tprefix const std::string & topic prefix with trailing '/' or empty.
+ * @param [in]uuid const std::string & client UUID.
+ * @param [in]partitions int partition topics 1-N.
+ * @param [in]zones int zone topics 1-N.
+ * @param [in]switches std::vector<int> & virtual switch IDs.
+ */
+void AD2MQTTTopicTable::build(const std::string &tprefix, const std::string &uuid,
+                              int partitions, int zones, const std::vector<int> &switches)
+{
+    _base = tprefix + MQTT_TOPIC_PREFIX "/" + uuid;
+    _arena.clear();
+    _offsets.clear();
+    _classes.clear();
+    _entries.clear();
+
+    // Size the buffer once. Longest suffix is "fw_version".
+    size_t count = MQTT_TOPIC_FIXED_COUNT + partitions + zones + switches.size();
+    _arena.reserve(count * (_base.length() + 14));
+
+    _add("status", MQTT_CLASS_DEVICE);
+    _add("info", MQTT_CLASS_DEVICE);
+    _add("fw_version", MQTT_CLASS_DEVICE);
+    _add("cid", MQTT_CLASS_CID);
+    _add(MQTT_COMMANDS_TOPIC, MQTT_CLASS_DEVICE);
+    _add("outbox", MQTT_CLASS_DEVICE);
+    _add("raw", MQTT_CLASS_RAW);
+    _add("responses", MQTT_CLASS_RESPONSES);
+
+    _partitions = partitions;
+    _partition_start = _offsets.size();
+    for (int n = 1; n <= partitions; n++) {
+        _add("partitions/" + std::to_string(n), MQTT_CLASS_PARTITIONS);
+    }
+
+    _zones = zones;
+    _zone_start = _offsets.size();
+    for (int n = 1; n <= zones; n++) {
+        _add("zones/" + std::to_string(n), MQTT_CLASS_ZONES);
+    }
+
+    int max_sw = 0;
+    for (int n : switches) {
+        max_sw = std::max(max_sw, n);
+    }
+    _switch_index.assign(max_sw + 1, -1);
+    for (int n : switches) {
+        if (n >= 0 && _switch_index[n] < 0) {
+            _switch_index[n] = _offsets.size();
+            _add("switches/" + std::to_string(n), MQTT_CLASS_SWITCHES);
+        }
+    }
+
+    // Buffer is final. Point the entries into it.
+    _arena.shrink_to_fit();
+    _entries.resize(_offsets.size());
+    for (size_t i = 0; i < _offsets.size(); i++) {
+        _entries[i].topic = _arena.c_str() + _offsets[i];
+        _entries[i].len = strlen(_entries[i].topic);
+        _entries[i].cls = _classes[i];
+    }
+    _offsets.clear();
+    _offsets.shrink_to_fit();
+    _classes.clear();
+    _classes.shrink_to_fit();
+    _state.assign(_entries.size(), topic_state_t());
+}
+
+/**
+ * @brief 64 bit FNV-1a hash of a payload.
+ *
+ * @param [in]data const char *
+ * @param [in]len size_t
+ * @param [in]seed uint64_t previous hash64() to chain buffers.
+ *
+ * @return uint64_t
+ */
+uint64_t AD2MQTTTopicTable::hash64(const char *data, size_t len, uint64_t seed)
+{
+    uint64_t h = seed;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)data[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+/**
+ * @brief Test if a retained payload needs to be published and record it
+ * as sent if it does. Unchanged payloads are skipped until the refresh
+ * interval has passed since they were last sent. The test and the
+ * record are one step so two tasks can not both send the same payload.
+ *
+ * @param [in]t const mqtt_topic_t * table entry.
+ * @param [in]hash uint64_t hash64() of the payload.
+ * @param [in]now_ms uint64_t monotonic time.
+ *
+ * @return bool true if the payload should be sent.
+ */
+bool AD2MQTTTopicTable::update(const mqtt_topic_t *t, uint64_t hash, uint64_t now_ms)
+{
+    topic_state_t &st = _state[t - _entries.data()];
+    if (_refresh_ms && st.generation == _generation && st.hash == hash) {
+        if (now_ms - st.sent_ms < _refresh_ms) {
+            _stats.suppressed++;
+            return false;
+        }
+        _stats.refreshed++;
+    }
+    st.hash = hash;
+    st.sent_ms = now_ms;
+    st.generation = _generation;
+    _stats.published++;
+    return true;
+}
+
+/**
+ * @brief Forget every payload sent. The next publish on each topic is
+ * sent even if unchanged. Used when the broker session is new.
+ */
+void AD2MQTTTopicTable::invalidate()
+{
+    _generation++;
+    if (!_generation) {
+        _generation = 1;
+    }
+}
+
+/**
+ * @brief Forget the payload sent on one topic. The next publish on the
+ * topic is sent even if unchanged. Used when a staged payload is lost.
+ *
+ * @param [in]t const mqtt_topic_t * table entry.
+ */
+void AD2MQTTTopicTable::invalidate(const mqtt_topic_t *t)
+{
+    _state[t - _entries.data()].generation = 0;
+}
@@ -0,0 +1,224 @@
+/**
+ *  @file    ad2mqtt_topics.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Precomputed MQTT topic table.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef _AD2MQTT_TOPICS_H
+#define _AD2MQTT_TOPICS_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// <tprefix>ad2iot/<uuid>/...
+#define MQTT_TOPIC_PREFIX "ad2iot"
+#define MQTT_COMMANDS_TOPIC "commands"
+
+/**
+ * Fixed device topics under <tprefix>ad2iot/<uuid>/.
+ */
+typedef enum {
+    MQTT_TOPIC_STATUS = 0,  ///< online/offline and LWT.
+    MQTT_TOPIC_INFO,        ///< device HW/FW info.
+    MQTT_TOPIC_FW_VERSION,  ///< installed and available firmware.
+    MQTT_TOPIC_CID,         ///< LRR contact ID events.
+    MQTT_TOPIC_COMMANDS,    ///< command subscription.
+    MQTT_TOPIC_OUTBOX,      ///< outbox counters.
+    MQTT_TOPIC_RAW,         ///< raw panel message batches.
+    MQTT_TOPIC_RESPONSES,   ///< command results.
+    MQTT_TOPIC_FIXED_COUNT
+} mqtt_topic_id_t;
+
+/**
+ * Topic classes with their own QoS and retain flag.
+ */
+typedef enum {
+    MQTT_CLASS_DEVICE = 0,  ///< status, info, fw_version, outbox. Fixed.
+    MQTT_CLASS_PARTITIONS,  ///< partitions/N
+    MQTT_CLASS_ZONES,       ///< zones/N
+    MQTT_CLASS_SWITCHES,    ///< switches/N
+    MQTT_CLASS_CID,         ///< cid LRR events.
+    MQTT_CLASS_RAW,         ///< raw batches.
+    MQTT_CLASS_DISCOVERY,   ///< discovery configs. Not in the table.
+    MQTT_CLASS_RESPONSES,   ///< command results. Fixed.
+    MQTT_CLASS_COUNT
+} mqtt_topic_class_t;
+
+/**
+ * QoS, retain flag and expiry for a topic class.
+ */
+typedef struct mqtt_class_options {
+    uint8_t qos;        ///< 0-2
+    uint8_t retain;     ///< 0 or 1
+    uint32_t expiry;    ///< seconds before a message is stale. 0 never.
+} mqtt_class_options_t;
+
+/**
+ * One interned topic. The topic buffer is owned by the table.
+ */
+typedef struct mqtt_topic {
+    const char *topic;  ///< nul terminated full topic.
+    uint16_t len;       ///< strlen(topic).
+    uint8_t cls;        ///< mqtt_topic_class_t
+} mqtt_topic_t;
+
+/**
+ * Retained state publish counters.
+ */
+typedef struct mqtt_publish_stats {
+    uint32_t published;     ///< payloads sent including refreshes.
+    uint32_t suppressed;    ///< unchanged payloads skipped.
+    uint32_t refreshed;     ///< unchanged payloads sent by the forced refresh.
+} mqtt_publish_stats_t;
+
+/**
+ * MQTT topic table.
+ *
+ * @brief Every topic the publish path uses is built once into a single
+ * buffer when the client starts. Lookups return a pointer into the
+ * table so publishing allocates nothing for topics. The topics are
+ * read only after build() so they can be used from any task. The
+ * publish-if-changed state is not locked. The caller serializes
+ * update(), invalidate() and getStats().
+ */
+class AD2MQTTTopicTable
+{
+public:
+    void build(const std::string &tprefix, const std::string &uuid,
+               int partitions, int zones, const std::vector<int> &switches);
+
+    // <tprefix>ad2iot/<uuid>
+    const std::string &base()
+    {
+        return _base;
+    }
+
+    const mqtt_topic_t *get(mqtt_topic_id_t id)
+    {
+        return _entry(id);
+    }
+
+    // nullptr if not in the table.
+    const mqtt_topic_t *partition(int n)
+    {
+        return (n >= 1 && n <= _partitions) ? _entry(_partition_start + n - 1) : nullptr;
+    }
+    const mqtt_topic_t *zone(int n)
+    {
+        return (n >= 1 && n <= _zones) ? _entry(_zone_start + n - 1) : nullptr;
+    }
+    const mqtt_topic_t *sw(int n)
+    {
+        return (n >= 0 && n < (int)_switch_index.size() && _switch_index[n] >= 0) ? _entry(_switch_index[n]) : nullptr;
+    }
+
+    // QoS, retain and expiry of a class. Single word writes so they
+    // can be changed while other tasks publish.
+    void setOptions(mqtt_topic_class_t c, uint8_t qos, bool retain)
+    {
+        _options[c].qos = qos;
+        _options[c].retain = retain;
+    }
+    void setExpiry(mqtt_topic_class_t c, uint32_t seconds)
+    {
+        _options[c].expiry = seconds;
+    }
+    mqtt_class_options_t getOptions(mqtt_topic_class_t c)
+    {
+        return _options[c];
+    }
+    mqtt_class_options_t getOptions(const mqtt_topic_t *t)
+    {
+        return _options[t->cls];
+    }
+
+    // Publish-if-changed for retained state topics.
+    bool update(const mqtt_topic_t *t, uint64_t hash, uint64_t now_ms);
+    void invalidate();
+    void invalidate(const mqtt_topic_t *t);
+
+    // resend unchanged payloads after ms. 0 always sends.
+    void setRefresh(uint32_t ms)
+    {
+        _refresh_ms = ms;
+    }
+    uint32_t getRefresh()
+    {
+        return _refresh_ms;
+    }
+
+    mqtt_publish_stats_t getStats()
+    {
+        return _stats;
+    }
+
+    // 0 to count() - 1 for per topic state kept by the caller.
+    size_t index(const mqtt_topic_t *t)
+    {
+        return t - _entries.data();
+    }
+
+    static uint64_t hash64(const char *data, size_t len, uint64_t seed = 0xcbf29ce484222325ULL);
+
+    // number of topics and bytes used by the topic buffer.
+    size_t count()
+    {
+        return _entries.size();
+    }
+    size_t bytes()
+    {
+        return _arena.size();
+    }
+
+protected:
+    const mqtt_topic_t *_entry(int i)
+    {
+        return &_entries[i];
+    }
+    void _add(const std::string &suffix, mqtt_topic_class_t c);
+
+    // last payload sent on each entry.
+    typedef struct topic_state {
+        uint64_t hash;
+        uint64_t sent_ms;
+        uint32_t generation;    // 0 never sent. Stale if not _generation.
+    } topic_state_t;
+
+    std::string _base;
+    std::string _arena;                 // all topics back to back with nul.
+    std::vector<mqtt_topic_t> _entries;
+    std::vector<topic_state_t> _state;
+    std::vector<size_t> _offsets;       // arena offset of each entry during build.
+    std::vector<uint8_t> _classes;      // class of each entry during build.
+    std::vector<int> _switch_index;     // switch ID to entry or -1.
+    int _partitions = 0;
+    int _partition_start = 0;
+    int _zones = 0;
+    int _zone_start = 0;
+    uint32_t _generation = 1;
+    uint32_t _refresh_ms = 0;
+    mqtt_publish_stats_t _stats = {};
+    // QoS 1 retained except raw and responses. No expiry.
+    mqtt_class_options_t _options[MQTT_CLASS_COUNT] = {
+        {1, 1, 0}, {1, 1, 0}, {1, 1, 0}, {1, 1, 0}, {1, 1, 0}, {0, 0, 0}, {1, 1, 0}, {1, 0, 0}
+    };
+};
+
+#endif /* _AD2MQTT_TOPICS_H */
@@ -409,6 +409,187 @@ void AlarmDecoderParser::subscribeTo(AD2SubScriber::AD2ParserCallback_sub_t fn,
     v.push_back(AD2SubScriber(fn, event_search));
 }
 
+/**
+ * @brief Test the hold time and rate limit for a new notification.
+ *
+ * @param [in]now_ms monotonic time in ms.
+ *
+ * @return true if a notification is allowed now.
+ */
+bool AD2EventSearch::canNotify(uint64_t now_ms)
+{
+    if (hold_time_ && last_notify_ms_ && now_ms - last_notify_ms_ < (uint64_t)hold_time_) {
+        return false;
+    }
+    if (max_rate_) {
+        if (now_ms - rate_window_ms_ >= 60000) {
+            rate_window_ms_ = now_ms;
+            rate_count_ = 0;
+        }
+        if (rate_count_ >= max_rate_) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Flap suppression for a search state change. Called before
+ * the subscriber callback so a suppressed change costs only a counter.
+ * While suppressing every change is folded into a single summary
+ * sent by endSuppression().
+ *
+ * @param [in]now_ms monotonic time in ms.
+ *
+ * @return true if the subscriber should be notified.
+ */
+bool AD2EventSearch::allowNotify(uint64_t now_ms)
+{
+    if (suppressing_) {
+        suppressed_++;
+        return false;
+    }
+    suppressed_ = 0;
+    if (!canNotify(now_ms)) {
+        suppressing_ = true;
+        suppressed_ = 1;
+        return false;
+    }
+    last_notify_ms_ = now_ms;
+    rate_count_++;
+    return true;
+}
+
+/**
+ * @brief End flap suppression once the hold time and rate limit allow.
+ * The subscriber is then notified once with the last state and
+ * getSuppressed() returns the number of changes that were folded in.
+ *
+ * @param [in]now_ms monotonic time in ms.
+ *
+ * @return true if suppression ended and a summary is due.
+ */
+bool AD2EventSearch::endSuppression(uint64_t now_ms)
+{
+    if (!suppressing_ || !canNotify(now_ms)) {
+        return false;
+    }
+    suppressing_ = false;
+    last_notify_ms_ = now_ms;
+    rate_count_++;
+    return true;
+}
+
+/**
+ * @brief Compile one REGEX list. Bad patterns are logged and skipped.
+ *
+ * @param [in]list std::vector<std::string> & patterns.
+ * @param [out]out std::vector<std::regex> & compiled patterns.
+ */
+static void compile_regex_list(const std::vector<std::string> &list, std::vector<std::regex> &out)
+{
+    out.clear();
+    for (auto &regexstr : list) {
+        try {
+            out.emplace_back(regexstr);
+        } catch (std::exception const& e) { // catch (std::regex_error& e) {
+#if defined(IDF_VER)
+            ESP_LOGE(TAG, "!ERR: regex error: '%s' '%s'", e.what(), regexstr.c_str());
+#endif
+        }
+    }
+}
+
+/**
+ * @brief Compile PRE_FILTER_REGEX and the CLOSE, OPEN and TROUBLE REGEX
+ * lists. Building a std::regex costs far more than a search so it is
+ * done once and not for every message.
+ */
+void AD2EventSearch::compile()
+{
+    std::vector<std::string> filter;
+    if (PRE_FILTER_REGEX.length()) {
+        filter.push_back(PRE_FILTER_REGEX);
+    }
+    compile_regex_list(filter, filter_re_);
+    // A bad filter matches nothing.
+    if (filter.size() && !filter_re_.size()) {
+        filter_re_.emplace_back("$^");
+    }
+    compile_regex_list(CLOSE_REGEX_LIST, close_re_);
+    compile_regex_list(OPEN_REGEX_LIST, open_re_);
+    compile_regex_list(TROUBLE_REGEX_LIST, trouble_re_);
+    compiled_ = true;
+}
+
+/**
+ * @brief Test a message against the filters and then the CLOSE, OPEN
+ * and TROUBLE patterns. The first pattern that matches sets the state
+ * and RESULT_GROUPS.
+ *
+ * @param [in]mt message type.
+ * @param [in]msg message to test.
+ * @param [out]outformat output format of the matched state. Unchanged if no match.
+ *
+ * @return false if the message type or filter skip the message.
+ */
+bool AD2EventSearch::match(ad2_message_t mt, const std::string &msg, std::string &outformat)
+{
+    if (!compiled_) {
+        compile();
+    }
+
+    // Pre filter tests for message type.
+    /// only test if a list is supplied.
+    if (PRE_FILTER_MESAGE_TYPE.size() &&
+            std::find(PRE_FILTER_MESAGE_TYPE.begin(), PRE_FILTER_MESAGE_TYPE.end(), mt) == PRE_FILTER_MESAGE_TYPE.end()) {
+        return false;
+    }
+
+    struct {
+        std::vector<std::regex> *list;
+        int state;
+        std::string *format;
+    } tests[] = {
+        {&close_re_, AD2_STATE_CLOSED, &CLOSE_OUTPUT_FORMAT},
+        {&open_re_, AD2_STATE_OPEN, &OPEN_OUTPUT_FORMAT},
+        {&trouble_re_, AD2_STATE_TROUBLE, &TROUBLE_OUTPUT_FORMAT}
+    };
+
+    try {
+        // Pre filter tests for message REGEX match.
+        for (auto &re : filter_re_) {
+            if (!std::regex_search(msg, re)) {
+                return false;
+            }
+        }
+
+        // Test each list stop on first matching statement.
+        for (auto &t : tests) {
+            for (auto &re : *t.list) {
+                std::smatch m;
+                if (std::regex_search(msg, m, re)) {
+                    // regex match
+                    setState(t.state);
+                    outformat = *t.format;
+                    // Clear last output results before we collect new.
+                    RESULT_GROUPS.clear();
+                    // save the regex group results if any.
+                    for (auto idx : m) {
+                        RESULT_GROUPS.push_back(idx);
+                    }
+                    return true;
+                }
+            }
+        }
+    } catch (std::exception const& e) { // catch (std::regex_error& e) {
+#if defined(IDF_VER)
+        ESP_LOGE(TAG, "!ERR: regex error: '%s' '%s'", e.what(), msg.c_str());
+#endif
+    }
+    return true;
+}
+
 /**
  * @brief Sequentially call each subscriber function in the list.
  *
@@ -418,10 +599,17 @@ void AlarmDecoderParser::subscribeTo(AD2SubScriber::AD2ParserCallback_sub_t fn,
  */
 void AlarmDecoderParser::notifySearchSubscribers(ad2_message_t mt, std::string &msg, AD2PartitionState *pstate)
 {
+    uint64_t now_ms = monotonicTimeMs();
     for ( subscribers_t::iterator i = AD2Subscribers[ON_SEARCH_MATCH].begin(); i != AD2Subscribers[ON_SEARCH_MATCH].end(); ++i ) {
         if (i->varg) {
             AD2EventSearch *eSearch = (AD2EventSearch*)i->varg;
-            bool done = false;
+
+            // Flap suppression ended. Send the last state with a summary
+            // before this message is tested. Checked on every message so
+            // it does not depend on the filters.
+            if (eSearch->endSuppression(now_ms)) {
+                ((AD2SubScriber::AD2ParserCallback_sub_t)i->fn)(&eSearch->last_message, nullptr, i->varg);
+            }
 
             // test reset time if set and restore state to default if true.
             // FIXME: For now only TRUE/FALSE no actual time tracked.
@@ -431,124 +619,19 @@ void AlarmDecoderParser::notifySearchSubscribers(ad2_message_t mt, std::string &
 
             int savedstate = eSearch->getState();
             std::string outformat;
-
-            // Pre filter tests for message type.
-            std::vector<ad2_message_t> *fmt = &eSearch->PRE_FILTER_MESAGE_TYPE;
-            /// only test if a list is supplied.
-            if (fmt->size()) {
-                bool res = false;
-                if(std::find(fmt->begin(), fmt->end(), mt)!=fmt->end()) {
-                    // Found the item
-                    res = true;
-                }
-                if (!res) {
-                    // no match next subscriber.
-                    continue;
-                }
+            if (!eSearch->match(mt, msg, outformat)) {
+                // no match next subscriber.
+                continue;
             }
 
-            // Pre filter tests for message REGEX match.
-            std::string pfregex = eSearch->PRE_FILTER_REGEX;
-            /// only test if supplied.
-            if (pfregex.length()) {
-                std::smatch m;
-                std::regex re(pfregex);
-                const auto& tmsg = msg;
-                std::match_results< std::string::const_iterator > mr;
-                bool res = std::regex_search(tmsg, m, re);
-                if (!res) {
-                    // no match next subscriber.
-                    continue;
-                }
-            }
-
-            // Test CLOSED REGEX list stop on first matching statement.
-            /// only test if a list is supplied.
-            if (!done && eSearch->CLOSE_REGEX_LIST.size()) {
-                for(auto &regexstr : eSearch->CLOSE_REGEX_LIST) {
-                    try {
-                        std::smatch m;
-                        std::regex re(regexstr);
-                        const auto& tmsg = msg;
-                        std::match_results< std::string::const_iterator > mr;
-                        bool res = std::regex_search(tmsg, m, re);
-                        if (res) {
-                            // regex match
-                            eSearch->setState(AD2_STATE_CLOSED);
-                            outformat = eSearch->CLOSE_OUTPUT_FORMAT;
-                            // Clear last output results before we collect new.
-                            eSearch->RESULT_GROUPS.clear();
-                            // save the regex group results if any.
-                            for(auto idx : m) {
-                                eSearch->RESULT_GROUPS.push_back(idx);
-                            }
-                            done = true;
-                            break;
-                        }
-                    } catch (std::exception const& e) { // catch (std::regex_error& e) {
-#if defined(IDF_VER)
-                        ESP_LOGE(TAG, "!ERR: regex error: '%s' '%s' '%s'", e.what(), regexstr.c_str(), msg.c_str());
-#endif
-                        done = true;
-                        break;
-                    }
-                }
-            }
-
-            // Test OPEN REGEX list stop on first matching statement.
-            /// only test if a list is supplied.
-            if (!done && eSearch->OPEN_REGEX_LIST.size()) {
-                for(auto &regexstr : eSearch->OPEN_REGEX_LIST) {
-                    std::smatch m;
-                    std::regex e(regexstr);
-                    const auto& tmsg = msg;
-                    bool res = std::regex_search(tmsg, m, e);
-                    if (res) {
-                        // regex match
-                        eSearch->setState(AD2_STATE_OPEN);
-                        outformat = eSearch->OPEN_OUTPUT_FORMAT;
-                        // Clear last output results before we collect new.
-                        eSearch->RESULT_GROUPS.clear();
-                        // save the regex group results if any.
-                        for(auto idx : m) {
-                            eSearch->RESULT_GROUPS.push_back(idx);
-                        }
-                        done = true;
-                        break;
-                    }
-                }
-            }
-
-            // Test TROUBLE REGEX list stop on first matching statement.
-            /// only test if a list is supplied.
-            if (!done && eSearch->TROUBLE_REGEX_LIST.size()) {
-                for(auto &regexstr : eSearch->TROUBLE_REGEX_LIST) {
-                    std::smatch m;
-                    std::regex e(regexstr);
-                    const auto& tmsg = msg;
-                    std::match_results< std::string::const_iterator > mr;
-                    bool res = std::regex_search(tmsg, m, e);
-                    if (res) {
-                        // regex match
-                        outformat = eSearch->TROUBLE_OUTPUT_FORMAT;
-                        eSearch->setState(AD2_STATE_TROUBLE);
-                        // Clear last output results before we collect new.
-                        eSearch->RESULT_GROUPS.clear();
-                        // save the regex group results if any.
-                        for(auto idx : m) {
-                            eSearch->RESULT_GROUPS.push_back(idx);
-                        }
-                        done = true;
-                        break;
-                    }
-                }
-            }
-
-            // Match found and state changed. Call the callback routine.
+            // Match found and state changed. Call the callback routine
+            // unless hold time or rate limits are suppressing this switch.
             if (savedstate != eSearch->getState()) {
                 eSearch->last_message = msg;
                 eSearch->out_message = outformat; //FIXME do the formatting macro magic stuff.
-                ((AD2SubScriber::AD2ParserCallback_sub_t)i->fn)(&msg, pstate, i->varg);
+                if (eSearch->allowNotify(now_ms)) {
+                    ((AD2SubScriber::AD2ParserCallback_sub_t)i->fn)(&msg, pstate, i->varg);
+                }
             }
 
             // All done with this subscriber. Next.
@@ -707,7 +790,7 @@ void AlarmDecoderParser::setZoneType(uint8_t zone, const char* type)
  * @note Parse all of the data firing off events upon parsing a full message.
  *   Continue parsing data until all is consumed.
  */
-bool AlarmDecoderParser::put(uint8_t *buff, int8_t len)
+bool AlarmDecoderParser::put(uint8_t *buff, size_t len)
 {
 
     // All AlarmDecoder messages are '\n' terminated.
@@ -717,11 +800,11 @@ bool AlarmDecoderParser::put(uint8_t *buff, int8_t len)
     // If KPM config bit is not set(the default) then standard keypad state
     // messages start with '['.
 
-    int8_t bytes_left = len;
+    size_t bytes_left = len;
     uint8_t *bp = buff;
 
     // Sanity check.
-    if (len<=0) {
+    if (!len) {
         return false;
     }
 
@@ -942,6 +1025,12 @@ bool AlarmDecoderParser::put(uint8_t *buff, int8_t len)
                         // call ON_ERR callback if enabled.
                         MESSAGE_TYPE = ERR_MESSAGE_TYPE;
                         notifySubscribers(ON_ERR, msg, nostate);
+                    } else if (msg.find("!Sending") == 0) {
+                        // keypress send acknowledgement "!Sending...done"
+                        if (msg.find("done") != std::string::npos) {
+                            // call ON_SENDING_RECEIVED callback if enabled.
+                            notifySubscribers(ON_SENDING_RECEIVED, msg, nostate);
+                        }
                     } else if (msg.find("!CONFIG>") == 0) {
                         // save the AlarmDecoder firmware configuration string if change.
                         std::string _new = msg.substr(8);
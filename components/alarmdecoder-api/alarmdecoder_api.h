@@ -393,17 +393,56 @@ class AD2EventSearch
      */
     int reset_time_;
 
+    ///< Minimum time in ms between notifications. 0 disables.
+    int hold_time_;
+
+    ///< Maximum notifications per minute. 0 disables.
+    int max_rate_;
+
+    ///< Flap suppression tracking.
+    uint64_t last_notify_ms_;
+    uint64_t rate_window_ms_;
+    int rate_count_;
+    bool suppressing_;
+    int suppressed_;
+
+    // true if hold time and rate limit allow a notification now.
+    bool canNotify(uint64_t now_ms);
+
+    ///< PRE_FILTER_REGEX and REGEX lists compiled once. See compile().
+    bool compiled_;
+    std::vector<std::regex> filter_re_;
+    std::vector<std::regex> open_re_;
+    std::vector<std::regex> close_re_;
+    std::vector<std::regex> trouble_re_;
+
 public:
     AD2EventSearch()
         : current_state_(AD2_STATE_CLOSED)
         , default_state_(AD2_STATE_CLOSED)
         , reset_time_( 0 )
+        , hold_time_( 0 )
+        , max_rate_( 0 )
+        , last_notify_ms_( 0 )
+        , rate_window_ms_( 0 )
+        , rate_count_( 0 )
+        , suppressing_( false )
+        , suppressed_( 0 )
+        , compiled_( false )
     { }
 
     AD2EventSearch(AD2_CMD_ZONE_state_t default_state, int reset_time_in_ms)
         : current_state_(default_state)
         , default_state_(default_state)
         , reset_time_(reset_time_in_ms)
+        , hold_time_( 0 )
+        , max_rate_( 0 )
+        , last_notify_ms_( 0 )
+        , rate_window_ms_( 0 )
+        , rate_count_( 0 )
+        , suppressing_( false )
+        , suppressed_( 0 )
+        , compiled_( false )
     { }
 
     // get/set current_state_
@@ -436,6 +475,45 @@ public:
         reset_time_ = ms;
     }
 
+    // get/set hold_time_
+    int getHoldTime()
+    {
+        return hold_time_;
+    }
+    void setHoldTime(int ms)
+    {
+        hold_time_ = ms;
+    }
+
+    // get/set max_rate_
+    int getMaxRate()
+    {
+        return max_rate_;
+    }
+    void setMaxRate(int per_minute)
+    {
+        max_rate_ = per_minute;
+    }
+
+    // state changes folded into the current notification. 0 if none.
+    int getSuppressed()
+    {
+        return suppressed_;
+    }
+
+    // flap suppression. Test a state change and start suppressing if limited.
+    bool allowNotify(uint64_t now_ms);
+
+    // flap suppression. true when suppression ended and a summary is due.
+    bool endSuppression(uint64_t now_ms);
+
+    // Compile the filter and REGEX lists. Done on the first message so
+    // only needed again if the lists are changed after that.
+    void compile();
+
+    // Test a message. false if the filters skip it.
+    bool match(ad2_message_t mt, const std::string &msg, std::string &outformat);
+
     ///< List of MESSAGE TYPES to filter for.
     std::vector<ad2_message_t>
     PRE_FILTER_MESAGE_TYPE;
@@ -478,6 +556,9 @@ public:
     /// user supplied value
     int INT_ARG;
     void *PTR_ARG;
+
+    /// user supplied delivery priority for notifications from this search.
+    int PRIORITY_ARG = 0;
 };
 
 /**
@@ -525,7 +606,7 @@ public:
 
     // Push data into state machine. Events fire if a complete message is
     // received.
-    bool put(uint8_t *buf, int8_t len);
+    bool put(uint8_t *buf, size_t len);
 
     // Reset the parser state machine.
     void reset_parser();
@@ -565,6 +646,13 @@ public:
                (std::chrono::system_clock::now().time_since_epoch()).count();
     }
 
+    // return monotonic time in ms for event search flap suppression
+    uint64_t monotonicTimeMs()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>
+               (std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
     // check for zones that timeout. Restore and notify.
     void checkZoneTimeout();
 
@@ -33,6 +33,7 @@ static const char *TAG = "PUSHOVER";
 #include "alarmdecoder_main.h"
 
 // specific includes
+#include <memory>
 
 //#define DEBUG_PUSHOVER
 #define AD2_DEFAULT_PUSHOVER_SLOT 0
@@ -45,6 +46,10 @@ const char PUSHOVER_URL[] = "https://api.pushover.net/" PUSHOVER_API_VERSION "/m
 #define PUSHOVER_TOKEN_SUBCMD   "apptoken"
 #define PUSHOVER_USERKEY_SUBCMD "userkey"
 #define PUSHOVER_SWITCH_SUBCMD  "switch"
+#define PUSHOVER_BATCH_SUBCMD   "batch"
+
+// Pushover message size limit.
+#define PUSHOVER_MAX_MESSAGE 1024
 
 #define PUSHOVER_CONFIG_SECTION "pushover"
 
@@ -58,10 +63,23 @@ const char PUSHOVER_URL[] = "https://api.pushover.net/" PUSHOVER_API_VERSION "/m
     PUSHOVER_CONFIG_SWITCH_SUFFIX_TROUBLE)
 
 
-static std::vector<AD2EventSearch *> pushover_AD2EventSearches;
+// forward decl
 
+/**
+ * @brief Provider settings for a notification slot.
+ * Loaded from the config once and replaced, never modified, when the
+ * [pushover] section changes.
+ */
+struct po_slot_config {
+    int batch_ms = 0;
+    bool configured = false;    // token and user key set.
+    std::string auth_post;  // urlencoded "token=...&user=..." POST prefix.
+};
+typedef std::shared_ptr<const po_slot_config> po_slot_config_ptr;
 
-// forward decl
+// slot settings cache. Filled at init and on first use.
+static std::map<int, po_slot_config_ptr> _po_slot_configs;
+static SemaphoreHandle_t _po_slot_configs_mutex = nullptr;
 
 /**
  * @brief class that will be stored in the sendQ for each request.
@@ -84,8 +102,7 @@ public:
     esp_http_client_config_t* config_client;
 
     // Application specific
-    std::string token;
-    std::string userkey;
+    po_slot_config_ptr cfg;
     std::string message;
     std::string post;
     std::string results;
@@ -102,10 +119,12 @@ static void _sendQ_ready_handler(esp_http_client_handle_t client, esp_http_clien
     if (client) {
         request_message *r = (request_message*) config->user_data;
 
+        // results from a failed attempt.
+        r->results = "";
+
         // Pushover message API
         //   https://pushover.net/api
-        r->post = std::string("token=" + ad2_urlencode(r->token) + "&user=" + ad2_urlencode(r->userkey) + \
-                              "&message=" + ad2_urlencode(r->message));
+        r->post = r->cfg->auth_post + "&message=" + ad2_urlencode(r->message);
 
         // does not copy data just a pointer so we have to maintain memory.
         esp_http_client_set_post_field(client, r->post.c_str(), r->post.length());
@@ -204,59 +223,216 @@ esp_err_t _pushover_http_event_handler(esp_http_client_event_t *evt)
 }
 
 /**
- * @brief SmartSwitch match callback.
- * Called when the current message matches a AD2EventSearch test.
+ * @brief Load the provider settings for a notification slot from config.
  *
- * @param [in]msg std::string new version string.
- * @param [in]s nullptr
- * @param [in]arg nullptr.
+ * @param [in]notify_slot int notification slot.
  *
- * @note No full queue handler
+ * @return po_slot_config_ptr new immutable settings.
  */
-void on_search_match_cb_pushover(std::string *msg, AD2PartitionState *s, void *arg)
+static po_slot_config_ptr _load_slot_config(int notify_slot)
 {
+    po_slot_config *cfg = new po_slot_config();
 
-    AD2EventSearch *es = (AD2EventSearch *)arg;
+    ad2_get_config_key_int(PUSHOVER_CONFIG_SECTION, PUSHOVER_BATCH_SUBCMD, &cfg->batch_ms, notify_slot);
 
-    // es->PTR_ARG is the notification slots std::list for this notification.
-    std::list<uint8_t> *notify_list = (std::list<uint8_t>*)es->PTR_ARG;
-    for (uint8_t const& notify_slot : *notify_list) {
+    // get the pushover api token and user key
+    std::string token;
+    std::string userkey;
+    ad2_get_config_key_string(PUSHOVER_CONFIG_SECTION, PUSHOVER_TOKEN_SUBCMD, token, notify_slot);
+    ad2_get_config_key_string(PUSHOVER_CONFIG_SECTION, PUSHOVER_USERKEY_SUBCMD, userkey, notify_slot);
+    cfg->configured = token.length() && userkey.length();
+    cfg->auth_post = "token=" + ad2_urlencode(token) + "&user=" + ad2_urlencode(userkey);
+
+    return po_slot_config_ptr(cfg);
+}
+
+/**
+ * @brief Get the cached provider settings for a notification slot.
+ * Loaded from config on first use.
+ *
+ * @param [in]notify_slot int notification slot.
+ *
+ * @return po_slot_config_ptr
+ */
+static po_slot_config_ptr _get_slot_config(int notify_slot)
+{
+    po_slot_config_ptr cfg;
+    xSemaphoreTake(_po_slot_configs_mutex, portMAX_DELAY);
+    auto it = _po_slot_configs.find(notify_slot);
+    if (it != _po_slot_configs.end()) {
+        cfg = it->second;
+    }
+    xSemaphoreGive(_po_slot_configs_mutex);
 
-        // Container to store details needed for delivery.
-        request_message *r = new request_message();
+    if (!cfg) {
+        cfg = _load_slot_config(notify_slot);
+        xSemaphoreTake(_po_slot_configs_mutex, portMAX_DELAY);
+        _po_slot_configs[notify_slot] = cfg;
+        xSemaphoreGive(_po_slot_configs_mutex);
+    }
+    return cfg;
+}
 
-        // load our settings for this event type.
-        // get the pushover user key
-        ad2_get_config_key_string(PUSHOVER_CONFIG_SECTION, PUSHOVER_USERKEY_SUBCMD, r->userkey, notify_slot);
+/**
+ * @brief ad2_config change callback for the [pushover] section.
+ * Reload the cached slots. Requests already queued keep the settings
+ * they were built with.
+ *
+ * @param [in]section config section.
+ * @param [in]key config key that changed.
+ */
+static void _config_change_handler(const char *section, const char *key)
+{
+    std::vector<int> slots;
+    xSemaphoreTake(_po_slot_configs_mutex, portMAX_DELAY);
+    for (auto &x : _po_slot_configs) {
+        slots.push_back(x.first);
+    }
+    xSemaphoreGive(_po_slot_configs_mutex);
 
-        // get the pushover api token
-        ad2_get_config_key_string(PUSHOVER_CONFIG_SECTION, PUSHOVER_TOKEN_SUBCMD, r->token, notify_slot);
+    for (auto slot : slots) {
+        po_slot_config_ptr cfg = _load_slot_config(slot);
+        xSemaphoreTake(_po_slot_configs_mutex, portMAX_DELAY);
+        _po_slot_configs[slot] = cfg;
+        xSemaphoreGive(_po_slot_configs_mutex);
+    }
+}
 
-        // save the message
-        r->message = es->out_message;
+/**
+ * @brief Build a request for a notification slot.
+ *
+ * @param [in]notify_slot uint8_t notification slot.
+ * @param [in]message std::string & message to send.
+ *
+ * @return request_message *
+ */
+static request_message *_build_request(uint8_t notify_slot, const std::string &message)
+{
+    // Container to store details needed for delivery.
+    request_message *r = new request_message();
 
-        // Settings specific for http_client_config
-        r->config_client->url = PUSHOVER_URL;
-        // set request type
-        r->config_client->method = HTTP_METHOD_POST;
+    // cached settings for this slot.
+    r->cfg = _get_slot_config(notify_slot);
 
-        // optional define an internal event handler
-        r->config_client->event_handler = _pushover_http_event_handler;
+    // save the message
+    r->message = message;
 
-        // required save internal class to user_data to be used in callback.
-        r->config_client->user_data = (void *)r; // Definition of grok.. see grok.
+    // Settings specific for http_client_config
+    r->config_client->url = PUSHOVER_URL;
+    // set request type
+    r->config_client->method = HTTP_METHOD_POST;
 
-        // Fails, but not needed to work.
-        // config_client->use_global_ca_store = true;
+    // optional define an internal event handler
+    r->config_client->event_handler = _pushover_http_event_handler;
 
-        // Add client config to the http_sendQ for processing.
-        bool res = ad2_add_http_sendQ(r->config_client, _sendQ_ready_handler, _sendQ_done_handler);
-        if (res) {
-            ESP_LOGI(TAG,"Switch #%i match message '%s'. Sending '%s' to acid #%i", es->INT_ARG, msg->c_str(), es->out_message.c_str(), notify_slot);
-        } else {
-            ESP_LOGE(TAG,"Error adding HTTP request to ad2_add_http_sendQ.");
-            // destroy storage class if we fail to add to the sendQ
-            delete r;
+    // required save internal class to user_data to be used in callback.
+    r->config_client->user_data = (void *)r; // Definition of grok.. see grok.
+
+    // Fails, but not needed to work.
+    // config_client->use_global_ca_store = true;
+
+    return r;
+}
+
+/**
+ * @brief ad2_http_sendQ spool callback. Rebuild a request saved before a restart.
+ *
+ * @param [in]record std::string & "<slot> <message>"
+ *
+ * @return esp_http_client_config_t *
+ */
+static esp_http_client_config_t *_sendQ_restore_handler(const std::string &record)
+{
+    size_t pos = record.find(' ');
+    if (pos == std::string::npos) {
+        return nullptr;
+    }
+
+    // skip notification slots that were removed.
+    int notify_slot = atoi(record.substr(0, pos).c_str());
+    if (!_get_slot_config(notify_slot)->configured) {
+        return nullptr;
+    }
+
+    request_message *r = _build_request(notify_slot, record.substr(pos + 1));
+    return r->config_client;
+}
+
+/**
+ * @brief Build and queue a notification for a slot.
+ *
+ * @param [in]notify_slot int notification slot.
+ * @param [in]message std::string & message to send.
+ * @param [in]priority int ad2_priority_t.
+ *
+ * @return bool true if queued.
+ */
+static bool _queue_notification(int notify_slot, const std::string &message, int priority)
+{
+    // Container to store details needed for delivery.
+    request_message *r = _build_request(notify_slot, message);
+
+    // Add client config to the http_sendQ for processing.
+    // Saved to the spool if enabled to be rebuilt after a restart.
+    std::string record = std::to_string(notify_slot) + " " + message;
+    bool res = ad2_add_http_sendQ(r->config_client, _sendQ_ready_handler, _sendQ_done_handler, priority,
+                                  PUSHOVER_CONFIG_SECTION, record);
+    if (!res) {
+        ESP_LOGE(TAG,"Error adding HTTP request to ad2_add_http_sendQ.");
+        // destroy storage class if we fail to add to the sendQ
+        delete r;
+    }
+    return res;
+}
+
+/**
+ * @brief ad2_digest callback. Send the messages merged for a slot.
+ *
+ * @param [in]notify_slot int notification slot.
+ * @param [in]message std::string & merged messages.
+ * @param [in]priority int highest ad2_priority_t of the merged messages.
+ */
+static void _digest_flush_handler(int notify_slot, const std::string &message, int priority)
+{
+    if (_queue_notification(notify_slot, message, priority)) {
+        ESP_LOGI(TAG,"Sending batch '%s' to acid #%i", message.c_str(), notify_slot);
+    }
+}
+
+/**
+ * @brief SmartSwitch match callback.
+ * Called when a shared virtual switch changes state.
+ *
+ * @param [in]msg std::string * message that changed the state.
+ * @param [in]es AD2EventSearch * switch.
+ * @param [in]out const std::string & output string for the new state.
+ * @param [in]arg std::list<uint8_t> * notification slots.
+ *
+ * @note No full queue handler
+ */
+void on_search_match_cb_pushover(std::string *msg, AD2EventSearch *es, const std::string &out, void *arg)
+{
+    // Flap suppression summary. Last state and the number of changes folded in.
+    std::string message = out;
+    if (es->getSuppressed()) {
+        message += " (" + std::to_string(es->getSuppressed()) + " changes suppressed)";
+    }
+
+    // arg is the notification slots std::list for this notification.
+    std::list<uint8_t> *notify_list = (std::list<uint8_t>*)arg;
+    for (uint8_t const& notify_slot : *notify_list) {
+
+        // Merge with other messages for this slot if batching is enabled.
+        // cli example: pushover batch 1 2000
+        int batch_ms = _get_slot_config(notify_slot)->batch_ms;
+        if (batch_ms > 0) {
+            ad2_digest_add(_digest_flush_handler, notify_slot, message, es->PRIORITY_ARG, batch_ms, PUSHOVER_MAX_MESSAGE);
+            ESP_LOGI(TAG,"Switch #%i match message '%s'. Batching '%s' for acid #%i", es->INT_ARG, msg->c_str(), message.c_str(), notify_slot);
+            continue;
+        }
+
+        if (_queue_notification(notify_slot, message, es->PRIORITY_ARG)) {
+            ESP_LOGI(TAG,"Switch #%i match message '%s'. Sending '%s' to acid #%i", es->INT_ARG, msg->c_str(), message.c_str(), notify_slot);
         }
     }
 }
@@ -267,19 +443,21 @@ void on_search_match_cb_pushover(std::string *msg, AD2PartitionState *s, void *a
 enum {
     PUSHOVER_TOKEN_SUBCMD_ID = 0,
     PUSHOVER_USERKEY_SUBCMD_ID,
-    PUSHOVER_SWITCH_SUBCMD_ID
+    PUSHOVER_SWITCH_SUBCMD_ID,
+    PUSHOVER_BATCH_SUBCMD_ID
 };
 char * PUSHOVER_SUBCMD [] = {
     (char*)PUSHOVER_TOKEN_SUBCMD,
     (char*)PUSHOVER_USERKEY_SUBCMD,
     (char*)PUSHOVER_SWITCH_SUBCMD,
+    (char*)PUSHOVER_BATCH_SUBCMD,
     0 // EOF
 };
 
 /**
  * Component generic command event processing
  *
- * Usage: pushover (apptoken|userkey) <acid> [<arg>]
+ * Usage: pushover (apptoken|userkey|batch) <acid> [<arg>]
  */
 static void _cli_cmd_pushover_event_generic(std::string &subcmd, const char *string)
 {
@@ -406,6 +584,7 @@ static void _cli_cmd_pushover_command_router(const char *string)
             switch(i) {
             case PUSHOVER_TOKEN_SUBCMD_ID:   // 'apptoken' sub command
             case PUSHOVER_USERKEY_SUBCMD_ID: // 'userkey' sub command
+            case PUSHOVER_BATCH_SUBCMD_ID:   // 'batch' sub command
                 _cli_cmd_pushover_event_generic(subcmd, string);
                 break;
             case PUSHOVER_SWITCH_SUBCMD_ID:
@@ -426,13 +605,14 @@ static struct cli_command pushover_cmd_list[] = {
     {
         // ### Pushover.net notification component
         (char*)PUSHOVER_COMMAND,(char*)
-        "Usage: pushover (apptoken|userkey) <acid> [<arg>]\r\n"
+        "Usage: pushover (apptoken|userkey|batch) <acid> [<arg>]\r\n"
         "Usage: pushover switch <swid> [delete|-|notify|open|close|trouble] [<arg>]\r\n"
         "\r\n"
         "    Configuration tool for Pushover.net notification\r\n"
         "Commands:\r\n"
         "    apptoken acid [hash]    Application token/key HASH\r\n"
         "    userkey acid [hash]     User Auth Token HASH\r\n"
+        "    batch acid [ms]         Merge messages within ms into one. 0 disabled\r\n"
         "    switch swid SCMD [ARG]  Configure virtual switches\r\n"
         "Sub-Commands:\r\n"
         "    delete | -              Clear switch notification settings\r\n"
@@ -465,6 +645,9 @@ void pushover_register_cmds()
  */
 void pushover_init()
 {
+    // Slot settings cache. Reloaded when the [pushover] section changes.
+    _po_slot_configs_mutex = xSemaphoreCreateMutex();
+    ad2_register_config_change(PUSHOVER_CONFIG_SECTION, _config_change_handler);
 
     // Register search based virtual switches if enabled.
     // [switch N]
@@ -502,32 +685,7 @@ void pushover_init()
                   close_output_format.length() ||
                   trouble_output_format.length() )
            ) {
-            // key switch N
-            std::string key = std::string(AD2SWITCH_CONFIG_SECTION);
-            key += " ";
-            key += std::to_string(swID);
-
-            // Default switch state from global switch settings
-            int defaultState = AD2_STATE_UNKNOWN; // default default to unknown.
-            ad2_get_config_key_int(key.c_str(),
-                                   AD2SWITCH_SK_DEFAULT,
-                                   &defaultState);
-
-            // Auto reset time from global switch settings
-            int autoReset = 0;
-            ad2_get_config_key_int(key.c_str(),
-                                   AD2SWITCH_SK_RESET,
-                                   &autoReset);
-
-            // construct our search object.
-            AD2EventSearch *es1 = new AD2EventSearch((AD2_CMD_ZONE_state_t)defaultState, autoReset);
-
-            // store validated output formats.
-            es1->OPEN_OUTPUT_FORMAT = open_output_format;
-            es1->CLOSE_OUTPUT_FORMAT = close_output_format;
-            es1->TROUBLE_OUTPUT_FORMAT = trouble_output_format;
-
-            // save notify list to PTR_ARG.
+            // notification slots for this switch.
             std::list<uint8_t> *pslots = new std::list<uint8_t>;
             std::vector<std::string> vres;
             ad2_tokenize(notify_slots_string, ",", vres);
@@ -535,79 +693,23 @@ void pushover_init()
                 uint8_t s = std::atoi(slotstring.c_str());
                 pslots->push_front((uint8_t)s & 0xff);
             }
-            es1->PTR_ARG = pslots;
-
-            // save the NVS Virtual SWITCH ID so we can read the data back later.
-            es1->INT_ARG = swID;
-
-            // switch filter settings
-            std::string filter;
-
-            // Get the optional switch types to listen for.
-            std::string types = "";
-            std::vector<std::string> notify_types_v;
-            ad2_get_config_key_string(key.c_str(), AD2SWITCH_SK_TYPES, types);
-            ad2_tokenize(types, ", ", notify_types_v);
-            for (auto &sztype : notify_types_v) {
-                ad2_trim(sztype);
-                auto x = AD2Parse.message_type_id.find(sztype);
-                if(x != std::end(AD2Parse.message_type_id)) {
-                    ad2_message_t mt = (ad2_message_t)AD2Parse.message_type_id.at(sztype);
-                    es1->PRE_FILTER_MESAGE_TYPE.push_back(mt);
-                }
-            }
 
-            // load [switch N] required regex match settings
-            std::string prefilter_regex;
-            ad2_get_config_key_string(key.c_str(), AD2SWITCH_SK_FILTER, prefilter_regex);
-            es1->PRE_FILTER_REGEX = prefilter_regex;
-
-            // Load all regex search patterns for open, close, and trouble sub keys.
-            std::string regex_sk_list = AD2SWITCH_SK_OPEN " "
-                                        AD2SWITCH_SK_CLOSE " "
-                                        AD2SWITCH_SK_TROUBLE;
-
-            std::stringstream ss(regex_sk_list);
-            std::string sk;
-            int sk_index = 0;
-            while (ss >> sk) {
-                for ( int a = 1; a < AD2_MAX_SWITCH_SEARCH_KEYS; a++) {
-                    std::string out = "";
-                    ad2_get_config_key_string(key.c_str(), sk.c_str(), out, a);
-
-                    if ( out.length()) {
-                        if (sk_index == 0) {
-                            es1->OPEN_REGEX_LIST.push_back(out);
-                        }
-                        if (sk_index == 1) {
-                            es1->CLOSE_REGEX_LIST.push_back(out);
-                        }
-                        if (sk_index == 2) {
-                            es1->TROUBLE_REGEX_LIST.push_back(out);
-                        }
-                    }
+            // subscribe to the shared [switch N] for state changes.
+            if (ad2_switch_subscribe(swID, on_search_match_cb_pushover, pslots,
+                                     open_output_format,
+                                     close_output_format,
+                                     trouble_output_format)) {
+                // Load the settings for every slot used by the switch.
+                for (uint8_t const& notify_slot : *pslots) {
+                    _get_slot_config(notify_slot);
                 }
-                sk_index++;
-            }
-
-            // Must provide at least one states or it will be skipped.
-            if (es1->OPEN_REGEX_LIST.size() ||
-                    es1->CLOSE_REGEX_LIST.size() ||
-                    es1->TROUBLE_REGEX_LIST.size()) {
-                // Save the search to a list for management.
-                pushover_AD2EventSearches.push_back(es1);
-
-                // subscribe to the callback for events.
-                AD2Parse.subscribeTo(on_search_match_cb_pushover, es1);
 
                 // keep track of how many for user feedback.
                 subscribers++;
 
             } else {
-                // incomplete switch so delete it and supporting pointers.
+                // incomplete switch so delete supporting pointers.
                 delete pslots;
-                delete es1;
-                ESP_LOGE(TAG, "Error in config section [switch %i]. Need at least one open, close, or trouble filter expressions.", swID);
             }
         } else {
             if (open_output_format.length() || close_output_format.length()
@@ -617,6 +719,9 @@ void pushover_init()
         }
     }
 
+    // Send any notifications left in the sendQ spool.
+    ad2_register_http_sendQ_spool(PUSHOVER_CONFIG_SECTION, _sendQ_restore_handler, _sendQ_ready_handler, _sendQ_done_handler);
+
     ad2_printf_host(true, "%s: Init done. Found and configured %i virtual switches.", TAG, subscribers);
 
 }
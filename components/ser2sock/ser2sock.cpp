@@ -623,7 +623,7 @@ static bool _poll_read_fdset(fd_set *read_fdset)
 #endif
                             // FIXME: overide to send raw pointer and not buffer.
                             std::string tmp(buffer, received);
-                            ad2_send(tmp);
+                            ad2_send(tmp, true);
                         }
                     }
                 }
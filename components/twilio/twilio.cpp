@@ -34,6 +34,8 @@ static const char *TAG = "TWILIO";
 
 // specific includes
 #include <fmt/core.h>
+#include <algorithm>
+#include <memory>
 
 //#define DEBUG_TWILIO
 
@@ -52,6 +54,7 @@ static const char *TAG = "TWILIO";
 #define TWILIO_TYPE_SUBCMD    "type"
 #define TWILIO_FORMAT_SUBCMD  "format"
 #define TWILIO_SWITCH_SUBCMD  "switch"
+#define TWILIO_BATCH_SUBCMD   "batch"
 
 #define TWILIO_CONFIG_SECTION "twilio"
 
@@ -69,8 +72,10 @@ static const char *TAG = "TWILIO";
 #define TWILIO_NOTIFY_CALL    "C"
 #define TWILIO_NOTIFY_EMAIL   "E"
 
-std::vector<AD2EventSearch *> twilio_AD2EventSearches;
-
+// Batched message size limits by type.
+#define TWILIO_MAX_MESSAGE    1600  // SMS body.
+#define TWILIO_MAX_CALL       1000  // Spoken text.
+#define SENDGRID_MAX_MESSAGE  4096  // EMail body.
 
 // forward decl
 
@@ -79,6 +84,31 @@ enum {
     TWILIO_NEXT_STATE_GET,
 };
 
+/**
+ * @brief Provider settings for a notification slot.
+ * Loaded from the config once and replaced, never modified, when the
+ * [twilio] section changes. Requests keep a reference to the copy they
+ * were built with so the delivery path does no config lookups.
+ */
+struct tw_slot_config {
+    bool disabled = false;
+    char type = 0;
+    int batch_ms = 0;
+    size_t max_size = TWILIO_MAX_MESSAGE;
+    std::string from;
+    std::string to;
+    std::string format;
+    std::string url;                    // API url for the type.
+    std::string auth_header;            // Authorization header value.
+    std::vector<std::string> to_list;   // EMail to addresses.
+    std::string group_key;              // EMail slots with the same key share a request.
+};
+typedef std::shared_ptr<const tw_slot_config> tw_slot_config_ptr;
+
+// slot settings cache. Filled at init and on first use.
+static std::map<int, tw_slot_config_ptr> _tw_slot_configs;
+static SemaphoreHandle_t _tw_slot_configs_mutex = nullptr;
+
 /**
  * @brief class that will be stored in the sendQ for each request.
  */
@@ -102,6 +132,10 @@ public:
 
     // Application specific
     int notify_slot;
+    tw_slot_config_ptr cfg;
+    // more EMail slots sharing this SendGrid request. Same key and sender.
+    std::vector<uint8_t> group_slots;
+    std::vector<tw_slot_config_ptr> group_cfgs;
     std::string message;
     std::string url;
     std::string post;
@@ -117,30 +151,12 @@ public:
 static void _build_twilio_message_post(esp_http_client_handle_t client, tw_request_message *r)
 {
     esp_err_t err;
-    std::string auth_header;
-
-    // get token for this notification slot from config.
-    std::string sidString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_SID_SUBCMD, sidString, r->notify_slot);
-
-    // get sid for this notification slot from config.
-    std::string tokenString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TOKEN_SUBCMD, tokenString, r->notify_slot);
 
     // Set the Authorization header
-    auth_header = "Basic " + ad2_make_basic_auth_string(sidString, tokenString);
-    esp_http_client_set_header(client, "Authorization", auth_header.c_str());
-
-    // get from for this notification slot from config.
-    std::string fromString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_FROM_SUBCMD, fromString, r->notify_slot);
-
-    // get to for this notification slot from config.
-    std::string toString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TO_SUBCMD, toString, r->notify_slot);
+    ad2_http_set_header(client, "Authorization", r->cfg->auth_header.c_str());
 
     // Set post body
-    r->post = "To=" + ad2_urlencode(toString) + "&From=" + ad2_urlencode(fromString) + \
+    r->post = "To=" + ad2_urlencode(r->cfg->to) + "&From=" + ad2_urlencode(r->cfg->from) + \
               "&Body=" + ad2_urlencode(r->message);
 
     // does not copy data just a pointer so we have to maintain memory.
@@ -154,42 +170,19 @@ static void _build_twilio_message_post(esp_http_client_handle_t client, tw_reque
 static void _build_twilio_call_post(esp_http_client_handle_t client, tw_request_message *r)
 {
     esp_err_t err;
-    std::string auth_header;
-
-    // get sid for this notification slot from config.
-    std::string sidString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_SID_SUBCMD, sidString, r->notify_slot);
-
-    // get token for this notification slot from config.
-    std::string tokenString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TOKEN_SUBCMD, tokenString, r->notify_slot);
 
     // Set the Authorization header
-    auth_header = "Basic " + ad2_make_basic_auth_string(sidString, tokenString);
-    esp_http_client_set_header(client, "Authorization", auth_header.c_str());
+    ad2_http_set_header(client, "Authorization", r->cfg->auth_header.c_str());
 
     // Build the Twiml message using the format and message as the arg
     // TODO: Multiple args by splitting r->message using , or |
-
-    // get format template string for this notification slot from config.
-    std::string formatString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_FORMAT_SUBCMD, formatString, r->notify_slot);
-
-    // get from for this notification slot from config.
-    std::string fromString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_FROM_SUBCMD, fromString, r->notify_slot);
-
-    // get to for this notification slot from config.
-    std::string toString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TO_SUBCMD, toString, r->notify_slot);
-
-    std::string twiml = fmt::format(fmt::runtime(formatString), r->message);
+    std::string twiml = fmt::format(fmt::runtime(r->cfg->format), r->message);
 #if defined(DEBUG_TWILIO)
     ESP_LOGI(TAG, "Sending Twiml message: %s", twiml.c_str());
 #endif
 
     // Set post body
-    r->post = "To=" + ad2_urlencode(toString) + "&From=" + ad2_urlencode(fromString) + \
+    r->post = "To=" + ad2_urlencode(r->cfg->to) + "&From=" + ad2_urlencode(r->cfg->from) + \
               "&Twiml=" + ad2_urlencode(twiml);
 
     // does not copy data just a pointer so we have to maintain memory.
@@ -203,13 +196,8 @@ static void _build_sendgrid_post(esp_http_client_handle_t client, tw_request_mes
 {
     esp_err_t err;
 
-    // get sid for this notification slot from config.
-    std::string tokenString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TOKEN_SUBCMD, tokenString, r->notify_slot);
-
     // Set the Authorization header
-    std::string auth_header = "Bearer " + tokenString;
-    esp_http_client_set_header(client, "Authorization", auth_header.c_str());
+    ad2_http_set_header(client, "Authorization", r->cfg->auth_header.c_str());
 
     // object: root
     cJSON *_root = cJSON_CreateObject();
@@ -217,13 +205,9 @@ static void _build_sendgrid_post(esp_http_client_handle_t client, tw_request_mes
     // array: personalizations
     cJSON *_personalizations = cJSON_CreateArray();
 
-    // get from for this notification slot from config.
-    std::string fromString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_FROM_SUBCMD, fromString, r->notify_slot);
-
     // object: from
     cJSON *_from = cJSON_CreateObject();
-    cJSON_AddStringToObject(_from, "email", fromString.c_str());
+    cJSON_AddStringToObject(_from, "email", r->cfg->from.c_str());
 
     // array: content
     cJSON *_content = cJSON_CreateArray();
@@ -238,13 +222,18 @@ static void _build_sendgrid_post(esp_http_client_handle_t client, tw_request_mes
     cJSON_AddItemToObject(_root, "personalizations", _personalizations);
     cJSON_AddItemToObject(_root, "content", _content);
 
-    // get from for this notification slot from config.
-    std::string toString;
-    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TO_SUBCMD, toString, r->notify_slot);
+    // to addresses for this notification slot and any grouped slots.
+    // One personalization per address so recipients do not see each other.
+    std::vector<std::string> to_list = r->cfg->to_list;
+    for (auto &cfg : r->group_cfgs) {
+        for (auto &szto : cfg->to_list) {
+            if (std::find(to_list.begin(), to_list.end(), szto) == to_list.end()) {
+                to_list.push_back(szto);
+            }
+        }
+    }
 
     // _personalizations -> to[]
-    std::vector<std::string> to_list;
-    ad2_tokenize(toString, ", ", to_list);
     for (auto &szto : to_list) {
         cJSON *_to = cJSON_CreateArray();
         cJSON *_pitem = cJSON_CreateObject();
@@ -264,7 +253,7 @@ static void _build_sendgrid_post(esp_http_client_handle_t client, tw_request_mes
     err = esp_http_client_set_post_field(client, r->post.c_str(), r->post.length());
 
     // set content type to json
-    esp_http_client_set_header(client, "Content-Type", "application/json; charset=utf-8");
+    ad2_http_set_header(client, "Content-Type", "application/json; charset=utf-8");
 
     cJSON_free(json);
     cJSON_Delete(_root);
@@ -282,13 +271,11 @@ static void _sendQ_ready_handler(esp_http_client_handle_t client, esp_http_clien
     if (client) {
         tw_request_message *r = (tw_request_message*) config->user_data;
 
-        // get twilio [type] : Used to determine delivery settings using SendGrid or twilio servers.
-        std::string type;
-        ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TYPE_SUBCMD, type, r->notify_slot);
-        type.resize(1);
+        // results from a failed attempt.
+        r->results = "";
 
         // Build POST based upon notification type
-        switch(type[0]) {
+        switch(r->cfg->type) {
 
         // Twilio Call api
         //     https://www.twilio.com/docs/voice/api/sip-making-calls
@@ -398,7 +385,8 @@ static bool _sendQ_done_handler(esp_err_t res, esp_http_client_handle_t client,
         cJSON_Delete(root);
     }
 
-    ESP_LOGI(TAG,"Notify slot #%i response code: '%i' status: '%s' message: '%s'", r->notify_slot, esp_http_client_get_status_code(client), szStatus.c_str(), szMessage.c_str());
+    // client is NULL if the request never made it out of the sendQ.
+    ESP_LOGI(TAG,"Notify slot #%i response code: '%i' status: '%s' message: '%s'", r->notify_slot, client ? esp_http_client_get_status_code(client) : -1, szStatus.c_str(), szMessage.c_str());
 
     // If first request was OK and we are scheduled to make GET for details.
     if (res == ESP_OK && r->state == TWILIO_NEXT_STATE_GET) {
@@ -491,111 +479,323 @@ esp_err_t _twilio_http_event_handler(esp_http_client_event_t *evt)
 }
 
 /**
- * @brief SmartSwitch match callback.
- * Called when the current message matches a AD2EventSearch test.
+ * @brief Load the provider settings for a notification slot from config.
  *
- * @param [in]msg std::string new version string.
- * @param [in]s nullptr
- * @param [in]arg nullptr.
+ * @param [in]notify_slot int notification slot.
  *
- * @note No full queue handler
+ * @return tw_slot_config_ptr new immutable settings.
  */
-void on_search_match_cb_tw(std::string *msg, AD2PartitionState *s, void *arg)
+static tw_slot_config_ptr _load_slot_config(int notify_slot)
 {
+    tw_slot_config *cfg = new tw_slot_config();
 
-    AD2EventSearch *es = (AD2EventSearch *)arg;
-#if defined(DEBUG_TWILIO)
-    ESP_LOGI(TAG, "ON_SEARCH_MATCH_CB: '%s' -> '%s' notify slot #%i", msg->c_str(), es->out_message.c_str(), es->INT_ARG);
-#endif
-    // es->PTR_ARG is the notification slots std::list for this notification.
-    std::list<uint8_t> *notify_list = (std::list<uint8_t>*)es->PTR_ARG;
-    for (uint8_t const& notify_slot : *notify_list) {
+    ad2_get_config_key_bool(TWILIO_CONFIG_SECTION, TWILIO_DISABLE_SUBCMD, &cfg->disabled, notify_slot);
+    ad2_get_config_key_int(TWILIO_CONFIG_SECTION, TWILIO_BATCH_SUBCMD, &cfg->batch_ms, notify_slot);
 
-        // skip if this notification slot if disabled.
-        // cli example: twilio disable 1 true
-        bool bDiabled = false;
-        ad2_get_config_key_bool(TWILIO_CONFIG_SECTION, TWILIO_DISABLE_SUBCMD, &bDiabled, notify_slot);
-        if (bDiabled) {
-            continue;
-        }
+    // get twilio [type] : Used to determine delivery settings using SendGrid or twilio servers.
+    std::string type;
+    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TYPE_SUBCMD, type, notify_slot);
+    type.resize(1);
+    cfg->type = type[0];
+
+    std::string sidString;
+    std::string tokenString;
+    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_SID_SUBCMD, sidString, notify_slot);
+    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TOKEN_SUBCMD, tokenString, notify_slot);
+    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_FROM_SUBCMD, cfg->from, notify_slot);
+    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TO_SUBCMD, cfg->to, notify_slot);
+    ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_FORMAT_SUBCMD, cfg->format, notify_slot);
+
+    // URL, auth header and size limit based upon the request type.
+    switch(cfg->type) {
+
+    // Twilio Call api
+    //     https://www.twilio.com/docs/voice/api/sip-making-calls
+    case TWILIO_NOTIFY_CALL[0]:
+        cfg->url = ad2_string_printf(TWILIO_URL_FMT, sidString.c_str(), "Calls.json");
+        cfg->auth_header = "Basic " + ad2_make_basic_auth_string(sidString, tokenString);
+        cfg->max_size = TWILIO_MAX_CALL;
+        break;
 
-        // Container to store details needed for delivery.
-        tw_request_message *r = new tw_request_message();
+    // Twilio Messages api
+    //     https://www.twilio.com/docs/sms/api/message-resource
+    case TWILIO_NOTIFY_MESSAGE[0]:
+        cfg->url = ad2_string_printf(TWILIO_URL_FMT, sidString.c_str(), "Messages.json");
+        cfg->auth_header = "Basic " + ad2_make_basic_auth_string(sidString, tokenString);
+        cfg->max_size = TWILIO_MAX_MESSAGE;
+        break;
 
-        // save the Account storage ID for the notification.
-        r->notify_slot = notify_slot;
+    // SendGrid Email api.
+    //     https://docs.sendgrid.com/api-reference/mail-send/mail-send
+    case TWILIO_NOTIFY_EMAIL[0]:
+        cfg->url = SENDGRID_URL;
+        cfg->auth_header = "Bearer " + tokenString;
+        cfg->max_size = SENDGRID_MAX_MESSAGE;
+        ad2_tokenize(cfg->to, ", ", cfg->to_list);
+        cfg->group_key = tokenString + " " + cfg->from;
+        break;
+    }
 
-        // save the message
-        r->message = es->out_message;
+    return tw_slot_config_ptr(cfg);
+}
 
-        // get sid for this notification slot from config.
-        std::string sidString;
-        ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_SID_SUBCMD, sidString, r->notify_slot);
+/**
+ * @brief Get the cached provider settings for a notification slot.
+ * Loaded from config on first use.
+ *
+ * @param [in]notify_slot int notification slot.
+ *
+ * @return tw_slot_config_ptr
+ */
+static tw_slot_config_ptr _get_slot_config(int notify_slot)
+{
+    tw_slot_config_ptr cfg;
+    xSemaphoreTake(_tw_slot_configs_mutex, portMAX_DELAY);
+    auto it = _tw_slot_configs.find(notify_slot);
+    if (it != _tw_slot_configs.end()) {
+        cfg = it->second;
+    }
+    xSemaphoreGive(_tw_slot_configs_mutex);
 
-        // get twilio [type] : Used to determine delivery settings using SendGrid or twilio servers.
-        std::string type;
-        ad2_get_config_key_string(TWILIO_CONFIG_SECTION, TWILIO_TYPE_SUBCMD, type, notify_slot);
-        type.resize(1);
+    if (!cfg) {
+        cfg = _load_slot_config(notify_slot);
+        xSemaphoreTake(_tw_slot_configs_mutex, portMAX_DELAY);
+        _tw_slot_configs[notify_slot] = cfg;
+        xSemaphoreGive(_tw_slot_configs_mutex);
+    }
+    return cfg;
+}
 
-        // Settings specific for http_client_config
+/**
+ * @brief ad2_config change callback for the [twilio] section.
+ * Reload the cached slots. Requests already queued keep the settings
+ * they were built with.
+ *
+ * @param [in]section config section.
+ * @param [in]key config key that changed.
+ */
+static void _config_change_handler(const char *section, const char *key)
+{
+    std::vector<int> slots;
+    xSemaphoreTake(_tw_slot_configs_mutex, portMAX_DELAY);
+    for (auto &x : _tw_slot_configs) {
+        slots.push_back(x.first);
+    }
+    xSemaphoreGive(_tw_slot_configs_mutex);
 
-        // Configure the URL based upon the request type.
-        switch(type[0]) {
+    for (auto slot : slots) {
+        tw_slot_config_ptr cfg = _load_slot_config(slot);
+        xSemaphoreTake(_tw_slot_configs_mutex, portMAX_DELAY);
+        _tw_slot_configs[slot] = cfg;
+        xSemaphoreGive(_tw_slot_configs_mutex);
+    }
+}
 
-        // Twilio Call api
-        //     https://www.twilio.com/docs/voice/api/sip-making-calls
-        case TWILIO_NOTIFY_CALL[0]:
-            // Build dynamic URL and set pointer to config_client->url;
-            r->url = ad2_string_printf(TWILIO_URL_FMT, sidString.c_str(), "Calls.json");
-            r->config_client->url = r->url.c_str();
-            // POST and parse resutls for url to query.
-            r->state = TWILIO_NEXT_STATE_GET;
-            break;
+/**
+ * @brief Build a request for a notification slot.
+ *
+ * @param [in]notify_slot uint8_t notification slot.
+ * @param [in]message std::string & message to send.
+ *
+ * @return tw_request_message * or nullptr if the slot type is unknown.
+ */
+static tw_request_message *_build_request(uint8_t notify_slot, const std::string &message)
+{
+    tw_slot_config_ptr cfg = _get_slot_config(notify_slot);
+    if (!cfg->url.length()) {
+        ESP_LOGW(TAG, "Unknown message type '%c' aborting adding to sendQ.", cfg->type);
+        return nullptr;
+    }
 
-        // Twilio Messages api
-        //     https://www.twilio.com/docs/sms/api/message-resource
-        case TWILIO_NOTIFY_MESSAGE[0]:
-            // Build dynamic URL and set pointer to config_client->url;
-            r->url = ad2_string_printf(TWILIO_URL_FMT, sidString.c_str(), "Messages.json");
-            r->config_client->url = r->url.c_str();
-            // Single POST request then done
-            r->state = TWILIO_NEXT_STATE_DONE;
-            break;
+    // Container to store details needed for delivery.
+    tw_request_message *r = new tw_request_message();
 
-        // SendGrid Email api.
-        //     https://docs.sendgrid.com/api-reference/mail-send/mail-send
-        case TWILIO_NOTIFY_EMAIL[0]:
-            // constant URL just set pointer to string.
-            r->config_client->url = SENDGRID_URL;
-            // Single POST request then done
-            r->state = TWILIO_NEXT_STATE_DONE;
-            break;
+    // save the Account storage ID and settings for the notification.
+    r->notify_slot = notify_slot;
+    r->cfg = cfg;
 
-        // Unknown.
-        default:
-            ESP_LOGW(TAG, "Unknown message type '%c' aborting adding to sendQ.", type[0]);
-            // destroy storage class if we fail to add to the sendQ
-            delete r;
-            return;
+    // save the message
+    r->message = message;
+
+    // Settings specific for http_client_config
+    r->url = cfg->url;
+    r->config_client->url = r->url.c_str();
+
+    // Twilio Calls POST and parse results for url to query.
+    // Messages and EMail are a single POST request then done.
+    if (cfg->type == TWILIO_NOTIFY_CALL[0]) {
+        r->state = TWILIO_NEXT_STATE_GET;
+    } else {
+        r->state = TWILIO_NEXT_STATE_DONE;
+    }
+
+    // set request type
+    r->config_client->method = HTTP_METHOD_POST;
+
+    // optional define an internal event handler
+    r->config_client->event_handler = _twilio_http_event_handler;
+
+    // required save internal class to user_data to be used in callback.
+    r->config_client->user_data = (void *)r; // Definition of grok.. see grok.
+
+    return r;
+}
+
+/**
+ * @brief ad2_http_sendQ spool callback. Rebuild a request saved before a restart.
+ *
+ * @param [in]record std::string & "<slot>[,<slot>...] <message>"
+ *
+ * @return esp_http_client_config_t * or nullptr if the slot can not be used.
+ */
+static esp_http_client_config_t *_sendQ_restore_handler(const std::string &record)
+{
+    size_t pos = record.find(' ');
+    if (pos == std::string::npos) {
+        return nullptr;
+    }
+
+    // skip any notification slots that were disabled.
+    std::vector<std::string> vslots;
+    std::vector<uint8_t> slots;
+    ad2_tokenize(record.substr(0, pos), ",", vslots);
+    for (auto &slotstring : vslots) {
+        int notify_slot = atoi(slotstring.c_str());
+        if (!_get_slot_config(notify_slot)->disabled) {
+            slots.push_back(notify_slot);
         }
+    }
+    if (!slots.size()) {
+        return nullptr;
+    }
 
-        // set request type
-        r->config_client->method = HTTP_METHOD_POST;
+    tw_request_message *r = _build_request(slots[0], record.substr(pos + 1));
+    if (!r) {
+        return nullptr;
+    }
+    r->group_slots.assign(slots.begin() + 1, slots.end());
+    for (auto slot : r->group_slots) {
+        r->group_cfgs.push_back(_get_slot_config(slot));
+    }
+    return r->config_client;
+}
 
-        // optional define an internal event handler
-        r->config_client->event_handler = _twilio_http_event_handler;
+/**
+ * @brief Build and queue a notification for a slot.
+ *
+ * @param [in]notify_slot int notification slot.
+ * @param [in]message std::string & message to send.
+ * @param [in]priority int ad2_priority_t.
+ * @param [in]group_slots more EMail slots to add to the same SendGrid request.
+ *
+ * @return bool true if queued.
+ */
+static bool _queue_notification(int notify_slot, const std::string &message, int priority,
+                                const std::vector<uint8_t> &group_slots = {})
+{
+    // Container to store details needed for delivery.
+    tw_request_message *r = _build_request(notify_slot, message);
+    if (!r) {
+        return false;
+    }
+    r->group_slots = group_slots;
+    for (auto slot : group_slots) {
+        r->group_cfgs.push_back(_get_slot_config(slot));
+    }
 
-        // required save internal class to user_data to be used in callback.
-        r->config_client->user_data = (void *)r; // Definition of grok.. see grok.
+    // Add client config to the http_sendQ for processing.
+    // Saved to the spool if enabled to be rebuilt after a restart.
+    std::string record = std::to_string(notify_slot);
+    for (auto slot : group_slots) {
+        record += "," + std::to_string(slot);
+    }
+    record += " " + message;
+    bool res = ad2_add_http_sendQ(r->config_client, _sendQ_ready_handler, _sendQ_done_handler, priority,
+                                  TWILIO_CONFIG_SECTION, record);
+    if (!res) {
+        ESP_LOGE(TAG,"Error adding HTTP request to ad2_add_http_sendQ.");
+        // destroy storage class if we fail to add to the sendQ
+        delete r;
+    }
+    return res;
+}
 
-        // Add client config to the http_sendQ for processing.
-        bool res = ad2_add_http_sendQ(r->config_client, _sendQ_ready_handler, _sendQ_done_handler);
-        if (res) {
-            ESP_LOGI(TAG,"Switch #%i match message '%s'. Sending '%s' to acid #%i", es->INT_ARG, msg->c_str(), es->out_message.c_str(), notify_slot);
-        } else {
-            ESP_LOGE(TAG,"Error adding HTTP request to ad2_add_http_sendQ.");
-            // destroy storage class if we fail to add to the sendQ
-            delete r;
+/**
+ * @brief ad2_digest callback. Send the messages merged for a slot.
+ *
+ * @param [in]notify_slot int notification slot.
+ * @param [in]message std::string & merged messages.
+ * @param [in]priority int highest ad2_priority_t of the merged messages.
+ */
+static void _digest_flush_handler(int notify_slot, const std::string &message, int priority)
+{
+    if (_queue_notification(notify_slot, message, priority)) {
+        ESP_LOGI(TAG,"Sending batch '%s' to acid #%i", message.c_str(), notify_slot);
+    }
+}
+
+/**
+ * @brief SmartSwitch match callback.
+ * Called when a shared virtual switch changes state.
+ *
+ * @param [in]msg std::string * message that changed the state.
+ * @param [in]es AD2EventSearch * switch.
+ * @param [in]out const std::string & output string for the new state.
+ * @param [in]arg std::list<uint8_t> * notification slots.
+ *
+ * @note No full queue handler
+ */
+void on_search_match_cb_tw(std::string *msg, AD2EventSearch *es, const std::string &out, void *arg)
+{
+#if defined(DEBUG_TWILIO)
+    ESP_LOGI(TAG, "ON_SEARCH_MATCH_CB: '%s' -> '%s' notify slot #%i", msg->c_str(), out.c_str(), es->INT_ARG);
+#endif
+    // Flap suppression summary. Last state and the number of changes folded in.
+    std::string message = out;
+    if (es->getSuppressed()) {
+        message += " (" + std::to_string(es->getSuppressed()) + " changes suppressed)";
+    }
+
+    // EMail slots that share a SendGrid key and sender get one request
+    // with a personalization for each address. Key is "<token> <from>".
+    std::map<std::string, std::vector<uint8_t>> email_groups;
+
+    // arg is the notification slots std::list for this notification.
+    std::list<uint8_t> *notify_list = (std::list<uint8_t>*)arg;
+    for (uint8_t const& notify_slot : *notify_list) {
+        tw_slot_config_ptr cfg = _get_slot_config(notify_slot);
+
+        // skip if this notification slot if disabled.
+        // cli example: twilio disable 1 true
+        if (cfg->disabled) {
+            continue;
+        }
+
+        // Merge with other messages for this slot if batching is enabled.
+        // cli example: twilio batch 1 2000
+        if (cfg->batch_ms > 0) {
+            ad2_digest_add(_digest_flush_handler, notify_slot, message, es->PRIORITY_ARG, cfg->batch_ms, cfg->max_size);
+            ESP_LOGI(TAG,"Switch #%i match message '%s'. Batching '%s' for acid #%i", es->INT_ARG, msg->c_str(), message.c_str(), notify_slot);
+            continue;
+        }
+
+        // Group EMail slots. Sent after all slots are checked.
+        if (cfg->type == TWILIO_NOTIFY_EMAIL[0]) {
+            email_groups[cfg->group_key].push_back(notify_slot);
+            continue;
+        }
+
+        // Twilio Messages and Calls take a single To per request.
+        if (_queue_notification(notify_slot, message, es->PRIORITY_ARG)) {
+            ESP_LOGI(TAG,"Switch #%i match message '%s'. Sending '%s' to acid #%i", es->INT_ARG, msg->c_str(), message.c_str(), notify_slot);
+        }
+    }
+
+    // One SendGrid request per key and sender.
+    for (auto &group : email_groups) {
+        std::vector<uint8_t> group_slots(group.second.begin() + 1, group.second.end());
+        if (_queue_notification(group.second[0], message, es->PRIORITY_ARG, group_slots)) {
+            ESP_LOGI(TAG,"Switch #%i match message '%s'. Sending '%s' to acid #%i and %i more", es->INT_ARG, msg->c_str(), message.c_str(), group.second[0], (int)group_slots.size());
         }
     }
 }
@@ -611,7 +811,8 @@ enum {
     TWILIO_TYPE_SUBCMD_ID,
     TWILIO_FORMAT_SUBCMD_ID,
     TWILIO_DISABLE_SUBCMD_ID,
-    TWILIO_SWITCH_SUBCMD_ID
+    TWILIO_SWITCH_SUBCMD_ID,
+    TWILIO_BATCH_SUBCMD_ID
 };
 char * TWILIO_SUBCMDS [] = {
     (char*)TWILIO_SID_SUBCMD,
@@ -622,13 +823,14 @@ char * TWILIO_SUBCMDS [] = {
     (char*)TWILIO_FORMAT_SUBCMD,
     (char*)TWILIO_DISABLE_SUBCMD,
     (char*)TWILIO_SWITCH_SUBCMD,
+    (char*)TWILIO_BATCH_SUBCMD,
     0 // EOF
 };
 
 /**
  * Component generic command event processing
  *
- * Usage: twilio (sid|token|from|to|type|format) <acid> [<arg>]
+ * Usage: twilio (sid|token|from|to|type|format|batch) <acid> [<arg>]
  */
 static void _cli_cmd_twilio_event_generic(std::string &subcmd, const char *string)
 {
@@ -776,6 +978,7 @@ static void _cli_cmd_twilio_command_router(const char *string)
             case TWILIO_TYPE_SUBCMD_ID:  // 'type' sub command
             case TWILIO_FORMAT_SUBCMD_ID:  // 'format' sub command
             case TWILIO_DISABLE_SUBCMD_ID:  // 'disable' sub command
+            case TWILIO_BATCH_SUBCMD_ID:  // 'batch' sub command
                 _cli_cmd_twilio_event_generic(subcmd, string);
                 break;
             case TWILIO_SWITCH_SUBCMD_ID:
@@ -796,7 +999,7 @@ static struct cli_command twilio_cmd_list[] = {
     {
         // ### Twilio notification component
         (char*)TWILIO_COMMAND,(char*)
-        "Usage: twilio (disable|sid|token|from|to|type|format) <acid> [<arg>]\r\n"
+        "Usage: twilio (disable|sid|token|from|to|type|format|batch) <acid> [<arg>]\r\n"
         "Usage: twilio switch <swid> [delete|-|notify|open|close|trouble] [<arg>]\r\n"
         "\r\n"
         "    Configuration tool for Twilio + SendGrid notifications\r\n"
@@ -808,6 +1011,7 @@ static struct cli_command twilio_cmd_list[] = {
         "    to acid [address]       Email or Phone #\r\n"
         "    type acid [M|C|E]       Notification type Mail, Call, EMail\r\n"
         "    format acid [format]    Output format string\r\n"
+        "    batch acid [ms]         Merge messages within ms into one. 0 disabled\r\n"
         "    switch swid SCMD [ARG]  Configure switches\r\n"
         "Sub-Commands: switch\r\n"
         "    delete | -              Clear switch notification settings\r\n"
@@ -842,6 +1046,9 @@ void twilio_register_cmds()
  */
 void twilio_init()
 {
+    // Slot settings cache. Reloaded when the [twilio] section changes.
+    _tw_slot_configs_mutex = xSemaphoreCreateMutex();
+    ad2_register_config_change(TWILIO_CONFIG_SECTION, _config_change_handler);
 
     // Register search based virtual switches if enabled.
     // [switch N]
@@ -879,32 +1086,7 @@ void twilio_init()
                   close_output_format.length() ||
                   trouble_output_format.length() )
            ) {
-            // key switch N
-            std::string key = std::string(AD2SWITCH_CONFIG_SECTION);
-            key += " ";
-            key += std::to_string(swID);
-
-            // Default switch state from global switch settings
-            int defaultState = AD2_STATE_UNKNOWN; // default default to unknown.
-            ad2_get_config_key_int(key.c_str(),
-                                   AD2SWITCH_SK_DEFAULT,
-                                   &defaultState);
-
-            // Auto reset time from global switch settings
-            int autoReset = 0;
-            ad2_get_config_key_int(key.c_str(),
-                                   AD2SWITCH_SK_RESET,
-                                   &autoReset);
-
-            // construct our search object.
-            AD2EventSearch *es1 = new AD2EventSearch((AD2_CMD_ZONE_state_t)defaultState, autoReset);
-
-            // store validated output formats.
-            es1->OPEN_OUTPUT_FORMAT = open_output_format;
-            es1->CLOSE_OUTPUT_FORMAT = close_output_format;
-            es1->TROUBLE_OUTPUT_FORMAT = trouble_output_format;
-
-            // save notify list to PTR_ARG.
+            // notification slots for this switch.
             std::list<uint8_t> *pslots = new std::list<uint8_t>;
             std::vector<std::string> vres;
             ad2_tokenize(notify_slots_string, ",", vres);
@@ -912,79 +1094,23 @@ void twilio_init()
                 uint8_t s = std::atoi(slotstring.c_str());
                 pslots->push_front((uint8_t)s & 0xff);
             }
-            es1->PTR_ARG = pslots;
-
-            // save the NVS Virtual SWITCH ID so we can read the data back later.
-            es1->INT_ARG = swID;
-
-            // switch filter settings
-            std::string filter;
-
-            // Get the optional switch types to listen for.
-            std::string types = "";
-            std::vector<std::string> notify_types_v;
-            ad2_get_config_key_string(key.c_str(), AD2SWITCH_SK_TYPES, types);
-            ad2_tokenize(types, ", ", notify_types_v);
-            for (auto &sztype : notify_types_v) {
-                ad2_trim(sztype);
-                auto x = AD2Parse.message_type_id.find(sztype);
-                if(x != std::end(AD2Parse.message_type_id)) {
-                    ad2_message_t mt = (ad2_message_t)AD2Parse.message_type_id.at(sztype);
-                    es1->PRE_FILTER_MESAGE_TYPE.push_back(mt);
-                }
-            }
-
-            // load [switch N] required regex match settings
-            std::string prefilter_regex;
-            ad2_get_config_key_string(key.c_str(), AD2SWITCH_SK_FILTER, prefilter_regex);
-            es1->PRE_FILTER_REGEX = prefilter_regex;
-
-            // Load all regex search patterns for open, close, and trouble sub keys.
-            std::string regex_sk_list = AD2SWITCH_SK_OPEN " "
-                                        AD2SWITCH_SK_CLOSE " "
-                                        AD2SWITCH_SK_TROUBLE;
 
-            std::stringstream ss(regex_sk_list);
-            std::string sk;
-            int sk_index = 0;
-            while (ss >> sk) {
-                for ( int a = 1; a < AD2_MAX_SWITCH_SEARCH_KEYS; a++) {
-                    std::string out = "";
-                    ad2_get_config_key_string(key.c_str(), sk.c_str(), out, a);
-
-                    if ( out.length()) {
-                        if (sk_index == 0) {
-                            es1->OPEN_REGEX_LIST.push_back(out);
-                        }
-                        if (sk_index == 1) {
-                            es1->CLOSE_REGEX_LIST.push_back(out);
-                        }
-                        if (sk_index == 2) {
-                            es1->TROUBLE_REGEX_LIST.push_back(out);
-                        }
-                    }
+            // subscribe to the shared [switch N] for state changes.
+            if (ad2_switch_subscribe(swID, on_search_match_cb_tw, pslots,
+                                     open_output_format,
+                                     close_output_format,
+                                     trouble_output_format)) {
+                // Load the settings for every slot used by the switch.
+                for (uint8_t const& notify_slot : *pslots) {
+                    _get_slot_config(notify_slot);
                 }
-                sk_index++;
-            }
-
-            // Must provide at least one states or it will be skipped.
-            if (es1->OPEN_REGEX_LIST.size() ||
-                    es1->CLOSE_REGEX_LIST.size() ||
-                    es1->TROUBLE_REGEX_LIST.size()) {
-                // Save the search to a list for management.
-                twilio_AD2EventSearches.push_back(es1);
-
-                // subscribe to the callback for events.
-                AD2Parse.subscribeTo(on_search_match_cb_tw, es1);
 
                 // keep track of how many for user feedback.
                 subscribers++;
 
             } else {
-                // incomplete switch so delete it and supporting pointers.
+                // incomplete switch so delete supporting pointers.
                 delete pslots;
-                delete es1;
-                ESP_LOGE(TAG, "Error in config section [switch %i]. Need at least one open, close, or trouble filter expressions.", swID);
             }
         } else {
             if (open_output_format.length() || close_output_format.length()
@@ -994,6 +1120,9 @@ void twilio_init()
         }
     }
 
+    // Send any notifications left in the sendQ spool.
+    ad2_register_http_sendQ_spool(TWILIO_CONFIG_SECTION, _sendQ_restore_handler, _sendQ_ready_handler, _sendQ_done_handler);
+
     ad2_printf_host(true, "%s: Init done. Found and configured %i virtual switches.", TAG, subscribers);
 
 }
@@ -0,0 +1,852 @@
+/**
+*  @file    webhook.cpp
+*  @author  Sean Mathews <coder@f34r.com>
+*  @date    10/18/2026
+*  @version 1.0.0
+*
+*  @brief Generic HTTP webhook notifications.
+*
+*  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+*
+*  Licensed under the Apache License, Version 2.0 (the "License");
+*  you may not use this file except in compliance with the License.
+*  You may obtain a copy of the License at
+*
+*      http://www.apache.org/licenses/LICENSE-2.0
+*
+*  Unless required by applicable law or agreed to in writing, software
+*  distributed under the License is distributed on an "AS IS" BASIS,
+*  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+*  See the License for the specific language governing permissions and
+*  limitations under the License.
+*
+*/
+// FreeRTOS includes
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+// Disable via sdkconfig
+#if CONFIG_AD2IOT_WEBHOOK_CLIENT
+static const char *TAG = "WEBHOOK";
+
+// AlarmDecoder std includes
+#include "alarmdecoder_main.h"
+
+// specific includes
+#include <memory>
+
+#include "webhook_template.h"
+
+//#define DEBUG_WEBHOOK
+
+#define WEBHOOK_COMMAND        "webhook"
+#define WEBHOOK_URL_SUBCMD     "url"
+#define WEBHOOK_METHOD_SUBCMD  "method"
+#define WEBHOOK_HEADERS_SUBCMD "headers"
+#define WEBHOOK_TYPE_SUBCMD    "type"
+#define WEBHOOK_BODY_SUBCMD    "body"
+#define WEBHOOK_SECRET_SUBCMD  "secret"
+#define WEBHOOK_BATCH_SUBCMD   "batch"
+#define WEBHOOK_SWITCH_SUBCMD  "switch"
+
+// Batched message size limit.
+#define WEBHOOK_MAX_MESSAGE 2048
+
+// Defaults for slots that only set a url.
+#define WEBHOOK_DEFAULT_METHOD "POST"
+#define WEBHOOK_DEFAULT_TYPE "application/json"
+#define WEBHOOK_DEFAULT_BODY "{\"switch\":${SWITCH},\"state\":\"${STATE}\",\"message\":\"${MESSAGE}\"}"
+
+// HMAC-SHA256 of the body with the slot secret.
+#define WEBHOOK_SIGNATURE_HEADER "X-AD2-Signature"
+
+// State name for merged batch messages.
+#define WEBHOOK_STATE_BATCH "BATCH"
+
+#define WEBHOOK_CONFIG_SECTION "webhook"
+
+#define WEBHOOK_CONFIG_SWITCH_SUFFIX_NOTIFY "notify"
+#define WEBHOOK_CONFIG_SWITCH_SUFFIX_OPEN "open"
+#define WEBHOOK_CONFIG_SWITCH_SUFFIX_CLOSE "close"
+#define WEBHOOK_CONFIG_SWITCH_SUFFIX_TROUBLE "trouble"
+
+
+// forward decl
+
+/**
+ * @brief Provider settings for a notification slot.
+ * Loaded from the config once and replaced, never modified, when the
+ * [webhook] section changes.
+ */
+struct wh_slot_config {
+    int batch_ms = 0;
+    esp_http_client_method_t method = HTTP_METHOD_POST;
+    bool has_body = true;
+    std::string content_type;
+    wh_encode_t body_encode = WH_ENCODE_JSON;
+    wh_template url;
+    wh_template body;
+    std::string secret;
+    std::vector<std::pair<std::string, std::string>> headers;
+};
+typedef std::shared_ptr<const wh_slot_config> wh_slot_config_ptr;
+
+// slot settings cache. Filled at init and on first use.
+static std::map<int, wh_slot_config_ptr> _wh_slot_configs;
+static SemaphoreHandle_t _wh_slot_configs_mutex = nullptr;
+
+/**
+ * @brief class that will be stored in the sendQ for each request.
+ */
+class request_message
+{
+public:
+    request_message()
+    {
+        config_client = (esp_http_client_config_t *)calloc(1, sizeof(esp_http_client_config_t));
+    }
+    ~request_message()
+    {
+        if (config_client) {
+            free(config_client);
+        }
+    }
+
+    // client_config used the the http_sendQ
+    esp_http_client_config_t* config_client;
+
+    // Application specific
+    wh_slot_config_ptr cfg;
+    std::string url;
+    std::string body;
+    std::string signature;
+    std::string results;
+};
+
+/**
+ * @brief ad2_http_sendQ callback before esp_http_client_perform() is called.
+ * Add headers content etc.
+ *
+ */
+static void _sendQ_ready_handler(esp_http_client_handle_t client, esp_http_client_config_t *config)
+{
+    // if perform failed this can be NULL
+    if (client) {
+        request_message *r = (request_message*) config->user_data;
+
+        // results from a failed attempt.
+        r->results = "";
+
+        for (auto &h : r->cfg->headers) {
+            ad2_http_set_header(client, h.first.c_str(), h.second.c_str());
+        }
+
+        if (r->cfg->has_body) {
+            ad2_http_set_header(client, "Content-Type", r->cfg->content_type.c_str());
+            if (r->signature.length()) {
+                ad2_http_set_header(client, WEBHOOK_SIGNATURE_HEADER, r->signature.c_str());
+            }
+            // does not copy data just a pointer so we have to maintain memory.
+            esp_http_client_set_post_field(client, r->body.c_str(), r->body.length());
+        }
+    }
+}
+
+/**
+ * @brief ad2_http_sendQ callback when esp_http_client_perform() is finished.
+ * Preform any final cleanup here.
+ *
+ *  @param [in]esp_err_t res - Results of esp_http_client_preform()
+ *  @param [in]evt esp_http_client_event_t
+ *  @param [in]config esp_http_client_config_t *
+ *
+ * @return bool TRUE: The connection done and allow sendQ worker to delete it.
+ *              FALSE: The connection expects a new URL and will call preform() again.
+ */
+static bool _sendQ_done_handler(esp_err_t res, esp_http_client_handle_t client, esp_http_client_config_t *config)
+{
+    request_message *r = (request_message*) config->user_data;
+#if defined(DEBUG_WEBHOOK)
+    ESP_LOGI(TAG, "perform results = %d HTTP Status = %d, response length = %d response = '%s'", res,
+             esp_http_client_get_status_code(client),
+             esp_http_client_get_content_length(client), r->results.c_str());
+#endif
+    // Pooled connections are shared with other slots on the same host.
+    // Remove our headers so they are not sent with the next request.
+    if (client) {
+        for (auto &h : r->cfg->headers) {
+            esp_http_client_delete_header(client, h.first.c_str());
+        }
+        esp_http_client_delete_header(client, WEBHOOK_SIGNATURE_HEADER);
+    }
+
+    // free message_data class will also delete the client_config in the distructor.
+    delete r;
+
+    // Report back this client request is all done and is ready to close.
+    return true;
+}
+
+/**
+ * @brief esp_http_client event callback.
+ *
+ * HTTP_EVENT_ON_DATA to capture server response message.
+ * Also use for diagnostics of response headers etc.
+ *
+ *  @param [in]evt esp_http_client_event_t *
+ */
+esp_err_t _webhook_http_event_handler(esp_http_client_event_t *evt)
+{
+    request_message *r;
+    size_t len;
+
+    switch(evt->event_id) {
+    case HTTP_EVENT_ON_HEADER:
+#if defined(DEBUG_WEBHOOK)
+        ESP_LOGI(TAG, "HTTP_EVENT_ON_HEADER, key=%s, value=%s", evt->header_key, evt->header_value);
+#endif
+        break;
+    case HTTP_EVENT_ERROR:
+#if defined(DEBUG_WEBHOOK)
+        ESP_LOGI(TAG, "HTTP_EVENT_ERROR");
+#endif
+        break;
+    case HTTP_EVENT_ON_CONNECTED:
+#if defined(DEBUG_WEBHOOK)
+        ESP_LOGI(TAG, "HTTP_EVENT_ON_CONNECTED");
+#endif
+        break;
+    case HTTP_EVENT_HEADERS_SENT:
+#if defined(DEBUG_WEBHOOK)
+        ESP_LOGI(TAG, "HTTP_EVENT_HEADERS_SENT");
+#endif
+        break;
+    case HTTP_EVENT_ON_FINISH:
+#if defined(DEBUG_WEBHOOK)
+        ESP_LOGI(TAG, "HTTP_EVENT_ON_FINISH");
+#endif
+        break;
+    case HTTP_EVENT_DISCONNECTED:
+#if defined(DEBUG_WEBHOOK)
+        ESP_LOGI(TAG, "HTTP_EVENT_DISCONNECTED");
+#endif
+        break;
+    case HTTP_EVENT_REDIRECT:
+#if defined(DEBUG_WEBHOOK)
+        ESP_LOGI(TAG, "HTTP_EVENT_REDIRECT");
+#endif
+        break;
+    case HTTP_EVENT_ON_DATA:
+        if (evt->data_len) {
+            // Save the results into our message_data structure.
+            r = (request_message *)evt->user_data;
+            // Limit size.
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
+            len = MIN(1024, evt->data_len);
+            r->results = std::string((char*)evt->data, len);
+        }
+        break;
+    }
+
+    return ESP_OK;
+}
+
+/**
+ * @brief Load the provider settings for a notification slot from config.
+ * Templates are compiled here once instead of on every notification.
+ *
+ * @param [in]notify_slot int notification slot.
+ *
+ * @return wh_slot_config_ptr new immutable settings.
+ */
+static wh_slot_config_ptr _load_slot_config(int notify_slot)
+{
+    wh_slot_config *cfg = new wh_slot_config();
+
+    ad2_get_config_key_int(WEBHOOK_CONFIG_SECTION, WEBHOOK_BATCH_SUBCMD, &cfg->batch_ms, notify_slot);
+
+    std::string url;
+    ad2_get_config_key_string(WEBHOOK_CONFIG_SECTION, WEBHOOK_URL_SUBCMD, url, notify_slot);
+    cfg->url = wh_compile_template(url);
+
+    std::string method = WEBHOOK_DEFAULT_METHOD;
+    ad2_get_config_key_string(WEBHOOK_CONFIG_SECTION, WEBHOOK_METHOD_SUBCMD, method, notify_slot);
+    ad2_ucase(method);
+    if (method == "GET") {
+        cfg->method = HTTP_METHOD_GET;
+        cfg->has_body = false;
+    } else if (method == "DELETE") {
+        cfg->method = HTTP_METHOD_DELETE;
+        cfg->has_body = false;
+    } else if (method == "PUT") {
+        cfg->method = HTTP_METHOD_PUT;
+    } else if (method == "PATCH") {
+        cfg->method = HTTP_METHOD_PATCH;
+    } else {
+        cfg->method = HTTP_METHOD_POST;
+    }
+
+    cfg->content_type = WEBHOOK_DEFAULT_TYPE;
+    ad2_get_config_key_string(WEBHOOK_CONFIG_SECTION, WEBHOOK_TYPE_SUBCMD, cfg->content_type, notify_slot);
+    if (cfg->content_type.find("json") != std::string::npos) {
+        cfg->body_encode = WH_ENCODE_JSON;
+    } else if (cfg->content_type.find("urlencoded") != std::string::npos) {
+        cfg->body_encode = WH_ENCODE_URL;
+    } else {
+        cfg->body_encode = WH_ENCODE_RAW;
+    }
+
+    std::string body = WEBHOOK_DEFAULT_BODY;
+    ad2_get_config_key_string(WEBHOOK_CONFIG_SECTION, WEBHOOK_BODY_SUBCMD, body, notify_slot);
+    cfg->body = wh_compile_template(body);
+
+    ad2_get_config_key_string(WEBHOOK_CONFIG_SECTION, WEBHOOK_SECRET_SUBCMD, cfg->secret, notify_slot);
+
+    // "Name: value|Name: value"
+    std::string headers;
+    std::vector<std::string> vres;
+    ad2_get_config_key_string(WEBHOOK_CONFIG_SECTION, WEBHOOK_HEADERS_SUBCMD, headers, notify_slot);
+    ad2_tokenize(headers, "|", vres);
+    for (auto &h : vres) {
+        size_t pos = h.find(':');
+        if (pos == std::string::npos) {
+            ESP_LOGW(TAG, "acid #%i ignoring header '%s' missing ':'", notify_slot, h.c_str());
+            continue;
+        }
+        std::string name = h.substr(0, pos);
+        std::string value = h.substr(pos + 1);
+        ad2_trim(name);
+        ad2_trim(value);
+        cfg->headers.push_back({name, value});
+    }
+
+    return wh_slot_config_ptr(cfg);
+}
+
+/**
+ * @brief Get the cached provider settings for a notification slot.
+ * Loaded from config on first use.
+ *
+ * @param [in]notify_slot int notification slot.
+ *
+ * @return wh_slot_config_ptr
+ */
+static wh_slot_config_ptr _get_slot_config(int notify_slot)
+{
+    wh_slot_config_ptr cfg;
+    xSemaphoreTake(_wh_slot_configs_mutex, portMAX_DELAY);
+    auto it = _wh_slot_configs.find(notify_slot);
+    if (it != _wh_slot_configs.end()) {
+        cfg = it->second;
+    }
+    xSemaphoreGive(_wh_slot_configs_mutex);
+
+    if (!cfg) {
+        cfg = _load_slot_config(notify_slot);
+        xSemaphoreTake(_wh_slot_configs_mutex, portMAX_DELAY);
+        _wh_slot_configs[notify_slot] = cfg;
+        xSemaphoreGive(_wh_slot_configs_mutex);
+    }
+    return cfg;
+}
+
+/**
+ * @brief ad2_config change callback for the [webhook] section.
+ * Reload the cached slots. Requests already queued keep the settings
+ * they were built with.
+ *
+ * @param [in]section config section.
+ * @param [in]key config key that changed.
+ */
+static void _config_change_handler(const char *section, const char *key)
+{
+    std::vector<int> slots;
+    xSemaphoreTake(_wh_slot_configs_mutex, portMAX_DELAY);
+    for (auto &x : _wh_slot_configs) {
+        slots.push_back(x.first);
+    }
+    xSemaphoreGive(_wh_slot_configs_mutex);
+
+    for (auto slot : slots) {
+        wh_slot_config_ptr cfg = _load_slot_config(slot);
+        xSemaphoreTake(_wh_slot_configs_mutex, portMAX_DELAY);
+        _wh_slot_configs[slot] = cfg;
+        xSemaphoreGive(_wh_slot_configs_mutex);
+    }
+}
+
+/**
+ * @brief Build a request for a notification slot.
+ * The url, body and signature are rendered here so the sendQ ready
+ * callback only attaches them.
+ *
+ * @param [in]notify_slot uint8_t notification slot.
+ * @param [in]swid int virtual switch ID. 0 for a batch.
+ * @param [in]state std::string & state name.
+ * @param [in]priority int ad2_priority_t.
+ * @param [in]message std::string & message to send.
+ *
+ * @return request_message * or nullptr if the slot has no url.
+ */
+static request_message *_build_request(uint8_t notify_slot, int swid, const std::string &state,
+                                       int priority, const std::string &message)
+{
+    // cached settings for this slot.
+    wh_slot_config_ptr cfg = _get_slot_config(notify_slot);
+    if (!cfg->url.size()) {
+        ESP_LOGW(TAG, "acid #%i has no url", notify_slot);
+        return nullptr;
+    }
+
+    // Container to store details needed for delivery.
+    request_message *r = new request_message();
+    r->cfg = cfg;
+    r->url = wh_render_template(cfg->url, WH_ENCODE_URL, swid, state, priority, message);
+    if (cfg->has_body) {
+        r->body = wh_render_template(cfg->body, cfg->body_encode, swid, state, priority, message);
+        if (cfg->secret.length()) {
+            r->signature = "sha256=" + ad2_hmac_sha256_hex(cfg->secret, r->body);
+        }
+    }
+
+    // Settings specific for http_client_config
+    r->config_client->url = r->url.c_str();
+    // set request type
+    r->config_client->method = cfg->method;
+
+    // optional define an internal event handler
+    r->config_client->event_handler = _webhook_http_event_handler;
+
+    // required save internal class to user_data to be used in callback.
+    r->config_client->user_data = (void *)r; // Definition of grok.. see grok.
+
+    return r;
+}
+
+/**
+ * @brief Build and queue a notification for a slot.
+ *
+ * @param [in]notify_slot int notification slot.
+ * @param [in]swid int virtual switch ID. 0 for a batch.
+ * @param [in]state std::string & state name.
+ * @param [in]message std::string & message to send.
+ * @param [in]priority int ad2_priority_t.
+ *
+ * @return bool true if queued.
+ */
+static bool _queue_notification(int notify_slot, int swid, const std::string &state,
+                                const std::string &message, int priority)
+{
+    // Container to store details needed for delivery.
+    request_message *r = _build_request(notify_slot, swid, state, priority, message);
+    if (!r) {
+        return false;
+    }
+
+    // Add client config to the http_sendQ for processing.
+    // Saved to the spool if enabled to be rebuilt after a restart.
+    std::string record = std::to_string(notify_slot) + " " + std::to_string(swid) + " " + state + " " + message;
+    bool res = ad2_add_http_sendQ(r->config_client, _sendQ_ready_handler, _sendQ_done_handler, priority,
+                                  WEBHOOK_CONFIG_SECTION, record);
+    if (!res) {
+        ESP_LOGE(TAG,"Error adding HTTP request to ad2_add_http_sendQ.");
+        // destroy storage class if we fail to add to the sendQ
+        delete r;
+    }
+    return res;
+}
+
+/**
+ * @brief ad2_http_sendQ spool callback. Rebuild a request saved before a restart.
+ *
+ * @param [in]record std::string & "<slot> <swid> <state> <message>"
+ *
+ * @return esp_http_client_config_t *
+ */
+static esp_http_client_config_t *_sendQ_restore_handler(const std::string &record)
+{
+    std::string slot, swid, state, message;
+    if (ad2_copy_nth_arg(slot, record.c_str(), 0) < 0 ||
+            ad2_copy_nth_arg(swid, record.c_str(), 1) < 0 ||
+            ad2_copy_nth_arg(state, record.c_str(), 2) < 0) {
+        return nullptr;
+    }
+    ad2_copy_nth_arg(message, record.c_str(), 3, true);
+    // priority is only used by the body template. The spool keeps the queue priority.
+    request_message *r = _build_request(atoi(slot.c_str()), atoi(swid.c_str()), state, AD2_PRIORITY_NORMAL, message);
+    return r ? r->config_client : nullptr;
+}
+
+/**
+ * @brief ad2_digest callback. Send the messages merged for a slot.
+ *
+ * @param [in]notify_slot int notification slot.
+ * @param [in]message std::string & merged messages.
+ * @param [in]priority int highest ad2_priority_t of the merged messages.
+ */
+static void _digest_flush_handler(int notify_slot, const std::string &message, int priority)
+{
+    if (_queue_notification(notify_slot, 0, WEBHOOK_STATE_BATCH, message, priority)) {
+        ESP_LOGI(TAG,"Sending batch '%s' to acid #%i", message.c_str(), notify_slot);
+    }
+}
+
+/**
+ * @brief SmartSwitch match callback.
+ * Called when a shared virtual switch changes state.
+ *
+ * @param [in]msg std::string * message that changed the state.
+ * @param [in]es AD2EventSearch * switch.
+ * @param [in]out const std::string & output string for the new state.
+ * @param [in]arg std::list<uint8_t> * notification slots.
+ *
+ * @note No full queue handler
+ */
+void on_search_match_cb_webhook(std::string *msg, AD2EventSearch *es, const std::string &out, void *arg)
+{
+    // Flap suppression summary. Last state and the number of changes folded in.
+    std::string message = out;
+    if (es->getSuppressed()) {
+        message += " (" + std::to_string(es->getSuppressed()) + " changes suppressed)";
+    }
+
+    std::string state;
+    auto st = AD2Parse.state_str.find(es->getState());
+    if (st != AD2Parse.state_str.end()) {
+        state = st->second;
+    } else {
+        state = "UNKNOWN";
+    }
+
+    // arg is the notification slots std::list for this notification.
+    std::list<uint8_t> *notify_list = (std::list<uint8_t>*)arg;
+    for (uint8_t const& notify_slot : *notify_list) {
+
+        // Merge with other messages for this slot if batching is enabled.
+        // cli example: webhook batch 1 2000
+        int batch_ms = _get_slot_config(notify_slot)->batch_ms;
+        if (batch_ms > 0) {
+            ad2_digest_add(_digest_flush_handler, notify_slot, message, es->PRIORITY_ARG, batch_ms, WEBHOOK_MAX_MESSAGE);
+            ESP_LOGI(TAG,"Switch #%i match message '%s'. Batching '%s' for acid #%i", es->INT_ARG, msg->c_str(), message.c_str(), notify_slot);
+            continue;
+        }
+
+        if (_queue_notification(notify_slot, es->INT_ARG, state, message, es->PRIORITY_ARG)) {
+            ESP_LOGI(TAG,"Switch #%i match message '%s'. Sending '%s' to acid #%i", es->INT_ARG, msg->c_str(), message.c_str(), notify_slot);
+        }
+    }
+}
+
+/**
+ * Command support values.
+ */
+enum {
+    WEBHOOK_URL_SUBCMD_ID = 0,
+    WEBHOOK_METHOD_SUBCMD_ID,
+    WEBHOOK_HEADERS_SUBCMD_ID,
+    WEBHOOK_TYPE_SUBCMD_ID,
+    WEBHOOK_BODY_SUBCMD_ID,
+    WEBHOOK_SECRET_SUBCMD_ID,
+    WEBHOOK_BATCH_SUBCMD_ID,
+    WEBHOOK_SWITCH_SUBCMD_ID
+};
+char * WEBHOOK_SUBCMD [] = {
+    (char*)WEBHOOK_URL_SUBCMD,
+    (char*)WEBHOOK_METHOD_SUBCMD,
+    (char*)WEBHOOK_HEADERS_SUBCMD,
+    (char*)WEBHOOK_TYPE_SUBCMD,
+    (char*)WEBHOOK_BODY_SUBCMD,
+    (char*)WEBHOOK_SECRET_SUBCMD,
+    (char*)WEBHOOK_BATCH_SUBCMD,
+    (char*)WEBHOOK_SWITCH_SUBCMD,
+    0 // EOF
+};
+
+/**
+ * Component generic command event processing
+ *
+ * Usage: webhook (url|method|headers|type|body|secret|batch) <acid> [<arg>]
+ */
+static void _cli_cmd_webhook_event_generic(std::string &subcmd, const char *string)
+{
+    int accountId = -1;
+    std::string buf;
+
+    // get the sub command value validation
+    ad2_copy_nth_arg(subcmd, string, 1);
+    ad2_lcase(subcmd);
+
+    // get the accountID 1-8
+    if (ad2_copy_nth_arg(buf, string, 2) >= 0) {
+        accountId = strtol(buf.c_str(), NULL, 10);
+    }
+    // Allowed accountId 1-8
+    if (accountId > 0 && accountId < 9) {
+        // <arg> to the end of the line. Headers and body templates have spaces.
+        if (ad2_copy_nth_arg(buf, string, 3, true) >= 0) {
+            ad2_set_config_key_string(WEBHOOK_CONFIG_SECTION, subcmd.c_str(), buf.c_str(), accountId);
+            ad2_printf_host(false, "Setting <acid> #%i '%s' value '%s' finished.\r\n", accountId, subcmd.c_str(), buf.c_str());
+        } else {
+            buf = "";
+            ad2_get_config_key_string(WEBHOOK_CONFIG_SECTION, subcmd.c_str(), buf, accountId);
+            ad2_printf_host(false, "Current <acid> #%i '%s' value '%s'\r\n", accountId, subcmd.c_str(), buf.length() ? buf.c_str() : "EMPTY");
+        }
+    } else {
+        ad2_printf_host(false, "Missing or invalid <acid> [1-8].\r\n");
+    }
+}
+
+/**
+ * Component SmartSwitch command event processing
+ *
+ *  Usage: webhook switch <swid> [delete|-|notify|open|close|trouble] [<arg>]
+ */
+static void _cli_cmd_webhook_smart_alert_switch(std::string &subcmd, const char *instring)
+{
+    int swID = 0;
+    std::string scmd;
+    std::string tbuf;
+    std::string arg;
+
+    // sub key "switch N AAAAA"
+    std::string key = std::string(AD2SWITCH_CONFIG_SECTION);
+
+    // get the sub command value validation
+    if (ad2_copy_nth_arg(tbuf, instring, 2) >= 0) {
+        swID = std::atoi (tbuf.c_str());
+    }
+    // Switch ID to the key.
+    if (swID > 0 && swID <= AD2_MAX_SWITCHES) {
+
+        // sub command
+        if (ad2_copy_nth_arg(scmd, instring, 3) >= 0) {
+
+            // load remaining arg data
+            ad2_copy_nth_arg(arg, instring, 4, true);
+
+            // sub key test.
+            if (scmd.compare(AD2SWITCH_SK_DELETE1) == 0 || scmd.compare(AD2SWITCH_SK_DELETE2) == 0) {
+                ad2_set_config_key_string(WEBHOOK_CONFIG_SECTION, key.c_str(), NULL, swID, WEBHOOK_CONFIG_SWITCH_SUFFIX_NOTIFY, true);
+                ad2_set_config_key_string(WEBHOOK_CONFIG_SECTION, key.c_str(), NULL, swID, WEBHOOK_CONFIG_SWITCH_SUFFIX_OPEN, true);
+                ad2_set_config_key_string(WEBHOOK_CONFIG_SECTION, key.c_str(), NULL, swID, WEBHOOK_CONFIG_SWITCH_SUFFIX_CLOSE, true);
+                ad2_set_config_key_string(WEBHOOK_CONFIG_SECTION, key.c_str(), NULL, swID, WEBHOOK_CONFIG_SWITCH_SUFFIX_TROUBLE, true);
+                ad2_printf_host(false, "Removing switch #%i settings from webhook config.\r\n", swID);
+            } else if (scmd.compare(WEBHOOK_CONFIG_SWITCH_SUFFIX_NOTIFY) == 0) {
+                ad2_set_config_key_string(WEBHOOK_CONFIG_SECTION, key.c_str(), arg.c_str(), swID, scmd.c_str());
+                ad2_printf_host(false, "Setting switch #%i %s string to '%s'.\r\n", swID, scmd.c_str(), arg.c_str());
+            } else if (scmd.compare(WEBHOOK_CONFIG_SWITCH_SUFFIX_OPEN) == 0 ||
+                       scmd.compare(WEBHOOK_CONFIG_SWITCH_SUFFIX_CLOSE) == 0 ||
+                       scmd.compare(WEBHOOK_CONFIG_SWITCH_SUFFIX_TROUBLE) == 0) {
+                ad2_set_config_key_string(WEBHOOK_CONFIG_SECTION, key.c_str(), arg.c_str(), swID, scmd.c_str());
+                ad2_printf_host(false, "Setting switch #%i output string for state '%s' to '%s'.\r\n", swID, scmd.c_str(), arg.c_str());
+            } else {
+                ESP_LOGW(TAG, "Unknown sub command setting '%s' ignored.", scmd.c_str());
+                return;
+            }
+        } else {
+            // check all settings verbs against provided verb and proform setting logic
+            std::stringstream ss(
+                WEBHOOK_CONFIG_SWITCH_SUFFIX_NOTIFY " "
+                WEBHOOK_CONFIG_SWITCH_SUFFIX_OPEN " "
+                WEBHOOK_CONFIG_SWITCH_SUFFIX_CLOSE " "
+                WEBHOOK_CONFIG_SWITCH_SUFFIX_TROUBLE);
+
+            std::string sk;
+            ad2_printf_host(false, "## [webhook] switch %i configuration.\r\n", swID);
+            while (ss >> sk) {
+                tbuf = "";
+                ad2_get_config_key_string(WEBHOOK_CONFIG_SECTION, key.c_str(), tbuf, swID, sk.c_str());
+                if (tbuf.length()) {
+                    ad2_printf_host(false, "%s = %s\r\n", sk.c_str(), tbuf.c_str());
+                } else {
+                    ad2_printf_host(false, "# %s = \r\n", sk.c_str());
+                }
+            }
+            // dump finished, all done.
+            return;
+        }
+    } else {
+        ad2_printf_host(false, "Missing or invalid switch <id> 1-255\r\n");
+    }
+}
+
+/**
+ * Component command router
+ */
+static void _cli_cmd_webhook_command_router(const char *string)
+{
+    int i;
+    std::string subcmd;
+
+    // get the sub command value validation
+    ad2_copy_nth_arg(subcmd, string, 1);
+    ad2_lcase(subcmd);
+
+    for(i = 0;; ++i) {
+        if (WEBHOOK_SUBCMD[i] == 0) {
+            ad2_printf_host(false, "What?\r\n");
+            break;
+        }
+        if(subcmd.compare(WEBHOOK_SUBCMD[i]) == 0) {
+            switch(i) {
+            case WEBHOOK_URL_SUBCMD_ID:     // 'url' sub command
+            case WEBHOOK_METHOD_SUBCMD_ID:  // 'method' sub command
+            case WEBHOOK_HEADERS_SUBCMD_ID: // 'headers' sub command
+            case WEBHOOK_TYPE_SUBCMD_ID:    // 'type' sub command
+            case WEBHOOK_BODY_SUBCMD_ID:    // 'body' sub command
+            case WEBHOOK_SECRET_SUBCMD_ID:  // 'secret' sub command
+            case WEBHOOK_BATCH_SUBCMD_ID:   // 'batch' sub command
+                _cli_cmd_webhook_event_generic(subcmd, string);
+                break;
+            case WEBHOOK_SWITCH_SUBCMD_ID:
+                _cli_cmd_webhook_smart_alert_switch(subcmd, string);
+                break;
+            }
+            // all done
+            break;
+        }
+    }
+}
+
+/**
+ * @brief command list for component
+ *
+ */
+static struct cli_command webhook_cmd_list[] = {
+    {
+        // ### Webhook notification component
+        (char*)WEBHOOK_COMMAND,(char*)
+        "Usage: webhook (url|method|headers|type|body|secret|batch) <acid> [<arg>]\r\n"
+        "Usage: webhook switch <swid> [delete|-|notify|open|close|trouble] [<arg>]\r\n"
+        "\r\n"
+        "    Configuration tool for HTTP webhook notification\r\n"
+        "Commands:\r\n"
+        "    url acid [url]          Request URL. Template macros are urlencoded\r\n"
+        "    method acid [method]    POST, PUT, PATCH, GET or DELETE. Default POST\r\n"
+        "    headers acid [list]     Extra headers 'Name: value|Name: value'\r\n"
+        "    type acid [type]        Body Content-Type. Default application/json\r\n"
+        "    body acid [template]    Body template. Default\r\n"
+        "                            {\"switch\":${SWITCH},\"state\":\"${STATE}\",\"message\":\"${MESSAGE}\"}\r\n"
+        "    secret acid [key]       Sign the body with HMAC-SHA256 in header\r\n"
+        "                            X-AD2-Signature: sha256=<hex>\r\n"
+        "    batch acid [ms]         Merge messages within ms into one. 0 disabled\r\n"
+        "    switch swid SCMD [ARG]  Configure virtual switches\r\n"
+        "Sub-Commands:\r\n"
+        "    delete | -              Clear switch notification settings\r\n"
+        "    notify <acid>,...       List of accounts [1-8] to use for notification\r\n"
+        "    open <message>          Send <message> for OPEN events\r\n"
+        "    close <message>         Send <message> for CLOSE events\r\n"
+        "    trouble <message>       Send <message> for TROUBLE events\r\n"
+        "Options:\r\n"
+        "    acid                    Account storage location 1-8\r\n"
+        "    swid                    ad2iot virtual switch ID 1-255.\r\n"
+        "                            See ```switch``` command\r\n"
+        "    message                 Message to send for this notification\r\n"
+        "Template macros:\r\n"
+        "    ${MESSAGE}              Switch output message or merged batch\r\n"
+        "    ${SWITCH}               Switch ID. 0 for a batch\r\n"
+        "    ${STATE}                OPEN, CLOSED, TROUBLE or BATCH\r\n"
+        "    ${PRIORITY}             Switch priority 0-3\r\n"
+        , _cli_cmd_webhook_command_router
+    },
+};
+
+/**
+ * Register cli commands
+ */
+void webhook_register_cmds()
+{
+    // Register webhook CLI commands
+    for (int i = 0; i < ARRAY_SIZE(webhook_cmd_list); i++) {
+        cli_register_command(&webhook_cmd_list[i]);
+    }
+}
+
+/**
+ * Initialize component
+ */
+void webhook_init()
+{
+    // Slot settings cache. Reloaded when the [webhook] section changes.
+    _wh_slot_configs_mutex = xSemaphoreCreateMutex();
+    ad2_register_config_change(WEBHOOK_CONFIG_SECTION, _config_change_handler);
+
+    // Register search based virtual switches if enabled.
+    // [switch N]
+    int subscribers = 0;
+    for (int swID = 1; swID < AD2_MAX_SWITCHES; swID++) {
+        // load switch settings for 'swID' and test if found
+        std::string open_output_format;
+        ad2_get_config_key_string(WEBHOOK_CONFIG_SECTION,
+                                  AD2SWITCH_CONFIG_SECTION,
+                                  open_output_format,
+                                  swID,
+                                  WEBHOOK_CONFIG_SWITCH_SUFFIX_OPEN);
+        std::string close_output_format;
+        ad2_get_config_key_string(WEBHOOK_CONFIG_SECTION,
+                                  AD2SWITCH_CONFIG_SECTION,
+                                  close_output_format,
+                                  swID,
+                                  WEBHOOK_CONFIG_SWITCH_SUFFIX_CLOSE);
+        std::string trouble_output_format;
+        ad2_get_config_key_string(WEBHOOK_CONFIG_SECTION,
+                                  AD2SWITCH_CONFIG_SECTION,
+                                  trouble_output_format,
+                                  swID,
+                                  WEBHOOK_CONFIG_SWITCH_SUFFIX_TROUBLE);
+        std::string notify_slots_string;
+        ad2_get_config_key_string(WEBHOOK_CONFIG_SECTION,
+                                  AD2SWITCH_CONFIG_SECTION,
+                                  notify_slots_string,
+                                  swID,
+                                  WEBHOOK_CONFIG_SWITCH_SUFFIX_NOTIFY);
+
+        // Only process entries with notify list and at least one output string.
+        if ( notify_slots_string.length() &&
+                ( open_output_format.length() ||
+                  close_output_format.length() ||
+                  trouble_output_format.length() )
+           ) {
+            // notification slots for this switch.
+            std::list<uint8_t> *pslots = new std::list<uint8_t>;
+            std::vector<std::string> vres;
+            ad2_tokenize(notify_slots_string, ",", vres);
+            for (auto &slotstring : vres) {
+                uint8_t s = std::atoi(slotstring.c_str());
+                pslots->push_front((uint8_t)s & 0xff);
+            }
+
+            // subscribe to the shared [switch N] for state changes.
+            if (ad2_switch_subscribe(swID, on_search_match_cb_webhook, pslots,
+                                     open_output_format,
+                                     close_output_format,
+                                     trouble_output_format)) {
+                // Load the settings for every slot used by the switch.
+                for (uint8_t const& notify_slot : *pslots) {
+                    _get_slot_config(notify_slot);
+                }
+
+                // keep track of how many for user feedback.
+                subscribers++;
+
+            } else {
+                // incomplete switch so delete supporting pointers.
+                delete pslots;
+            }
+        } else {
+            if (open_output_format.length() || close_output_format.length()
+                    || trouble_output_format.length()) {
+                ESP_LOGE(TAG, "Section config error. Need at least one open, close, or trouble output strings for switch %i.", swID);
+            }
+        }
+    }
+
+    // Send any notifications left in the sendQ spool.
+    ad2_register_http_sendQ_spool(WEBHOOK_CONFIG_SECTION, _sendQ_restore_handler, _sendQ_ready_handler, _sendQ_done_handler);
+
+    ad2_printf_host(true, "%s: Init done. Found and configured %i virtual switches.", TAG, subscribers);
+
+}
+
+#endif /*  CONFIG_AD2IOT_WEBHOOK_CLIENT */
+
@@ -0,0 +1,31 @@
+/**
+ *  @file    webhook.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Generic HTTP webhook notifications.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef _WEBHOOK_H
+#define _WEBHOOK_H
+#if CONFIG_AD2IOT_WEBHOOK_CLIENT
+
+void webhook_register_cmds();
+void webhook_init();
+
+#endif /* CONFIG_AD2IOT_WEBHOOK_CLIENT */
+#endif /* _WEBHOOK_H */
@@ -0,0 +1,161 @@
+/**
+ *  @file    webhook_template.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Webhook body and url templates. No ESP-IDF dependencies
+ *  so they also build on the host.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include <stdio.h>
+#include <map>
+
+#include "ad2_encode.h"
+#include "webhook_template.h"
+
+/**
+ * @brief Escape a string for use inside a JSON string value.
+ *
+ * @param [in]str const std::string &
+ *
+ * @return std::string
+ */
+std::string wh_json_escape(const std::string &str)
+{
+    std::string out;
+    out.reserve(str.length());
+    for (unsigned char c : str) {
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (c < 0x20) {
+                char hex[8];
+                snprintf(hex, sizeof(hex), "\\u%04x", c);
+                out += hex;
+            } else {
+                out += c;
+            }
+        }
+    }
+    return out;
+}
+
+/**
+ * @brief Compile a template string into literal and macro segments.
+ * Unknown macros are kept as literal text.
+ *
+ * @param [in]src const std::string & template ex. "{\"msg\":\"${MESSAGE}\"}"
+ *
+ * @return wh_template
+ */
+wh_template wh_compile_template(const std::string &src)
+{
+    static const std::map<std::string, wh_field_t> macros = {
+        {"MESSAGE",  WH_FIELD_MESSAGE},
+        {"SWITCH",   WH_FIELD_SWITCH},
+        {"STATE",    WH_FIELD_STATE},
+        {"PRIORITY", WH_FIELD_PRIORITY},
+    };
+
+    wh_template t;
+    std::string text;
+    size_t pos = 0;
+    while (pos < src.length()) {
+        size_t start = src.find("${", pos);
+        size_t end = start == std::string::npos ? start : src.find('}', start);
+        if (end == std::string::npos) {
+            text += src.substr(pos);
+            break;
+        }
+        text += src.substr(pos, start - pos);
+        auto m = macros.find(src.substr(start + 2, end - start - 2));
+        if (m == macros.end()) {
+            text += src.substr(start, end - start + 1);
+        } else {
+            if (text.length()) {
+                t.push_back({WH_FIELD_TEXT, text});
+                text = "";
+            }
+            t.push_back({m->second, ""});
+        }
+        pos = end + 1;
+    }
+    if (text.length()) {
+        t.push_back({WH_FIELD_TEXT, text});
+    }
+    return t;
+}
+
+/**
+ * @brief Render a compiled template.
+ *
+ * @param [in]t const wh_template &
+ * @param [in]encode wh_encode_t encoding for macro values.
+ * @param [in]swid int virtual switch ID.
+ * @param [in]state const std::string & state name.
+ * @param [in]priority int ad2_priority_t.
+ * @param [in]message const std::string & message.
+ *
+ * @return std::string
+ */
+std::string wh_render_template(const wh_template &t, wh_encode_t encode, int swid,
+                               const std::string &state, int priority, const std::string &message)
+{
+    std::string out;
+    for (auto &seg : t) {
+        std::string value;
+        switch (seg.field) {
+        case WH_FIELD_TEXT:
+            out += seg.text;
+            continue;
+        case WH_FIELD_MESSAGE:
+            value = message;
+            break;
+        case WH_FIELD_SWITCH:
+            value = std::to_string(swid);
+            break;
+        case WH_FIELD_STATE:
+            value = state;
+            break;
+        case WH_FIELD_PRIORITY:
+            value = std::to_string(priority);
+            break;
+        }
+        if (encode == WH_ENCODE_JSON) {
+            out += wh_json_escape(value);
+        } else if (encode == WH_ENCODE_URL) {
+            out += ad2_urlencode(value);
+        } else {
+            out += value;
+        }
+    }
+    return out;
+}
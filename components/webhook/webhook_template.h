@@ -0,0 +1,64 @@
+/**
+ *  @file    webhook_template.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Webhook body and url templates. No ESP-IDF dependencies
+ *  so they also build on the host.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef _WEBHOOK_TEMPLATE_H
+#define _WEBHOOK_TEMPLATE_H
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Template macro fields.
+ */
+typedef enum {
+    WH_FIELD_TEXT = 0,  // literal text.
+    WH_FIELD_MESSAGE,   // ${MESSAGE} switch output message.
+    WH_FIELD_SWITCH,    // ${SWITCH} virtual switch ID. 0 for a batch.
+    WH_FIELD_STATE,     // ${STATE} OPEN, CLOSED, TROUBLE or BATCH.
+    WH_FIELD_PRIORITY   // ${PRIORITY} ad2_priority_t.
+} wh_field_t;
+
+/**
+ * @brief Value encoding for template macros.
+ */
+typedef enum {
+    WH_ENCODE_RAW = 0,
+    WH_ENCODE_JSON,
+    WH_ENCODE_URL
+} wh_encode_t;
+
+/**
+ * @brief One piece of a compiled template.
+ */
+struct wh_segment {
+    wh_field_t field;
+    std::string text;
+};
+typedef std::vector<wh_segment> wh_template;
+
+std::string wh_json_escape(const std::string &str);
+wh_template wh_compile_template(const std::string &src);
+std::string wh_render_template(const wh_template &t, wh_encode_t encode, int swid,
+                               const std::string &state, int priority, const std::string &message);
+
+#endif /* _WEBHOOK_TEMPLATE_H */
@@ -0,0 +1,322 @@
+/**
+ *  @file    ad2bench.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Linux host benchmark for the AD2* RX -> parse -> sink pipeline.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <algorithm>
+
+#include "alarmdecoder_api.h"
+#include "ad2_transport.h"
+
+// Same read sizes as the firmware ad2source task.
+#define BENCH_RX_BUFF_SIZE 512
+#define BENCH_POLL_RX_BUFF_SIZE 100
+
+static AlarmDecoderParser AD2Parse;
+static volatile bool g_stop = false;
+
+// sink counters.
+static uint64_t raw_messages = 0;
+static uint64_t alpha_messages = 0;
+static uint64_t zone_events = 0;
+static uint64_t search_matches = 0;
+
+// feeder send time for each message in ns. 0 until sent.
+static std::vector<std::atomic<int64_t>> *feed_times = nullptr;
+static std::vector<int64_t> latencies;
+
+/**
+ * @brief monotonic time in ns.
+ */
+static int64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief ON_RAW_MESSAGE sink. Track RX to callback latency when feeding.
+ */
+static void on_raw_message(std::string *msg, AD2PartitionState *s, void *arg)
+{
+    if (feed_times && raw_messages < feed_times->size()) {
+        int64_t sent = (*feed_times)[raw_messages].load();
+        if (sent) {
+            latencies.push_back(now_ns() - sent);
+        }
+    }
+    raw_messages++;
+}
+
+/**
+ * @brief Write each line of a capture to the pty slave at a fixed rate.
+ *
+ * @param [in]path slave device path.
+ * @param [in]lines capture lines with EOL.
+ * @param [in]rate lines per second.
+ */
+static void feeder(std::string path, std::vector<std::string> *lines, int rate)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_NOCTTY);
+    if (fd < 0) {
+        fprintf(stderr, "feeder unable to open '%s'\n", path.c_str());
+        return;
+    }
+    auto next = std::chrono::steady_clock::now();
+    auto period = std::chrono::microseconds(1000000 / rate);
+    for (size_t i = 0; i < lines->size() && !g_stop; i++) {
+        std::this_thread::sleep_until(next);
+        next += period;
+        (*feed_times)[i].store(now_ns());
+        if (write(fd, (*lines)[i].c_str(), (*lines)[i].length()) < 0) {
+            break;
+        }
+    }
+    close(fd);
+}
+
+/**
+ * @brief ON_ALPHA_MESSAGE sink.
+ */
+static void on_alpha_message(std::string *msg, AD2PartitionState *s, void *arg)
+{
+    alpha_messages++;
+}
+
+/**
+ * @brief ON_ZONE_CHANGE sink.
+ */
+static void on_zone_change(std::string *msg, AD2PartitionState *s, void *arg)
+{
+    zone_events++;
+}
+
+/**
+ * @brief ON_SEARCH_MATCH sink.
+ */
+static void on_search_match(std::string *msg, AD2PartitionState *s, void *arg)
+{
+    search_matches++;
+}
+
+/**
+ * @brief SIGINT handler.
+ */
+static void on_signal(int sig)
+{
+    g_stop = true;
+}
+
+/**
+ * @brief Print usage and exit.
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-d seconds] [-p] [-f file [-r rate]] [-w capture] <mode> [<arg>...]\n"
+            "    Read an AD2* stream from a transport, parse it and count events.\n"
+            "\n"
+            "Modes:\n"
+            "    S <HOST:PORT>           TCP client ex. ser2sock or ad2loadgen\n"
+            "    F <PATH> [loop]         Replay a raw capture file\n"
+            "    R <PATH> [speed|max] [loop]\n"
+            "                            Replay a timestamped capture. Default speed 1\n"
+            "    P [LINKPATH]            Create a pty UART stand-in and read from it\n"
+            "Options:\n"
+            "    -d seconds              Run time. Default 10\n"
+            "    -p                      Legacy polling reader. 100 byte reads 5ms timeout 10ms sleep\n"
+            "    -f file                 P mode only. Feed file lines into the pty and report\n"
+            "                            RX to ON_RAW_MESSAGE callback latency\n"
+            "    -r rate                 Feed rate in lines per second. Default 100\n"
+            "    -w capture              Record the stream to a timestamped capture file\n"
+            "    -s searches             Number of virtual switch searches. Default 1\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    int duration = 10;
+    bool poll_mode = false;
+    std::string feed_file;
+    int feed_rate = 100;
+    std::string capture_file;
+    int searches = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:pf:r:w:s:")) != -1) {
+        switch (opt) {
+        case 'd':
+            duration = atoi(optarg);
+            break;
+        case 'p':
+            poll_mode = true;
+            break;
+        case 'f':
+            feed_file = optarg;
+            break;
+        case 'r':
+            feed_rate = std::max(1, atoi(optarg));
+            break;
+        case 'w':
+            capture_file = optarg;
+            break;
+        case 's':
+            searches = std::max(0, atoi(optarg));
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+    }
+
+    char mode = argv[optind][0];
+    std::string args;
+    for (int i = optind + 1; i < argc; i++) {
+        if (args.length()) {
+            args += " ";
+        }
+        args += argv[i];
+    }
+
+    AD2Transport *t = ad2_transport_create(mode, args);
+    if (!t || !t->open()) {
+        fprintf(stderr, "unable to open transport\n");
+        return 1;
+    }
+
+    AD2Capture capture;
+    if (capture_file.length()) {
+        if (!capture.start(capture_file)) {
+            return 1;
+        }
+        t->setCapture(&capture);
+    }
+
+    // Sinks like the firmware components use.
+    AD2Parse.subscribeTo(ON_RAW_MESSAGE, on_raw_message, nullptr);
+    AD2Parse.subscribeTo(ON_ALPHA_MESSAGE, on_alpha_message, nullptr);
+    AD2Parse.subscribeTo(ON_ZONE_CHANGE, on_zone_change, nullptr);
+    for (int n = 0; n < searches; n++) {
+        AD2EventSearch *es = new AD2EventSearch(AD2_STATE_CLOSED, 0);
+        es->PRE_FILTER_MESAGE_TYPE.push_back(ALPHA_MESSAGE_TYPE);
+        es->OPEN_REGEX_LIST.push_back("FAULT");
+        es->CLOSE_REGEX_LIST.push_back("Ready to Arm");
+        AD2Parse.subscribeTo(on_search_match, es);
+    }
+
+    signal(SIGINT, on_signal);
+
+    // Optional pty feeder for latency measurements.
+    std::vector<std::string> lines;
+    std::thread feed_thread;
+    if (feed_file.length()) {
+        AD2TransportPTY *pty = dynamic_cast<AD2TransportPTY *>(t);
+        std::ifstream in(feed_file);
+        std::string line;
+        while (pty && std::getline(in, line)) {
+            lines.push_back(line + "\n");
+        }
+        if (!lines.size()) {
+            fprintf(stderr, "-f requires P mode and a non empty file\n");
+            return 1;
+        }
+        feed_times = new std::vector<std::atomic<int64_t>>(lines.size());
+        latencies.reserve(lines.size());
+        feed_thread = std::thread(feeder, pty->slavePath(), &lines, feed_rate);
+    }
+
+    uint8_t rx_buffer[BENCH_RX_BUFF_SIZE];
+    uint64_t busy_us = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto end = start + std::chrono::seconds(duration);
+    while (!g_stop && std::chrono::steady_clock::now() < end) {
+        int len;
+        if (poll_mode) {
+            // Firmware reader before event driven receive.
+            len = t->read(rx_buffer, BENCH_POLL_RX_BUFF_SIZE - 1, 5);
+        } else {
+            len = t->read(rx_buffer, sizeof(rx_buffer), 100);
+        }
+        if (len < 0) {
+            break;
+        }
+        if (len > 0) {
+            auto p0 = std::chrono::steady_clock::now();
+            AD2Parse.put(rx_buffer, len);
+            busy_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - p0).count();
+        }
+        if (poll_mode) {
+            usleep(10 * 1000);
+        }
+        if (feed_times && raw_messages >= lines.size()) {
+            break;
+        }
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    g_stop = true;
+    if (feed_thread.joinable()) {
+        feed_thread.join();
+    }
+
+    ad2_transport_stats_t st = t->getStats();
+    printf("transport      %s\n", t->name());
+    printf("elapsed        %.3f s\n", secs);
+    printf("rx bytes       %llu (%u reads %u timeouts %u errors)\n",
+           (unsigned long long)st.rx_bytes, st.rx_reads, st.rx_timeouts, st.rx_errors);
+    printf("messages       %llu raw %llu alpha %llu zone %llu search\n",
+           (unsigned long long)raw_messages, (unsigned long long)alpha_messages,
+           (unsigned long long)zone_events, (unsigned long long)search_matches);
+    printf("parse time     %.3f s (%.2f us/message)\n", busy_us / 1e6,
+           raw_messages ? (double)busy_us / raw_messages : 0.0);
+    printf("throughput     %.0f messages/s %.0f bytes/s\n",
+           raw_messages / secs, st.rx_bytes / secs);
+    if (latencies.size()) {
+        std::sort(latencies.begin(), latencies.end());
+        auto pct = [](double p) {
+            return latencies[std::min(latencies.size() - 1, (size_t)(p * latencies.size()))] / 1000.0;
+        };
+        printf("rx->callback   p50 %.0f us p90 %.0f us p99 %.0f us max %.0f us (%zu samples)\n",
+               pct(0.50), pct(0.90), pct(0.99), latencies.back() / 1000.0, latencies.size());
+    }
+
+    if (capture.isActive()) {
+        ad2_capture_stats_t cs = capture.getStats();
+        printf("capture        %u records %llu bytes -> %llu file bytes\n", cs.records,
+               (unsigned long long)cs.bytes, (unsigned long long)cs.file_bytes);
+        capture.stop();
+    }
+
+    t->close();
+    delete t;
+    return 0;
+}
@@ -0,0 +1,153 @@
+/**
+ *  @file    ad2cmdqtest.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Linux host test for the MQTT command queue. Queue overflow and
+ *  order and the per action token bucket burst and refill.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include <stdio.h>
+#include <string>
+
+#include "ad2mqtt_cmdq.h"
+
+static int g_checks = 0;
+static int g_failed = 0;
+
+/**
+ * @brief Compare a result with the expected value and report a mismatch.
+ */
+static void check(const char *name, int got, int want)
+{
+    g_checks++;
+    if (got != want) {
+        g_failed++;
+        printf("FAIL %s got %d want %d\n", name, got, want);
+    }
+}
+
+/**
+ * @brief Count the tokens an action gets at the given time.
+ */
+static int taken(AD2MQTTCommandQueue &q, size_t action, uint64_t now_us, int count)
+{
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        n += q.take(action, now_us) ? 1 : 0;
+    }
+    return n;
+}
+
+static void test_overflow()
+{
+    AD2MQTTCommandQueue q;
+    q.setSize(4);
+
+    // 6 commands into a queue of 4. The last 2 are dropped.
+    int queued = 0;
+    for (int i = 0; i < 6; i++) {
+        std::string cmd = "{\"action\":\"test\",\"n\":" + std::to_string(i) + "}";
+        queued += q.push(cmd.c_str(), cmd.length(), 1000 + i) ? 1 : 0;
+    }
+    mqtt_cmdq_stats_t s = q.getStats();
+    check("overflow queued", queued, 4);
+    check("overflow received", s.received, 4);
+    check("overflow dropped", s.dropped, 2);
+    check("overflow depth", s.depth, 4);
+    check("overflow max depth", s.max_depth, 4);
+
+    // oldest first with its receive time.
+    mqtt_command_t cmd;
+    for (int i = 0; i < 4; i++) {
+        std::string want = "{\"action\":\"test\",\"n\":" + std::to_string(i) + "}";
+        check("pop", q.pop(cmd), true);
+        check("pop order", cmd.payload == want, true);
+        check("pop received", (int)cmd.received_us, 1000 + i);
+    }
+    check("pop empty", q.pop(cmd), false);
+    s = q.getStats();
+    check("pop depth", s.depth, 0);
+    check("pop max depth", s.max_depth, 4);
+
+    // room again once drained.
+    check("push after drain", q.push("{}", 2, 2000), true);
+    check("dropped after drain", q.getStats().dropped, 2);
+}
+
+static void test_burst()
+{
+    const uint64_t t0 = 5000000;
+    AD2MQTTCommandQueue q;
+    q.setActions(2);
+    q.setRate(0, 1, 3, t0);
+
+    // the bucket starts full. 3 go through at once.
+    check("burst", taken(q, 0, t0, 5), 3);
+    check("burst limited", q.getStats().rate_limited, 2);
+
+    // action 1 has no rate and out of range actions are not limited.
+    check("burst unlimited", taken(q, 1, t0, 100), 100);
+    check("burst out of range", taken(q, 7, t0, 10), 10);
+    check("burst other limited", q.getStats().rate_limited, 2);
+}
+
+static void test_refill()
+{
+    const uint64_t t0 = 5000000;
+    AD2MQTTCommandQueue q;
+    q.setActions(1);
+    q.setRate(0, 2, 2, t0);
+    check("refill empty", taken(q, 0, t0, 2), 2);
+
+    // 2 per second. One token every 500ms.
+    check("refill early", taken(q, 0, t0 + 250000, 1), 0);
+    check("refill one", taken(q, 0, t0 + 500000, 2), 1);
+    check("refill next", taken(q, 0, t0 + 1000000, 2), 1);
+
+    // a long idle time refills only up to burst.
+    check("refill capped", taken(q, 0, t0 + 60000000, 5), 2);
+    check("refill limited", q.getStats().rate_limited, 6);
+
+    // rate 0 turns the limit off.
+    q.setRate(0, 0, 1, t0 + 60000000);
+    check("refill off", taken(q, 0, t0 + 60000000, 10), 10);
+}
+
+static void test_counters()
+{
+    AD2MQTTCommandQueue q;
+    q.executed(1500);
+    q.executed(250000);
+    q.executed(40000);
+    q.invalid();
+    mqtt_cmdq_stats_t s = q.getStats();
+    check("executed", s.executed, 3);
+    check("latency max", s.latency_max_ms, 250);
+    check("invalid", s.invalid, 1);
+}
+
+int main(int argc, char *argv[])
+{
+    test_overflow();
+    test_burst();
+    test_refill();
+    test_counters();
+
+    printf("%d checks, %d failed\n", g_checks, g_failed);
+    return g_failed ? 1 : 0;
+}
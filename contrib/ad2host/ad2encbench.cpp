@@ -0,0 +1,431 @@
+/**
+ *  @file    ad2encbench.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Linux host size and encode time comparison of the ad2mqtt
+ *  JSON and CBOR payloads on a replayed AD2* capture. Also the MQTT
+ *  3.1.1 and MQTT 5 PUBLISH packet sizes of the JSON payloads.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <set>
+
+#include "alarmdecoder_api.h"
+#include "ad2mqtt_cbor.h"
+
+static AlarmDecoderParser AD2Parse;
+
+// encodes per event for timing.
+static int g_reps = 1000;
+
+typedef struct enc_stats {
+    const char *name;
+    uint64_t events;
+    uint64_t json_bytes;
+    uint64_t cbor_bytes;
+    double json_ns;
+    double cbor_ns;
+} enc_stats_t;
+
+static enc_stats_t g_stats[] = {
+    {"partitions"}, {"zones"}, {"cid"}
+};
+
+// Default topic. ad2iot/<UUID>/
+static const std::string g_base = "ad2iot/41443249-4f54-4e55-5445-434853455256/";
+
+// Bytes on the wire per topic for each protocol mode. PUBACK included for QoS 1.
+typedef struct pkt_stats {
+    uint64_t v311_qos1;     ///< MQTT 3.1.1 QoS 1. Firmware default.
+    uint64_t v311_qos0;     ///< MQTT 3.1.1 QoS 0.
+    uint64_t v5_qos1;       ///< MQTT 5 QoS 1 with message expiry.
+    uint64_t v5_alias;      ///< MQTT 5 QoS 0 with topic alias.
+    uint64_t v5_alias_event;///< MQTT 5 QoS 0 with topic alias and event user property.
+} pkt_stats_t;
+
+static pkt_stats_t g_pkts[3] = {};
+static std::set<std::string> g_aliased;
+
+/**
+ * @brief Bytes in a Variable Byte Integer. MQTT 5.0 1.5.5
+ */
+static size_t varint_len(size_t v)
+{
+    size_t n = 1;
+    while (v >= 128) {
+        v >>= 7;
+        n++;
+    }
+    return n;
+}
+
+/**
+ * @brief Bytes in a PUBLISH packet. MQTT 3.1.1 3.3 and MQTT 5.0 3.3
+ *
+ * @param [in]topic size_t topic name length. 0 if sent as an alias.
+ * @param [in]payload size_t
+ * @param [in]qos int
+ * @param [in]v5 bool MQTT 5 property length field.
+ * @param [in]props size_t MQTT 5 property bytes.
+ */
+static size_t publish_len(size_t topic, size_t payload, int qos, bool v5, size_t props)
+{
+    size_t rl = 2 + topic + (qos ? 2 : 0) + payload;
+    if (v5) {
+        rl += varint_len(props) + props;
+    }
+    return 1 + varint_len(rl) + rl;
+}
+
+/**
+ * @brief Add one publish of a JSON payload to the packet totals.
+ */
+static void record_packets(pkt_stats_t &st, const std::string &topic, size_t payload, const std::string &event)
+{
+    // PUBACK. Fixed header and packet id. MQTT 5 omits a success reason.
+    const size_t puback = 4;
+    // Property id and value.
+    const size_t expiry = 1 + 4;
+    const size_t alias = 1 + 2;
+    const size_t user = 1 + 2 + strlen("event") + 2 + event.length();
+    // The first publish on a topic carries the topic and the alias.
+    size_t alias_topic = g_aliased.insert(topic).second ? topic.length() : 0;
+
+    st.v311_qos1 += publish_len(topic.length(), payload, 1, false, 0) + puback;
+    st.v311_qos0 += publish_len(topic.length(), payload, 0, false, 0);
+    st.v5_qos1 += publish_len(topic.length(), payload, 1, true, expiry) + puback;
+    st.v5_alias += publish_len(alias_topic, payload, 0, true, alias);
+    st.v5_alias_event += publish_len(alias_topic, payload, 0, true, alias + user);
+}
+
+/**
+ * @brief JSON writer with the same output as cJSON_Print() and
+ * cJSON_Minify() for the ad2mqtt payloads. Streaming so the times
+ * below do not include building a cJSON tree like the firmware does.
+ */
+class JSONWriter
+{
+public:
+    explicit JSONWriter(std::string &out) : _out(out) {}
+    void open()
+    {
+        _out += '{';
+        _first = true;
+    }
+    void close()
+    {
+        _out += '}';
+    }
+    void key(const char *k)
+    {
+        if (!_first) {
+            _out += ',';
+        }
+        _first = false;
+        str(k, strlen(k));
+        _out += ':';
+    }
+    void boolean(const char *k, bool b)
+    {
+        key(k);
+        _out += b ? "true" : "false";
+    }
+    void number(const char *k, long v)
+    {
+        key(k);
+        _out += std::to_string(v);
+    }
+    void string(const char *k, const std::string &v)
+    {
+        key(k);
+        str(v.data(), v.length());
+    }
+
+protected:
+    void str(const char *s, size_t len)
+    {
+        _out += '"';
+        for (size_t i = 0; i < len; i++) {
+            unsigned char c = s[i];
+            switch (c) {
+            case '"':
+                _out += "\\\"";
+                break;
+            case '\\':
+                _out += "\\\\";
+                break;
+            case '\n':
+                _out += "\\n";
+                break;
+            case '\r':
+                _out += "\\r";
+                break;
+            case '\t':
+                _out += "\\t";
+                break;
+            default:
+                if (c < 0x20) {
+                    char esc[8];
+                    snprintf(esc, sizeof(esc), "\\u%04x", c);
+                    _out += esc;
+                } else {
+                    _out += (char)c;
+                }
+            }
+        }
+        _out += '"';
+    }
+    std::string &_out;
+    bool _first = true;
+};
+
+/**
+ * @brief Same fields as ad2_get_partition_state_json() plus event.
+ */
+static void json_partition_state(std::string &out, AD2PartitionState *s, const std::string &event)
+{
+    JSONWriter w(out);
+    w.open();
+    if (s && !s->unknown_state) {
+        w.boolean("ready", s->ready);
+        w.boolean("armed_away", s->armed_away);
+        w.boolean("armed_stay", s->armed_stay);
+        w.boolean("backlight_on", s->backlight_on);
+        w.boolean("programming", s->programming);
+        w.boolean("zone_bypassed", s->zone_bypassed);
+        w.boolean("ac_power", s->ac_power);
+        w.boolean("chime_on", s->chime_on);
+        w.boolean("alarm_event_occurred", s->alarm_event_occurred);
+        w.boolean("alarm_sounding", s->alarm_sounding);
+        w.boolean("battery_low", s->battery_low);
+        w.boolean("entry_delay_off", s->entry_delay_off);
+        w.boolean("fire_alarm", s->fire_alarm);
+        w.boolean("system_issue", s->system_issue);
+        w.boolean("perimeter_only", s->perimeter_only);
+        w.boolean("exit_now", s->exit_now);
+        w.number("system_specific", s->system_specific);
+        w.number("beeps", s->beeps);
+        w.string("panel_type", std::string(1, s->panel_type));
+        w.string("last_alpha_message", s->last_alpha_message);
+        w.string("last_numeric_messages", s->last_numeric_message);
+        w.number("mask", s->address_mask_filter);
+    } else {
+        w.string("last_alpha_message", "Unknown");
+    }
+    w.string("event", event);
+    w.close();
+}
+
+/**
+ * @brief Same fields as mqtt_on_zone_change().
+ */
+static void json_zone_state(std::string &out, const std::string &state, int partition,
+                            uint32_t mask, bool system, const std::string &name)
+{
+    JSONWriter w(out);
+    w.open();
+    w.string("state", state);
+    w.number("partition", partition);
+    w.number("mask", mask);
+    w.boolean("system", system);
+    w.string("name", name);
+    w.close();
+}
+
+/**
+ * @brief Same fields as mqtt_on_lrr().
+ */
+static void json_lrr_event(std::string &out, const std::string &message)
+{
+    JSONWriter w(out);
+    w.open();
+    w.string("event_message", message);
+    w.close();
+}
+
+/**
+ * @brief Time g_reps encodes and record the size of one.
+ */
+template <typename F>
+static double time_encode(F encode, uint64_t &bytes)
+{
+    std::string out;
+    out.reserve(1024);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < g_reps; i++) {
+        out.clear();
+        encode(out);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    bytes += out.length();
+    return ns / g_reps;
+}
+
+static void on_state_change(std::string *msg, AD2PartitionState *s, void *arg)
+{
+    enc_stats_t &st = g_stats[0];
+    const std::string &event = AD2Parse.event_str[(int)(intptr_t)arg];
+    st.events++;
+    st.json_ns += time_encode([&](std::string & o) {
+        json_partition_state(o, s, event);
+    }, st.json_bytes);
+    st.cbor_ns += time_encode([&](std::string & o) {
+        ad2_cbor_partition_state(o, s, event);
+    }, st.cbor_bytes);
+    std::string json;
+    json_partition_state(json, s, event);
+    record_packets(g_pkts[0], g_base + "partitions/" + std::to_string(s->partition), json.length(), event);
+}
+
+static void on_zone_change(std::string *msg, AD2PartitionState *s, void *arg)
+{
+    enc_stats_t &st = g_stats[1];
+    // grab the verb(FOO) 'ZONE FOO 001'
+    std::string verb = s->last_event_message;
+    size_t sp = verb.find(' ');
+    verb = sp == std::string::npos ? "" : verb.substr(sp + 1, verb.find(' ', sp + 1) - sp - 1);
+    std::string zalpha;
+    AD2Parse.getZoneString((int)s->zone, zalpha);
+    bool system = s->zone_states[s->zone].is_system();
+    st.events++;
+    st.json_ns += time_encode([&](std::string & o) {
+        json_zone_state(o, verb, s->partition, s->address_mask_filter, system, zalpha);
+    }, st.json_bytes);
+    st.cbor_ns += time_encode([&](std::string & o) {
+        ad2_cbor_zone_state(o, verb, s->partition, s->address_mask_filter, system, zalpha);
+    }, st.cbor_bytes);
+    std::string json;
+    json_zone_state(json, verb, s->partition, s->address_mask_filter, system, zalpha);
+    record_packets(g_pkts[1], g_base + "zones/" + std::to_string(s->zone), json.length(), verb);
+}
+
+static void on_lrr(std::string *msg, AD2PartitionState *s, void *arg)
+{
+    enc_stats_t &st = g_stats[2];
+    st.events++;
+    st.json_ns += time_encode([&](std::string & o) {
+        json_lrr_event(o, *msg);
+    }, st.json_bytes);
+    st.cbor_ns += time_encode([&](std::string & o) {
+        ad2_cbor_lrr_event(o, *msg);
+    }, st.cbor_bytes);
+    std::string json;
+    json_lrr_event(json, *msg);
+    record_packets(g_pkts[2], g_base + "cid", json.length(), "");
+}
+
+/**
+ * @brief Print usage and exit.
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-n reps] [-l loops] <capture>\n"
+            "    Replay an AD2* capture and compare the size and encode time of the\n"
+            "    ad2mqtt JSON and CBOR payloads for every partition, zone and cid event\n"
+            "    and the MQTT 3.1.1 and MQTT 5 PUBLISH packet sizes of the JSON payloads.\n"
+            "Options:\n"
+            "    -n reps                 Encodes per event for timing. Default 1000\n"
+            "    -l loops                Times to replay the capture. Default 1\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    int loops = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:l:")) != -1) {
+        switch (opt) {
+        case 'n':
+            g_reps = std::max(1, atoi(optarg));
+            break;
+        case 'l':
+            loops = std::max(1, atoi(optarg));
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+    }
+
+    // Same events as the ad2mqtt partition state topic.
+    static const ad2_event_t state_events[] = {
+        ON_ARM, ON_DISARM, ON_CHIME_CHANGE, ON_BEEPS_CHANGE, ON_FIRE_CHANGE,
+        ON_POWER_CHANGE, ON_READY_CHANGE, ON_LOW_BATTERY, ON_ALARM_CHANGE,
+        ON_ZONE_BYPASSED_CHANGE, ON_EXIT_CHANGE
+    };
+    for (auto ev : state_events) {
+        AD2Parse.subscribeTo(ev, on_state_change, (void *)(intptr_t)ev);
+    }
+    AD2Parse.subscribeTo(ON_ZONE_CHANGE, on_zone_change, nullptr);
+    AD2Parse.subscribeTo(ON_LRR, on_lrr, nullptr);
+
+    for (int l = 0; l < loops; l++) {
+        std::ifstream in(argv[optind]);
+        if (!in) {
+            fprintf(stderr, "unable to open '%s'\n", argv[optind]);
+            return 1;
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            line += "\n";
+            AD2Parse.put((uint8_t *)line.data(), line.length());
+        }
+    }
+
+    printf("%-12s %8s %12s %12s %7s %10s %10s\n",
+           "topic", "events", "json bytes", "cbor bytes", "ratio", "json ns", "cbor ns");
+    for (auto &st : g_stats) {
+        if (!st.events) {
+            printf("%-12s %8s\n", st.name, "0");
+            continue;
+        }
+        printf("%-12s %8llu %12llu %12llu %6.1f%% %10.0f %10.0f\n", st.name,
+               (unsigned long long)st.events,
+               (unsigned long long)st.json_bytes, (unsigned long long)st.cbor_bytes,
+               100.0 * st.cbor_bytes / st.json_bytes,
+               st.json_ns / st.events, st.cbor_ns / st.events);
+    }
+
+    // Packet sizes from the MQTT packet layout for the default topics.
+    printf("\nPUBLISH bytes per event. QoS 1 includes the PUBACK.\n");
+    printf("%-12s %10s %10s %10s %10s %12s\n",
+           "topic", "3.1.1 q1", "3.1.1 q0", "5 q1 exp", "5 q0 alias", "5 alias+evt");
+    for (size_t n = 0; n < sizeof(g_pkts) / sizeof(g_pkts[0]); n++) {
+        pkt_stats_t &pk = g_pkts[n];
+        uint64_t events = g_stats[n].events;
+        if (!events) {
+            printf("%-12s %10s\n", g_stats[n].name, "0");
+            continue;
+        }
+        printf("%-12s %10.1f %10.1f %10.1f %10.1f %12.1f\n", g_stats[n].name,
+               (double)pk.v311_qos1 / events, (double)pk.v311_qos0 / events,
+               (double)pk.v5_qos1 / events, (double)pk.v5_alias / events,
+               (double)pk.v5_alias_event / events);
+    }
+    return 0;
+}
@@ -0,0 +1,170 @@
+/**
+ *  @file    ad2flaptest.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Linux host test for virtual switch flap suppression. Hold time
+ *  and rate limit on AD2EventSearch and through the parser.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <chrono>
+
+#include "alarmdecoder_api.h"
+
+static int g_checks = 0;
+static int g_failed = 0;
+
+/**
+ * @brief Compare a result with the expected value and report a mismatch.
+ */
+static void check(const char *name, int got, int want)
+{
+    g_checks++;
+    if (got != want) {
+        g_failed++;
+        printf("FAIL %s got %d want %d\n", name, got, want);
+    }
+}
+
+/**
+ * @brief Count the changes a search lets through at the given times.
+ */
+static int allowed(AD2EventSearch &es, uint64_t start_ms, int count, int step_ms)
+{
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        n += es.allowNotify(start_ms + i * step_ms) ? 1 : 0;
+    }
+    return n;
+}
+
+static void test_disabled()
+{
+    AD2EventSearch es(AD2_STATE_CLOSED, 0);
+    check("disabled allowed", allowed(es, 100000, 50, 1), 50);
+    check("disabled summary", es.endSuppression(100100), false);
+}
+
+static void test_hold_time()
+{
+    const uint64_t t0 = 100000;
+    AD2EventSearch es(AD2_STATE_CLOSED, 0);
+    es.setHoldTime(300);
+
+    // 20 changes 10ms apart. Only the first is sent.
+    check("hold first", es.allowNotify(t0), true);
+    check("hold flapping", allowed(es, t0 + 10, 19, 10), 0);
+    check("hold suppressed", es.getSuppressed(), 19);
+
+    // summary once the hold time has passed.
+    check("hold early", es.endSuppression(t0 + 299), false);
+    check("hold summary", es.endSuppression(t0 + 300), true);
+    check("hold summary count", es.getSuppressed(), 19);
+    check("hold summary once", es.endSuppression(t0 + 301), false);
+
+    // the summary starts a new hold time.
+    check("hold after summary", es.allowNotify(t0 + 310), false);
+    check("hold next summary", es.endSuppression(t0 + 600), true);
+    check("hold next count", es.getSuppressed(), 1);
+    check("hold quiet", es.allowNotify(t0 + 1000), true);
+    check("hold quiet count", es.getSuppressed(), 0);
+}
+
+static void test_max_rate()
+{
+    const uint64_t t0 = 100000;
+    AD2EventSearch es(AD2_STATE_CLOSED, 0);
+    es.setMaxRate(3);
+
+    // one change a second for a minute. 3 go out.
+    check("rate minute", allowed(es, t0, 60, 1000), 3);
+    check("rate suppressed", es.getSuppressed(), 57);
+    check("rate early", es.endSuppression(t0 + 59999), false);
+    check("rate summary", es.endSuppression(t0 + 60000), true);
+    check("rate summary count", es.getSuppressed(), 57);
+    // the summary is the first of the new minute.
+    check("rate new minute", allowed(es, t0 + 60001, 3, 1), 2);
+}
+
+static int g_notified = 0;
+static int g_summary_suppressed = -1;
+static AD2_CMD_ZONE_state_t g_summary_state = AD2_STATE_OPEN;
+
+static void on_search_match(std::string *msg, AD2PartitionState *s, void *arg)
+{
+    AD2EventSearch *es = (AD2EventSearch *)arg;
+    g_notified++;
+    // the summary has no partition state.
+    if (!s) {
+        g_summary_suppressed = es->getSuppressed();
+        g_summary_state = (AD2_CMD_ZONE_state_t)es->getState();
+    }
+}
+
+static void put_line(AlarmDecoderParser &parser, const std::string &line)
+{
+    std::string l = line + "\r\n";
+    parser.put((uint8_t *)l.c_str(), l.length());
+}
+
+/**
+ * @brief A FAULT/Ready to Arm flap through the parser with a 300ms hold
+ * time gives one notification and then one summary.
+ */
+static void test_parser()
+{
+    const std::string fault = "[00000011000000000A--],002,[f70600ef1002000018020000000000],\"FAULT 02                        \"";
+    const std::string ready = "[10000011000000003A--],008,[f70600ef1008001c18020000000000],\"DISARMED BYPASS   Ready to Arm  \"";
+
+    AlarmDecoderParser parser;
+    AD2EventSearch *es = new AD2EventSearch(AD2_STATE_CLOSED, 0);
+    es->PRE_FILTER_MESAGE_TYPE.push_back(ALPHA_MESSAGE_TYPE);
+    es->OPEN_REGEX_LIST.push_back("FAULT");
+    es->CLOSE_REGEX_LIST.push_back("Ready to Arm");
+    es->setHoldTime(300);
+    parser.subscribeTo(on_search_match, es);
+
+    // 10 cycles in about 200ms.
+    for (int n = 0; n < 10; n++) {
+        put_line(parser, fault);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        put_line(parser, ready);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    check("parser flapping", g_notified, 1);
+
+    // the next message after the hold time sends the summary.
+    std::this_thread::sleep_for(std::chrono::milliseconds(350));
+    put_line(parser, ready);
+    check("parser summary", g_notified, 2);
+    check("parser summary count", g_summary_suppressed, 19);
+    check("parser summary state", g_summary_state, AD2_STATE_CLOSED);
+}
+
+int main(int argc, char *argv[])
+{
+    test_disabled();
+    test_hold_time();
+    test_max_rate();
+    test_parser();
+
+    printf("%d checks, %d failed\n", g_checks, g_failed);
+    return g_failed ? 1 : 0;
+}
@@ -0,0 +1,557 @@
+/**
+ *  @file    ad2host_idf.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Linux host stand-ins for the FreeRTOS, esp_http_client and
+ *  ad2 utility calls used by main/ad2_sendq.cpp.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <random>
+#include <map>
+#include <vector>
+#include <atomic>
+
+#include "ad2host_idf.h"
+
+int g_StopMainTask = 0;
+int g_init_done = 0;
+
+static std::atomic<bool> _network_connected(true);
+static std::mutex _config_mutex;
+static std::map<std::string, std::string> _config;
+
+/**
+ * @brief Semaphore. A mutex is a binary semaphore that starts given.
+ */
+typedef struct host_sem {
+    std::mutex m;
+    std::condition_variable cv;
+    unsigned count;
+    unsigned max;
+} host_sem_t;
+
+/**
+ * @brief Task notification value.
+ */
+typedef struct host_task {
+    std::mutex m;
+    std::condition_variable cv;
+    uint32_t notify = 0;
+} host_task_t;
+
+static thread_local host_task_t *_task_self = nullptr;
+
+/**
+ * @brief Wait on a condition for ticks. portMAX_DELAY waits forever.
+ *
+ * @return bool result of the predicate.
+ */
+template<typename P>
+static bool _wait_ticks(std::condition_variable &cv, std::unique_lock<std::mutex> &lock, TickType_t ticks, P pred)
+{
+    if (ticks == portMAX_DELAY) {
+        cv.wait(lock, pred);
+        return true;
+    }
+    return cv.wait_for(lock, std::chrono::milliseconds(ticks * portTICK_PERIOD_MS), pred);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    host_sem_t *s = new host_sem_t;
+    s->count = 1;
+    s->max = 1;
+    return s;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    host_sem_t *s = new host_sem_t;
+    s->count = initial;
+    s->max = max;
+    return s;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    host_sem_t *s = (host_sem_t *)sem;
+    std::unique_lock<std::mutex> lock(s->m);
+    if (!_wait_ticks(s->cv, lock, ticks, [s] { return s->count > 0; })) {
+        return pdFALSE;
+    }
+    s->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    host_sem_t *s = (host_sem_t *)sem;
+    std::lock_guard<std::mutex> lock(s->m);
+    if (s->count >= s->max) {
+        return pdFALSE;
+    }
+    s->count++;
+    s->cv.notify_one();
+    return pdTRUE;
+}
+
+static host_task_t *_task_current()
+{
+    if (!_task_self) {
+        _task_self = new host_task_t;
+    }
+    return _task_self;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                       UBaseType_t prio, TaskHandle_t *handle)
+{
+    host_task_t *task = new host_task_t;
+    if (handle) {
+        *handle = task;
+    }
+    std::thread([fn, arg, task]() {
+        _task_self = task;
+        fn(arg);
+    }).detach();
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    // The thread ends when the task function returns.
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks * portTICK_PERIOD_MS));
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    host_task_t *t = _task_current();
+    std::unique_lock<std::mutex> lock(t->m);
+    _wait_ticks(t->cv, lock, ticks, [t] { return t->notify > 0; });
+    uint32_t value = t->notify;
+    if (value) {
+        t->notify = clear ? 0 : value - 1;
+    }
+    return value;
+}
+
+void xTaskNotifyGive(TaskHandle_t task)
+{
+    host_task_t *t = (host_task_t *)task;
+    std::lock_guard<std::mutex> lock(t->m);
+    t->notify++;
+    t->cv.notify_one();
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    return 0;
+}
+
+uint32_t esp_random()
+{
+    static std::mutex m;
+    static std::mt19937 rng(std::random_device{}());
+    std::lock_guard<std::mutex> lock(m);
+    return rng();
+}
+
+void esp_chip_info(esp_chip_info_t *info)
+{
+    info->revision = 3;
+}
+
+/**
+ * @brief HTTP/1.1 client over a keep-alive TCP socket.
+ */
+struct esp_http_client {
+    esp_http_client_config_t config;
+    std::string host;
+    std::string port;
+    std::string path;
+    esp_http_client_method_t method;
+    std::string post;
+    std::vector<std::pair<std::string, std::string>> headers;
+    int timeout_ms;
+    int fd = -1;
+    int status = 0;
+};
+
+static const char *_method_names[] = {"GET", "POST", "PUT", "PATCH", "DELETE"};
+
+/**
+ * @brief Split http://host[:port][/path] into the client.
+ *
+ * @return bool false if not an http url.
+ */
+static bool _http_parse_url(esp_http_client_handle_t c, const char *url)
+{
+    std::string u = url ? url : "";
+    if (u.compare(0, 7, "http://") != 0) {
+        return false;
+    }
+    size_t start = 7;
+    size_t slash = u.find('/', start);
+    std::string hostport = u.substr(start, slash == std::string::npos ? std::string::npos : slash - start);
+    c->path = slash == std::string::npos ? "/" : u.substr(slash);
+    size_t colon = hostport.rfind(':');
+    if (colon != std::string::npos) {
+        c->host = hostport.substr(0, colon);
+        c->port = hostport.substr(colon + 1);
+    } else {
+        c->host = hostport;
+        c->port = "80";
+    }
+    return c->host.length() != 0;
+}
+
+static void _http_close(esp_http_client_handle_t c)
+{
+    if (c->fd >= 0) {
+        close(c->fd);
+        c->fd = -1;
+    }
+}
+
+static bool _http_connect(esp_http_client_handle_t c)
+{
+    struct addrinfo hints = {};
+    struct addrinfo *res = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(c->host.c_str(), c->port.c_str(), &hints, &res) != 0) {
+        return false;
+    }
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd >= 0) {
+        struct timeval tv;
+        tv.tv_sec = c->timeout_ms / 1000;
+        tv.tv_usec = (c->timeout_ms % 1000) * 1000;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    c->fd = fd;
+    return fd >= 0;
+}
+
+/**
+ * @brief Send the request and read the response on the open socket.
+ *
+ * @return bool false on a socket error or a malformed response.
+ */
+static bool _http_exchange(esp_http_client_handle_t c, std::string &body)
+{
+    std::string req = std::string(_method_names[c->method]) + " " + c->path + " HTTP/1.1\r\n";
+    req += "Host: " + c->host + ":" + c->port + "\r\n";
+    for (auto &h : c->headers) {
+        req += h.first + ": " + h.second + "\r\n";
+    }
+    if (c->post.length() || c->method != HTTP_METHOD_GET) {
+        req += "Content-Length: " + std::to_string(c->post.length()) + "\r\n";
+    }
+    req += "\r\n" + c->post;
+    if (send(c->fd, req.data(), req.length(), MSG_NOSIGNAL) != (ssize_t)req.length()) {
+        return false;
+    }
+
+    std::string buf;
+    char tmp[1024];
+    size_t eoh;
+    while ((eoh = buf.find("\r\n\r\n")) == std::string::npos) {
+        ssize_t n = recv(c->fd, tmp, sizeof(tmp), 0);
+        if (n <= 0) {
+            return false;
+        }
+        buf.append(tmp, n);
+    }
+    std::string head = buf.substr(0, eoh);
+    body = buf.substr(eoh + 4);
+    if (head.compare(0, 5, "HTTP/") != 0 || head.find(' ') == std::string::npos) {
+        return false;
+    }
+    c->status = atoi(head.c_str() + head.find(' ') + 1);
+
+    size_t length = 0;
+    bool keep = true;
+    std::string lhead = head;
+    ad2_lcase(lhead);
+    size_t p = lhead.find("\r\ncontent-length:");
+    if (p != std::string::npos) {
+        length = strtoul(lhead.c_str() + p + 17, nullptr, 10);
+    }
+    if (lhead.find("\r\nconnection: close") != std::string::npos) {
+        keep = false;
+    }
+    while (body.length() < length) {
+        ssize_t n = recv(c->fd, tmp, sizeof(tmp), 0);
+        if (n <= 0) {
+            return false;
+        }
+        body.append(tmp, n);
+    }
+    body.resize(length);
+    if (!keep) {
+        _http_close(c);
+    }
+    return true;
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    esp_http_client_handle_t c = new esp_http_client;
+    c->config = *config;
+    c->method = config->method;
+    c->timeout_ms = config->timeout_ms ? config->timeout_ms : 5000;
+    if (!_http_parse_url(c, config->url)) {
+        delete c;
+        return nullptr;
+    }
+    return c;
+}
+
+esp_err_t esp_http_client_perform(esp_http_client_handle_t c)
+{
+    c->status = 0;
+    std::string body;
+    bool ok = false;
+    // A kept socket may have been closed by the server. Try once more
+    // on a new connection.
+    for (int attempt = 0; attempt < 2 && !ok; attempt++) {
+        bool reused = c->fd >= 0;
+        if (!reused && !_http_connect(c)) {
+            break;
+        }
+        ok = _http_exchange(c, body);
+        if (!ok) {
+            _http_close(c);
+            if (!reused) {
+                break;
+            }
+        }
+    }
+    if (!ok) {
+        return ESP_FAIL;
+    }
+    if (c->config.event_handler) {
+        esp_http_client_event_t evt = {};
+        evt.client = c;
+        evt.user_data = c->config.user_data;
+        if (body.length()) {
+            evt.event_id = HTTP_EVENT_ON_DATA;
+            evt.data = (void *)body.data();
+            evt.data_len = body.length();
+            c->config.event_handler(&evt);
+        }
+        evt.event_id = HTTP_EVENT_ON_FINISH;
+        evt.data = nullptr;
+        evt.data_len = 0;
+        c->config.event_handler(&evt);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t c)
+{
+    _http_close(c);
+    delete c;
+    return ESP_OK;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t c)
+{
+    return c->status;
+}
+
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t c, const char *url)
+{
+    std::string host = c->host;
+    std::string port = c->port;
+    if (!_http_parse_url(c, url)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (host != c->host || port != c->port) {
+        _http_close(c);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t c, esp_http_client_method_t method)
+{
+    c->method = method;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t c, const char *data, int len)
+{
+    c->post = data ? std::string(data, len) : "";
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t c, const char *key, const char *value)
+{
+    esp_http_client_delete_header(c, key);
+    c->headers.push_back(std::make_pair(std::string(key), std::string(value)));
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t c, const char *key)
+{
+    std::string k = key;
+    ad2_lcase(k);
+    for (auto it = c->headers.begin(); it != c->headers.end(); it++) {
+        std::string h = it->first;
+        ad2_lcase(h);
+        if (h == k) {
+            c->headers.erase(it);
+            break;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_timeout_ms(esp_http_client_handle_t c, int timeout_ms)
+{
+    c->timeout_ms = timeout_ms;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_authtype(esp_http_client_handle_t c, esp_http_client_auth_type_t auth_type)
+{
+    c->config.auth_type = auth_type;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_username(esp_http_client_handle_t c, const char *username)
+{
+    c->config.username = username;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_password(esp_http_client_handle_t c, const char *password)
+{
+    c->config.password = password;
+    return ESP_OK;
+}
+
+uint64_t hal_uptime_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool hal_get_network_connected()
+{
+    return _network_connected;
+}
+
+void ad2_printf_host(bool prefix, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+}
+
+std::string ad2_string_printf(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(nullptr, 0, fmt, args);
+    va_end(args);
+    std::string out(len > 0 ? len : 0, '\0');
+    va_start(args, fmt);
+    vsnprintf(&out[0], out.length() + 1, fmt, args);
+    va_end(args);
+    return out;
+}
+
+int ad2_copy_nth_arg(std::string &dest, const char *src, int n, bool remaining)
+{
+    std::string s = src;
+    size_t pos = 0;
+    for (int i = 0;; i++) {
+        size_t start = s.find_first_not_of(' ', pos);
+        if (start == std::string::npos) {
+            return -1;
+        }
+        size_t end = s.find(' ', start);
+        if (i == n) {
+            dest = remaining || end == std::string::npos ? s.substr(start) : s.substr(start, end - start);
+            return 0;
+        }
+        if (end == std::string::npos) {
+            return -1;
+        }
+        pos = end;
+    }
+}
+
+void ad2_lcase(std::string &str)
+{
+    for (auto &c : str) {
+        c = tolower(c);
+    }
+}
+
+void ad2_get_config_key_string(const char *section, const char *key, std::string &vout,
+                               int index, const char *suffix)
+{
+    std::lock_guard<std::mutex> lock(_config_mutex);
+    auto it = _config.find(std::string(section) + "." + key);
+    if (it != _config.end()) {
+        vout = it->second;
+    }
+}
+
+void ad2host_set_config(const char *section, const char *key, const std::string &value)
+{
+    std::lock_guard<std::mutex> lock(_config_mutex);
+    _config[std::string(section) + "." + key] = value;
+}
+
+void ad2host_set_network(bool connected)
+{
+    _network_connected = connected;
+}
@@ -0,0 +1,191 @@
+/**
+ *  @file    ad2host_idf.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Linux host stand-ins for the FreeRTOS, esp_http_client and
+ *  ad2 utility calls used by main/ad2_sendq.cpp. Tasks are threads,
+ *  semaphores are mutexes and condition variables and the HTTP client
+ *  is a plain HTTP/1.1 keep-alive client over POSIX sockets.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef _AD2HOST_IDF_H
+#define _AD2HOST_IDF_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <string>
+
+// Common settings
+#include "ad2_settings.h"
+
+#ifndef CONFIG_AD2IOT_HTTP_SENDQ_WORKERS
+#define CONFIG_AD2IOT_HTTP_SENDQ_WORKERS 2
+#endif
+
+// esp_err
+typedef int esp_err_t;
+#define ESP_OK                  0
+#define ESP_FAIL                -1
+#define ESP_ERR_NO_MEM          0x101
+#define ESP_ERR_INVALID_ARG     0x102
+#define ESP_ERR_NOT_FINISHED    0x10c
+
+// esp_log. Warnings and errors to stderr.
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) fprintf(stderr, "I %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...)
+
+// FreeRTOS. One tick is one ms.
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef void *SemaphoreHandle_t;
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+#define pdTRUE              1
+#define pdFALSE             0
+#define pdPASS              pdTRUE
+#define portMAX_DELAY       0xffffffffUL
+#define portTICK_PERIOD_MS  1
+#define tskIDLE_PRIORITY    0
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                       UBaseType_t prio, TaskHandle_t *handle);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+void xTaskNotifyGive(TaskHandle_t task);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+// esp_system
+uint32_t esp_random();
+typedef struct {
+    int revision;
+} esp_chip_info_t;
+void esp_chip_info(esp_chip_info_t *info);
+
+// esp_http_client
+typedef enum {
+    HTTP_METHOD_GET = 0,
+    HTTP_METHOD_POST,
+    HTTP_METHOD_PUT,
+    HTTP_METHOD_PATCH,
+    HTTP_METHOD_DELETE
+} esp_http_client_method_t;
+
+typedef enum {
+    HTTP_EVENT_ERROR = 0,
+    HTTP_EVENT_ON_CONNECTED,
+    HTTP_EVENT_HEADERS_SENT,
+    HTTP_EVENT_ON_HEADER,
+    HTTP_EVENT_ON_DATA,
+    HTTP_EVENT_ON_FINISH,
+    HTTP_EVENT_DISCONNECTED,
+    HTTP_EVENT_REDIRECT
+} esp_http_client_event_id_t;
+
+typedef enum {
+    HTTP_AUTH_TYPE_NONE = 0,
+    HTTP_AUTH_TYPE_BASIC,
+    HTTP_AUTH_TYPE_DIGEST
+} esp_http_client_auth_type_t;
+
+typedef enum {
+    HTTP_TRANSPORT_UNKNOWN = 0,
+    HTTP_TRANSPORT_OVER_TCP,
+    HTTP_TRANSPORT_OVER_SSL
+} esp_http_client_transport_t;
+
+typedef struct esp_http_client *esp_http_client_handle_t;
+
+typedef struct {
+    esp_http_client_event_id_t event_id;
+    esp_http_client_handle_t client;
+    void *data;
+    int data_len;
+    void *user_data;
+    char *header_key;
+    char *header_value;
+} esp_http_client_event_t;
+
+typedef esp_err_t (*http_event_handle_cb)(esp_http_client_event_t *evt);
+
+// The fields the sendQ reads. Only http:// is supported.
+typedef struct {
+    const char *url;
+    const char *username;
+    const char *password;
+    esp_http_client_auth_type_t auth_type;
+    const char *cert_pem;
+    const char *client_cert_pem;
+    const char *client_key_pem;
+    esp_http_client_method_t method;
+    int timeout_ms;
+    bool disable_auto_redirect;
+    int max_redirection_count;
+    int max_authorization_retries;
+    http_event_handle_cb event_handler;
+    esp_http_client_transport_t transport_type;
+    int buffer_size;
+    int buffer_size_tx;
+    void *user_data;
+    bool use_global_ca_store;
+    bool skip_cert_common_name_check;
+    const char *common_name;
+    esp_err_t (*crt_bundle_attach)(void *conf);
+    bool keep_alive_enable;
+} esp_http_client_config_t;
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config);
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client);
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client);
+int esp_http_client_get_status_code(esp_http_client_handle_t client);
+esp_err_t esp_http_client_set_url(esp_http_client_handle_t client, const char *url);
+esp_err_t esp_http_client_set_method(esp_http_client_handle_t client, esp_http_client_method_t method);
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char *data, int len);
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value);
+esp_err_t esp_http_client_delete_header(esp_http_client_handle_t client, const char *key);
+esp_err_t esp_http_client_set_timeout_ms(esp_http_client_handle_t client, int timeout_ms);
+esp_err_t esp_http_client_set_authtype(esp_http_client_handle_t client, esp_http_client_auth_type_t auth_type);
+esp_err_t esp_http_client_set_username(esp_http_client_handle_t client, const char *username);
+esp_err_t esp_http_client_set_password(esp_http_client_handle_t client, const char *password);
+
+// ad2 utilities and HAL.
+#define CFG_SECTION_MAIN ""
+extern int g_StopMainTask;
+extern int g_init_done;
+uint64_t hal_uptime_us();
+bool hal_get_network_connected();
+void ad2_printf_host(bool prefix, const char *format, ...);
+std::string ad2_string_printf(const char *fmt, ...);
+int ad2_copy_nth_arg(std::string &dest, const char *src, int n, bool remaining = false);
+void ad2_lcase(std::string &str);
+void ad2_get_config_key_string(const char *section, const char *key, std::string &vout,
+                               int index = -1, const char *suffix = NULL);
+
+// Host test controls.
+void ad2host_set_config(const char *section, const char *key, const std::string &value);
+void ad2host_set_network(bool connected);
+
+#endif /* _AD2HOST_IDF_H */
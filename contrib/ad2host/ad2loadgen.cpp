@@ -0,0 +1,590 @@
+/**
+ *  @file    ad2loadgen.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Linux host synthetic alarm panel AD2* protocol stream generator.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include "alarmdecoder_api.h"
+
+// Limits of the AD2* protocol.
+#define LOADGEN_MAX_PARTITIONS 32
+#define LOADGEN_MAX_ZONES 255
+#define LOADGEN_MAX_CLIENTS 8
+
+// 5800 RFX status bits.
+#define RFX_BATTERY_BIT 0x02
+#define RFX_SUPERVISION_BIT 0x04
+#define RFX_LOOP1_BIT 0x80
+
+static volatile bool g_stop = false;
+
+/**
+ * Synthetic partition state.
+ */
+struct lg_partition {
+    uint32_t mask;              // address mask bit for this partition.
+    std::vector<int> zones;     // zones assigned to this partition.
+    size_t fault_cursor = 0;    // next open zone to show on the display.
+};
+
+/**
+ * Synthetic panel.
+ */
+struct lg_panel {
+    char type = ADEMCO_PANEL;
+    int zones = 16;
+    int rfx_sensors = 0;
+    std::vector<lg_partition> partitions;
+    std::vector<bool> zone_open;
+    std::vector<int> zone_partition;
+};
+
+/**
+ * Generated message counters.
+ */
+struct lg_stats {
+    uint64_t keypad = 0;
+    uint64_t exp = 0;
+    uint64_t rfx = 0;
+    uint64_t lrr = 0;
+    uint64_t zone_changes = 0;
+    uint64_t bytes = 0;
+};
+
+// verify parser counters.
+static uint64_t v_raw = 0, v_alpha = 0, v_zone = 0, v_exp = 0, v_rfx = 0, v_lrr = 0;
+
+/**
+ * @brief ser2sock style output. Stream to all connected clients.
+ */
+class lg_output
+{
+public:
+    bool listenOn(int port)
+    {
+        _listen_fd = socket(AF_INET6, SOCK_STREAM, 0);
+        if (_listen_fd < 0) {
+            return false;
+        }
+        int on = 1;
+        setsockopt(_listen_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        int off = 0;
+        setsockopt(_listen_fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+        struct sockaddr_in6 addr = {};
+        addr.sin6_family = AF_INET6;
+        addr.sin6_addr = in6addr_any;
+        addr.sin6_port = htons(port);
+        if (bind(_listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+                listen(_listen_fd, LOADGEN_MAX_CLIENTS) != 0) {
+            fprintf(stderr, "unable to listen on port %i: %s\n", port, strerror(errno));
+            return false;
+        }
+        fcntl(_listen_fd, F_SETFL, O_NONBLOCK);
+        return true;
+    }
+
+    bool openPath(const std::string &path)
+    {
+        if (path == "-") {
+            _out_fd = STDOUT_FILENO;
+        } else {
+            _out_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        }
+        if (_out_fd < 0) {
+            fprintf(stderr, "unable to open '%s': %s\n", path.c_str(), strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Accept new clients and answer keypresses like an AD2*.
+     */
+    void service()
+    {
+        if (_listen_fd < 0) {
+            return;
+        }
+        int fd;
+        while ((fd = accept(_listen_fd, nullptr, nullptr)) >= 0) {
+            if (_clients.size() >= LOADGEN_MAX_CLIENTS) {
+                ::close(fd);
+                continue;
+            }
+            fcntl(fd, F_SETFL, O_NONBLOCK);
+            _clients.push_back(fd);
+            fprintf(stderr, "client %i connected\n", fd);
+        }
+        char buf[256];
+        for (size_t i = 0; i < _clients.size(); i++) {
+            ssize_t n = ::read(_clients[i], buf, sizeof(buf));
+            if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+                _drop(i--);
+                continue;
+            }
+            // acknowledge keypad commands.
+            for (ssize_t c = 0; c < n; c++) {
+                if (buf[c] == '\r' || buf[c] == '\n') {
+                    if (_pending_cmd) {
+                        write("!Sending...done\r\n");
+                    }
+                    _pending_cmd = false;
+                } else {
+                    _pending_cmd = true;
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Wait for a client before streaming.
+     */
+    bool hasReader()
+    {
+        return _out_fd >= 0 || _clients.size();
+    }
+
+    void write(const std::string &msg)
+    {
+        if (_out_fd >= 0) {
+            if (::write(_out_fd, msg.c_str(), msg.length()) < 0) {
+                g_stop = true;
+            }
+        }
+        for (size_t i = 0; i < _clients.size(); i++) {
+            ssize_t n = send(_clients[i], msg.c_str(), msg.length(), MSG_NOSIGNAL);
+            if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                _drop(i--);
+            }
+        }
+    }
+
+    void close()
+    {
+        while (_clients.size()) {
+            _drop(0);
+        }
+        if (_listen_fd >= 0) {
+            ::close(_listen_fd);
+        }
+        if (_out_fd > STDERR_FILENO) {
+            ::close(_out_fd);
+        }
+    }
+
+protected:
+    void _drop(size_t i)
+    {
+        fprintf(stderr, "client %i disconnected\n", _clients[i]);
+        ::close(_clients[i]);
+        _clients.erase(_clients.begin() + i);
+    }
+
+    int _listen_fd = -1;
+    int _out_fd = -1;
+    bool _pending_cmd = false;
+    std::vector<int> _clients;
+};
+
+/**
+ * @brief Space pad or truncate the alpha message to the 32 character display.
+ */
+static std::string pad32(const std::string &s)
+{
+    std::string out = s.substr(0, 32);
+    out.resize(32, ' ');
+    return out;
+}
+
+/**
+ * @brief Build a keypad status message using the alarmdecoder-api field layout.
+ *
+ * @param [in]panel panel type ADEMCO_PANEL or DSC_PANEL.
+ * @param [in]mask partition address mask. LSB is address/partition 1.
+ * @param [in]ready ready to arm.
+ * @param [in]numeric section #2 numeric field.
+ * @param [in]alpha 32 character display text.
+ */
+static std::string keypad_message(char panel, uint32_t mask, bool ready, int numeric, const std::string &alpha)
+{
+    // section #1 bit field.
+    std::string bits(20, BIT_OFF);
+    bits[READY_BYTE - 1] = ready ? BIT_ON : BIT_OFF;
+    bits[BEEPMODE_BYTE - 1] = '0';
+    bits[ACPOWER_BYTE - 1] = BIT_ON;
+    bits[CHIME_BYTE - 1] = BIT_ON;
+    bits[SYSSPECIFIC_BYTE - 1] = '0';
+    bits[PANEL_TYPE_BYTE - 1] = panel;
+    bits[UNUSED_1_BYTE - 1] = BIT_UNDEFINED;
+    bits[UNUSED_2_BYTE - 1] = BIT_UNDEFINED;
+
+    // section #3 raw data with the mask in network order.
+    char sec3[64];
+    snprintf(sec3, sizeof(sec3), "f7%08x%02d00%02x18000000000000",
+             (unsigned)AD2_NTOHL(mask), numeric % 100, ready ? 0x1c : 0x00);
+
+    char num[8];
+    snprintf(num, sizeof(num), "%03d", numeric % 1000);
+
+    std::string msg = "[" + bits + "]," + num + ",[" + sec3 + "],\"" + pad32(alpha) + "\"";
+    return msg;
+}
+
+/**
+ * @brief Next display message for a partition. Cycle open zones like a real keypad.
+ */
+static std::string partition_message(lg_panel &p, lg_partition &part)
+{
+    std::vector<int> open;
+    for (int z : part.zones) {
+        if (p.zone_open[z]) {
+            open.push_back(z);
+        }
+    }
+    if (!open.size()) {
+        if (p.type == DSC_PANEL) {
+            return keypad_message(p.type, part.mask, true, 0, "System is       Ready to Arm");
+        }
+        return keypad_message(p.type, part.mask, true, 8, "DISARMED CHIME   Ready to Arm");
+    }
+    int zone = open[part.fault_cursor++ % open.size()];
+    char alpha[40];
+    if (p.type == DSC_PANEL) {
+        snprintf(alpha, sizeof(alpha), "System not      Ready to Arm");
+        return keypad_message(p.type, part.mask, false, 0, alpha);
+    }
+    snprintf(alpha, sizeof(alpha), "FAULT %02d ZONE %03d", zone, zone);
+    return keypad_message(p.type, part.mask, false, zone, alpha);
+}
+
+static void on_raw(std::string *msg, AD2PartitionState *s, void *arg)
+{
+    v_raw++;
+}
+static void on_alpha(std::string *msg, AD2PartitionState *s, void *arg)
+{
+    v_alpha++;
+}
+static void on_zone(std::string *msg, AD2PartitionState *s, void *arg)
+{
+    v_zone++;
+}
+static void on_exp(std::string *msg, AD2PartitionState *s, void *arg)
+{
+    v_exp++;
+}
+static void on_rfx(std::string *msg, AD2PartitionState *s, void *arg)
+{
+    v_rfx++;
+}
+static void on_lrr(std::string *msg, AD2PartitionState *s, void *arg)
+{
+    v_lrr++;
+}
+
+static void on_signal(int sig)
+{
+    g_stop = true;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [options] (-l port | -o path)\n"
+            "    Generate a synthetic AD2* protocol stream.\n"
+            "\n"
+            "Output:\n"
+            "    -l port                 Serve the stream to ser2sock clients on a TCP port\n"
+            "    -o path                 Write the stream to a file or pipe. '-' for stdout\n"
+            "Panel:\n"
+            "    -t A|D                  Panel type Ademco or DSC. Default A\n"
+            "    -p count                Partitions 1-32. One address mask bit each. Default 1\n"
+            "    -z count                Zones 1-255. Default 16\n"
+            "    -x count                RFX wireless sensors on the first zones. Default 0\n"
+            "Rates:\n"
+            "    -r rate                 Keypad messages per second. Default 10\n"
+            "    -c rate                 Zone fault/restore changes per second. Default 1\n"
+            "    -f rate                 RFX supervision messages per second. Default 0\n"
+            "    -e rate                 LRR contact ID events per second. Default 0\n"
+            "    -m                      Max speed. Ignore rates and write as fast as possible\n"
+            "Run:\n"
+            "    -d seconds              Run time. Default 0 run until interrupted\n"
+            "    -n count                Stop after count messages\n"
+            "    -s seed                 Random seed. Default 1\n"
+            "    -v                      Verify. Parse the generated stream and report events\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    lg_panel panel;
+    int partitions = 1;
+    double keypad_rate = 10, churn_rate = 1, rfx_rate = 0, lrr_rate = 0;
+    bool max_speed = false;
+    bool verify = false;
+    int duration = 0;
+    uint64_t max_messages = 0;
+    unsigned seed = 1;
+    int listen_port = 0;
+    std::string out_path;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "l:o:t:p:z:x:r:c:f:e:md:n:s:v")) != -1) {
+        switch (opt) {
+        case 'l':
+            listen_port = atoi(optarg);
+            break;
+        case 'o':
+            out_path = optarg;
+            break;
+        case 't':
+            panel.type = toupper(optarg[0]) == DSC_PANEL ? DSC_PANEL : ADEMCO_PANEL;
+            break;
+        case 'p':
+            partitions = std::min(std::max(1, atoi(optarg)), LOADGEN_MAX_PARTITIONS);
+            break;
+        case 'z':
+            panel.zones = std::min(std::max(1, atoi(optarg)), LOADGEN_MAX_ZONES);
+            break;
+        case 'x':
+            panel.rfx_sensors = std::max(0, atoi(optarg));
+            break;
+        case 'r':
+            keypad_rate = atof(optarg);
+            break;
+        case 'c':
+            churn_rate = atof(optarg);
+            break;
+        case 'f':
+            rfx_rate = atof(optarg);
+            break;
+        case 'e':
+            lrr_rate = atof(optarg);
+            break;
+        case 'm':
+            max_speed = true;
+            break;
+        case 'd':
+            duration = atoi(optarg);
+            break;
+        case 'n':
+            max_messages = strtoull(optarg, nullptr, 10);
+            break;
+        case 's':
+            seed = strtoul(optarg, nullptr, 10);
+            break;
+        case 'v':
+            verify = true;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (!listen_port && !out_path.length()) {
+        usage(argv[0]);
+    }
+    panel.rfx_sensors = std::min(panel.rfx_sensors, panel.zones);
+
+    // Zones are numbered from 1 and spread across the partitions.
+    panel.partitions.resize(partitions);
+    for (int i = 0; i < partitions; i++) {
+        panel.partitions[i].mask = 1UL << i;
+    }
+    panel.zone_open.assign(panel.zones + 1, false);
+    panel.zone_partition.assign(panel.zones + 1, 0);
+    for (int z = 1; z <= panel.zones; z++) {
+        panel.zone_partition[z] = (z - 1) % partitions;
+        panel.partitions[(z - 1) % partitions].zones.push_back(z);
+    }
+
+    lg_output out;
+    if ((listen_port && !out.listenOn(listen_port)) ||
+            (out_path.length() && !out.openPath(out_path))) {
+        return 1;
+    }
+
+    // Optional in process parse of the same stream.
+    AlarmDecoderParser parser;
+    if (verify) {
+        parser.subscribeTo(ON_RAW_MESSAGE, on_raw, nullptr);
+        parser.subscribeTo(ON_ALPHA_MESSAGE, on_alpha, nullptr);
+        parser.subscribeTo(ON_ZONE_CHANGE, on_zone, nullptr);
+        parser.subscribeTo(ON_EXP, on_exp, nullptr);
+        parser.subscribeTo(ON_RFX, on_rfx, nullptr);
+        parser.subscribeTo(ON_LRR, on_lrr, nullptr);
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (listen_port) {
+        fprintf(stderr, "waiting for ser2sock clients on port %i\n", listen_port);
+    }
+    while (!g_stop && !out.hasReader()) {
+        out.service();
+        usleep(100 * 1000);
+    }
+
+    std::mt19937 rng(seed);
+    lg_stats st;
+    size_t next_part = 0;
+    typedef std::chrono::steady_clock clock;
+    auto start = clock::now();
+    auto end = start + std::chrono::seconds(duration);
+
+    // next due time for each stream in seconds from start.
+    const double never = 1e30;
+    double t_keypad = 0, t_churn = 0, t_rfx = 0, t_lrr = 0;
+    auto period = [](double rate) {
+        return rate > 0 ? 1.0 / rate : 1e30;
+    };
+    if (churn_rate <= 0) {
+        t_churn = never;
+    }
+    if (rfx_rate <= 0 || !panel.rfx_sensors) {
+        t_rfx = never;
+    }
+    if (lrr_rate <= 0) {
+        t_lrr = never;
+    }
+    if (keypad_rate <= 0) {
+        t_keypad = never;
+    }
+
+    uint64_t sent = 0;
+    auto emit = [&](const std::string &msg) {
+        std::string line = msg + "\r\n";
+        out.write(line);
+        st.bytes += line.length();
+        sent++;
+        if (verify) {
+            parser.put((uint8_t *)line.c_str(), line.length());
+        }
+    };
+
+    while (!g_stop && (!duration || clock::now() < end) && (!max_messages || sent < max_messages)) {
+        double now = std::chrono::duration<double>(clock::now() - start).count();
+        double due = std::min(std::min(t_keypad, t_churn), std::min(t_rfx, t_lrr));
+        if (due >= never) {
+            break;
+        }
+        if (!max_speed && due > now) {
+            out.service();
+            usleep(std::min(100000.0, (due - now) * 1e6));
+            continue;
+        }
+        if (max_speed) {
+            // keep the same mix of messages without waiting.
+            now = due;
+        }
+
+        if (due == t_churn) {
+            // Fault or restore a random zone.
+            int zone = std::uniform_int_distribution<int>(1, panel.zones)(rng);
+            bool open = !panel.zone_open[zone];
+            panel.zone_open[zone] = open;
+            int part = panel.zone_partition[zone];
+            st.zone_changes++;
+            if (panel.type == DSC_PANEL) {
+                // DSC zones are reported with expander messages. zone = addr * 8 + chan
+                char buf[32];
+                snprintf(buf, sizeof(buf), "!EXP:%02d,%02d,%02d", zone / 8, zone % 8, open ? 1 : 0);
+                emit(buf);
+                st.exp++;
+            }
+            if (zone <= panel.rfx_sensors) {
+                // 5800 wireless zone loop 1.
+                char buf[32];
+                snprintf(buf, sizeof(buf), "!RFX:%07d,%02x", 100000 + zone, open ? RFX_LOOP1_BIT : 0);
+                emit(buf);
+                st.rfx++;
+            }
+            // the panel reports the change on the keypad right away.
+            emit(partition_message(panel, panel.partitions[part]));
+            st.keypad++;
+            t_churn += period(churn_rate);
+        } else if (due == t_keypad) {
+            lg_partition &part = panel.partitions[next_part++ % panel.partitions.size()];
+            emit(partition_message(panel, part));
+            st.keypad++;
+            t_keypad += period(keypad_rate);
+        } else if (due == t_rfx) {
+            // periodic supervision check in from a random sensor.
+            int zone = std::uniform_int_distribution<int>(1, panel.rfx_sensors)(rng);
+            uint8_t status = RFX_SUPERVISION_BIT | (panel.zone_open[zone] ? RFX_LOOP1_BIT : 0);
+            if (std::uniform_int_distribution<int>(0, 99)(rng) == 0) {
+                status |= RFX_BATTERY_BIT;
+            }
+            char buf[32];
+            snprintf(buf, sizeof(buf), "!RFX:%07d,%02x", 100000 + zone, status);
+            emit(buf);
+            st.rfx++;
+            t_rfx += period(rfx_rate);
+        } else {
+            // Contact ID burglary alarm or restore on a random zone.
+            int zone = std::uniform_int_distribution<int>(1, panel.zones)(rng);
+            char buf[48];
+            snprintf(buf, sizeof(buf), "!LRR:%03d,%d,CID_%c130,ff", zone,
+                     panel.zone_partition[zone] + 1, panel.zone_open[zone] ? '1' : '3');
+            emit(buf);
+            st.lrr++;
+            t_lrr += period(lrr_rate);
+        }
+        if (max_speed && (sent & 0xff) == 0) {
+            out.service();
+        }
+    }
+
+    double secs = std::chrono::duration<double>(clock::now() - start).count();
+    out.close();
+
+    fprintf(stderr, "panel          %c %i partitions %i zones %i rfx\n", panel.type,
+            partitions, panel.zones, panel.rfx_sensors);
+    fprintf(stderr, "elapsed        %.3f s\n", secs);
+    fprintf(stderr, "messages       %llu (%llu keypad %llu exp %llu rfx %llu lrr) %llu zone changes\n",
+            (unsigned long long)sent, (unsigned long long)st.keypad, (unsigned long long)st.exp,
+            (unsigned long long)st.rfx, (unsigned long long)st.lrr, (unsigned long long)st.zone_changes);
+    fprintf(stderr, "throughput     %.0f messages/s %.0f bytes/s\n", sent / secs, st.bytes / secs);
+    if (verify) {
+        fprintf(stderr, "verify         %llu raw %llu alpha %llu zone %llu exp %llu rfx %llu lrr\n",
+                (unsigned long long)v_raw, (unsigned long long)v_alpha, (unsigned long long)v_zone,
+                (unsigned long long)v_exp, (unsigned long long)v_rfx, (unsigned long long)v_lrr);
+        if (v_raw != sent || v_alpha != st.keypad) {
+            fprintf(stderr, "verify FAILED parser did not accept every message\n");
+            return 2;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,216 @@
+/**
+ *  @file    ad2mqttbench.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Linux host micro-benchmark for the ad2mqtt publish path.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <new>
+#include <algorithm>
+
+#include "ad2_settings.h"
+#include "ad2mqtt_topics.h"
+#include "ad2mqtt_outbox.h"
+
+// heap allocations made by the code under test.
+static uint64_t g_allocs = 0;
+
+void *operator new(size_t size)
+{
+    g_allocs++;
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+// Stand-in for esp_mqtt_client_enqueue(). Copies the topic and payload
+// into an outbox buffer like the client does.
+static char g_outbox[512];
+static uint64_t g_outbox_bytes = 0;
+
+static int enqueue(const char *topic, const char *data, int len)
+{
+    size_t tlen = strlen(topic);
+    if (len <= 0) {
+        len = strlen(data);
+    }
+    if (tlen + len < sizeof(g_outbox)) {
+        memcpy(g_outbox, topic, tlen);
+        memcpy(g_outbox + tlen, data, len);
+    }
+    g_outbox_bytes += tlen + len;
+    return 1;
+}
+
+static const char *ZONE_PAYLOAD = "{\"state\":\"OPEN\",\"partition\":1,\"mask\":1,\"system\":false,\"name\":\"FRONT DOOR\"}";
+
+/**
+ * @brief Topic built per publish the way ad2mqtt did before the topic table.
+ */
+static void publish_concat(const std::string &tprefix, const std::string &uuid, int zone)
+{
+    std::string sTopic = tprefix + MQTT_TOPIC_PREFIX "/";
+    sTopic += uuid;
+    sTopic += "/zones/";
+    sTopic += std::to_string(zone);
+    enqueue(sTopic.c_str(), ZONE_PAYLOAD, 0);
+}
+
+/**
+ * @brief Topic from the precomputed table.
+ */
+static void publish_table(AD2MQTTTopicTable &t, int zone)
+{
+    const mqtt_topic_t *topic = t.zone(zone);
+    if (topic) {
+        enqueue(topic->topic, ZONE_PAYLOAD, 0);
+    }
+}
+
+/**
+ * @brief Stage count publishes with the broker offline. Zone chatter
+ * with some partition state and contact ID events. Limits of 0 are
+ * unbounded.
+ */
+static void offline_run(const char *name, AD2MQTTTopicTable &t, int count, size_t max_bytes, size_t max_count)
+{
+    AD2MQTTOutbox outbox;
+    outbox.setLimits(max_bytes, max_count);
+    static const char *PART_PAYLOAD = "{\"ready\":true,\"armed_away\":false,\"armed_stay\":false,\"fire_alarm\":false,\"alarm_sounding\":false,\"event\":\"READY CHANGE\"}";
+    static const char *CID_PAYLOAD = "{\"event_message\":\"!LRR:001,1,CID_1406,ff\"}";
+    uint32_t cid = 0;
+    for (int i = 0; i < count; i++) {
+        if (i % 50 == 0) {
+            outbox.push(t.get(MQTT_TOPIC_CID), CID_PAYLOAD, strlen(CID_PAYLOAD), 1, true, false, MQTT_PRIO_ALARM);
+            cid++;
+        } else if (i % 10 == 0) {
+            outbox.push(t.partition((i / 10) % 2 + 1), PART_PAYLOAD, strlen(PART_PAYLOAD), 1, true, true, MQTT_PRIO_ALARM);
+        } else {
+            outbox.push(t.zone((i * 7) % AD2_MAX_ZONES + 1), ZONE_PAYLOAD, strlen(ZONE_PAYLOAD), 1, true, true, MQTT_PRIO_ZONE);
+        }
+    }
+    // count the contact ID events still staged.
+    uint32_t cid_kept = 0;
+    mqtt_outbox_msg_t msg;
+    mqtt_outbox_stats_t st = outbox.getStats();
+    while (outbox.pop(msg)) {
+        if (msg.topic == t.get(MQTT_TOPIC_CID)) {
+            cid_kept++;
+        }
+    }
+    printf("%-14s depth %u bytes %u collapsed %u dropped %u cid %u/%u\n", name,
+           st.depth, st.bytes, st.collapsed, st.dropped, cid_kept, cid);
+}
+
+/**
+ * @brief Print usage and exit.
+ */
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "Usage: %s [-n count] [-t tprefix]\n"
+            "    Compare building MQTT topics per publish with the precomputed topic table\n"
+            "    and stage publishes in the bounded outbox with the broker offline.\n"
+            "Options:\n"
+            "    -n count                Publishes per run. Default 1000000\n"
+            "    -t tprefix              Topic prefix. Default none\n", prog);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    int count = 1000000;
+    std::string tprefix;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:")) != -1) {
+        switch (opt) {
+        case 'n':
+            count = std::max(1, atoi(optarg));
+            break;
+        case 't':
+            tprefix = std::string(optarg) + "/";
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    // Same length as ad2_genUUID(0x10) output.
+    std::string uuid = "41443249-4f54-1000-8000-0123456789ab";
+
+    std::vector<int> switches;
+    for (int n = 1; n <= 32; n++) {
+        switches.push_back(n);
+    }
+    AD2MQTTTopicTable table;
+    uint64_t a0 = g_allocs;
+    auto t0 = std::chrono::steady_clock::now();
+    table.build(tprefix, uuid, AD2_MAX_PARTITION, AD2_MAX_ZONES, switches);
+    double build_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    printf("table          %zu topics %zu bytes built in %.0f us with %llu allocations\n",
+           table.count(), table.bytes(), build_us, (unsigned long long)(g_allocs - a0));
+
+    struct {
+        const char *name;
+        bool use_table;
+    } runs[] = {{"concat", false}, {"table", true}};
+
+    for (auto &run : runs) {
+        g_outbox_bytes = 0;
+        uint64_t allocs = g_allocs;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; i++) {
+            int zone = (i % AD2_MAX_ZONES) + 1;
+            if (run.use_table) {
+                publish_table(table, zone);
+            } else {
+                publish_concat(tprefix, uuid, zone);
+            }
+        }
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        allocs = g_allocs - allocs;
+        printf("%-14s %.1f ns/publish %.2f allocations/publish (%llu bytes)\n", run.name,
+               ns / count, (double)allocs / count, (unsigned long long)g_outbox_bytes);
+    }
+
+    // Outbox while the broker is unreachable.
+    int offline = std::min(count, 10000);
+    printf("offline        %d publishes staged\n", offline);
+    offline_run("unbounded", table, offline, 0, 0);
+    offline_run("16K/64", table, offline, 16384, 64);
+    return 0;
+}
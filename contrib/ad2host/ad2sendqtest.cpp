@@ -0,0 +1,522 @@
+/**
+ *  @file    ad2sendqtest.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Linux host test for the HTTP sendQ. main/ad2_sendq.cpp is
+ *  built against the ad2host_idf shims and delivers to local HTTP
+ *  servers with injected delays and failures.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+
+#include "ad2host_idf.h"
+#include "ad2_sendq.h"
+
+static int g_checks = 0;
+static int g_failed = 0;
+
+/**
+ * @brief Report a failed check.
+ */
+static void check(const char *name, bool ok, const std::string &detail = "")
+{
+    g_checks++;
+    if (!ok) {
+        g_failed++;
+        printf("FAIL %s %s\n", name, detail.c_str());
+    }
+}
+
+static void check(const char *name, const std::string &got, const std::string &want)
+{
+    check(name, got == want, "\n  got  '" + got + "'\n  want '" + want + "'");
+}
+
+static uint64_t now_ms()
+{
+    return hal_uptime_us() / 1000;
+}
+
+static void sleep_ms(int ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+/**
+ * @brief Local HTTP/1.1 keep-alive server. Records each request and
+ * answers after delay_ms. The first fail_first requests get a 503.
+ */
+class TestServer
+{
+public:
+    struct request {
+        std::string body;
+        bool has_test_header;
+        int conn;
+    };
+
+    int delay_ms = 0;
+    int fail_first = 0;
+
+    void start()
+    {
+        _fd = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(_fd, (struct sockaddr *)&addr, sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(_fd, (struct sockaddr *)&addr, &len);
+        _port = ntohs(addr.sin_port);
+        listen(_fd, 8);
+        std::thread([this]() {
+            int conn = 0;
+            while (1) {
+                int c = accept(_fd, nullptr, nullptr);
+                if (c < 0) {
+                    break;
+                }
+                std::thread([this, c, conn]() {
+                    _serve(c, conn);
+                }).detach();
+                conn++;
+            }
+        }).detach();
+    }
+
+    std::string url(const std::string &path = "/notify")
+    {
+        return "http://127.0.0.1:" + std::to_string(_port) + path;
+    }
+
+    std::vector<request> requests()
+    {
+        std::lock_guard<std::mutex> lock(_m);
+        return _requests;
+    }
+
+    std::string bodies()
+    {
+        std::string out;
+        for (auto &r : requests()) {
+            out += (out.length() ? "," : "") + r.body;
+        }
+        return out;
+    }
+
+    int max_inflight()
+    {
+        std::lock_guard<std::mutex> lock(_m);
+        return _max_inflight;
+    }
+
+protected:
+    void _serve(int c, int conn)
+    {
+        std::string buf;
+        char tmp[1024];
+        while (1) {
+            size_t eoh;
+            while ((eoh = buf.find("\r\n\r\n")) == std::string::npos) {
+                ssize_t n = recv(c, tmp, sizeof(tmp), 0);
+                if (n <= 0) {
+                    close(c);
+                    return;
+                }
+                buf.append(tmp, n);
+            }
+            std::string head = buf.substr(0, eoh);
+            buf.erase(0, eoh + 4);
+            std::string lhead = head;
+            ad2_lcase(lhead);
+            size_t length = 0;
+            size_t p = lhead.find("\r\ncontent-length:");
+            if (p != std::string::npos) {
+                length = strtoul(lhead.c_str() + p + 17, nullptr, 10);
+            }
+            while (buf.length() < length) {
+                ssize_t n = recv(c, tmp, sizeof(tmp), 0);
+                if (n <= 0) {
+                    close(c);
+                    return;
+                }
+                buf.append(tmp, n);
+            }
+            request r = {buf.substr(0, length), lhead.find("\r\nx-test:") != std::string::npos, conn};
+            buf.erase(0, length);
+
+            int status = 200;
+            {
+                std::lock_guard<std::mutex> lock(_m);
+                _requests.push_back(r);
+                if (fail_first > 0) {
+                    fail_first--;
+                    status = 503;
+                }
+                _max_inflight = std::max(_max_inflight, ++_inflight);
+            }
+            sleep_ms(delay_ms);
+            {
+                std::lock_guard<std::mutex> lock(_m);
+                _inflight--;
+            }
+            std::string resp = "HTTP/1.1 " + std::to_string(status) +
+                               (status == 200 ? " OK" : " Service Unavailable") +
+                               "\r\nContent-Length: 2\r\nConnection: keep-alive\r\n\r\nok";
+            send(c, resp.data(), resp.length(), MSG_NOSIGNAL);
+        }
+    }
+
+    int _fd = -1;
+    int _port = 0;
+    std::mutex _m;
+    std::vector<request> _requests;
+    int _inflight = 0;
+    int _max_inflight = 0;
+};
+
+/**
+ * @brief A queued test request. The body is the request name.
+ */
+typedef struct test_req {
+    esp_http_client_config_t config;
+    std::string url;
+    std::string body;
+    bool test_header;
+} test_req_t;
+
+typedef struct test_result {
+    std::string body;
+    int status;
+    uint64_t done_ms;
+} test_result_t;
+
+static std::mutex g_results_mutex;
+static std::vector<test_result_t> g_results;
+static TestServer *g_spool_server = nullptr;
+
+static void test_ready(esp_http_client_handle_t client, esp_http_client_config_t *config)
+{
+    test_req_t *r = (test_req_t *)config->user_data;
+    esp_http_client_set_post_field(client, r->body.c_str(), r->body.length());
+    if (r->test_header) {
+        ad2_http_set_header(client, "X-Test", "1");
+    }
+}
+
+static bool test_done(esp_err_t err, esp_http_client_handle_t client, esp_http_client_config_t *config)
+{
+    test_req_t *r = (test_req_t *)config->user_data;
+    // parked in the spool. Not finished.
+    if (err != ESP_ERR_NOT_FINISHED) {
+        std::lock_guard<std::mutex> lock(g_results_mutex);
+        g_results.push_back({r->body, client ? esp_http_client_get_status_code(client) : -1, now_ms()});
+    }
+    delete r;
+    return true;
+}
+
+static test_req_t *make_req(const std::string &url, const std::string &body, bool test_header = false)
+{
+    test_req_t *r = new test_req_t();
+    r->url = url;
+    r->body = body;
+    r->test_header = test_header;
+    r->config.url = r->url.c_str();
+    r->config.method = HTTP_METHOD_POST;
+    r->config.user_data = r;
+    return r;
+}
+
+static void add_req(const std::string &url, const std::string &body, bool test_header = false,
+                    const char *owner = nullptr)
+{
+    test_req_t *r = make_req(url, body, test_header);
+    if (!ad2_add_http_sendQ(&r->config, test_ready, test_done, AD2_PRIORITY_NORMAL, owner, owner ? body : "")) {
+        delete r;
+    }
+}
+
+/**
+ * @brief Spool restore. The record is the body. Sent to the server of
+ * this run.
+ */
+static esp_http_client_config_t *test_restore(const std::string &record)
+{
+    return &make_req(g_spool_server->url(), record)->config;
+}
+
+static bool wait_results(size_t count, int timeout_ms)
+{
+    for (int t = 0; t < timeout_ms; t += 10) {
+        {
+            std::lock_guard<std::mutex> lock(g_results_mutex);
+            if (g_results.size() >= count) {
+                return true;
+            }
+        }
+        sleep_ms(10);
+    }
+    return false;
+}
+
+static uint64_t last_done_ms(char prefix)
+{
+    std::lock_guard<std::mutex> lock(g_results_mutex);
+    uint64_t t = 0;
+    for (auto &r : g_results) {
+        if (r.body[0] == prefix) {
+            t = std::max(t, r.done_ms);
+        }
+    }
+    return t;
+}
+
+/**
+ * @brief Workers and per destination ordering. A slow server must not
+ * hold up a fast one, each server sees one request at a time in queue
+ * order and a retried request stays ahead of the next one.
+ */
+static void test_order()
+{
+    TestServer slow, fast, flaky;
+    slow.delay_ms = 150;
+    flaky.fail_first = 1;
+    slow.start();
+    fast.start();
+    flaky.start();
+
+    // no provider limit so only ordering is tested.
+    ad2host_set_config(SENDQ_CONFIG_SECTION, "webhook", "0 1");
+    ad2_init_http_sendQ();
+
+    for (int n = 0; n < 6; n++) {
+        add_req(slow.url(), "a" + std::to_string(n));
+        add_req(fast.url(), "b" + std::to_string(n), n == 0);
+    }
+    add_req(flaky.url(), "c0");
+    add_req(flaky.url(), "c1");
+
+    check("order all done", wait_results(14, 10000));
+    check("order slow", slow.bodies(), "a0,a1,a2,a3,a4,a5");
+    check("order fast", fast.bodies(), "b0,b1,b2,b3,b4,b5");
+    check("order retry", flaky.bodies(), "c0,c0,c1");
+    check("order one in flight slow", slow.max_inflight() == 1);
+    check("order one in flight fast", fast.max_inflight() == 1);
+    check("order fast not behind slow", last_done_ms('b') + 300 < last_done_ms('a'));
+
+    // keep-alive and header reset on the reused connection.
+    auto fr = fast.requests();
+    bool one_conn = true;
+    bool header_once = fr.size() == 6 && fr[0].has_test_header;
+    for (size_t n = 1; n < fr.size(); n++) {
+        one_conn = one_conn && fr[n].conn == fr[0].conn;
+        header_once = header_once && !fr[n].has_test_header;
+    }
+    check("pool reuse fast", one_conn);
+    check("pool header reset", header_once);
+
+    bool all_ok = true;
+    {
+        std::lock_guard<std::mutex> lock(g_results_mutex);
+        for (auto &r : g_results) {
+            all_ok = all_ok && r.status == 200;
+        }
+    }
+    check("order status", all_ok);
+
+    ad2_http_sendQ_stats_t st;
+    ad2_get_http_sendQ_stats(&st);
+    check("order workers", std::to_string(st.workers), std::to_string(CONFIG_AD2IOT_HTTP_SENDQ_WORKERS));
+    check("order delivered", std::to_string(st.delivered), "14");
+    check("order retries", std::to_string(st.retries), "1");
+    ad2_http_pool_stats_t ps;
+    ad2_get_http_pool_stats(&ps);
+    check("pool reused", ps.reused >= 10, std::to_string(ps.reused));
+    check("pool open", ps.open <= CONFIG_AD2IOT_HTTP_SENDQ_WORKERS, std::to_string(ps.open));
+}
+
+/**
+ * @brief Provider token bucket. 2/s with a burst of 4.
+ */
+static void test_rate()
+{
+    TestServer fast;
+    fast.start();
+    ad2host_set_config(SENDQ_CONFIG_SECTION, "webhook", "2 4");
+    ad2_init_http_sendQ();
+
+    uint64_t start = now_ms();
+    for (int n = 0; n < 10; n++) {
+        add_req(fast.url(), "r" + std::to_string(n));
+    }
+    check("rate all done", wait_results(10, 10000));
+    std::lock_guard<std::mutex> lock(g_results_mutex);
+    if (g_results.size() == 10) {
+        check("rate burst", g_results[3].done_ms - start < 400, std::to_string(g_results[3].done_ms - start));
+        check("rate limited", g_results[9].done_ms - start >= 2500, std::to_string(g_results[9].done_ms - start));
+    }
+    check("rate order", fast.bodies(), "r0,r1,r2,r3,r4,r5,r6,r7,r8,r9");
+    ad2_http_sendQ_stats_t st;
+    ad2_get_http_sendQ_stats(&st);
+    check("rate sent", std::to_string(st.provider_sent[AD2_HTTP_PROVIDER_WEBHOOK]), "10");
+    check("rate waits", st.provider_waits[AD2_HTTP_PROVIDER_WEBHOOK] > 0);
+}
+
+/**
+ * @brief Spool write. The network is down so nothing is sent. The
+ * queue takes what fits and the rest is parked in the spool. A record
+ * with a huge length is appended and the process ends without closing
+ * the spool like a crash.
+ */
+static void test_spool_write(const char *path)
+{
+    unlink(path);
+    ad2host_set_network(false);
+    ad2host_set_config(CFG_SECTION_MAIN, SENDQ_SPOOL_CONFIG_KEY, path);
+    ad2_init_http_sendQ();
+    ad2_register_http_sendQ_spool("test", test_restore, test_ready, test_done);
+
+    for (int n = 0; n < 25; n++) {
+        add_req("http://127.0.0.1:9/notify", "s" + std::to_string(n), false, "test");
+    }
+    ad2_http_sendQ_stats_t st;
+    ad2_get_http_sendQ_stats(&st);
+    check("spool written", std::to_string(st.spool_written), "25");
+    check("spool pending", std::to_string(st.spool_pending), "25");
+    check("spool parked", st.spool_parked > 0 && st.depth + st.spool_parked == 25,
+          std::to_string(st.depth) + " " + std::to_string(st.spool_parked));
+
+    FILE *fp = fopen(path, "a");
+    if (fp) {
+        fprintf(fp, "A 9999 1 test 999999999\nxx\n");
+        fclose(fp);
+    }
+}
+
+/**
+ * @brief Spool read after the simulated restart. Everything before the
+ * bad record is delivered in order and the spool ends empty.
+ */
+static void test_spool_read(const char *path)
+{
+    TestServer server;
+    server.start();
+    g_spool_server = &server;
+    ad2host_set_config(SENDQ_CONFIG_SECTION, "webhook", "0 1");
+    ad2host_set_config(CFG_SECTION_MAIN, SENDQ_SPOOL_CONFIG_KEY, path);
+    ad2_init_http_sendQ();
+    ad2_register_http_sendQ_spool("test", test_restore, test_ready, test_done);
+
+    check("spool all done", wait_results(25, 10000));
+    std::string want;
+    for (int n = 0; n < 25; n++) {
+        want += (n ? ",s" : "s") + std::to_string(n);
+    }
+    check("spool order", server.bodies(), want);
+    sleep_ms(200);
+    ad2_http_sendQ_stats_t st;
+    ad2_get_http_sendQ_stats(&st);
+    check("spool restored", std::to_string(st.spool_restored), "25");
+    check("spool empty", std::to_string(st.spool_pending), "0");
+}
+
+static std::mutex g_digest_mutex;
+static std::vector<std::string> g_digests;
+static uint64_t g_digest_start = 0;
+
+static void test_digest_flush(int slot, const std::string &message, int priority)
+{
+    uint64_t t = now_ms() - g_digest_start;
+    std::lock_guard<std::mutex> lock(g_digest_mutex);
+    g_digests.push_back(std::to_string(slot) + "|" + std::to_string(priority) + "|" + message +
+                        (t < 100 ? "|now" : "|window"));
+}
+
+/**
+ * @brief Notification digest. Messages merge within the window, a
+ * CRITICAL message sends the digest at once and a message that does
+ * not fit sends the digest before it.
+ */
+static void test_digest()
+{
+    ad2_init_http_sendQ();
+    g_digest_start = now_ms();
+    ad2_digest_add(test_digest_flush, 1, "one", AD2_PRIORITY_NORMAL, 300, 64);
+    ad2_digest_add(test_digest_flush, 1, "two", AD2_PRIORITY_LOW, 300, 64);
+    ad2_digest_add(test_digest_flush, 2, "other", AD2_PRIORITY_LOW, 300, 64);
+    ad2_digest_add(test_digest_flush, 1, "FIRE", AD2_PRIORITY_CRITICAL, 300, 64);
+    ad2_digest_add(test_digest_flush, 3, "aaaaaaaa", AD2_PRIORITY_NORMAL, 300, 12);
+    ad2_digest_add(test_digest_flush, 3, "bbbbbbbb", AD2_PRIORITY_NORMAL, 300, 12);
+    sleep_ms(700);
+
+    std::string got;
+    {
+        std::lock_guard<std::mutex> lock(g_digest_mutex);
+        for (auto &d : g_digests) {
+            got += "[" + d + "]";
+        }
+    }
+    check("digest", got,
+          "[1|3|one\ntwo\nFIRE|now][3|1|aaaaaaaa|now][2|0|other|window][3|1|bbbbbbbb|window]");
+    ad2_http_sendQ_stats_t st;
+    ad2_get_http_sendQ_stats(&st);
+    check("digest messages", std::to_string(st.digest_messages), "6");
+    check("digest merged", std::to_string(st.digest_merged), "2");
+}
+
+int main(int argc, char *argv[])
+{
+    std::string test = argc > 1 ? argv[1] : "";
+    const char *path = argc > 2 ? argv[2] : "ad2sendqtest.spl";
+    g_init_done = 1;
+
+    if (test == "order") {
+        test_order();
+    } else if (test == "rate") {
+        test_rate();
+    } else if (test == "spool-write") {
+        test_spool_write(path);
+    } else if (test == "spool-read") {
+        test_spool_read(path);
+    } else if (test == "digest") {
+        test_digest();
+    } else {
+        printf("Usage: ad2sendqtest (order|rate|digest|spool-write|spool-read) [spool path]\n");
+        return 2;
+    }
+
+    printf("%s: %d checks, %d failed\n", test.c_str(), g_checks, g_failed);
+    fflush(stdout);
+    // The sendQ tasks never end. Skip the static destructors.
+    _exit(g_failed ? 1 : 0);
+}
@@ -0,0 +1,115 @@
+/**
+ *  @file    ad2webhooktest.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Linux host test for the webhook templates and signature.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include <stdio.h>
+#include <string>
+
+#include "ad2_encode.h"
+#include "webhook_template.h"
+
+static int g_checks = 0;
+static int g_failed = 0;
+
+/**
+ * @brief Compare a result with the expected value and report a mismatch.
+ *
+ * @param [in]name const char * test name.
+ * @param [in]got const std::string & result.
+ * @param [in]want const std::string & expected result.
+ */
+static void check(const char *name, const std::string &got, const std::string &want)
+{
+    g_checks++;
+    if (got != want) {
+        g_failed++;
+        printf("FAIL %s\n  got  '%s'\n  want '%s'\n", name, got.c_str(), want.c_str());
+    }
+}
+
+/**
+ * @brief Compile and render a template in one step.
+ */
+static std::string render(const std::string &src, wh_encode_t encode, int swid,
+                          const std::string &state, int priority, const std::string &message)
+{
+    return wh_render_template(wh_compile_template(src), encode, swid, state, priority, message);
+}
+
+static void test_compile()
+{
+    wh_template t = wh_compile_template("a${MESSAGE}b${SWITCH}${STATE}");
+    check("compile segments", std::to_string(t.size()), "5");
+    check("compile text", t.size() == 5 ? t[0].text + t[2].text : "", "ab");
+
+    // Unknown and unterminated macros stay literal text.
+    check("unknown macro", render("${FOO}-${SWITCH}", WH_ENCODE_RAW, 7, "", 0, ""), "${FOO}-7");
+    check("unterminated macro", render("x=${MESSAGE", WH_ENCODE_RAW, 0, "", 0, "m"), "x=${MESSAGE");
+    check("empty template", render("", WH_ENCODE_RAW, 0, "", 0, "m"), "");
+    check("no macros", render("plain", WH_ENCODE_JSON, 0, "", 0, "m"), "plain");
+}
+
+static void test_json()
+{
+    const std::string body = "{\"switch\":${SWITCH},\"state\":\"${STATE}\",\"message\":\"${MESSAGE}\"}";
+    check("json body", render(body, WH_ENCODE_JSON, 3, "OPEN", 0, "FAULT 01"),
+          "{\"switch\":3,\"state\":\"OPEN\",\"message\":\"FAULT 01\"}");
+    check("json escape", render(body, WH_ENCODE_JSON, 0, "BATCH", 0, "a\"b\\c\nd\re\tf"),
+          "{\"switch\":0,\"state\":\"BATCH\",\"message\":\"a\\\"b\\\\c\\nd\\re\\tf\"}");
+    check("json control", wh_json_escape(std::string("\x01\x1f", 2)), "\\u0001\\u001f");
+    check("json utf8", wh_json_escape("caf\xc3\xa9"), "caf\xc3\xa9");
+    // Literal template text is never escaped.
+    check("json literal", render("\"${PRIORITY}\"", WH_ENCODE_JSON, 0, "", 2, ""), "\"2\"");
+}
+
+static void test_url()
+{
+    const std::string url = "https://example.com/hook?sw=${SWITCH}&msg=${MESSAGE}";
+    check("url encode", render(url, WH_ENCODE_URL, 12, "OPEN", 0, "a b&c=d/e"),
+          "https://example.com/hook?sw=12&msg=a+b%26c%3Dd%2Fe");
+    check("url utf8", ad2_urlencode("\xc3\xa9"), "%C3%A9");
+    check("url raw", render(url, WH_ENCODE_RAW, 1, "", 0, "a b"), "https://example.com/hook?sw=1&msg=a b");
+}
+
+static void test_hmac()
+{
+    // RFC 4231 4.2 and 4.3.
+    check("hmac rfc4231 1", ad2_hmac_sha256_hex(std::string(20, '\x0b'), "Hi There"),
+          "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7");
+    check("hmac rfc4231 2", ad2_hmac_sha256_hex("Jefe", "what do ya want for nothing?"),
+          "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+    // RFC 4231 4.7 key longer than the block size.
+    check("hmac rfc4231 6", ad2_hmac_sha256_hex(std::string(131, '\xaa'),
+          "Test Using Larger Than Block-Size Key - Hash Key First"),
+          "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54");
+    check("hmac empty", ad2_hmac_sha256_hex("", ""),
+          "b613679a0814d9ec772f95d778c35fc5ff1697c493715653c6c712144292c5ad");
+}
+
+int main(int argc, char *argv[])
+{
+    test_compile();
+    test_json();
+    test_url();
+    test_hmac();
+    printf("%d checks %d failed\n", g_checks, g_failed);
+    return g_failed ? 1 : 0;
+}
@@ -185,6 +185,10 @@ static void _cli_cmd_part_event(const char *string)
  *                          [TX PIN:RX PIN]
  *     AD2IOT # ad2source s 192.168.1.2:10000
  *                          [HOST:PORT]
+ *     AD2IOT # ad2source f /sdcard/ad2capture.log loop
+ *                          [PATH] [loop]
+ *     AD2IOT # ad2source r /sdcard/ad2capture.ad2 10 loop
+ *                          [PATH] [speed|max] [loop]
  */
 static void _cli_cmd_ad2source_event(const char *string)
 {
@@ -202,13 +206,15 @@ static void _cli_cmd_ad2source_event(const char *string)
             switch (mode[0]) {
             case 'S':
             case 'C':
+            case 'F':
+            case 'R':
                 ad2_copy_nth_arg(arg, string, 2, true);
                 modestring = mode + " " + arg;
                 ad2_set_config_key_string(AD2MAIN_CONFIG_SECTION, AD2MODE_CONFIG_KEY, modestring.c_str());
                 ad2_printf_host(false, "Success setting value. Restart required to take effect.\r\n");
                 break;
             default:
-                ad2_printf_host(false, "Invalid mode selected must be [S]ocket or [C]OM\r\n");
+                ad2_printf_host(false, "Invalid mode selected must be [S]ocket, [C]OM, [F]ile or [R]eplay\r\n");
             }
         } else {
             ad2_printf_host(false, "Missing <arg>\r\n");
@@ -221,6 +227,172 @@ static void _cli_cmd_ad2source_event(const char *string)
     ad2_get_config_key_string(AD2MAIN_CONFIG_SECTION, AD2MODE_CONFIG_KEY, modestring);
     ad2_printf_host(false, "Current " AD2MODE_CONFIG_KEY " config string '%s'\r\n", modestring.c_str());
 
+    // show the active transport and counters.
+    if (g_ad2_transport) {
+        ad2_transport_stats_t st = g_ad2_transport->getStats();
+        ad2_printf_host(false, "Active transport '%s' %s opens(%u/%u) rx(%llu bytes %u reads %u errors) tx(%llu bytes %u writes %u errors)\r\n",
+                        g_ad2_transport->name(), g_ad2_transport->isOpen() ? "open" : "closed",
+                        st.opens, st.open_errors,
+                        st.rx_bytes, st.rx_reads, st.rx_errors,
+                        st.tx_bytes, st.tx_writes, st.tx_errors);
+    }
+    ad2_cmdQ_stats_t qs;
+    ad2_get_cmdQ_stats(&qs);
+    ad2_printf_host(false, "Command queue depth(%u max %u) queued(%u) sent(%u) coalesced(%u) dropped(%u) write errors(%u) acked(%u) ack timeouts(%u) latency(last %ums max %ums avg %ums)\r\n",
+                    qs.depth, qs.max_depth, qs.queued, qs.sent, qs.coalesced, qs.dropped, qs.write_errors,
+                    qs.acked, qs.ack_timeouts, qs.last_latency_ms, qs.max_latency_ms,
+                    qs.latency_count ? (unsigned)(qs.total_latency_ms / qs.latency_count) : 0);
+
+}
+
+/**
+ * @brief Record the raw AD2* stream to a timestamped capture file.
+ *
+ * @param [in]string command buffer pointer.
+ *
+ * @note command: ad2capture [start <path>|stop]
+ *   examples.
+ *     AD2IOT # ad2capture start /sdcard/ad2capture.ad2
+ *     AD2IOT # ad2capture stop
+ */
+static void _cli_cmd_ad2capture_event(const char *string)
+{
+    std::string action;
+    std::string path;
+
+    if (ad2_copy_nth_arg(action, string, 1) >= 0) {
+        ad2_lcase(action);
+        if (action.compare("start") == 0) {
+            if (ad2_copy_nth_arg(path, string, 2) >= 0) {
+                if (g_ad2_capture.start(path)) {
+                    ad2_printf_host(false, "Recording AD2* stream to '%s'.\r\n", path.c_str());
+                } else {
+                    ad2_printf_host(false, "Unable to create capture file '%s'.\r\n", path.c_str());
+                }
+            } else {
+                ad2_printf_host(false, "Missing <path>\r\n");
+            }
+        } else if (action.compare("stop") == 0) {
+            g_ad2_capture.stop();
+        } else {
+            ad2_printf_host(false, "Unknown action '%s'.\r\n", action.c_str());
+        }
+    }
+
+    // show the capture state.
+    ad2_capture_stats_t cs = g_ad2_capture.getStats();
+    ad2_printf_host(false, "Capture %s '%s' records(%u) bytes(%llu) file bytes(%llu) errors(%u)\r\n",
+                    g_ad2_capture.isActive() ? "recording" : "stopped", g_ad2_capture.path().c_str(),
+                    cs.records, cs.bytes, cs.file_bytes, cs.errors);
+}
+
+/**
+ * @brief Show the HTTP sendQ and connection pool status.
+ *
+ * @param [in]string command buffer pointer.
+ *
+ * @note command: sendq [spool [<path>|-]] [rate <provider> [<rate> <burst>|-]]
+ *   examples.
+ *     AD2IOT # sendq spool /sdcard/sendq.spl
+ *     AD2IOT # sendq spool -
+ *     AD2IOT # sendq rate twilio 1 10
+ */
+static void _cli_cmd_sendq_event(const char *string)
+{
+    std::string action;
+    std::string path;
+
+    if (ad2_copy_nth_arg(action, string, 1) >= 0) {
+        ad2_lcase(action);
+        if (action.compare("spool") == 0) {
+            if (ad2_copy_nth_arg(path, string, 2) >= 0) {
+                if (path.compare("-") == 0) {
+                    ad2_set_config_key_string(AD2MAIN_CONFIG_SECTION, SENDQ_SPOOL_CONFIG_KEY, NULL, -1, NULL, true);
+                } else {
+                    ad2_set_config_key_string(AD2MAIN_CONFIG_SECTION, SENDQ_SPOOL_CONFIG_KEY, path.c_str());
+                }
+                ad2_printf_host(false, "Success. Restart required to take effect.\r\n");
+            }
+            ad2_get_config_key_string(AD2MAIN_CONFIG_SECTION, SENDQ_SPOOL_CONFIG_KEY, path);
+            ad2_printf_host(false, "Spool path '%s'\r\n", path.c_str());
+            return;
+        } else if (action.compare("rate") == 0) {
+            std::string provider;
+            std::string setting;
+            float rate, burst;
+            ad2_copy_nth_arg(provider, string, 2);
+            ad2_lcase(provider);
+            int n;
+            for (n = 0; n < AD2_HTTP_PROVIDER_COUNT; n++) {
+                if (provider.compare(ad2_get_http_sendQ_rate(n, "", &rate, &burst)) == 0) {
+                    break;
+                }
+            }
+            if (n == AD2_HTTP_PROVIDER_COUNT) {
+                ad2_printf_host(false, "Unknown provider '%s'. Use twilio, sendgrid, pushover or webhook.\r\n", provider.c_str());
+                return;
+            }
+            if (ad2_copy_nth_arg(setting, string, 3, true) >= 0) {
+                if (setting.compare("-") == 0) {
+                    ad2_set_config_key_string(SENDQ_CONFIG_SECTION, provider.c_str(), NULL, -1, NULL, true);
+                } else {
+                    ad2_get_http_sendQ_rate(n, setting, &rate, &burst);
+                    setting = ad2_string_printf("%g %g", rate, burst);
+                    ad2_set_config_key_string(SENDQ_CONFIG_SECTION, provider.c_str(), setting.c_str());
+                }
+                ad2_printf_host(false, "Success. Restart required to take effect.\r\n");
+            }
+            setting = "";
+            ad2_get_config_key_string(SENDQ_CONFIG_SECTION, provider.c_str(), setting);
+            ad2_get_http_sendQ_rate(n, setting, &rate, &burst);
+            ad2_printf_host(false, "Provider '%s' rate %g/s burst %g%s\r\n", provider.c_str(), rate, burst,
+                            setting.length() ? "" : " (default)");
+            return;
+        } else {
+            ad2_printf_host(false, "Unknown action '%s'.\r\n", action.c_str());
+            return;
+        }
+    }
+
+    ad2_http_sendQ_stats_t qs;
+    ad2_get_http_sendQ_stats(&qs);
+    ad2_printf_host(false, "HTTP sendQ workers(%u) busy destinations(%u) depth(%u max %u)\r\n",
+                    qs.workers, qs.busy, qs.depth, qs.max_depth);
+    static const char *priority_names[AD2_PRIORITY_COUNT] = {"LOW", "NORMAL", "HIGH", "CRITICAL"};
+    for (int p = AD2_PRIORITY_COUNT - 1; p >= 0; p--) {
+        ad2_printf_host(false, "  %-8s queued(%u) dropped(%u) evicted(%u)\r\n",
+                        priority_names[p], qs.queued[p], qs.dropped[p], qs.evicted[p]);
+    }
+    for (int n = 0; n < AD2_HTTP_PROVIDER_COUNT; n++) {
+        std::string setting;
+        float rate, burst;
+        const char *provider = ad2_get_http_sendQ_rate(n, "", &rate, &burst);
+        ad2_get_config_key_string(SENDQ_CONFIG_SECTION, provider, setting);
+        ad2_get_http_sendQ_rate(n, setting, &rate, &burst);
+        ad2_printf_host(false, "  %-8s rate(%g/s burst %g) sent(%u) rate limited(%u)\r\n",
+                        provider, rate, burst, qs.provider_sent[n], qs.provider_waits[n]);
+    }
+    ad2_printf_host(false, "HTTP delivered(%u) failed(%u) retries(%u) held destinations(%u) latency(p50 %ums p90 %ums p99 %ums max %ums)\r\n",
+                    qs.delivered, qs.failed, qs.retries, qs.held,
+                    qs.latency_p50_ms, qs.latency_p90_ms, qs.latency_p99_ms, qs.latency_max_ms);
+    ad2_printf_host(false, "Notification batching messages(%u) merged(%u)\r\n",
+                    qs.digest_messages, qs.digest_merged);
+    std::string spool = ad2_get_http_sendQ_spool_path();
+    if (spool.length()) {
+        ad2_printf_host(false, "HTTP spool '%s' pending(%u) parked(%u) written(%u) restored(%u) orphaned(%u) errors(%u)\r\n",
+                        spool.c_str(), qs.spool_pending, qs.spool_parked, qs.spool_written,
+                        qs.spool_restored, qs.spool_orphaned, qs.spool_errors);
+    }
+
+    ad2_http_pool_stats_t ps;
+    ad2_get_http_pool_stats(&ps);
+    uint32_t reused_avg = ps.reused ? (uint32_t)(ps.total_reused_latency_ms / ps.reused) : 0;
+    uint32_t created = ps.requests - ps.reused;
+    uint32_t new_avg = created ? (uint32_t)(ps.total_new_latency_ms / created) : 0;
+    ad2_printf_host(false, "HTTP pool open(%u) created(%u) reused(%u) evicted(%u) idle closed(%u) error closed(%u)\r\n",
+                    ps.open, ps.created, ps.reused, ps.evicted, ps.closed_idle, ps.closed_error);
+    ad2_printf_host(false, "HTTP requests(%u) latency(last %ums max %ums avg new %ums avg reused %ums)\r\n",
+                    ps.requests, ps.last_latency_ms, ps.max_latency_ms, new_avg, reused_avg);
 }
 
 /**
@@ -290,36 +462,16 @@ static void _cli_cmd_ad2term_event(const char *string)
 
     while (1) {
 
-        // UART source to host
-        if (g_ad2_mode == 'C') {
-            // Read data from the UART
-            int len = uart_read_bytes((uart_port_t)g_ad2_client_handle, rx_buffer, AD2_UART_RX_BUFF_SIZE - 1, 5 / portTICK_PERIOD_MS);
-            if (len == -1) {
-                // An error happend. Sleep for a bit and try again?
-                ESP_LOGE(TAG, "Error reading for UART aborting task.");
-                break;
-            }
-            if (len>0) {
-                rx_buffer[len] = 0;
-                ad2_printf_host(false, (char*)rx_buffer);
-                fflush(stdout);
-            }
-
-            // Socket source
-        } else if (g_ad2_mode == 'S') {
-            if (hal_get_network_connected()) {
-                int len = recv(g_ad2_client_handle, rx_buffer, AD2_UART_RX_BUFF_SIZE - 1, 0);
-
-                // test if error occurred
-                if (len < 0) {
-                    if ( errno != EAGAIN && errno == EWOULDBLOCK ) {
-                        ESP_LOGE(TAG, "ser2sock client recv failed: errno %d", errno);
-                        break;
-                    }
+        // AD2* source to host
+        if (g_ad2_transport) {
+            if (g_ad2_transport->isOpen()) {
+                int len = g_ad2_transport->read(rx_buffer, AD2_UART_RX_BUFF_SIZE - 1, 5);
+                if (len == -1) {
+                    // An error happend. Sleep for a bit and try again?
+                    ESP_LOGE(TAG, "Error reading from ad2source %s aborting task.", g_ad2_transport->name());
+                    break;
                 }
-                // Data received
-                else {
-                    // Parse data from AD2* and report back to host.
+                if (len>0) {
                     rx_buffer[len] = 0; // Null-terminate whatever we received and treat like a string
                     ad2_printf_host(false, (char*)rx_buffer);
                     fflush(stdout);
@@ -328,7 +480,7 @@ static void _cli_cmd_ad2term_event(const char *string)
 
             // should not happen
         } else {
-            ESP_LOGW(TAG, "Unknown ad2source mode '%c'", g_ad2_mode);
+            ESP_LOGW(TAG, "Unknown ad2source mode");
             ad2_printf_host(false, "AD2IoT operating mode configured. Configure using ad2source command.\r\n");
             break;
         }
@@ -363,7 +515,7 @@ static void _cli_cmd_ad2term_event(const char *string)
             // null terminate and send the message to the AD2*
             rx_buffer[len] = 0;
             std::string temp = (char *)rx_buffer;
-            ad2_send(temp);
+            ad2_send(temp, true);
         }
 
         vTaskDelay(10 / portTICK_PERIOD_MS);
@@ -524,7 +676,10 @@ static void _cli_cmd_switch_event(const char *command_string)
             AD2SWITCH_SK_FILTER " "  // 4
             AD2SWITCH_SK_OPEN " "
             AD2SWITCH_SK_CLOSE " "
-            AD2SWITCH_SK_TROUBLE);
+            AD2SWITCH_SK_TROUBLE " "
+            AD2SWITCH_SK_PRIORITY " " // 8
+            AD2SWITCH_SK_HOLDTIME " " // 9
+            AD2SWITCH_SK_MAXRATE);    // 10
 
         ad2_printf_host(false, "## switch %i global configuration.\r\n[%s]\r\n", sId, key.c_str());
         sk_index = 0;
@@ -569,6 +724,17 @@ static void _cli_cmd_switch_event(const char *command_string)
                     ad2_printf_host(false, "# %s [N] = \r\n", sk.c_str());
                 }
                 break;
+            case 8: // priority
+            case 9: // holdtime
+            case 10: // maxrate
+                itmp = -1;
+                ad2_get_config_key_int(key.c_str(), sk.c_str(), &itmp);
+                if (itmp > -1) {
+                    ad2_printf_host(false, "%s = %i\r\n", sk.c_str(), itmp);
+                } else {
+                    ad2_printf_host(false, "# %s = \r\n", sk.c_str());
+                }
+                break;
             }
         }
         // dump finished, all done.
@@ -583,7 +749,10 @@ static void _cli_cmd_switch_event(const char *command_string)
                          AD2SWITCH_SK_FILTER " "
                          AD2SWITCH_SK_OPEN " "
                          AD2SWITCH_SK_CLOSE " "
-                         AD2SWITCH_SK_TROUBLE);
+                         AD2SWITCH_SK_TROUBLE " "
+                         AD2SWITCH_SK_PRIORITY " "
+                         AD2SWITCH_SK_HOLDTIME " "
+                         AD2SWITCH_SK_MAXRATE);
 
     sk_index = 0;
     bool command_found = false;
@@ -602,6 +771,9 @@ static void _cli_cmd_switch_event(const char *command_string)
                 ad2_set_config_key_string(key.c_str(), AD2SWITCH_SK_OPEN, NULL, -1, NULL, true);
                 ad2_set_config_key_string(key.c_str(), AD2SWITCH_SK_CLOSE, NULL, -1, NULL, true);
                 ad2_set_config_key_string(key.c_str(), AD2SWITCH_SK_TROUBLE, NULL, -1, NULL, true);
+                ad2_set_config_key_int(key.c_str(), AD2SWITCH_SK_PRIORITY, 0, -1, NULL, true);
+                ad2_set_config_key_int(key.c_str(), AD2SWITCH_SK_HOLDTIME, 0, -1, NULL, true);
+                ad2_set_config_key_int(key.c_str(), AD2SWITCH_SK_MAXRATE, 0, -1, NULL, true);
                 break;
             case 3: // default
                 // TODO: validate
@@ -638,6 +810,25 @@ static void _cli_cmd_switch_event(const char *command_string)
                 ad2_copy_nth_arg(arg, command_string, 4, true);
                 ad2_set_config_key_string(key.c_str(), sk.c_str(), arg.c_str(), itmp);
                 break;
+            case 10: // priority
+                ad2_copy_nth_arg(arg, command_string, 3, true);
+                itmp = std::atoi(arg.c_str());
+                if (itmp < AD2_PRIORITY_LOW || itmp > AD2_PRIORITY_CRITICAL) {
+                    ad2_printf_host(false, "Invalid priority '%s' must be 0-3.\r\n", arg.c_str());
+                    break;
+                }
+                ad2_set_config_key_int(key.c_str(), AD2SWITCH_SK_PRIORITY, itmp);
+                break;
+            case 11: // holdtime
+            case 12: // maxrate
+                ad2_copy_nth_arg(arg, command_string, 3, true);
+                itmp = std::atoi(arg.c_str());
+                if (itmp < 0) {
+                    ad2_printf_host(false, "Invalid %s '%s' must be 0 or more.\r\n", sk.c_str(), arg.c_str());
+                    break;
+                }
+                ad2_set_config_key_int(key.c_str(), sk.c_str(), itmp);
+                break;
             }
             // all done.
             break;
@@ -702,6 +893,14 @@ static struct cli_command cmd_list[] = {
         "    open IDX REGEX          OPEN event REGEX filter for IDX 1-8\r\n"
         "    close IDX REGEX         CLOSE event REGEX filter for IDX 1-8\r\n"
         "    trouble IDX REGEX       TROUBLE event REGEX filter for IDX 1-8\r\n"
+        "    priority LEVEL          Notification delivery priority LEVEL\r\n"
+        "                            [0]LOW [1]NORMAL(default) [2]HIGH [3]CRITICAL\r\n"
+        "                            CRITICAL is for life safety. It is sent first\r\n"
+        "                            and has reserved sendQ space\r\n"
+        "    holdtime TIME           Minimum TIME in ms between notifications 0 to disable\r\n"
+        "    maxrate COUNT           Maximum COUNT notifications per minute 0 to disable\r\n"
+        "                            Changes inside these limits are suppressed and\r\n"
+        "                            sent as one summary with the last state\r\n"
         "Options:\r\n"
         "    swid                    ad2iot virtual switch ID 1-255\r\n"
         "    IDX                     REGEX index 1-8 for multiple tests\r\n"
@@ -780,17 +979,65 @@ static struct cli_command cmd_list[] = {
         "    Manage AlarmDecoder protocol source\r\n"
         "\r\n"
         "Options:\r\n"
-        "    mode                    Mode [S]ocket or [C]om port\r\n"
+        "    mode                    Mode [S]ocket, [C]om port, [F]ile replay or\r\n"
+        "                            [R]eplay timed capture\r\n"
         "    arg                     arg string\r\n"
         "                              for COM use <TXPIN:RXPIN>\r\n"
         "                              for SOCKET use <HOST:PORT>\r\n"
+        "                              for FILE use <PATH> [loop]\r\n"
+        "                              for REPLAY use <PATH> [speed|max] [loop]\r\n"
         "Examples:\r\n"
         "    Set source to ser2sock client at address and port.\r\n"
         "      ```ad2source SOCK 192.168.1.2:10000```\r\n"
         "    Set source to local attached uart with TX on GPIO 4 and RX on GPIO 36.\r\n"
         "      ```ad2source COM 4:36```\r\n"
+        "    Replay a raw AD2* capture from the uSD card in a loop.\r\n"
+        "      ```ad2source FILE /sdcard/ad2capture.log loop```\r\n"
+        "    Replay an ad2capture recording at 10 times the recorded speed.\r\n"
+        "      ```ad2source REPLAY /sdcard/ad2capture.ad2 10```\r\n"
         , _cli_cmd_ad2source_event
     },
+    {
+        (char*)AD2_CMD_CAPTURE,(char*)
+        "Usage: ad2capture [start <path>|stop]"
+        "\r\n"
+        "    Record the raw AD2* stream with microsecond timestamps\r\n"
+        "\r\n"
+        "    Replay a recording with ```ad2source REPLAY <path>```.\r\n"
+        "    With no arguments show the capture state.\r\n"
+        "\r\n"
+        "Options:\r\n"
+        "    start <path>            Start recording to a new file\r\n"
+        "    stop                    Stop recording\r\n"
+        "Examples:\r\n"
+        "    Record to the uSD card.\r\n"
+        "      ```ad2capture start /sdcard/ad2capture.ad2```\r\n"
+        , _cli_cmd_ad2capture_event
+    },
+    {
+        (char*)AD2_CMD_SENDQ,(char*)
+        "Usage: sendq [spool [<path>|-]] [rate <provider> [<rate> <burst>|-]]"
+        "\r\n"
+        "    Show the HTTP notification sendQ and connection pool status\r\n"
+        "\r\n"
+        "    Failed requests are retried with an increasing delay.\r\n"
+        "    With a spool set notifications are saved until delivered\r\n"
+        "    and sent after a restart.\r\n"
+        "    Each provider has its own rate limit. Up to burst requests\r\n"
+        "    go out right away then rate per second.\r\n"
+        "\r\n"
+        "Options:\r\n"
+        "    spool [<path>|-]        Set or get the spool file path. Use - to disable\r\n"
+        "    rate <provider>         twilio, sendgrid, pushover or webhook\r\n"
+        "      [<rate> <burst>|-]    Set or get requests per second and bucket size\r\n"
+        "                            Rate 0 is no limit. Use - for the default\r\n"
+        "Examples:\r\n"
+        "    Spool notifications to the uSD card.\r\n"
+        "      ```sendq spool /sdcard/sendq.spl```\r\n"
+        "    Allow bursts of 10 Twilio requests then 1 per second.\r\n"
+        "      ```sendq rate twilio 1 10```\r\n"
+        , _cli_cmd_sendq_event
+    },
     {
         (char*)AD2_CMD_CONFIG,(char*)
         "Usage: ad2config [<configString>]"
@@ -33,6 +33,8 @@
 #define AD2_CMD_SOURCE   "ad2source"
 #define AD2_CMD_CONFIG   "ad2config"
 #define AD2_CMD_TERM     "ad2term"
+#define AD2_CMD_CAPTURE  "ad2capture"
+#define AD2_CMD_SENDQ    "sendq"
 #define AD2_CMD_LOGMODE  "logmode"
 #define AD2_CMD_FACTORY  "factory-reset"
 #define AD2_CMD_TOP      "top"
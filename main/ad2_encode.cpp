@@ -0,0 +1,106 @@
+/**
+ *  @file    ad2_encode.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief URL encoding and HMAC signing helpers. No ESP-IDF
+ *  dependencies so they also build on the host.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include <ctype.h>
+
+#if defined(IDF_VER)
+#include "mbedtls/md.h"
+#else
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#endif
+
+#include "ad2_encode.h"
+
+/**
+ * @brief HMAC-SHA256 of data as a lower case hex string.
+ *
+ * @arg [in]key std::string & secret key.
+ * @arg [in]data std::string & data to sign.
+ *
+ * @return std::string 64 hex characters or empty on error.
+ *
+ */
+std::string ad2_hmac_sha256_hex(const std::string &key, const std::string &data)
+{
+    unsigned char mac[32];
+#if defined(IDF_VER)
+    const mbedtls_md_info_t *info = mbedtls_md_info_from_type(MBEDTLS_MD_SHA256);
+    if (mbedtls_md_hmac(info, (const unsigned char *)key.c_str(), key.length(),
+                        (const unsigned char *)data.c_str(), data.length(), mac) != 0) {
+        return "";
+    }
+#else
+    unsigned int len = sizeof(mac);
+    if (!HMAC(EVP_sha256(), key.c_str(), key.length(),
+              (const unsigned char *)data.c_str(), data.length(), mac, &len)) {
+        return "";
+    }
+#endif
+
+    static const char hex[] = "0123456789abcdef";
+    std::string out;
+    for (int i = 0; i < (int)sizeof(mac); i++) {
+        out += hex[mac[i] >> 4];
+        out += hex[mac[i] & 0xf];
+    }
+    return out;
+}
+
+/**
+ * @brief url encode a string making it safe for http protocols.
+ *
+ * @arg [in]str std::string to url encode.
+ *
+ * @return std::string url encoded string
+ *
+ */
+std::string ad2_urlencode(const std::string str)
+{
+    std::string encoded = "";
+    char c;
+    char code0;
+    char code1;
+    for (size_t i = 0; i < str.length(); i++) {
+        c = str[i];
+        if (c == ' ') {
+            encoded += '+';
+        } else if (isalnum(c)) {
+            encoded += c;
+        } else {
+            code1 = (c & 0xf) + '0';
+            if ((c & 0xf) > 9) {
+                code1 = (c & 0xf) - 10 + 'A';
+            }
+            c = (c >> 4) & 0xf;
+            code0 = c + '0';
+            if (c > 9) {
+                code0 = c - 10 + 'A';
+            }
+            encoded += '%';
+            encoded += code0;
+            encoded += code1;
+        }
+    }
+    return encoded;
+}
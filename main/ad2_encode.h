@@ -0,0 +1,32 @@
+/**
+ *  @file    ad2_encode.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief URL encoding and HMAC signing helpers. No ESP-IDF
+ *  dependencies so they also build on the host.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef _AD2_ENCODE_H
+#define _AD2_ENCODE_H
+
+#include <string>
+
+std::string ad2_urlencode(const std::string str);
+std::string ad2_hmac_sha256_hex(const std::string& key, const std::string& data);
+
+#endif /* _AD2_ENCODE_H */
@@ -0,0 +1,1378 @@
+/**
+ *  @file    ad2_sendq.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief HTTP request send queue shared by the notification components.
+ *  Worker tasks, keep-alive connection pool, retries, durable spool,
+ *  provider rate limits and the notification digest.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <deque>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#if defined(IDF_VER)
+// FreeRTOS includes
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+// esp includes
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_chip_info.h"
+
+// AlarmDecoder std includes
+#include "alarmdecoder_main.h"
+#else
+// POSIX host build. contrib/ad2host maps FreeRTOS, esp_http_client
+// and the ad2 utilities used here onto threads and sockets.
+#include "ad2host_idf.h"
+#endif
+
+#include "ad2_sendq.h"
+
+static const char *TAG = "AD2SENDQ";
+
+#define HTTP_SEND_QUEUE_SIZE 20  // More? Less?
+#define HTTP_SEND_QUEUE_RESERVED 5 // slots only CRITICAL requests can use.
+#define HTTP_POOL_MAX_CONNECTIONS CONFIG_AD2IOT_HTTP_SENDQ_WORKERS // One per worker. Each TLS session holds ~40k of heap.
+#define HTTP_POOL_IDLE_TIMEOUT 30000    // ms an unused connection is kept open.
+#define HTTP_CLIENT_TIMEOUT 5000        // ms request timeout when the config leaves it 0.
+#define HTTP_SEND_MAX_RETRIES 6         // attempts after the first before giving up.
+#define HTTP_SEND_RETRY_BASE 2000       // ms backoff before the first retry. Doubles each attempt.
+#define HTTP_SEND_RETRY_MAX 300000      // ms backoff cap.
+#define HTTP_SEND_LATENCY_SAMPLES 64    // completed requests kept for latency percentiles.
+#define HTTP_SPOOL_MAX_RECORDS 100      // spooled requests waiting for delivery.
+#define HTTP_SPOOL_COMPACT_SIZE 32768   // rewrite the spool with only pending records past this size.
+#define HTTP_SPOOL_MAX_RECORD 16384     // largest owner record saved or loaded.
+#define HTTP_SEND_IDLE_WAIT 1000        // ms max worker wait for new work.
+
+typedef struct sendQ_event_data {
+    esp_http_client_config_t *client_config;
+    ad2_http_sendQ_ready_cb_t ready;
+    ad2_http_sendQ_done_cb_t done;
+    std::string key;    // destination scheme://host:port. Ordering key.
+    int priority;
+    uint64_t queued_us; // time added for delivery latency.
+    int attempts;       // failed attempts so far.
+    uint32_t spool_id;  // spool record or 0 if not spooled.
+    int provider;       // ad2_http_provider_t rate limit bucket.
+    bool throttled;     // waited for a provider token.
+} sendQ_event_data_t;
+
+/**
+ * @brief Per provider token bucket. Each request takes a token. Tokens
+ * refill at rate per second up to burst so a quiet provider can send a
+ * burst right away. Rate 0 is no limit.
+ */
+typedef struct http_sendQ_bucket {
+    float rate;
+    float burst;
+    float tokens;
+    uint64_t last_us;
+} http_sendQ_bucket_t;
+
+// [sendq] ini key and default 'rate burst' by provider.
+static const char *_http_provider_names[AD2_HTTP_PROVIDER_COUNT] = {"twilio", "sendgrid", "pushover", "webhook"};
+static const char *_http_provider_defaults[AD2_HTTP_PROVIDER_COUNT] = {"1 5", "10 10", "2 5", "5 10"};
+static http_sendQ_bucket_t _http_sendQ_buckets[AD2_HTTP_PROVIDER_COUNT];
+
+// Pending requests by priority in arrival order and destinations with a request in flight.
+static std::deque<sendQ_event_data_t> _http_sendQ[AD2_PRIORITY_COUNT];
+static size_t _http_sendQ_depth = 0;
+static std::vector<std::string> _http_sendQ_busy;
+// Destinations waiting out a retry backoff. Uptime us they can be tried again.
+static std::map<std::string, uint64_t> _http_sendQ_hold;
+static SemaphoreHandle_t _http_sendQ_mutex = nullptr;
+static SemaphoreHandle_t _http_sendQ_work = nullptr;
+static ad2_http_sendQ_stats_t _http_sendQ_stats = {};
+static uint32_t _http_sendQ_latency[HTTP_SEND_LATENCY_SAMPLES];
+static uint32_t _http_sendQ_latency_count = 0;
+
+/**
+ * @brief HTTP sendQ spool. Optional append only file on the uSD card or
+ * spiffs that keeps requests until delivered so they survive a restart.
+ *
+ * Text records.
+ *   A <id> <priority> <owner> <length>\n<record bytes>\n  request added.
+ *   D <id>\n                                          request finished.
+ *
+ * The owner component rebuilds the request from its record.
+ */
+typedef struct http_spool_rec {
+    uint32_t id;
+    int priority;
+    std::string owner;
+    std::string record;
+} http_spool_rec_t;
+
+typedef struct http_spool_owner {
+    std::string owner;
+    ad2_http_sendQ_restore_cb_t restore;
+    ad2_http_sendQ_ready_cb_t ready;
+    ad2_http_sendQ_done_cb_t done;
+} http_spool_owner_t;
+
+static std::string _http_spool_path;
+static FILE *_http_spool_fp = nullptr;
+// Guards the spool file handle for fsync() outside the sendQ mutex.
+static SemaphoreHandle_t _http_spool_io_mutex = nullptr;
+static size_t _http_spool_size = 0;
+static uint32_t _http_spool_next_id = 1;
+// Spooled and not yet delivered by id.
+static std::map<uint32_t, http_spool_rec_t> _http_spool_pending;
+// Pending records not in the sendQ. Oldest first.
+static std::deque<uint32_t> _http_spool_parked;
+static std::vector<http_spool_owner_t> _http_spool_owners;
+
+/**
+ * @brief HTTP keep-alive connection pool entry.
+ * One esp_http_client per scheme://host:port reused across requests
+ * from all components.
+ */
+typedef struct http_pool_conn {
+    std::string key;                        // scheme://host:port and fixed client settings.
+    esp_http_client_handle_t client;
+    std::vector<std::string> headers;       // headers set with ad2_http_set_header().
+    esp_http_client_config_t *config;       // request using the connection.
+    uint64_t last_used_us;
+    bool in_use;
+} http_pool_conn_t;
+
+static std::vector<http_pool_conn_t *> _http_pool;
+static SemaphoreHandle_t _http_pool_mutex = nullptr;
+static ad2_http_pool_stats_t _http_pool_stats = {};
+
+/**
+ * @brief Build the pool key scheme://host:port from a url.
+ *
+ * @param [in]url const char *
+ *
+ * @return std::string key or empty if the url is not valid.
+ */
+static std::string _http_pool_key(const char *url)
+{
+    if (!url) {
+        return "";
+    }
+    std::string u = url;
+    size_t pos = u.find("://");
+    if (pos == std::string::npos) {
+        return "";
+    }
+    std::string scheme = u.substr(0, pos);
+    ad2_lcase(scheme);
+    std::string hostport = u.substr(pos + 3);
+    hostport = hostport.substr(0, hostport.find_first_of("/?#"));
+    // drop any user:pass@
+    size_t at = hostport.rfind('@');
+    if (at != std::string::npos) {
+        hostport = hostport.substr(at + 1);
+    }
+    ad2_lcase(hostport);
+    // add the default port. Skip IPv6 literal colons.
+    size_t colon = hostport.rfind(':');
+    size_t brace = hostport.rfind(']');
+    if (colon == std::string::npos || (brace != std::string::npos && colon < brace)) {
+        hostport += (scheme == "https") ? ":443" : ":80";
+    }
+    return scheme + "://" + hostport;
+}
+
+/**
+ * @brief Build the key a pooled connection is found by. Settings that
+ * esp_http_client can only take at init are part of the key so a
+ * connection is only reused by requests that would have created the
+ * same client.
+ *
+ * @param [in]config esp_http_client_config_t *
+ *
+ * @return std::string key or empty if the url is not valid.
+ */
+static std::string _http_pool_conn_key(const esp_http_client_config_t *config)
+{
+    std::string key = _http_pool_key(config->url);
+    if (!key.length()) {
+        return key;
+    }
+    key += ad2_string_printf("|%p|%p|%p|%p|%d|%d|%p|%d|%d|%d|%d|%d|%d|%d",
+                             config->cert_pem, config->client_cert_pem, config->client_key_pem,
+                             (void *)config->crt_bundle_attach, config->use_global_ca_store,
+                             config->skip_cert_common_name_check, config->common_name,
+                             config->max_redirection_count, config->max_authorization_retries,
+                             config->disable_auto_redirect, config->buffer_size, config->buffer_size_tx,
+                             config->transport_type, config->keep_alive_enable);
+    return key;
+}
+
+/**
+ * @brief esp_http_client event trampoline for pooled connections.
+ * The client event handler is fixed at init so route events to the
+ * handler of the request currently using the connection.
+ *
+ * @param [in]evt esp_http_client_event_t *
+ */
+static esp_err_t _http_pool_event_handler(esp_http_client_event_t *evt)
+{
+    http_pool_conn_t *conn = (http_pool_conn_t *)evt->user_data;
+    if (conn && conn->config && conn->config->event_handler) {
+        evt->user_data = conn->config->user_data;
+        return conn->config->event_handler(evt);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Close and free a pool connection.
+ *
+ * @param [in]conn http_pool_conn_t *
+ */
+static void _http_pool_destroy(http_pool_conn_t *conn)
+{
+    esp_http_client_cleanup(conn->client);
+    delete conn;
+}
+
+/**
+ * @brief Close connections idle longer than HTTP_POOL_IDLE_TIMEOUT.
+ */
+static void _http_pool_expire()
+{
+    uint64_t now = hal_uptime_us();
+    xSemaphoreTake(_http_pool_mutex, portMAX_DELAY);
+    for (auto it = _http_pool.begin(); it != _http_pool.end();) {
+        http_pool_conn_t *conn = *it;
+        if (!conn->in_use && (now - conn->last_used_us) > (HTTP_POOL_IDLE_TIMEOUT * 1000ULL)) {
+            ESP_LOGD(TAG, "http pool closing idle connection '%s'", conn->key.c_str());
+            _http_pool_destroy(conn);
+            it = _http_pool.erase(it);
+            _http_pool_stats.closed_idle++;
+        } else {
+            it++;
+        }
+    }
+    _http_pool_stats.open = _http_pool.size();
+    xSemaphoreGive(_http_pool_mutex);
+}
+
+/**
+ * @brief Get a connection for a request. Reuse an idle keep-alive
+ * connection to the same scheme://host:port or open a new one.
+ *
+ * @param [in]config esp_http_client_config_t * request config.
+ *
+ * @return http_pool_conn_t * or nullptr if none is available.
+ */
+static http_pool_conn_t *_http_pool_acquire(esp_http_client_config_t *config)
+{
+    std::string key = _http_pool_conn_key(config);
+    http_pool_conn_t *conn = nullptr;
+
+    xSemaphoreTake(_http_pool_mutex, portMAX_DELAY);
+    if (key.length()) {
+        for (auto c : _http_pool) {
+            if (!c->in_use && c->key == key) {
+                conn = c;
+                break;
+            }
+        }
+    }
+
+    if (conn) {
+        // Reset the request state left by the last user. Everything
+        // else is fixed at init and part of the key.
+        esp_http_client_set_url(conn->client, config->url);
+        esp_http_client_set_method(conn->client, config->method);
+        esp_http_client_set_post_field(conn->client, NULL, 0);
+        esp_http_client_set_timeout_ms(conn->client, config->timeout_ms ? config->timeout_ms : HTTP_CLIENT_TIMEOUT);
+        esp_http_client_set_authtype(conn->client, config->auth_type);
+        esp_http_client_set_username(conn->client, config->username);
+        esp_http_client_set_password(conn->client, config->password);
+        esp_http_client_delete_header(conn->client, "Authorization");
+        esp_http_client_delete_header(conn->client, "Content-Type");
+        for (auto &h : conn->headers) {
+            esp_http_client_delete_header(conn->client, h.c_str());
+        }
+        conn->headers.clear();
+        _http_pool_stats.reused++;
+    } else {
+        // Make room by closing the least recently used idle connection.
+        if (_http_pool.size() >= HTTP_POOL_MAX_CONNECTIONS) {
+            auto lru = _http_pool.end();
+            for (auto it = _http_pool.begin(); it != _http_pool.end(); it++) {
+                if (!(*it)->in_use && (lru == _http_pool.end() || (*it)->last_used_us < (*lru)->last_used_us)) {
+                    lru = it;
+                }
+            }
+            if (lru != _http_pool.end()) {
+                _http_pool_destroy(*lru);
+                _http_pool.erase(lru);
+                _http_pool_stats.evicted++;
+            }
+        }
+
+        // Open a new client. Events are routed by the pool trampoline.
+        conn = new http_pool_conn_t();
+        conn->key = key;
+        esp_http_client_config_t pool_config = *config;
+        pool_config.event_handler = _http_pool_event_handler;
+        pool_config.user_data = conn;
+        conn->client = esp_http_client_init(&pool_config);
+        if (!conn->client) {
+            delete conn;
+            xSemaphoreGive(_http_pool_mutex);
+            return nullptr;
+        }
+        // Only keep connections we can find again.
+        if (key.length() && _http_pool.size() < HTTP_POOL_MAX_CONNECTIONS) {
+            _http_pool.push_back(conn);
+        }
+        _http_pool_stats.created++;
+    }
+    conn->config = config;
+    conn->in_use = true;
+    _http_pool_stats.open = _http_pool.size();
+    xSemaphoreGive(_http_pool_mutex);
+
+    // Set user agent not including version info.
+    esp_chip_info_t chip_info;
+    esp_chip_info(&chip_info);
+    std::string ua = "AD2IoT-HTTP-Client/NOPE (ESP32-r" + std::to_string(chip_info.revision) + ")";
+    esp_http_client_set_header(conn->client, "User-Agent", ua.c_str());
+
+    return conn;
+}
+
+/**
+ * @brief Return a connection to the pool after a request.
+ * Failed connections and connections not in the pool are closed.
+ *
+ * @param [in]conn http_pool_conn_t *
+ * @param [in]err esp_err_t last esp_http_client_perform() result.
+ */
+static void _http_pool_release(http_pool_conn_t *conn, esp_err_t err)
+{
+    xSemaphoreTake(_http_pool_mutex, portMAX_DELAY);
+    conn->config = nullptr;
+    conn->in_use = false;
+    conn->last_used_us = hal_uptime_us();
+    auto it = std::find(_http_pool.begin(), _http_pool.end(), conn);
+    if (err != ESP_OK || it == _http_pool.end()) {
+        if (it != _http_pool.end()) {
+            _http_pool.erase(it);
+            _http_pool_stats.closed_error++;
+        }
+        _http_pool_destroy(conn);
+    }
+    _http_pool_stats.open = _http_pool.size();
+    xSemaphoreGive(_http_pool_mutex);
+}
+
+/**
+ * @brief Set a request header on a sendQ client. Use from the ready and
+ * done callbacks in place of esp_http_client_set_header() so the header
+ * is removed before the pooled connection is used by another request.
+ *
+ * @param [in]client esp_http_client_handle_t from the callback.
+ * @param [in]key const char * header name.
+ * @param [in]value const char * header value.
+ *
+ * @return esp_err_t
+ */
+esp_err_t ad2_http_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    xSemaphoreTake(_http_pool_mutex, portMAX_DELAY);
+    for (auto conn : _http_pool) {
+        if (conn->client == client) {
+            if (std::find(conn->headers.begin(), conn->headers.end(), key) == conn->headers.end()) {
+                conn->headers.push_back(key);
+            }
+            break;
+        }
+    }
+    xSemaphoreGive(_http_pool_mutex);
+    return esp_http_client_set_header(client, key, value);
+}
+
+/**
+ * @brief Get a copy of the HTTP connection pool counters.
+ *
+ * @param [out]stats ad2_http_pool_stats_t *
+ */
+void ad2_get_http_pool_stats(ad2_http_pool_stats_t *stats)
+{
+    *stats = _http_pool_stats;
+}
+
+/**
+ * @brief Take the oldest pending request whose destination is idle.
+ * Strict priority. Higher classes are always taken first. Requests to
+ * the same destination stay in order while other destinations make progress.
+ *
+ * @param [out]event_data sendQ_event_data_t &
+ *
+ * @return bool true if a request was taken.
+ */
+static bool _http_sendQ_take(sendQ_event_data_t &event_data, uint32_t &wait_ms)
+{
+    bool found = false;
+    uint64_t now = hal_uptime_us();
+    uint64_t wait_us = HTTP_SEND_IDLE_WAIT * 1000ULL;
+    xSemaphoreTake(_http_sendQ_mutex, portMAX_DELAY);
+
+    // refill the provider buckets.
+    for (auto &b : _http_sendQ_buckets) {
+        b.tokens = std::min(b.burst, b.tokens + (now - b.last_us) * b.rate / 1000000.0f);
+        b.last_us = now;
+    }
+
+    for (int p = AD2_PRIORITY_COUNT - 1; p >= 0 && !found; p--) {
+        std::deque<sendQ_event_data_t> &q = _http_sendQ[p];
+        for (auto it = q.begin(); it != q.end(); it++) {
+            // destination waiting out a retry backoff.
+            auto hold = _http_sendQ_hold.find(it->key);
+            if (hold != _http_sendQ_hold.end() && hold->second > now) {
+                wait_us = std::min(wait_us, hold->second - now);
+                continue;
+            }
+            // blocked behind a request in flight to the same destination.
+            // The worker that finishes it wakes the others.
+            if (std::find(_http_sendQ_busy.begin(), _http_sendQ_busy.end(), it->key) != _http_sendQ_busy.end()) {
+                continue;
+            }
+            // provider out of tokens. Others keep going.
+            http_sendQ_bucket_t &b = _http_sendQ_buckets[it->provider];
+            if (b.rate > 0 && b.tokens < 1.0f) {
+                wait_us = std::min(wait_us, (uint64_t)((1.0f - b.tokens) * 1000000.0f / b.rate) + 1000);
+                if (!it->throttled) {
+                    it->throttled = true;
+                    _http_sendQ_stats.provider_waits[it->provider]++;
+                }
+                continue;
+            }
+            if (b.rate > 0) {
+                b.tokens -= 1.0f;
+            }
+            _http_sendQ_stats.provider_sent[it->provider]++;
+            event_data = *it;
+            q.erase(it);
+            _http_sendQ_depth--;
+            _http_sendQ_busy.push_back(event_data.key);
+            _http_sendQ_stats.depth = _http_sendQ_depth;
+            _http_sendQ_stats.busy = _http_sendQ_busy.size();
+            found = true;
+            break;
+        }
+    }
+    xSemaphoreGive(_http_sendQ_mutex);
+    wait_ms = wait_us / 1000 + 1;
+    return found;
+}
+
+/**
+ * @brief Rate limit bucket for a destination.
+ *
+ * @param [in]key std::string & destination scheme://host:port.
+ *
+ * @return int ad2_http_provider_t
+ */
+static int _http_sendQ_provider(const std::string &key)
+{
+    if (key.find("api.twilio.com") != std::string::npos) {
+        return AD2_HTTP_PROVIDER_TWILIO;
+    }
+    if (key.find("api.sendgrid.com") != std::string::npos) {
+        return AD2_HTTP_PROVIDER_SENDGRID;
+    }
+    if (key.find("api.pushover.net") != std::string::npos) {
+        return AD2_HTTP_PROVIDER_PUSHOVER;
+    }
+    return AD2_HTTP_PROVIDER_WEBHOOK;
+}
+
+/**
+ * @brief Load the provider token bucket settings from the [sendq] section.
+ * Each key is 'RATE BURST'. Requests per second and bucket size.
+ */
+static void _http_sendQ_load_buckets()
+{
+    uint64_t now = hal_uptime_us();
+    for (int n = 0; n < AD2_HTTP_PROVIDER_COUNT; n++) {
+        std::string setting = _http_provider_defaults[n];
+        ad2_get_config_key_string(SENDQ_CONFIG_SECTION, _http_provider_names[n], setting);
+        ad2_get_http_sendQ_rate(n, setting, &_http_sendQ_buckets[n].rate, &_http_sendQ_buckets[n].burst);
+        // start full.
+        _http_sendQ_buckets[n].tokens = _http_sendQ_buckets[n].burst;
+        _http_sendQ_buckets[n].last_us = now;
+    }
+}
+
+/**
+ * @brief Mark a destination idle and wake a worker for its next request.
+ *
+ * @param [in]key std::string & destination.
+ */
+static void _http_sendQ_finish(const std::string &key)
+{
+    xSemaphoreTake(_http_sendQ_mutex, portMAX_DELAY);
+    auto it = std::find(_http_sendQ_busy.begin(), _http_sendQ_busy.end(), key);
+    if (it != _http_sendQ_busy.end()) {
+        _http_sendQ_busy.erase(it);
+    }
+    _http_sendQ_stats.busy = _http_sendQ_busy.size();
+    bool more = _http_sendQ_depth > 0;
+    xSemaphoreGive(_http_sendQ_mutex);
+    if (more) {
+        xSemaphoreGive(_http_sendQ_work);
+    }
+}
+
+/**
+ * @brief Flush the spool to the card. SD card syncs are slow so this is
+ * called after the sendQ mutex is released.
+ */
+static void _http_spool_sync()
+{
+    if (!_http_spool_io_mutex) {
+        return;
+    }
+    xSemaphoreTake(_http_spool_io_mutex, portMAX_DELAY);
+    if (_http_spool_fp) {
+        fsync(fileno(_http_spool_fp));
+    }
+    xSemaphoreGive(_http_spool_io_mutex);
+}
+
+/**
+ * @brief Append a request record to the spool. Call with the sendQ mutex
+ * held and _http_spool_sync() after it is released.
+ *
+ * @param [in]rec http_spool_rec_t &
+ *
+ * @return bool true if the record was written.
+ */
+static bool _http_spool_write_add(const http_spool_rec_t &rec)
+{
+    int len = fprintf(_http_spool_fp, "A %u %d %s %u\n", rec.id, rec.priority, rec.owner.c_str(), (unsigned)rec.record.length());
+    if (len < 0 || fwrite(rec.record.c_str(), 1, rec.record.length(), _http_spool_fp) != rec.record.length()
+            || fputc('\n', _http_spool_fp) == EOF || fflush(_http_spool_fp) != 0) {
+        _http_sendQ_stats.spool_errors++;
+        return false;
+    }
+    _http_spool_size += len + rec.record.length() + 1;
+    _http_sendQ_stats.spool_written++;
+    return true;
+}
+
+/**
+ * @brief Rewrite the spool with only the pending records. Empties the
+ * file when nothing is pending. Call with the sendQ mutex held.
+ */
+static void _http_spool_compact()
+{
+    xSemaphoreTake(_http_spool_io_mutex, portMAX_DELAY);
+    if (_http_spool_fp) {
+        fclose(_http_spool_fp);
+    }
+    _http_spool_size = 0;
+    _http_spool_fp = fopen(_http_spool_path.c_str(), "w");
+    if (!_http_spool_fp) {
+        ESP_LOGE(TAG, "sendQ spool unable to open '%s'. Spool disabled.", _http_spool_path.c_str());
+        _http_sendQ_stats.spool_errors++;
+    } else {
+        for (auto &e : _http_spool_pending) {
+            _http_spool_write_add(e.second);
+        }
+    }
+    xSemaphoreGive(_http_spool_io_mutex);
+}
+
+/**
+ * @brief Mark a spooled request finished. Call with the sendQ mutex held
+ * and _http_spool_sync() after it is released.
+ *
+ * @param [in]id uint32_t spool record id.
+ */
+static void _http_spool_finish(uint32_t id)
+{
+    _http_spool_pending.erase(id);
+    _http_sendQ_stats.spool_pending = _http_spool_pending.size();
+    if (!_http_spool_fp) {
+        return;
+    }
+    if (!_http_spool_pending.size() || _http_spool_size > HTTP_SPOOL_COMPACT_SIZE) {
+        _http_spool_compact();
+        return;
+    }
+    int len = fprintf(_http_spool_fp, "D %u\n", id);
+    if (len < 0 || fflush(_http_spool_fp) != 0) {
+        _http_sendQ_stats.spool_errors++;
+        return;
+    }
+    _http_spool_size += len;
+}
+
+/**
+ * @brief Load requests left in the spool by the last run. Every pending
+ * record is parked until its owner registers and the sendQ has room.
+ */
+static void _http_spool_load()
+{
+    FILE *fp = fopen(_http_spool_path.c_str(), "r");
+    if (fp) {
+        char line[80];
+        while (fgets(line, sizeof(line), fp)) {
+            http_spool_rec_t rec;
+            char owner[32];
+            unsigned id = 0, len = 0;
+            if (sscanf(line, "A %u %d %31s %u", &id, &rec.priority, owner, &len) == 4) {
+                // damaged header. Nothing after it can be trusted.
+                if (len > HTTP_SPOOL_MAX_RECORD) {
+                    ESP_LOGW(TAG, "sendQ spool record %u length %u too large. Rest of spool discarded.", id, len);
+                    break;
+                }
+                rec.id = id;
+                rec.owner = owner;
+                rec.record.resize(len);
+                // incomplete record from a power loss during a write.
+                if (fread(&rec.record[0], 1, len, fp) != len || fgetc(fp) != '\n') {
+                    break;
+                }
+                if (rec.priority < AD2_PRIORITY_LOW || rec.priority >= AD2_PRIORITY_COUNT) {
+                    rec.priority = AD2_PRIORITY_NORMAL;
+                }
+                _http_spool_pending[rec.id] = rec;
+            } else if (sscanf(line, "D %u", &id) == 1) {
+                _http_spool_pending.erase(id);
+            }
+            if (id >= _http_spool_next_id) {
+                _http_spool_next_id = id + 1;
+            }
+        }
+        fclose(fp);
+    }
+    for (auto &e : _http_spool_pending) {
+        _http_spool_parked.push_back(e.first);
+    }
+    _http_sendQ_stats.spool_pending = _http_spool_pending.size();
+    _http_sendQ_stats.spool_parked = _http_spool_parked.size();
+
+    // start a clean file with only the pending records.
+    _http_spool_compact();
+    _http_spool_sync();
+    if (_http_spool_fp) {
+        ad2_printf_host(true, "%s: sendQ spool '%s' has %u undelivered requests.", TAG, _http_spool_path.c_str(),
+                        (unsigned)_http_spool_pending.size());
+    }
+}
+
+/**
+ * @brief Find the registered owner of a spool record.
+ *
+ * @param [in]owner const std::string & owner name.
+ *
+ * @return const http_spool_owner_t * or nullptr if not registered.
+ *
+ * @note Call with _http_sendQ_mutex held.
+ */
+static const http_spool_owner_t *_http_spool_owner(const std::string &owner)
+{
+    for (auto &o : _http_spool_owners) {
+        if (o.owner == owner) {
+            return &o;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Test if any parked record can still be delivered. Records for
+ * an owner that never registered, compiled out or its section removed,
+ * do not count once init is done. They are dropped by _http_spool_drain().
+ *
+ * @return bool
+ *
+ * @note Call with _http_sendQ_mutex held.
+ */
+static bool _http_spool_drainable()
+{
+    if (!g_init_done) {
+        return _http_spool_parked.size() > 0;
+    }
+    for (uint32_t id : _http_spool_parked) {
+        auto rec = _http_spool_pending.find(id);
+        if (rec != _http_spool_pending.end() && _http_spool_owner(rec->second.owner)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Move parked spool records back into the sendQ while it has room.
+ * The owner rebuilds each request from its record.
+ */
+static void _http_spool_drain()
+{
+    while (1) {
+        xSemaphoreTake(_http_sendQ_mutex, portMAX_DELAY);
+        if (!_http_spool_parked.size() || _http_sendQ_depth >= HTTP_SEND_QUEUE_SIZE - HTTP_SEND_QUEUE_RESERVED) {
+            xSemaphoreGive(_http_sendQ_mutex);
+            return;
+        }
+        auto pending = _http_spool_pending.find(_http_spool_parked.front());
+        if (pending == _http_spool_pending.end()) {
+            // already finished.
+            _http_spool_parked.pop_front();
+            _http_sendQ_stats.spool_parked = _http_spool_parked.size();
+            xSemaphoreGive(_http_sendQ_mutex);
+            continue;
+        }
+        http_spool_rec_t rec = pending->second;
+        const http_spool_owner_t *owner = _http_spool_owner(rec.owner);
+        if (!owner) {
+            if (!g_init_done) {
+                // keep order. Wait for the owner to register.
+                xSemaphoreGive(_http_sendQ_mutex);
+                return;
+            }
+            // No owner after init. It will never be rebuilt so drop it.
+            ESP_LOGW(TAG, "sendQ spool record %u owner '%s' not found. Record dropped.", rec.id, rec.owner.c_str());
+            _http_spool_parked.pop_front();
+            _http_sendQ_stats.spool_parked = _http_spool_parked.size();
+            _http_sendQ_stats.spool_orphaned++;
+            _http_spool_finish(rec.id);
+            xSemaphoreGive(_http_sendQ_mutex);
+            _http_spool_sync();
+            continue;
+        }
+        http_spool_owner_t o = *owner;
+        _http_spool_parked.pop_front();
+        _http_sendQ_stats.spool_parked = _http_spool_parked.size();
+        xSemaphoreGive(_http_sendQ_mutex);
+
+        esp_http_client_config_t *config = o.restore(rec.record);
+
+        xSemaphoreTake(_http_sendQ_mutex, portMAX_DELAY);
+        if (config) {
+            sendQ_event_data_t event_data = {
+                .client_config = config,
+                .ready = o.ready,
+                .done = o.done,
+                .key = _http_pool_key(config->url),
+                .priority = rec.priority,
+                .queued_us = hal_uptime_us(),
+                .attempts = 0,
+                .spool_id = rec.id,
+                .provider = _http_sendQ_provider(_http_pool_key(config->url)),
+                .throttled = false
+            };
+            _http_sendQ[rec.priority].push_back(event_data);
+            _http_sendQ_depth++;
+            _http_sendQ_stats.depth = _http_sendQ_depth;
+            _http_sendQ_stats.spool_restored++;
+        } else {
+            // owner can no longer build it. Settings removed etc.
+            _http_spool_finish(rec.id);
+        }
+        xSemaphoreGive(_http_sendQ_mutex);
+        if (config) {
+            xSemaphoreGive(_http_sendQ_work);
+        } else {
+            _http_spool_sync();
+        }
+    }
+}
+
+/**
+ * @brief Schedule a failed request to be sent again after an exponential
+ * backoff with jitter. The request goes back to the front of its class and
+ * its destination is held so later requests to it stay in order.
+ *
+ * @param [in]event_data sendQ_event_data_t &
+ *
+ * @return bool false if the request is out of retries.
+ */
+static bool _http_sendQ_retry(sendQ_event_data_t &event_data)
+{
+    if (event_data.attempts >= HTTP_SEND_MAX_RETRIES) {
+        return false;
+    }
+    uint32_t backoff = HTTP_SEND_RETRY_BASE << event_data.attempts;
+    if (backoff > HTTP_SEND_RETRY_MAX) {
+        backoff = HTTP_SEND_RETRY_MAX;
+    }
+    // half fixed half random so many devices do not retry in step.
+    backoff = backoff / 2 + esp_random() % (backoff / 2 + 1);
+    event_data.attempts++;
+
+    xSemaphoreTake(_http_sendQ_mutex, portMAX_DELAY);
+    _http_sendQ_hold[event_data.key] = hal_uptime_us() + (backoff * 1000ULL);
+    _http_sendQ[event_data.priority].push_front(event_data);
+    _http_sendQ_depth++;
+    _http_sendQ_stats.depth = _http_sendQ_depth;
+    _http_sendQ_stats.retries++;
+    _http_sendQ_stats.held = _http_sendQ_hold.size();
+    xSemaphoreGive(_http_sendQ_mutex);
+
+    ESP_LOGW(TAG, "http sendQ '%s' failed. Retry %i of %i in %ums.", event_data.key.c_str(),
+             event_data.attempts, HTTP_SEND_MAX_RETRIES, backoff);
+    return true;
+}
+
+/**
+ * @brief Record the final result of a request. Updates the delivery
+ * counters and latency samples and removes it from the spool.
+ *
+ * @param [in]event_data sendQ_event_data_t &
+ * @param [in]delivered bool true if the server accepted or rejected it.
+ */
+static void _http_sendQ_complete(sendQ_event_data_t &event_data, bool delivered)
+{
+    uint32_t latency = (hal_uptime_us() - event_data.queued_us) / 1000;
+    xSemaphoreTake(_http_sendQ_mutex, portMAX_DELAY);
+    if (delivered) {
+        _http_sendQ_stats.delivered++;
+    } else {
+        _http_sendQ_stats.failed++;
+        ESP_LOGE(TAG, "http sendQ '%s' failed after %i retries. Request dropped.", event_data.key.c_str(), event_data.attempts);
+    }
+    _http_sendQ_hold.erase(event_data.key);
+    _http_sendQ_stats.held = _http_sendQ_hold.size();
+    _http_sendQ_latency[_http_sendQ_latency_count++ % HTTP_SEND_LATENCY_SAMPLES] = latency;
+    if (event_data.spool_id) {
+        _http_spool_finish(event_data.spool_id);
+    }
+    xSemaphoreGive(_http_sendQ_mutex);
+    if (event_data.spool_id) {
+        _http_spool_sync();
+    }
+}
+
+/**
+ * @brief HTTP sendQ worker. CONFIG_AD2IOT_HTTP_SENDQ_WORKERS of these
+ * share the queue.
+ *
+ * @param [in]pvParameters void *
+ */
+static void _http_sendQ_consumer_task(void *pvParameters)
+{
+    esp_err_t err;
+    uint32_t wait_ms = HTTP_SEND_IDLE_WAIT;
+
+    while (1) {
+        if (_http_sendQ_mutex == nullptr) {
+            break;
+        }
+        if (!g_StopMainTask && hal_get_network_connected()) {
+            sendQ_event_data_t event_data;
+            // refill from the spool.
+            _http_spool_drain();
+            // wait for new work, a destination to be freed, a retry to be
+            // due or a provider token.
+            xSemaphoreTake(_http_sendQ_work, wait_ms / portTICK_PERIOD_MS + 1);
+            if (_http_sendQ_take(event_data, wait_ms)) {
+#if defined(AD2_STACK_REPORT)
+                ESP_LOGI(TAG, "_http_sendQ_consumer_task stack free %d", uxTaskGetStackHighWaterMark(NULL));
+#endif
+                // other destinations may be waiting.
+                xSemaphoreGive(_http_sendQ_work);
+
+                uint64_t start_us = hal_uptime_us();
+
+                // Get a pooled keep-alive client for this host or a new one.
+                http_pool_conn_t *conn = _http_pool_acquire(event_data.client_config);
+                if (!conn) {
+                    ESP_LOGE(TAG, "http sendQ unable to create client for '%s'", event_data.client_config->url);
+                    if (!_http_sendQ_retry(event_data)) {
+                        event_data.done(ESP_FAIL, NULL, event_data.client_config);
+                        _http_sendQ_complete(event_data, false);
+                    }
+                    _http_sendQ_finish(event_data.key);
+                    continue;
+                }
+                bool reused = conn->last_used_us != 0;
+
+                // notify compoenet we are about to send and allow to
+                // update connection details including post data etc.
+                // Called again for each retry.
+                event_data.ready(conn->client, event_data.client_config);
+
+                // start the connection
+                err = esp_http_client_perform(conn->client);
+
+                // Network errors, server errors and throttling are retried.
+                // The component only sees the final attempt.
+                int status = esp_http_client_get_status_code(conn->client);
+                bool delivered = err == ESP_OK && status < 500 && status != 429;
+                if (!delivered && _http_sendQ_retry(event_data)) {
+                    _http_pool_release(conn, err == ESP_OK ? ESP_FAIL : err);
+                    _http_sendQ_finish(event_data.key);
+                    continue;
+                }
+
+                // Notify client the request finished and the results.
+                // If it wants to preform again on the same connection it will
+                // return false. Follow up requests are not retried.
+                // TODO: sanity checking. Put back in sendQ for others to get some time? Memory.
+                while (!event_data.done(err, conn->client, event_data.client_config) && err == ESP_OK) {
+                    err = esp_http_client_perform(conn->client);
+                }
+
+                // keep the connection for the next request to this host.
+                _http_pool_release(conn, err);
+
+                // delivery stats and spool cleanup.
+                _http_sendQ_complete(event_data, delivered);
+
+                // request latency stats.
+                uint32_t latency = (hal_uptime_us() - start_us) / 1000;
+                xSemaphoreTake(_http_pool_mutex, portMAX_DELAY);
+                _http_pool_stats.requests++;
+                _http_pool_stats.last_latency_ms = latency;
+                if (latency > _http_pool_stats.max_latency_ms) {
+                    _http_pool_stats.max_latency_ms = latency;
+                }
+                if (reused) {
+                    _http_pool_stats.total_reused_latency_ms += latency;
+                } else {
+                    _http_pool_stats.total_new_latency_ms += latency;
+                }
+                xSemaphoreGive(_http_pool_mutex);
+
+                _http_sendQ_finish(event_data.key);
+            } else {
+                // close idle connections.
+                _http_pool_expire();
+            }
+            continue;
+        }
+        // sleep for a bit then check the queue again.
+        vTaskDelay(100 / portTICK_PERIOD_MS);
+    }
+    ESP_LOGW(TAG, "http sendQ ending. HTTP request delivery halted.");
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Get a copy of the HTTP sendQ counters.
+ *
+ * @param [out]stats ad2_http_sendQ_stats_t *
+ */
+void ad2_get_http_sendQ_stats(ad2_http_sendQ_stats_t *stats)
+{
+    std::vector<uint32_t> samples;
+    xSemaphoreTake(_http_sendQ_mutex, portMAX_DELAY);
+    *stats = _http_sendQ_stats;
+    samples.assign(_http_sendQ_latency, _http_sendQ_latency + std::min<uint32_t>(_http_sendQ_latency_count, HTTP_SEND_LATENCY_SAMPLES));
+    xSemaphoreGive(_http_sendQ_mutex);
+
+    // delivery latency percentiles over the recent requests.
+    if (samples.size()) {
+        std::sort(samples.begin(), samples.end());
+        stats->latency_p50_ms = samples[samples.size() * 50 / 100];
+        stats->latency_p90_ms = samples[samples.size() * 90 / 100];
+        stats->latency_p99_ms = samples[samples.size() * 99 / 100];
+        stats->latency_max_ms = samples.back();
+    }
+}
+
+/**
+ * @brief Get a provider name and parse its 'RATE BURST' rate limit setting.
+ *
+ * @param [in]provider int ad2_http_provider_t
+ * @param [in]setting std::string & 'RATE BURST' or empty for the default.
+ * @param [out]rate float * requests per second. 0 no limit.
+ * @param [out]burst float * bucket size. At least 1.
+ *
+ * @return const char * provider name used as the [sendq] key or NULL if not valid.
+ */
+const char *ad2_get_http_sendQ_rate(int provider, const std::string &setting, float *rate, float *burst)
+{
+    if (provider < 0 || provider >= AD2_HTTP_PROVIDER_COUNT) {
+        return NULL;
+    }
+    std::string arg;
+    std::string value = setting.length() ? setting : _http_provider_defaults[provider];
+    ad2_copy_nth_arg(arg, value.c_str(), 0);
+    *rate = std::max(0.0f, (float)atof(arg.c_str()));
+    arg = "";
+    ad2_copy_nth_arg(arg, value.c_str(), 1);
+    *burst = std::max(1.0f, (float)atof(arg.c_str()));
+    return _http_provider_names[provider];
+}
+
+/**
+ * @brief Get the sendQ spool file path.
+ *
+ * @return std::string path or empty if the spool is disabled.
+ */
+std::string ad2_get_http_sendQ_spool_path()
+{
+    return _http_spool_fp ? _http_spool_path : "";
+}
+
+/**
+ * @brief Register a component that spools its requests. Any requests
+ * it left in the spool before a restart are rebuilt with restore_cb
+ * and sent using ready_cb and done_cb.
+ *
+ * @param [in]owner const char * short name saved with each record. No spaces.
+ * @param [in]restore_cb ad2_http_sendQ_restore_cb_t: Rebuild a request from a record.
+ * @param [in]ready_cb ad2_http_sendQ_ready_cb_t: Called before esp_http_client_perform()
+ * @param [in]done_cb ad2_http_sendQ_done_cb_t: Called before esp_http_client_cleanup()
+ */
+void ad2_register_http_sendQ_spool(const char *owner, ad2_http_sendQ_restore_cb_t restore_cb, ad2_http_sendQ_ready_cb_t ready_cb, ad2_http_sendQ_done_cb_t done_cb)
+{
+    if (!_http_sendQ_mutex) {
+        return;
+    }
+    http_spool_owner_t o = {
+        .owner = owner,
+        .restore = restore_cb,
+        .ready = ready_cb,
+        .done = done_cb
+    };
+    xSemaphoreTake(_http_sendQ_mutex, portMAX_DELAY);
+    _http_spool_owners.push_back(o);
+    xSemaphoreGive(_http_sendQ_mutex);
+}
+
+/**
+ * @brief Notification digest. Messages for the same owner and slot that
+ * arrive within the window are merged into one message.
+ */
+typedef struct ad2_digest {
+    ad2_digest_flush_cb_t flush;
+    int slot;
+    std::string message;
+    int priority;
+    uint64_t due_us;
+} ad2_digest_t;
+
+static std::vector<ad2_digest_t> _ad2_digests;
+static SemaphoreHandle_t _ad2_digest_mutex = nullptr;
+static TaskHandle_t _ad2_digest_task = nullptr;
+
+/**
+ * @brief Digest task. Sends each digest when its window closes.
+ *
+ * @param [in]pvParameters void *
+ */
+static void _ad2_digest_consumer_task(void *pvParameters)
+{
+    while (1) {
+        std::vector<ad2_digest_t> ready;
+        uint64_t now = hal_uptime_us();
+        uint64_t wait_us = HTTP_SEND_IDLE_WAIT * 1000ULL;
+
+        xSemaphoreTake(_ad2_digest_mutex, portMAX_DELAY);
+        for (auto it = _ad2_digests.begin(); it != _ad2_digests.end();) {
+            if (it->due_us <= now) {
+                ready.push_back(*it);
+                it = _ad2_digests.erase(it);
+            } else {
+                wait_us = std::min(wait_us, it->due_us - now);
+                it++;
+            }
+        }
+        xSemaphoreGive(_ad2_digest_mutex);
+
+        for (auto &d : ready) {
+            d.flush(d.slot, d.message, d.priority);
+        }
+
+        // sleep until the next window closes or a new digest starts.
+        ulTaskNotifyTake(pdTRUE, (wait_us / 1000) / portTICK_PERIOD_MS + 1);
+    }
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Add a message to the digest for a notification slot.
+ *
+ * @details The first message starts a window of window_ms. Messages added
+ * before it closes are appended on a new line and flush_cb is called once
+ * with the merged message and the highest priority. If a message would make
+ * the digest larger than max_size the digest is sent right away and the
+ * message starts a new one. A CRITICAL message is not held. It is added to
+ * any open digest for the slot and the digest is sent right away.
+ *
+ * @param [in]flush_cb ad2_digest_flush_cb_t: Called with the merged message.
+ * @param [in]slot int notification slot.
+ * @param [in]message std::string & message to add.
+ * @param [in]priority int ad2_priority_t.
+ * @param [in]window_ms int merge window.
+ * @param [in]max_size size_t max merged message size.
+ */
+void ad2_digest_add(ad2_digest_flush_cb_t flush_cb, int slot, const std::string &message, int priority, int window_ms, size_t max_size)
+{
+    if (!_ad2_digest_mutex) {
+        flush_cb(slot, message, priority);
+        return;
+    }
+
+    std::string msg = message.substr(0, max_size);
+    ad2_digest_t full = {};
+    bool send_full = false;
+    ad2_digest_t now = {};
+    bool send_now = false;
+    bool merged = false;
+
+    xSemaphoreTake(_ad2_digest_mutex, portMAX_DELAY);
+    auto it = std::find_if(_ad2_digests.begin(), _ad2_digests.end(), [&](const ad2_digest_t &d) {
+        return d.flush == flush_cb && d.slot == slot;
+    });
+    if (it != _ad2_digests.end() && it->message.length() + 1 + msg.length() > max_size) {
+        // no room. Send what we have and start over.
+        full = *it;
+        send_full = true;
+        _ad2_digests.erase(it);
+        it = _ad2_digests.end();
+    }
+    if (it == _ad2_digests.end()) {
+        ad2_digest_t d = {
+            .flush = flush_cb,
+            .slot = slot,
+            .message = msg,
+            .priority = priority,
+            .due_us = hal_uptime_us() + (window_ms * 1000ULL)
+        };
+        _ad2_digests.push_back(d);
+        it = _ad2_digests.end() - 1;
+    } else {
+        it->message += "\n" + msg;
+        it->priority = std::max(it->priority, priority);
+        merged = true;
+    }
+    if (priority >= AD2_PRIORITY_CRITICAL) {
+        // life safety. Do not wait for the window.
+        now = *it;
+        send_now = true;
+        _ad2_digests.erase(it);
+    }
+    xSemaphoreGive(_ad2_digest_mutex);
+
+    // stats belong to the sendQ.
+    xSemaphoreTake(_http_sendQ_mutex, portMAX_DELAY);
+    if (merged) {
+        _http_sendQ_stats.digest_merged++;
+    }
+    _http_sendQ_stats.digest_messages++;
+    xSemaphoreGive(_http_sendQ_mutex);
+
+    if (send_full) {
+        full.flush(full.slot, full.message, full.priority);
+    }
+    if (send_now) {
+        now.flush(now.slot, now.message, now.priority);
+    } else {
+        xTaskNotifyGive(_ad2_digest_task);
+    }
+}
+
+/**
+ * @brief Initialize and start the HTTP request send queue.
+ * Allows for components to POST requests to server ASYNC. Requests to a server
+ * are serialized with each other while a pool of workers lets other servers make
+ * progress. This limits memory use at the cost of a potential slower delivery time.
+ *
+ * @note Failed requests are retried with an exponential backoff. The
+ * destination is held during the backoff so its requests stay in order
+ * while other destinations are not blocked.
+ *
+ * @note With a spool path set in SENDQ_SPOOL_CONFIG_KEY requests from
+ * components that spool are saved until delivered and sent again after
+ * a restart.
+ */
+void ad2_init_http_sendQ()
+{
+    // Init the queue.
+    if (_http_sendQ_mutex == nullptr) {
+        _http_sendQ_mutex = xSemaphoreCreateMutex();
+        _http_sendQ_work = xSemaphoreCreateCounting(HTTP_SEND_QUEUE_SIZE * 2, 0);
+    }
+    if (_http_pool_mutex == nullptr) {
+        _http_pool_mutex = xSemaphoreCreateMutex();
+    }
+    if (_http_spool_io_mutex == nullptr) {
+        _http_spool_io_mutex = xSemaphoreCreateMutex();
+    }
+    _http_sendQ_stats.workers = CONFIG_AD2IOT_HTTP_SENDQ_WORKERS;
+
+    // Provider rate limits.
+    _http_sendQ_load_buckets();
+
+    // Optional durable spool.
+    ad2_get_config_key_string(CFG_SECTION_MAIN, SENDQ_SPOOL_CONFIG_KEY, _http_spool_path);
+    if (_http_spool_path.length() && !_http_spool_fp) {
+        _http_spool_load();
+    }
+
+    // Notification digest task.
+    if (_ad2_digest_mutex == nullptr) {
+        _ad2_digest_mutex = xSemaphoreCreateMutex();
+        xTaskCreate(_ad2_digest_consumer_task, "AD2 digest", 1024 * 6, NULL, tskIDLE_PRIORITY + 1, &_ad2_digest_task);
+    }
+
+    // Start the queue worker tasks. Keep the stack as small as possible.
+    // 20210815SM: 1444 bytes stack free
+    for (int n = 0; n < CONFIG_AD2IOT_HTTP_SENDQ_WORKERS; n++) {
+        std::string name = "AD2 sendQ " + std::to_string(n);
+        xTaskCreate(_http_sendQ_consumer_task, name.c_str(), 1024 * 8, NULL, tskIDLE_PRIORITY + 1, NULL);
+    }
+}
+
+/**
+ * @brief Add a http client config to the queue
+ *
+ * @param [in]client_config esp_http_client_config_t *
+ * @param [in]ready_cb ad2_http_sendQ_ready_cb_t: Called before esp_http_client_perform()
+ * @param [in]done_cb ad2_http_sendQ_done_cb_t: Called before esp_http_client_cleanup()
+ * @param [in]priority ad2_priority_t delivery class.
+ * @param [in]spool_owner const char * owner registered with ad2_register_http_sendQ_spool() or NULL.
+ * @param [in]spool_record std::string & owner data to rebuild the request after a restart.
+ *
+ * @note Requests to the same scheme://host:port are delivered in the
+ * order they are added.
+ *
+ * @note The last HTTP_SEND_QUEUE_RESERVED slots are kept for CRITICAL
+ * requests. If the queue is full a CRITICAL request replaces the newest
+ * lowest priority request. The replaced request done_cb is called with
+ * ESP_ERR_NO_MEM and a NULL client.
+ *
+ * @note With the spool enabled a spooled request that does not fit in the
+ * queue is kept in the spool and rebuilt when there is room. Its done_cb
+ * is called right away with ESP_ERR_NOT_FINISHED and a NULL client to
+ * release it.
+ */
+bool ad2_add_http_sendQ(esp_http_client_config_t *client_config, ad2_http_sendQ_ready_cb_t ready_cb, ad2_http_sendQ_done_cb_t done_cb, int priority,
+                        const char *spool_owner, const std::string &spool_record)
+{
+    if (!_http_sendQ_mutex) {
+        ESP_LOGE(TAG, "Invalid queue handle");
+        return false;
+    }
+    if (priority < AD2_PRIORITY_LOW || priority >= AD2_PRIORITY_COUNT) {
+        priority = AD2_PRIORITY_NORMAL;
+    }
+
+    // Save queue data into a structure for storage in the sendQ
+    sendQ_event_data_t event_data = {
+        .client_config = client_config,
+        .ready = ready_cb,
+        .done = done_cb,
+        .key = _http_pool_key(client_config->url),
+        .priority = priority,
+        .queued_us = hal_uptime_us(),
+        .attempts = 0,
+        .spool_id = 0,
+        .provider = 0,
+        .throttled = false
+    };
+    event_data.provider = _http_sendQ_provider(event_data.key);
+    sendQ_event_data_t evicted = {};
+    bool have_evicted = false;
+
+    xSemaphoreTake(_http_sendQ_mutex, portMAX_DELAY);
+
+    // save it to the spool first.
+    if (_http_spool_fp && spool_owner && spool_record.length()) {
+        if (spool_record.length() > HTTP_SPOOL_MAX_RECORD) {
+            ESP_LOGW(TAG, "sendQ spool record too large. Request not saved.");
+        } else if (_http_spool_pending.size() < HTTP_SPOOL_MAX_RECORDS) {
+            http_spool_rec_t rec = {
+                .id = _http_spool_next_id++,
+                .priority = priority,
+                .owner = spool_owner,
+                .record = spool_record
+            };
+            if (_http_spool_write_add(rec)) {
+                _http_spool_pending[rec.id] = rec;
+                event_data.spool_id = rec.id;
+                _http_sendQ_stats.spool_pending = _http_spool_pending.size();
+            }
+        } else {
+            ESP_LOGW(TAG, "sendQ spool full. Request not saved.");
+        }
+    }
+
+    size_t limit = (priority == AD2_PRIORITY_CRITICAL) ? HTTP_SEND_QUEUE_SIZE : HTTP_SEND_QUEUE_SIZE - HTTP_SEND_QUEUE_RESERVED;
+    if (_http_sendQ_depth >= limit && priority == AD2_PRIORITY_CRITICAL) {
+        // make room. Remove the newest request from the lowest non empty class.
+        for (int p = AD2_PRIORITY_LOW; p < AD2_PRIORITY_CRITICAL; p++) {
+            if (_http_sendQ[p].size()) {
+                evicted = _http_sendQ[p].back();
+                _http_sendQ[p].pop_back();
+                _http_sendQ_depth--;
+                _http_sendQ_stats.evicted[p]++;
+                have_evicted = true;
+                // spooled. Deliver it later.
+                if (evicted.spool_id) {
+                    _http_spool_parked.insert(std::upper_bound(_http_spool_parked.begin(), _http_spool_parked.end(), evicted.spool_id), evicted.spool_id);
+                }
+                break;
+            }
+        }
+    }
+
+    // Keep spooled requests in order behind any already waiting in the spool.
+    if (event_data.spool_id && (_http_sendQ_depth >= limit || (priority != AD2_PRIORITY_CRITICAL && _http_spool_drainable()))) {
+        _http_spool_parked.push_back(event_data.spool_id);
+        _http_sendQ_stats.spool_parked = _http_spool_parked.size();
+        _http_sendQ_stats.queued[priority]++;
+        xSemaphoreGive(_http_sendQ_mutex);
+        _http_spool_sync();
+        done_cb(ESP_ERR_NOT_FINISHED, NULL, client_config);
+        return true;
+    }
+    _http_sendQ_stats.spool_parked = _http_spool_parked.size();
+
+    if (_http_sendQ_depth >= limit) {
+        _http_sendQ_stats.dropped[priority]++;
+        xSemaphoreGive(_http_sendQ_mutex);
+        return false;
+    }
+    _http_sendQ[priority].push_back(event_data);
+    _http_sendQ_depth++;
+    _http_sendQ_stats.queued[priority]++;
+    _http_sendQ_stats.depth = _http_sendQ_depth;
+    if (_http_sendQ_stats.depth > _http_sendQ_stats.max_depth) {
+        _http_sendQ_stats.max_depth = _http_sendQ_stats.depth;
+    }
+    xSemaphoreGive(_http_sendQ_mutex);
+    if (event_data.spool_id) {
+        _http_spool_sync();
+    }
+
+    // let the owner of the replaced request clean up.
+    if (have_evicted) {
+        ESP_LOGW(TAG, "sendQ full. Dropped a lower priority request for a CRITICAL request.");
+        evicted.done(evicted.spool_id ? ESP_ERR_NOT_FINISHED : ESP_ERR_NO_MEM, NULL, evicted.client_config);
+    }
+
+    // wake a worker.
+    xSemaphoreGive(_http_sendQ_work);
+    return true;
+}
@@ -0,0 +1,117 @@
+/**
+ *  @file    ad2_sendq.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief HTTP request send queue shared by the notification components.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef _AD2_SENDQ_H
+#define _AD2_SENDQ_H
+
+#include <string>
+
+// ASYNC serialized http request api for components.
+
+/// ad2_http async http request callback. Called before esp_http_client_perform()
+typedef void (*ad2_http_sendQ_ready_cb_t)(esp_http_client_handle_t, esp_http_client_config_t*);
+/// ad2_http async http request callback. Called before after esp_http_client_cleanup()
+typedef bool (*ad2_http_sendQ_done_cb_t)(esp_err_t, esp_http_client_handle_t, esp_http_client_config_t*);
+/// Notification delivery priority. Set per virtual switch with 'switch N priority'.
+typedef enum {
+    AD2_PRIORITY_LOW = 0,       ///< Chime, informational.
+    AD2_PRIORITY_NORMAL,        ///< Default.
+    AD2_PRIORITY_HIGH,          ///< Arm, disarm, trouble.
+    AD2_PRIORITY_CRITICAL,      ///< Life safety. Fire, alarm, panic.
+    AD2_PRIORITY_COUNT
+} ad2_priority_t;
+
+/// HTTP sendQ rate limit buckets. Set in the [sendq] ini section.
+typedef enum {
+    AD2_HTTP_PROVIDER_TWILIO = 0,   ///< api.twilio.com
+    AD2_HTTP_PROVIDER_SENDGRID,     ///< api.sendgrid.com
+    AD2_HTTP_PROVIDER_PUSHOVER,     ///< api.pushover.net
+    AD2_HTTP_PROVIDER_WEBHOOK,      ///< any other host.
+    AD2_HTTP_PROVIDER_COUNT
+} ad2_http_provider_t;
+
+/// ad2_http spool restore callback. Rebuild a request from its spool record after a restart.
+typedef esp_http_client_config_t* (*ad2_http_sendQ_restore_cb_t)(const std::string &);
+
+void ad2_init_http_sendQ();
+bool ad2_add_http_sendQ(esp_http_client_config_t*, ad2_http_sendQ_ready_cb_t, ad2_http_sendQ_done_cb_t, int priority = AD2_PRIORITY_NORMAL,
+                        const char *spool_owner = nullptr, const std::string &spool_record = "");
+void ad2_register_http_sendQ_spool(const char *owner, ad2_http_sendQ_restore_cb_t restore_cb, ad2_http_sendQ_ready_cb_t ready_cb, ad2_http_sendQ_done_cb_t done_cb);
+
+/**
+ * HTTP sendQ keep-alive connection pool counters.
+ */
+typedef struct ad2_http_pool_stats {
+    uint32_t open;                      ///< connections currently held.
+    uint32_t created;                   ///< new connections.
+    uint32_t reused;                    ///< requests sent on an existing connection.
+    uint32_t evicted;                   ///< idle connections closed to make room.
+    uint32_t closed_idle;               ///< connections closed after the idle timeout.
+    uint32_t closed_error;              ///< connections closed after a failed request.
+    uint32_t requests;                  ///< requests completed.
+    uint32_t last_latency_ms;           ///< last request time.
+    uint32_t max_latency_ms;            ///< max request time.
+    uint64_t total_new_latency_ms;      ///< request time sum on new connections.
+    uint64_t total_reused_latency_ms;   ///< request time sum on reused connections.
+} ad2_http_pool_stats_t;
+void ad2_get_http_pool_stats(ad2_http_pool_stats_t *stats);
+esp_err_t ad2_http_set_header(esp_http_client_handle_t client, const char *key, const char *value);
+
+/**
+ * HTTP sendQ counters.
+ */
+typedef struct ad2_http_sendQ_stats {
+    uint32_t workers;       ///< worker tasks.
+    uint32_t depth;         ///< requests waiting.
+    uint32_t max_depth;     ///< high water requests waiting.
+    uint32_t busy;          ///< destinations with a request in flight.
+    uint32_t queued[AD2_PRIORITY_COUNT];    ///< requests added by priority.
+    uint32_t dropped[AD2_PRIORITY_COUNT];   ///< requests refused with the queue full by priority.
+    uint32_t evicted[AD2_PRIORITY_COUNT];   ///< waiting requests removed for a CRITICAL request by priority.
+    uint32_t delivered;     ///< requests completed with a 2xx-4xx response.
+    uint32_t failed;        ///< requests given up on after the last retry.
+    uint32_t retries;       ///< attempts scheduled again after a failure.
+    uint32_t held;          ///< destinations waiting for a retry backoff.
+    uint32_t latency_p50_ms;    ///< queue to completion time percentiles over the
+    uint32_t latency_p90_ms;    ///< last HTTP_SEND_LATENCY_SAMPLES requests.
+    uint32_t latency_p99_ms;
+    uint32_t latency_max_ms;
+    uint32_t spool_pending;     ///< spooled requests not yet delivered.
+    uint32_t spool_parked;      ///< spooled requests waiting for room in the queue.
+    uint32_t spool_written;     ///< records appended to the spool.
+    uint32_t spool_restored;    ///< requests rebuilt from the spool.
+    uint32_t spool_errors;      ///< spool write failures.
+    uint32_t spool_orphaned;    ///< records dropped with no registered owner.
+    uint32_t provider_sent[AD2_HTTP_PROVIDER_COUNT];    ///< requests started by provider.
+    uint32_t provider_waits[AD2_HTTP_PROVIDER_COUNT];   ///< times a request waited for a provider token.
+    uint32_t digest_messages;   ///< messages added to a notification digest.
+    uint32_t digest_merged;     ///< messages merged into an earlier one. Requests saved.
+} ad2_http_sendQ_stats_t;
+void ad2_get_http_sendQ_stats(ad2_http_sendQ_stats_t *stats);
+std::string ad2_get_http_sendQ_spool_path();
+const char *ad2_get_http_sendQ_rate(int provider, const std::string &setting, float *rate, float *burst);
+
+/// Notification digest flush callback. Called with the merged message for a slot.
+typedef void (*ad2_digest_flush_cb_t)(int slot, const std::string &message, int priority);
+void ad2_digest_add(ad2_digest_flush_cb_t flush_cb, int slot, const std::string &message, int priority, int window_ms, size_t max_size);
+
+#endif /* _AD2_SENDQ_H */
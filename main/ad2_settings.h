@@ -87,6 +87,12 @@
 #define AD2SWITCH_SK_OPEN "open"
 #define AD2SWITCH_SK_CLOSE "close"
 #define AD2SWITCH_SK_TROUBLE "trouble"
+#define AD2SWITCH_SK_PRIORITY "priority"
+#define AD2SWITCH_SK_HOLDTIME "holdtime"
+#define AD2SWITCH_SK_MAXRATE "maxrate"
+
+// @brief [sendq] config section. HTTP sendQ provider rate limits.
+#define SENDQ_CONFIG_SECTION "sendq"
 
 // @brief netmode settings key under main section
 #define NETMODE_CONFIG_KEY    "netmode"
@@ -100,10 +106,19 @@
 // @brief logmode setting key under main section
 #define LOGMODE_CONFIG_KEY    "logmode"
 
+// @brief HTTP sendQ spool file path key under main section
+#define SENDQ_SPOOL_CONFIG_KEY    "sendqspool"
+
 // UART RX buffer size
 #define AD2_UART_RX_BUFF_SIZE  100
 #define MAX_UART_CMD_SIZE    (1024)
 
+// AD2* source task read size. Drains the driver ring buffer in large reads.
+#define AD2_SOURCE_RX_BUFF_SIZE 512
+
+// AD2* UART driver event queue and line pattern position queue depth.
+#define AD2_UART_EVENT_QUEUE_SIZE 20
+
 // NV
 #define AD2_MAX_VALUE_SIZE 1024
 
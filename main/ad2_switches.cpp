@@ -0,0 +1,256 @@
+/**
+ *  @file    ad2_switches.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Shared virtual switch registry. Each [switch N] is loaded and
+ *  tested once and state changes are sent to every component using it.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+// FreeRTOS includes
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+
+static const char *TAG = "AD2SW";
+
+// AlarmDecoder std includes
+#include "alarmdecoder_main.h"
+
+// specific includes
+#include <map>
+#include <vector>
+#include <sstream>
+
+/**
+ * Component subscribed to a switch and its output strings.
+ */
+typedef struct ad2_switch_notifier {
+    ad2_switch_cb_t fn;
+    void *arg;
+    std::string open_output_format;
+    std::string close_output_format;
+    std::string trouble_output_format;
+} ad2_switch_notifier_t;
+
+/**
+ * One loaded [switch N]. es is nullptr if the section is not usable.
+ */
+typedef struct ad2_switch {
+    AD2EventSearch *es;
+    std::vector<ad2_switch_notifier_t> notifiers;
+} ad2_switch_t;
+
+/// Loaded switches by ID. Only changed during init before parsing starts.
+static std::map<int, ad2_switch_t> _switches;
+
+/**
+ * @brief Parser ON_SEARCH_MATCH callback. Send the new state to each
+ * component with its own output string.
+ *
+ * @param [in]msg std::string * message that changed the state.
+ * @param [in]s AD2PartitionState * nullptr for the suppression summary.
+ * @param [in]arg AD2EventSearch * with PTR_ARG set to its ad2_switch_t.
+ */
+static void _on_search_match_cb(std::string *msg, AD2PartitionState *s, void *arg)
+{
+    AD2EventSearch *es = (AD2EventSearch *)arg;
+    ad2_switch_t *sw = (ad2_switch_t *)es->PTR_ARG;
+    int state = es->getState();
+    for (auto &n : sw->notifiers) {
+        const std::string *message;
+        if (state == AD2_STATE_OPEN) {
+            message = &n.open_output_format;
+        } else if (state == AD2_STATE_CLOSED) {
+            message = &n.close_output_format;
+        } else {
+            message = &n.trouble_output_format;
+        }
+        n.fn(msg, es, *message, n.arg);
+    }
+}
+
+/**
+ * @brief Load [switch N] settings into a new search.
+ *
+ * @param [in]swID int switch ID.
+ *
+ * @return AD2EventSearch * or nullptr if no open, close or trouble
+ * expressions are set.
+ */
+static AD2EventSearch *_load_switch(int swID)
+{
+    // key switch N
+    std::string key = std::string(AD2SWITCH_CONFIG_SECTION);
+    key += " ";
+    key += std::to_string(swID);
+
+    // Default switch state from global switch settings
+    int defaultState = AD2_STATE_UNKNOWN; // default default to unknown.
+    ad2_get_config_key_int(key.c_str(),
+                           AD2SWITCH_SK_DEFAULT,
+                           &defaultState);
+
+    // Auto reset time from global switch settings
+    int autoReset = 0;
+    ad2_get_config_key_int(key.c_str(),
+                           AD2SWITCH_SK_RESET,
+                           &autoReset);
+
+    // construct our search object.
+    AD2EventSearch *es1 = new AD2EventSearch((AD2_CMD_ZONE_state_t)defaultState, autoReset);
+
+    // save the NVS Virtual SWITCH ID so we can read the data back later.
+    es1->INT_ARG = swID;
+
+    // Notification delivery priority from global switch settings
+    int priority = AD2_PRIORITY_NORMAL;
+    ad2_get_config_key_int(key.c_str(),
+                           AD2SWITCH_SK_PRIORITY,
+                           &priority);
+    es1->PRIORITY_ARG = priority;
+
+    // Flap suppression from global switch settings
+    int holdTime = 0;
+    ad2_get_config_key_int(key.c_str(),
+                           AD2SWITCH_SK_HOLDTIME,
+                           &holdTime);
+    es1->setHoldTime(holdTime);
+    int maxRate = 0;
+    ad2_get_config_key_int(key.c_str(),
+                           AD2SWITCH_SK_MAXRATE,
+                           &maxRate);
+    es1->setMaxRate(maxRate);
+
+    // Get the optional switch types to listen for.
+    std::string types = "";
+    std::vector<std::string> notify_types_v;
+    ad2_get_config_key_string(key.c_str(), AD2SWITCH_SK_TYPES, types);
+    ad2_tokenize(types, ", ", notify_types_v);
+    for (auto &sztype : notify_types_v) {
+        ad2_trim(sztype);
+        auto x = AD2Parse.message_type_id.find(sztype);
+        if(x != std::end(AD2Parse.message_type_id)) {
+            ad2_message_t mt = (ad2_message_t)AD2Parse.message_type_id.at(sztype);
+            es1->PRE_FILTER_MESAGE_TYPE.push_back(mt);
+        }
+    }
+
+    // load [switch N] required regex match settings
+    std::string prefilter_regex;
+    ad2_get_config_key_string(key.c_str(), AD2SWITCH_SK_FILTER, prefilter_regex);
+    es1->PRE_FILTER_REGEX = prefilter_regex;
+
+    // Load all regex search patterns for open, close, and trouble sub keys.
+    std::string regex_sk_list = AD2SWITCH_SK_OPEN " "
+                                AD2SWITCH_SK_CLOSE " "
+                                AD2SWITCH_SK_TROUBLE;
+
+    std::stringstream ss(regex_sk_list);
+    std::string sk;
+    int sk_index = 0;
+    while (ss >> sk) {
+        for ( int a = 1; a < AD2_MAX_SWITCH_SEARCH_KEYS; a++) {
+            std::string out = "";
+            ad2_get_config_key_string(key.c_str(), sk.c_str(), out, a);
+
+            if ( out.length()) {
+                if (sk_index == 0) {
+                    es1->OPEN_REGEX_LIST.push_back(out);
+                }
+                if (sk_index == 1) {
+                    es1->CLOSE_REGEX_LIST.push_back(out);
+                }
+                if (sk_index == 2) {
+                    es1->TROUBLE_REGEX_LIST.push_back(out);
+                }
+            }
+        }
+        sk_index++;
+    }
+
+    // Must provide at least one states or it will be skipped.
+    if (!es1->OPEN_REGEX_LIST.size() &&
+            !es1->CLOSE_REGEX_LIST.size() &&
+            !es1->TROUBLE_REGEX_LIST.size()) {
+        delete es1;
+        return nullptr;
+    }
+
+    // Compile now and not on the first message from the AD2*.
+    es1->compile();
+    return es1;
+}
+
+/**
+ * @brief Subscribe a component to a virtual switch. The [switch N]
+ * section is loaded and subscribed to the parser the first time any
+ * component asks for it. Later calls share the same search so it is
+ * only tested once per message.
+ *
+ * @param [in]swID int switch ID.
+ * @param [in]fn ad2_switch_cb_t callback.
+ * @param [in]arg void * callback argument.
+ * @param [in]open_output_format const std::string & sent on OPEN.
+ * @param [in]close_output_format const std::string & sent on CLOSED.
+ * @param [in]trouble_output_format const std::string & sent on TROUBLE.
+ *
+ * @return AD2EventSearch * shared switch or nullptr if [switch N] has
+ * no open, close or trouble expressions.
+ */
+AD2EventSearch *ad2_switch_subscribe(int swID, ad2_switch_cb_t fn, void *arg,
+                                     const std::string &open_output_format,
+                                     const std::string &close_output_format,
+                                     const std::string &trouble_output_format)
+{
+    auto it = _switches.find(swID);
+    if (it == _switches.end()) {
+        ad2_switch_t &sw = _switches[swID];
+        sw.es = _load_switch(swID);
+        if (sw.es) {
+            // PTR_ARG is the registry entry for the callback.
+            sw.es->PTR_ARG = &sw;
+            AD2Parse.subscribeTo(_on_search_match_cb, sw.es);
+        } else {
+            ESP_LOGE(TAG, "Error in config section [switch %i]. Need at least one open, close, or trouble filter expressions.", swID);
+        }
+        it = _switches.find(swID);
+    }
+
+    ad2_switch_t &sw = it->second;
+    if (!sw.es) {
+        return nullptr;
+    }
+
+    sw.notifiers.push_back({fn, arg, open_output_format, close_output_format, trouble_output_format});
+    return sw.es;
+}
+
+/**
+ * @brief Number of switches tested on each message.
+ *
+ * @return int
+ */
+int ad2_switch_count()
+{
+    int count = 0;
+    for (auto &sw : _switches) {
+        if (sw.second.es) {
+            count++;
+        }
+    }
+    return count;
+}
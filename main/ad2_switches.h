@@ -0,0 +1,47 @@
+/**
+ *  @file    ad2_switches.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief Shared virtual switch registry. Each [switch N] is loaded and
+ *  tested once and state changes are sent to every component using it.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef _AD2_SWITCHES_H
+#define _AD2_SWITCHES_H
+
+#include <string>
+#include "alarmdecoder_api.h"
+
+/**
+ * Component switch callback. Called for each state change of a switch
+ * and for the flap suppression summary.
+ *
+ * @param [in]msg std::string * message that changed the state.
+ * @param [in]es AD2EventSearch * shared switch. INT_ARG is the switch ID.
+ * @param [in]message const std::string & component output string for the new state.
+ * @param [in]arg void * component argument given to ad2_switch_subscribe().
+ */
+typedef void (*ad2_switch_cb_t)(std::string *msg, AD2EventSearch *es, const std::string &message, void *arg);
+
+AD2EventSearch *ad2_switch_subscribe(int swID, ad2_switch_cb_t fn, void *arg,
+                                     const std::string &open_output_format,
+                                     const std::string &close_output_format,
+                                     const std::string &trouble_output_format);
+int ad2_switch_count();
+
+#endif /* _AD2_SWITCHES_H */
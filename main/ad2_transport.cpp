@@ -0,0 +1,921 @@
+/**
+ *  @file    ad2_transport.cpp
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief AD2* protocol stream transport interface and backends.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <vector>
+#include <algorithm>
+
+#include "ad2_transport.h"
+
+#if defined(IDF_VER)
+// FreeRTOS includes
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// esp includes
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+
+// Common settings
+#include "ad2_settings.h"
+#else
+// POSIX host build. Map the ESP log macros to stderr.
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netdb.h>
+#include <termios.h>
+#include <time.h>
+#define ESP_LOGE(tag, fmt, ...) fprintf(stderr, "E %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) fprintf(stderr, "W %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) fprintf(stderr, "I %s: " fmt "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...)
+#endif
+
+static const char *TAG = "AD2TRANS";
+
+/**
+ * @brief Open the transport.
+ *
+ * @return bool true if open.
+ */
+bool AD2Transport::open()
+{
+    if (_is_open) {
+        return true;
+    }
+    _is_open = _open();
+    if (_is_open) {
+        _stats.opens++;
+    } else {
+        _stats.open_errors++;
+    }
+    return _is_open;
+}
+
+/**
+ * @brief Read bytes from the transport.
+ *
+ * @param [in]buf buffer to fill.
+ * @param [in]len size of buf.
+ * @param [in]timeout_ms max time to wait for data.
+ *
+ * @return int bytes read, 0 on timeout or -1 on error.
+ */
+int AD2Transport::read(uint8_t *buf, size_t len, int timeout_ms)
+{
+    if (!_is_open) {
+        return -1;
+    }
+    int res = _read(buf, len, timeout_ms);
+    if (res > 0) {
+        _stats.rx_reads++;
+        _stats.rx_bytes += res;
+        if (_capture) {
+            _capture->record(buf, res);
+        }
+    } else if (res == 0) {
+        _stats.rx_timeouts++;
+    } else {
+        _stats.rx_errors++;
+    }
+    return res;
+}
+
+/**
+ * @brief Write bytes to the transport.
+ *
+ * @param [in]buf bytes to send.
+ * @param [in]len number of bytes in buf.
+ *
+ * @return int bytes sent or -1 on error.
+ */
+int AD2Transport::write(const uint8_t *buf, size_t len)
+{
+    if (!_is_open) {
+        _stats.tx_errors++;
+        return -1;
+    }
+    int res = _write(buf, len);
+    if (res >= 0) {
+        _stats.tx_writes++;
+        _stats.tx_bytes += res;
+    } else {
+        _stats.tx_errors++;
+    }
+    return res;
+}
+
+/**
+ * @brief Close the transport.
+ */
+void AD2Transport::close()
+{
+    if (_is_open) {
+        _close();
+        _is_open = false;
+    }
+}
+
+/**
+ * @brief Reset the I/O counters.
+ */
+void AD2Transport::resetStats()
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+/**
+ * @brief Sleep helper for idle backends.
+ *
+ * @param [in]ms milliseconds to sleep.
+ */
+static void _transport_sleep_ms(int ms)
+{
+    if (ms <= 0) {
+        return;
+    }
+#if defined(IDF_VER)
+    vTaskDelay(ms / portTICK_PERIOD_MS);
+#else
+    usleep(ms * 1000);
+#endif
+}
+
+/**
+ * @brief Monotonic time in microseconds.
+ *
+ * @return uint64_t
+ */
+uint64_t ad2_transport_uptime_us()
+{
+#if defined(IDF_VER)
+    return (uint64_t)esp_timer_get_time();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+#endif
+}
+
+/**
+ * @brief Wait for a file descriptor to be readable.
+ *
+ * @param [in]fd file descriptor.
+ * @param [in]timeout_ms max time to wait.
+ *
+ * @return int >0 readable, 0 timeout, -1 error.
+ */
+static int _transport_wait_readable(int fd, int timeout_ms)
+{
+    fd_set rfds;
+    FD_ZERO(&rfds);
+    FD_SET(fd, &rfds);
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    int res = select(fd + 1, &rfds, NULL, NULL, &tv);
+    if (res < 0 && errno == EINTR) {
+        return 0;
+    }
+    return res;
+}
+
+#if defined(IDF_VER)
+/**
+ * @brief Configure the UART and install the driver.
+ */
+bool AD2TransportUART::_open()
+{
+    if (!_driver_installed) {
+        // Configure parameters of an UART driver,
+        uart_config_t uart_config = {};
+        uart_config.baud_rate = _baud_rate;
+        uart_config.data_bits = UART_DATA_8_BITS;
+        uart_config.parity    = UART_PARITY_DISABLE;
+        uart_config.stop_bits = UART_STOP_BITS_1;
+        uart_config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+        uart_config.rx_flow_ctrl_thresh = 1;
+
+        // esp_restart causes issues with UART2 don't set config if reset switch pushed.
+        // https://github.com/espressif/esp-idf/issues/5274
+        if (esp_reset_reason() != ESP_RST_SW) {
+            uart_param_config(_port, &uart_config);
+        }
+
+        uart_set_pin(_port,
+                     _tx_pin,   // TX
+                     _rx_pin,   // RX
+                     UART_PIN_NO_CHANGE, // RTS
+                     UART_PIN_NO_CHANGE);// CTS
+
+#if CONFIG_AD2IOT_UART_RX_PATTERN_DETECT
+        if (uart_driver_install(_port, MAX_UART_CMD_SIZE * 2, 0, AD2_UART_EVENT_QUEUE_SIZE, &_event_queue, ESP_INTR_FLAG_LOWMED) != ESP_OK) {
+            ESP_LOGE(TAG, "uart driver install failed on port %i", _port);
+            return false;
+        }
+        // Wake the reader on every AD2* message terminator.
+        uart_enable_pattern_det_baud_intr(_port, '\n', 1, 9, 0, 0);
+        uart_pattern_queue_reset(_port, AD2_UART_EVENT_QUEUE_SIZE);
+#else
+        if (uart_driver_install(_port, MAX_UART_CMD_SIZE * 2, 0, 0, NULL, ESP_INTR_FLAG_LOWMED) != ESP_OK) {
+            ESP_LOGE(TAG, "uart driver install failed on port %i", _port);
+            return false;
+        }
+#endif
+        _driver_installed = true;
+    }
+    return true;
+}
+
+/**
+ * @brief Read from the UART driver ring buffer.
+ *
+ * @note Event driven mode drains anything already buffered first and
+ * only blocks on the driver event queue when the ring buffer is empty.
+ */
+int AD2TransportUART::_read(uint8_t *buf, size_t len, int timeout_ms)
+{
+#if CONFIG_AD2IOT_UART_RX_PATTERN_DETECT
+    size_t buffered = 0;
+    uart_get_buffered_data_len(_port, &buffered);
+    if (!buffered) {
+        uart_event_t event;
+        if (xQueueReceive(_event_queue, &event, timeout_ms / portTICK_PERIOD_MS) != pdTRUE) {
+            return 0;
+        }
+        switch (event.type) {
+        case UART_PATTERN_DET:
+            // Only the wakeup matters. Keep the position queue from filling.
+            while (uart_pattern_pop_pos(_port) != -1) {
+            }
+            break;
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            // Data was lost. Drop the partial stream the parser will resync on the next EOL.
+            ESP_LOGW(TAG, "uart rx overflow event %i flushing", event.type);
+            _stats.rx_overflows++;
+            uart_flush_input(_port);
+            xQueueReset(_event_queue);
+            uart_pattern_queue_reset(_port, AD2_UART_EVENT_QUEUE_SIZE);
+            return 0;
+        default:
+            break;
+        }
+        uart_get_buffered_data_len(_port, &buffered);
+        if (!buffered) {
+            return 0;
+        }
+    }
+    return uart_read_bytes(_port, buf, buffered < len ? buffered : len, 0);
+#else
+    return uart_read_bytes(_port, buf, len, timeout_ms / portTICK_PERIOD_MS);
+#endif
+}
+
+/**
+ * @brief Write to the UART driver.
+ */
+int AD2TransportUART::_write(const uint8_t *buf, size_t len)
+{
+    return uart_write_bytes(_port, (const char *)buf, len);
+}
+
+/**
+ * @brief Nothing to release. The driver stays installed for reopen.
+ */
+void AD2TransportUART::_close()
+{
+    uart_flush_input(_port);
+    if (_event_queue) {
+        xQueueReset(_event_queue);
+    }
+}
+#endif
+
+/**
+ * @brief Resolve the host and connect.
+ */
+bool AD2TransportTCP::_open()
+{
+    struct addrinfo hints = {};
+    struct addrinfo *res = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    std::string port = std::to_string(_port);
+    int err = getaddrinfo(_host.c_str(), port.c_str(), &hints, &res);
+    if (err != 0 || res == nullptr) {
+        ESP_LOGE(TAG, "tcp unable to resolve host '%s': %i", _host.c_str(), err);
+        return false;
+    }
+
+    ESP_LOGI(TAG, "tcp connecting to host %s on port %i", _host.c_str(), _port);
+    for (struct addrinfo *ai = res; ai != nullptr; ai = ai->ai_next) {
+        _fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (_fd < 0) {
+            continue;
+        }
+        if (connect(_fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            break;
+        }
+        ::close(_fd);
+        _fd = -1;
+    }
+    freeaddrinfo(res);
+
+    if (_fd < 0) {
+        ESP_LOGE(TAG, "tcp unable to connect: errno %d", errno);
+        return false;
+    }
+    ESP_LOGI(TAG, "tcp successfully connected");
+    return true;
+}
+
+/**
+ * @brief Wait for data then receive it.
+ */
+int AD2TransportTCP::_read(uint8_t *buf, size_t len, int timeout_ms)
+{
+    int res = _transport_wait_readable(_fd, timeout_ms);
+    if (res <= 0) {
+        return res;
+    }
+    res = recv(_fd, buf, len, 0);
+    if (res == 0) {
+        // peer closed the connection.
+        ESP_LOGW(TAG, "tcp connection closed by peer");
+        return -1;
+    }
+    if (res < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return 0;
+        }
+        ESP_LOGE(TAG, "tcp recv failed: errno %d", errno);
+        return -1;
+    }
+    return res;
+}
+
+/**
+ * @brief Send all bytes.
+ */
+int AD2TransportTCP::_write(const uint8_t *buf, size_t len)
+{
+    int flags = 0;
+#ifdef MSG_NOSIGNAL
+    flags = MSG_NOSIGNAL;
+#endif
+    size_t sent = 0;
+    while (sent < len) {
+        int res = send(_fd, buf + sent, len - sent, flags);
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ESP_LOGE(TAG, "tcp send failed: errno %d", errno);
+            return -1;
+        }
+        sent += res;
+    }
+    return sent;
+}
+
+/**
+ * @brief Shutdown and close the socket.
+ */
+void AD2TransportTCP::_close()
+{
+    if (_fd != -1) {
+        shutdown(_fd, 0);
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+/**
+ * @brief Open the capture file.
+ */
+bool AD2TransportFile::_open()
+{
+    _fp = fopen(_path.c_str(), "rb");
+    if (!_fp) {
+        ESP_LOGE(TAG, "file unable to open '%s': errno %d", _path.c_str(), errno);
+        return false;
+    }
+    ESP_LOGI(TAG, "file replay from '%s'%s", _path.c_str(), _loop ? " looping" : "");
+    return true;
+}
+
+/**
+ * @brief Read the next chunk of the capture.
+ */
+int AD2TransportFile::_read(uint8_t *buf, size_t len, int timeout_ms)
+{
+    size_t res = fread(buf, 1, len, _fp);
+    if (res > 0) {
+        return res;
+    }
+    if (ferror(_fp)) {
+        return -1;
+    }
+    // end of file.
+    if (_loop) {
+        rewind(_fp);
+    } else {
+        _transport_sleep_ms(timeout_ms);
+    }
+    return 0;
+}
+
+/**
+ * @brief Nowhere to send. Discard the data.
+ */
+int AD2TransportFile::_write(const uint8_t *buf, size_t len)
+{
+    return len;
+}
+
+/**
+ * @brief Close the capture file.
+ */
+void AD2TransportFile::_close()
+{
+    if (_fp) {
+        fclose(_fp);
+        _fp = nullptr;
+    }
+}
+
+/**
+ * @brief Append a LEB128 varint.
+ *
+ * @param [in]out destination.
+ * @param [in]v value.
+ */
+static void _capture_put_varint(std::vector<uint8_t> &out, uint64_t v)
+{
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+/**
+ * @brief Read a LEB128 varint.
+ *
+ * @param [in]fp source file.
+ * @param [out]v value.
+ *
+ * @return bool false on end of file or a corrupt value.
+ */
+static bool _capture_get_varint(FILE *fp, uint64_t &v)
+{
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = fgetc(fp);
+        if (c == EOF) {
+            return false;
+        }
+        v |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Create the capture file and write the header.
+ *
+ * @param [in]path file to create. Replaced if it exists.
+ *
+ * @return bool true if recording.
+ */
+bool AD2Capture::start(const std::string &path)
+{
+    stop();
+    std::lock_guard<std::mutex> guard(_lock);
+    _fp = fopen(path.c_str(), "wb");
+    if (!_fp) {
+        ESP_LOGE(TAG, "capture unable to create '%s': errno %d", path.c_str(), errno);
+        return false;
+    }
+    char header[AD2_CAPTURE_HEADER_SIZE] = AD2_CAPTURE_MAGIC;
+    header[6] = AD2_CAPTURE_VERSION;
+    header[7] = '\n';
+    if (fwrite(header, 1, sizeof(header), _fp) != sizeof(header)) {
+        ESP_LOGE(TAG, "capture unable to write '%s': errno %d", path.c_str(), errno);
+        fclose(_fp);
+        _fp = nullptr;
+        return false;
+    }
+    _path = path;
+    _stats = {};
+    _stats.file_bytes = sizeof(header);
+    _last_us = ad2_transport_uptime_us();
+    ESP_LOGI(TAG, "capture recording to '%s'", path.c_str());
+    return true;
+}
+
+/**
+ * @brief Flush and close the capture file.
+ */
+void AD2Capture::stop()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_fp) {
+        fclose(_fp);
+        _fp = nullptr;
+        ESP_LOGI(TAG, "capture '%s' closed %u records %llu bytes", _path.c_str(),
+                 _stats.records, (unsigned long long)_stats.file_bytes);
+    }
+}
+
+/**
+ * @brief Save one block of received data with the time since the last.
+ *
+ * @param [in]buf data.
+ * @param [in]len size of data.
+ */
+void AD2Capture::record(const uint8_t *buf, size_t len)
+{
+    if (!_fp || !len) {
+        return;
+    }
+    uint64_t now = ad2_transport_uptime_us();
+    std::lock_guard<std::mutex> guard(_lock);
+    if (!_fp) {
+        return;
+    }
+    // record header and data in one buffered write.
+    std::vector<uint8_t> rec;
+    rec.reserve(len + 10);
+    _capture_put_varint(rec, now - _last_us);
+    _capture_put_varint(rec, len);
+    rec.insert(rec.end(), buf, buf + len);
+    _last_us = now;
+    if (fwrite(rec.data(), 1, rec.size(), _fp) != rec.size()) {
+        ESP_LOGE(TAG, "capture write to '%s' failed errno %d. Stopped.", _path.c_str(), errno);
+        _stats.errors++;
+        fclose(_fp);
+        _fp = nullptr;
+        return;
+    }
+    _stats.records++;
+    _stats.bytes += len;
+    _stats.file_bytes += rec.size();
+}
+
+/**
+ * @brief Open the capture and check the header.
+ */
+bool AD2TransportReplay::_open()
+{
+    _fp = fopen(_path.c_str(), "rb");
+    if (!_fp) {
+        ESP_LOGE(TAG, "replay unable to open '%s': errno %d", _path.c_str(), errno);
+        return false;
+    }
+    char header[AD2_CAPTURE_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), _fp) != sizeof(header) ||
+            memcmp(header, AD2_CAPTURE_MAGIC, 6) != 0 || header[6] != AD2_CAPTURE_VERSION) {
+        ESP_LOGE(TAG, "replay '%s' is not an AD2* capture", _path.c_str());
+        fclose(_fp);
+        _fp = nullptr;
+        return false;
+    }
+    _pending_ready = false;
+    _record_us = 0;
+    _start_us = ad2_transport_uptime_us();
+    if (_speed > 0) {
+        ESP_LOGI(TAG, "replay from '%s' at %gx%s", _path.c_str(), _speed, _loop ? " looping" : "");
+    } else {
+        ESP_LOGI(TAG, "replay from '%s' at max speed%s", _path.c_str(), _loop ? " looping" : "");
+    }
+    return true;
+}
+
+/**
+ * @brief Load the next record.
+ *
+ * @return bool false at the end of the capture or on a damaged record.
+ */
+bool AD2TransportReplay::_next()
+{
+    uint64_t delta, len;
+    if (!_capture_get_varint(_fp, delta) || !_capture_get_varint(_fp, len)) {
+        return false;
+    }
+    if (len > AD2_CAPTURE_MAX_RECORD) {
+        ESP_LOGE(TAG, "replay '%s' record length %llu too large. End of capture.", _path.c_str(), (unsigned long long)len);
+        // skip to the end so the rest is not parsed as records.
+        fseek(_fp, 0, SEEK_END);
+        return false;
+    }
+    _pending.resize(len);
+    if (len && fread(&_pending[0], 1, len, _fp) != len) {
+        return false;
+    }
+    _pending_off = 0;
+    _record_us += delta;
+    _pending_ready = true;
+    return true;
+}
+
+/**
+ * @brief Return record data once its scaled capture time is reached.
+ */
+int AD2TransportReplay::_read(uint8_t *buf, size_t len, int timeout_ms)
+{
+    if (!_pending_ready && !_next()) {
+        if (ferror(_fp)) {
+            return -1;
+        }
+        // end of capture.
+        if (_loop) {
+            fseek(_fp, AD2_CAPTURE_HEADER_SIZE, SEEK_SET);
+            _record_us = 0;
+            _start_us = ad2_transport_uptime_us();
+        } else {
+            _transport_sleep_ms(timeout_ms);
+        }
+        return 0;
+    }
+
+    // wait for the record time scaled by speed.
+    if (_speed > 0 && _pending_off == 0) {
+        uint64_t due = _start_us + (uint64_t)(_record_us / _speed);
+        uint64_t now = ad2_transport_uptime_us();
+        if (due > now) {
+            uint64_t wait_ms = (due - now + 999) / 1000;
+            if (wait_ms > (uint64_t)timeout_ms) {
+                _transport_sleep_ms(timeout_ms);
+                return 0;
+            }
+            _transport_sleep_ms(wait_ms);
+        }
+    }
+
+    size_t n = std::min(len, _pending.length() - _pending_off);
+    memcpy(buf, _pending.data() + _pending_off, n);
+    _pending_off += n;
+    if (_pending_off >= _pending.length()) {
+        _pending_ready = false;
+    }
+    return n;
+}
+
+/**
+ * @brief Nowhere to send. Discard the data.
+ */
+int AD2TransportReplay::_write(const uint8_t *buf, size_t len)
+{
+    return len;
+}
+
+/**
+ * @brief Close the capture.
+ */
+void AD2TransportReplay::_close()
+{
+    if (_fp) {
+        fclose(_fp);
+        _fp = nullptr;
+    }
+    _pending_ready = false;
+}
+
+#if !defined(IDF_VER)
+/**
+ * @brief Create a raw mode pseudo terminal and optionally link it.
+ */
+bool AD2TransportPTY::_open()
+{
+    _fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (_fd < 0 || grantpt(_fd) != 0 || unlockpt(_fd) != 0) {
+        ESP_LOGE(TAG, "pty unable to allocate: errno %d", errno);
+        if (_fd >= 0) {
+            ::close(_fd);
+            _fd = -1;
+        }
+        return false;
+    }
+
+    // no line discipline. bytes pass through like a UART.
+    struct termios tio;
+    if (tcgetattr(_fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(_fd, TCSANOW, &tio);
+    }
+
+    _slave = ptsname(_fd);
+
+    // Hold the slave open so the master does not return EIO
+    // between feeder connections.
+    _slave_fd = ::open(_slave.c_str(), O_RDWR | O_NOCTTY);
+
+    if (_link.length()) {
+        unlink(_link.c_str());
+        if (symlink(_slave.c_str(), _link.c_str()) != 0) {
+            ESP_LOGW(TAG, "pty unable to link '%s': errno %d", _link.c_str(), errno);
+        }
+    }
+    ESP_LOGI(TAG, "pty slave '%s'", _link.length() ? _link.c_str() : _slave.c_str());
+    return true;
+}
+
+/**
+ * @brief Wait for data then read it.
+ */
+int AD2TransportPTY::_read(uint8_t *buf, size_t len, int timeout_ms)
+{
+    int res = _transport_wait_readable(_fd, timeout_ms);
+    if (res <= 0) {
+        return res;
+    }
+    res = ::read(_fd, buf, len);
+    if (res < 0) {
+        if (errno == EAGAIN || errno == EINTR) {
+            return 0;
+        }
+        return -1;
+    }
+    return res;
+}
+
+/**
+ * @brief Write to the slave side reader.
+ */
+int AD2TransportPTY::_write(const uint8_t *buf, size_t len)
+{
+    return ::write(_fd, buf, len);
+}
+
+/**
+ * @brief Release the pty and link.
+ */
+void AD2TransportPTY::_close()
+{
+    if (_link.length()) {
+        unlink(_link.c_str());
+    }
+    if (_slave_fd != -1) {
+        ::close(_slave_fd);
+        _slave_fd = -1;
+    }
+    if (_fd != -1) {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+#endif
+
+/**
+ * @brief Split a HOST:PORT string. IPv6 hosts must be surrounded
+ * by square braces RFC 3986, section 3.2.2: Host.
+ *
+ * @param [in]args HOST:PORT string.
+ * @param [out]host host part.
+ * @param [out]port port part.
+ *
+ * @return bool true if parsed.
+ */
+static bool _transport_parse_host_port(const std::string &args, std::string &host, int &port)
+{
+    size_t sep = args.rfind(':');
+    if (sep == std::string::npos || sep == 0) {
+        return false;
+    }
+    host = args.substr(0, sep);
+    if (host.length() > 1 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.length() - 2);
+    }
+    port = atoi(args.substr(sep + 1).c_str());
+    return port > 0 && port < 65536;
+}
+
+/**
+ * @brief Create a transport from the ad2source mode and arguments.
+ *
+ * @param [in]mode 'C'om, 'S'ocket, 'F'ile replay, 'R'eplay capture
+ *   or 'P'ty(host only).
+ * @param [in]args mode arguments.
+ *   C: <TXPIN:RXPIN>
+ *   S: <HOST:PORT>
+ *   F: <PATH> [loop]
+ *   R: <PATH> [speed|max] [loop]
+ *   P: [LINKPATH]
+ *
+ * @return AD2Transport * or nullptr if the mode or args are invalid.
+ */
+AD2Transport *ad2_transport_create(char mode, const std::string &args)
+{
+    switch (toupper(mode)) {
+#if defined(IDF_VER)
+    case 'C': {
+        size_t sep = args.find(':');
+        if (sep == std::string::npos) {
+            ESP_LOGE(TAG, "Error parsing TXPIN:RXPIN from '%s'", args.c_str());
+            return nullptr;
+        }
+        int tx_pin = atoi(args.substr(0, sep).c_str());
+        int rx_pin = atoi(args.substr(sep + 1).c_str());
+        return new AD2TransportUART(UART_NUM_2, tx_pin, rx_pin);
+    }
+#endif
+    case 'S': {
+        std::string host;
+        int port;
+        if (!_transport_parse_host_port(args, host, port)) {
+            ESP_LOGE(TAG, "Error parsing HOST:PORT from '%s'", args.c_str());
+            return nullptr;
+        }
+        return new AD2TransportTCP(host, port);
+    }
+    case 'F': {
+        std::string path = args;
+        bool loop = false;
+        size_t sep = path.find(' ');
+        if (sep != std::string::npos) {
+            loop = path.compare(sep + 1, std::string::npos, "loop") == 0;
+            path = path.substr(0, sep);
+        }
+        if (!path.length()) {
+            ESP_LOGE(TAG, "Missing replay file path");
+            return nullptr;
+        }
+        return new AD2TransportFile(path, loop);
+    }
+    case 'R': {
+        std::string path;
+        double speed = 1.0;
+        bool loop = false;
+        size_t pos = 0;
+        while (pos < args.length()) {
+            size_t sep = args.find(' ', pos);
+            if (sep == std::string::npos) {
+                sep = args.length();
+            }
+            std::string tok = args.substr(pos, sep - pos);
+            pos = sep + 1;
+            if (!tok.length()) {
+                continue;
+            }
+            if (!path.length()) {
+                path = tok;
+            } else if (tok == "loop") {
+                loop = true;
+            } else if (tok == "max") {
+                speed = 0;
+            } else {
+                speed = atof(tok.c_str());
+                if (speed <= 0) {
+                    ESP_LOGE(TAG, "Invalid replay speed '%s'", tok.c_str());
+                    return nullptr;
+                }
+            }
+        }
+        if (!path.length()) {
+            ESP_LOGE(TAG, "Missing replay capture path");
+            return nullptr;
+        }
+        return new AD2TransportReplay(path, speed, loop);
+    }
+#if !defined(IDF_VER)
+    case 'P':
+        return new AD2TransportPTY(args);
+#endif
+    default:
+        ESP_LOGE(TAG, "Unknown transport mode '%c'", mode);
+        return nullptr;
+    }
+}
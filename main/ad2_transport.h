@@ -0,0 +1,343 @@
+/**
+ *  @file    ad2_transport.h
+ *  @author  Sean Mathews <coder@f34r.com>
+ *  @date    10/18/2026
+ *
+ *  @brief AD2* protocol stream transport interface and backends.
+ *
+ *  @copyright Copyright (C) 2026 Nu Tech Software Solutions, Inc.
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+#ifndef _AD2_TRANSPORT_H
+#define _AD2_TRANSPORT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <mutex>
+
+#if defined(IDF_VER)
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "driver/uart.h"
+#endif
+
+/**
+ * AD2* transport I/O counters.
+ */
+typedef struct ad2_transport_stats {
+    uint32_t opens;         ///< successful open() calls.
+    uint32_t open_errors;   ///< failed open() calls.
+    uint64_t rx_bytes;      ///< total bytes received.
+    uint32_t rx_reads;      ///< read() calls that returned data.
+    uint32_t rx_timeouts;   ///< read() calls that timed out with no data.
+    uint32_t rx_errors;     ///< read() calls that failed.
+    uint32_t rx_overflows;  ///< receive buffer overflows reported by the backend.
+    uint64_t tx_bytes;      ///< total bytes sent.
+    uint32_t tx_writes;     ///< write() calls that sent data.
+    uint32_t tx_errors;     ///< write() calls that failed.
+} ad2_transport_stats_t;
+
+/**
+ * AD2* stream capture file format.
+ *
+ * Header: 8 bytes "AD2CAP" AD2_CAPTURE_VERSION '\n'.
+ * Records: one per transport read.
+ *   varint   microseconds since the previous record.
+ *   varint   number of data bytes.
+ *   bytes    raw data as received from the AD2*.
+ * Varints are LEB128. 7 bits per byte low bits first.
+ */
+#define AD2_CAPTURE_MAGIC "AD2CAP"
+#define AD2_CAPTURE_VERSION 1
+#define AD2_CAPTURE_HEADER_SIZE 8
+// Largest record accepted on replay. Reads are far smaller. A larger
+// length means the file is damaged or not a capture.
+#define AD2_CAPTURE_MAX_RECORD 65536
+
+/**
+ * AD2* capture writer counters.
+ */
+typedef struct ad2_capture_stats {
+    uint32_t records;       ///< records written.
+    uint64_t bytes;         ///< data bytes written.
+    uint64_t file_bytes;    ///< file size including record headers.
+    uint32_t errors;        ///< failed writes. The capture stops on error.
+} ad2_capture_stats_t;
+
+/**
+ * AD2* stream capture writer.
+ *
+ * @brief Record the raw AD2* stream with microsecond timestamps.
+ * Attached to a transport every read() that returns data is saved
+ * as one record.
+ */
+class AD2Capture
+{
+public:
+    ~AD2Capture()
+    {
+        stop();
+    }
+
+    bool start(const std::string &path);
+    void stop();
+    void record(const uint8_t *buf, size_t len);
+
+    bool isActive()
+    {
+        return _fp != nullptr;
+    }
+
+    const std::string &path()
+    {
+        return _path;
+    }
+
+    ad2_capture_stats_t getStats()
+    {
+        return _stats;
+    }
+
+protected:
+    std::mutex _lock;
+    std::string _path;
+    FILE *_fp = nullptr;
+    uint64_t _last_us = 0;
+    ad2_capture_stats_t _stats = {};
+};
+
+/**
+ * AD2* protocol stream transport.
+ *
+ * @brief Byte stream connection to an AlarmDecoder device. Backends
+ * implement the protected _open/_read/_write/_close methods and the
+ * public wrappers track the I/O counters.
+ *
+ * read() returns the number of bytes received, 0 if the timeout
+ * expired with no data or -1 if the connection failed and must be
+ * closed and opened again.
+ */
+class AD2Transport
+{
+public:
+    virtual ~AD2Transport() {}
+
+    // short backend name for logging and stats.
+    virtual const char *name() = 0;
+
+    // true if the backend needs the network to be up before open().
+    virtual bool requiresNetwork()
+    {
+        return false;
+    }
+
+    bool open();
+    int read(uint8_t *buf, size_t len, int timeout_ms);
+    int write(const uint8_t *buf, size_t len);
+    void close();
+
+    bool isOpen()
+    {
+        return _is_open;
+    }
+
+    // return a copy of the current counters.
+    ad2_transport_stats_t getStats()
+    {
+        return _stats;
+    }
+
+    void resetStats();
+
+    // save all received data to a capture. nullptr to detach.
+    void setCapture(AD2Capture *capture)
+    {
+        _capture = capture;
+    }
+
+protected:
+    virtual bool _open() = 0;
+    virtual int _read(uint8_t *buf, size_t len, int timeout_ms) = 0;
+    virtual int _write(const uint8_t *buf, size_t len) = 0;
+    virtual void _close() = 0;
+
+    bool _is_open = false;
+    ad2_transport_stats_t _stats = {};
+    AD2Capture *_capture = nullptr;
+};
+
+#if defined(IDF_VER)
+/**
+ * ESP32 hardware UART backend.
+ * With CONFIG_AD2IOT_UART_RX_PATTERN_DETECT the reader blocks on the
+ * driver event queue and wakes on each '\n' instead of polling.
+ */
+class AD2TransportUART : public AD2Transport
+{
+public:
+    AD2TransportUART(uart_port_t port, int tx_pin, int rx_pin, int baud_rate = 115200)
+        : _port(port), _tx_pin(tx_pin), _rx_pin(rx_pin), _baud_rate(baud_rate) { }
+
+    const char *name()
+    {
+        return "uart";
+    }
+
+protected:
+    bool _open();
+    int _read(uint8_t *buf, size_t len, int timeout_ms);
+    int _write(const uint8_t *buf, size_t len);
+    void _close();
+
+    uart_port_t _port;
+    int _tx_pin;
+    int _rx_pin;
+    int _baud_rate;
+    bool _driver_installed = false;
+    QueueHandle_t _event_queue = nullptr;
+};
+#endif
+
+/**
+ * TCP client backend. ser2sock or any raw AD2* TCP stream.
+ * Uses BSD sockets so it runs on lwIP and POSIX hosts.
+ */
+class AD2TransportTCP : public AD2Transport
+{
+public:
+    AD2TransportTCP(const std::string &host, int port)
+        : _host(host), _port(port) { }
+
+    const char *name()
+    {
+        return "tcp";
+    }
+
+    bool requiresNetwork()
+    {
+        return true;
+    }
+
+protected:
+    bool _open();
+    int _read(uint8_t *buf, size_t len, int timeout_ms);
+    int _write(const uint8_t *buf, size_t len);
+    void _close();
+
+    std::string _host;
+    int _port;
+    int _fd = -1;
+};
+
+/**
+ * File replay backend. Streams a raw AD2* capture from a file.
+ * At the end of the file it rewinds if loop is set or idles.
+ */
+class AD2TransportFile : public AD2Transport
+{
+public:
+    AD2TransportFile(const std::string &path, bool loop = false)
+        : _path(path), _loop(loop) { }
+
+    const char *name()
+    {
+        return "file";
+    }
+
+protected:
+    bool _open();
+    int _read(uint8_t *buf, size_t len, int timeout_ms);
+    int _write(const uint8_t *buf, size_t len);
+    void _close();
+
+    std::string _path;
+    bool _loop;
+    FILE *_fp = nullptr;
+};
+
+/**
+ * Capture replay backend. Streams an AD2Capture recording with the
+ * recorded timing scaled by speed. Speed 0 replays as fast as the
+ * reader can take it.
+ */
+class AD2TransportReplay : public AD2Transport
+{
+public:
+    AD2TransportReplay(const std::string &path, double speed = 1.0, bool loop = false)
+        : _path(path), _speed(speed), _loop(loop) { }
+
+    const char *name()
+    {
+        return "replay";
+    }
+
+protected:
+    bool _open();
+    int _read(uint8_t *buf, size_t len, int timeout_ms);
+    int _write(const uint8_t *buf, size_t len);
+    void _close();
+    bool _next();
+
+    std::string _path;
+    double _speed;
+    bool _loop;
+    FILE *_fp = nullptr;
+    std::string _pending;       // current record data.
+    size_t _pending_off = 0;    // bytes of _pending already returned.
+    bool _pending_ready = false;
+    uint64_t _record_us = 0;    // capture time of the current record.
+    uint64_t _start_us = 0;     // local time replay started.
+};
+
+#if !defined(IDF_VER)
+/**
+ * POSIX pseudo terminal backend. Stand-in for the UART on a Linux host.
+ * A feeder process writes AD2* data to the slave side.
+ */
+class AD2TransportPTY : public AD2Transport
+{
+public:
+    AD2TransportPTY(const std::string &link = "")
+        : _link(link) { }
+
+    const char *name()
+    {
+        return "pty";
+    }
+
+    // path of the slave device once open.
+    const std::string &slavePath()
+    {
+        return _slave;
+    }
+
+protected:
+    bool _open();
+    int _read(uint8_t *buf, size_t len, int timeout_ms);
+    int _write(const uint8_t *buf, size_t len);
+    void _close();
+
+    std::string _link;
+    std::string _slave;
+    int _fd = -1;
+    int _slave_fd = -1;
+};
+#endif
+
+uint64_t ad2_transport_uptime_us();
+AD2Transport *ad2_transport_create(char mode, const std::string &args);
+
+#endif /* _AD2_TRANSPORT_H */
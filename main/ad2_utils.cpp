@@ -24,6 +24,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 
 static const char *TAG = "AD2UTIL";
 
@@ -43,7 +44,13 @@ static const char *TAG = "AD2UTIL";
 #include "esp_mac.h"
 #include "esp_chip_info.h"
 #include "esp_flash.h"
+#include "esp_random.h"
 #include <SimpleIni.h>
+#include <unistd.h>
+#include <deque>
+#include <vector>
+#include <map>
+#include <algorithm>
 // ini config class
 static CSimpleIniA _ad2ini;
 
@@ -385,44 +392,6 @@ std::string ad2_make_basic_auth_string(const std::string &user, const std::strin
     return encoded_string;
 }
 
-/**
- * @brief url encode a string making it safe for http protocols.
- *
- * @arg [in]str std::string to url encode.
- *
- * @return std::string url encoded string
- *
- */
-std::string ad2_urlencode(const std::string str)
-{
-    std::string encoded = "";
-    char c;
-    char code0;
-    char code1;
-    for (int i = 0; i < str.length(); i++) {
-        c = str[i];
-        if (c == ' ') {
-            encoded += '+';
-        } else if (isalnum(c)) {
-            encoded += c;
-        } else {
-            code1 = (c & 0xf) + '0';
-            if ((c & 0xf) > 9) {
-                code1 = (c & 0xf) - 10 + 'A';
-            }
-            c = (c >> 4) & 0xf;
-            code0 = c + '0';
-            if (c > 9) {
-                code0 = c - 10 + 'A';
-            }
-            encoded += '%';
-            encoded += code0;
-            encoded += code1;
-        }
-    }
-    return encoded;
-}
-
 /**
  * @brief Generate a UUID based upon the ESP32 wifi hardware mac address.
  *
@@ -647,6 +616,37 @@ void ad2_remove_ws(std::string &s)
     s = str_no_ws;
 }
 
+// config change subscribers by section.
+static std::vector<std::pair<std::string, ad2_config_change_cb_t>> _config_change_cbs;
+
+/**
+ * @brief Call the change callbacks registered for a section.
+ *
+ * @param[in] section config section.
+ * @param[in] key full config key including index and suffix.
+ */
+static void _config_changed(const char *section, const std::string &key)
+{
+    for (auto &cb : _config_change_cbs) {
+        if (cb.first.compare(section) == 0) {
+            cb.second(section, key.c_str());
+        }
+    }
+}
+
+/**
+ * @brief Register a callback for changes to a config section.
+ * Called from the task that set or removed the key. Register during
+ * component init before the CLI is running.
+ *
+ * @param[in] section config section to watch.
+ * @param[in] cb callback.
+ */
+void ad2_register_config_change(const char *section, ad2_config_change_cb_t cb)
+{
+    _config_change_cbs.push_back(std::make_pair(std::string(section), cb));
+}
+
 /**
  * @brief Get bool configuration value by section and key.
  *  Optional default value, index(0-999), and suffix helpers.
@@ -729,6 +729,7 @@ void ad2_set_config_key_bool(
         ESP_LOGE(TAG, "%s: fail ini Set|Delete(%s).", __func__, tkey.c_str());
     } else {
         _config_dirty = true;
+        _config_changed(section, tkey);
     }
     if (_config_autosave && _config_dirty) {
         SI_Error rc = _ad2ini.SaveFile("/" AD2_USD_MOUNT_POINT AD2_CONFIG_FILE);
@@ -819,6 +820,7 @@ void ad2_set_config_key_int(
         ESP_LOGE(TAG, "%s: fail ini Set|Delete(%s).", __func__, tkey.c_str());
     } else {
         _config_dirty = true;
+        _config_changed(section, tkey);
     }
     if (_config_autosave && _config_dirty) {
         SI_Error rc = _ad2ini.SaveFile("/" AD2_USD_MOUNT_POINT AD2_CONFIG_FILE);
@@ -910,6 +912,7 @@ void ad2_set_config_key_string(
         ESP_LOGE(TAG, "%s: fail ini Set|Delete(%s).", __func__, tkey.c_str());
     } else {
         _config_dirty = true;
+        _config_changed(section, tkey);
     }
     if (_config_autosave && _config_dirty) {
         SI_Error rc = _ad2ini.SaveFile("/" AD2_USD_MOUNT_POINT AD2_CONFIG_FILE);
@@ -1027,7 +1030,7 @@ void ad2_arm_away(std::string &code, int partId)
         }
 
         ESP_LOGI(TAG, "Sending ARM AWAY command");
-        ad2_send(msg);
+        ad2_send(msg, false, true);
     } else {
         ESP_LOGE(TAG, "No partition state found for address %i. Waiting for messages from the AD2?", address);
     }
@@ -1085,7 +1088,7 @@ void ad2_arm_stay(std::string &code, int partId)
             msg = ad2_string_printf("K%01i1<S4>", address);
         }
         ESP_LOGI(TAG, "Sending ARM STAY command to address %i using code '%s'", address, code.c_str());
-        ad2_send(msg);
+        ad2_send(msg, false, true);
     } else {
         ESP_LOGE(TAG, "No partition state found for address %i. Waiting for messages from the AD2?", address);
     }
@@ -1399,7 +1402,7 @@ void ad2_bypass_zone(std::string &code, int partId, uint8_t zone)
         }
 
         ESP_LOGI(TAG, "Sending BYPASS ZONE command");
-        ad2_send(msg);
+        ad2_send(msg, false, true);
     } else {
         ESP_LOGE(TAG, "No partition state found for address %i. Waiting for messages from the AD2?", address);
     }
@@ -1429,42 +1432,268 @@ void ad2_bypass_zone(int codeId, int partId, uint8_t zone)
     ad2_bypass_zone(code, partId, zone);
 }
 
+#define AD2_CMDQ_SIZE 32            // max pending keypad commands.
+#define AD2_CMDQ_ACK_TIMEOUT 3000   // ms to wait for the AD2* "!Sending...done".
+#define AD2_CMDQ_PACE 50            // ms between commands sent to the AD2*.
+#define AD2_CMDQ_NOTIFY_NEW 0x01    // task notify bit. command queued.
+#define AD2_CMDQ_NOTIFY_ACK 0x02    // task notify bit. ON_SENDING_RECEIVED.
+
+typedef struct ad2_cmdQ_entry {
+    std::string data;   // macro expanded bytes to send.
+    bool raw;           // passthrough. No coalescing or ack wait.
+    bool merge;         // idempotent. Same pending command is merged.
+    uint64_t queued_us; // time queued for latency stats.
+} ad2_cmdQ_entry_t;
+
+static std::deque<ad2_cmdQ_entry_t> _ad2_cmdQ;
+static SemaphoreHandle_t _ad2_cmdQ_mutex = nullptr;
+static TaskHandle_t _ad2_cmdQ_task = nullptr;
+static ad2_cmdQ_stats_t _ad2_cmdQ_stats = {};
+
+/**
+ * @brief Expand macros <S1>-<S8> into the panel specific special keys.
+ * Single pass. Each macro is replaced with 3 bytes of its key value.
+ *
+ * @param [in]in std::string & source string.
+ * @param [out]out std::string & expanded string.
+ */
+static void _ad2_expand_macros(const std::string &in, std::string &out)
+{
+    out.clear();
+    out.reserve(in.length());
+    size_t len = in.length();
+    for (size_t i = 0; i < len; i++) {
+        if (in[i] == '<' && i + 3 < len && in[i + 1] == 'S' &&
+                in[i + 2] >= '1' && in[i + 2] <= '8' && in[i + 3] == '>') {
+            out.append(3, (char)(in[i + 2] - '0'));
+            i += 3;
+        } else {
+            out += in[i];
+        }
+    }
+}
+
+/**
+ * @brief Test if a command is a keypress the AD2* will acknowledge with
+ * "!Sending...done". Optional K## address prefix then keypad keys only.
+ *
+ * @param [in]cmd std::string & expanded command.
+ *
+ * @return bool
+ */
+static bool _ad2_cmd_expects_ack(const std::string &cmd)
+{
+    size_t i = 0;
+    if (cmd.length() > 3 && cmd[0] == 'K' && isdigit((int)cmd[1]) && isdigit((int)cmd[2])) {
+        i = 3;
+    }
+    if (i >= cmd.length()) {
+        return false;
+    }
+    for (; i < cmd.length(); i++) {
+        char c = cmd[i];
+        if (!isdigit((int)c) && c != '*' && c != '#' && !(c >= 1 && c <= 8)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Write bytes to the AD2* transport.
+ *
+ * @param [in]data std::string & bytes to send.
+ *
+ * @return bool true if sent.
+ */
+static bool _ad2_write(const std::string &data)
+{
+    if (g_ad2_transport && g_ad2_transport->isOpen()) {
+        ESP_LOGD(TAG, "sending '%s' to AD2*", data.c_str());
+        if (g_ad2_transport->write((const uint8_t *)data.c_str(), data.length()) < 0) {
+            ESP_LOGE(TAG, "ad2source %s write failed", g_ad2_transport->name());
+            return false;
+        }
+        return true;
+    }
+    ESP_LOGE(TAG, "ad2source transport not open in send_to_ad2");
+    return false;
+}
+
+/**
+ * @brief ON_SENDING_RECEIVED. Wake the command queue waiting for an ack.
+ *
+ * @param [in]msg std::string * "!Sending...done" message.
+ * @param [in]s nullptr
+ * @param [in]arg nullptr
+ */
+static void _ad2_cmdQ_on_sending_received(std::string *msg, AD2PartitionState *s, void *arg)
+{
+    if (_ad2_cmdQ_task) {
+        xTaskNotify(_ad2_cmdQ_task, AD2_CMDQ_NOTIFY_ACK, eSetBits);
+    }
+}
+
+/**
+ * @brief AD2* keypad command queue consumer. Sends one command at a time
+ * waiting for the AD2* to acknowledge keypresses before the next.
+ *
+ * @param [in]pvParameters void *
+ */
+static void _ad2_cmdQ_consumer_task(void *pvParameters)
+{
+    uint32_t bits;
+
+    while (1) {
+        // wait for work.
+        xSemaphoreTake(_ad2_cmdQ_mutex, portMAX_DELAY);
+        bool empty = _ad2_cmdQ.empty();
+        xSemaphoreGive(_ad2_cmdQ_mutex);
+        if (empty) {
+            xTaskNotifyWait(0, AD2_CMDQ_NOTIFY_NEW, &bits, portMAX_DELAY);
+            continue;
+        }
+
+        // hold commands until the transport is connected.
+        if (!g_ad2_transport || !g_ad2_transport->isOpen()) {
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+            continue;
+        }
+
+        xSemaphoreTake(_ad2_cmdQ_mutex, portMAX_DELAY);
+        ad2_cmdQ_entry_t cmd = _ad2_cmdQ.front();
+        _ad2_cmdQ.pop_front();
+        _ad2_cmdQ_stats.depth = _ad2_cmdQ.size();
+        xSemaphoreGive(_ad2_cmdQ_mutex);
+
+        bool expect_ack = !cmd.raw && _ad2_cmd_expects_ack(cmd.data);
+
+        // clear any stale ack from a raw or external send.
+        xTaskNotifyWait(0, AD2_CMDQ_NOTIFY_ACK, &bits, 0);
+
+        if (!_ad2_write(cmd.data)) {
+            _ad2_cmdQ_stats.write_errors++;
+            ESP_LOGE(TAG, "AD2* command write failed. Command dropped.");
+            continue;
+        }
+        _ad2_cmdQ_stats.sent++;
+
+        if (expect_ack) {
+            bool acked = false;
+            uint64_t deadline = hal_uptime_us() + (AD2_CMDQ_ACK_TIMEOUT * 1000ULL);
+            uint64_t now;
+            while ((now = hal_uptime_us()) < deadline) {
+                bits = 0;
+                xTaskNotifyWait(0, AD2_CMDQ_NOTIFY_ACK, &bits, ((deadline - now) / 1000) / portTICK_PERIOD_MS + 1);
+                if (bits & AD2_CMDQ_NOTIFY_ACK) {
+                    acked = true;
+                    break;
+                }
+            }
+            if (acked) {
+                _ad2_cmdQ_stats.acked++;
+            } else {
+                _ad2_cmdQ_stats.ack_timeouts++;
+                ESP_LOGW(TAG, "no ack from AD2* for keypad command");
+            }
+        }
+
+        // latency from queue to send or ack.
+        if (!cmd.raw) {
+            uint32_t latency = (hal_uptime_us() - cmd.queued_us) / 1000;
+            _ad2_cmdQ_stats.last_latency_ms = latency;
+            _ad2_cmdQ_stats.total_latency_ms += latency;
+            _ad2_cmdQ_stats.latency_count++;
+            if (latency > _ad2_cmdQ_stats.max_latency_ms) {
+                _ad2_cmdQ_stats.max_latency_ms = latency;
+            }
+            // pace commands to what the AD2* can accept.
+            vTaskDelay(AD2_CMDQ_PACE / portTICK_PERIOD_MS);
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Initialize and start the AD2* keypad command queue.
+ * All writers post to the queue and a single task sends to the AD2*.
+ */
+void ad2_init_cmdQ()
+{
+    if (_ad2_cmdQ_mutex == nullptr) {
+        _ad2_cmdQ_mutex = xSemaphoreCreateMutex();
+    }
+
+    // Match keypress completions.
+    AD2Parse.subscribeTo(ON_SENDING_RECEIVED, _ad2_cmdQ_on_sending_received, nullptr);
+
+    xTaskCreate(_ad2_cmdQ_consumer_task, "AD2 cmdQ", 1024 * 4, NULL, tskIDLE_PRIORITY + 2, &_ad2_cmdQ_task);
+}
+
+/**
+ * @brief Get a copy of the command queue counters.
+ *
+ * @param [out]stats ad2_cmdQ_stats_t *
+ */
+void ad2_get_cmdQ_stats(ad2_cmdQ_stats_t *stats)
+{
+    *stats = _ad2_cmdQ_stats;
+}
+
 /**
  * @brief Send string to the AD2 devices after macro translation.
  *
  * @param [in]buf Pointer to string to send to AD2 devices.
+ * @param [in]raw true for terminal or ser2sock passthrough data. Raw data
+ *  is sent in order with other commands but is not merged or held for an ack.
+ * @param [in]merge true for idempotent commands. Arm and bypass.
  *
  * @note Macros <SX> for sending panel specific special keys.
  *       http://www.alarmdecoder.com/wiki/index.php/Protocol#Special_Keys
  * This makes it more simple to send complex sequences with a simple human
  * readable macro.
+ *
+ * @note Commands are queued. A merge request that is the same as the
+ * last merge request still waiting in the queue is merged with it. Keys,
+ * toggles like chime and disarm are never merged. Sending them twice must
+ * press them twice. A second disarm clears the Ademco alarm memory.
  */
-void ad2_send(std::string &buf)
+void ad2_send(std::string &buf, bool raw, bool merge)
 {
-    if (g_ad2_client_handle > -1) {
-
-        /* replace macros <S1>-<S8> with real values */
-        for (int x = 1; x < 9; x++) {
-            std::string key = ad2_string_printf("<S%01i>", x);
-            std::string out;
-            out.append(3, (char)x);
-            ad2_replace_all(buf, key.c_str(), out.c_str());
-        }
+    ad2_cmdQ_entry_t cmd;
+    _ad2_expand_macros(buf, cmd.data);
+    cmd.raw = raw;
+    cmd.merge = merge && !raw;
+    cmd.queued_us = hal_uptime_us();
 
-        ESP_LOGD(TAG, "sending '%s' to AD2*", buf.c_str());
+    // no queue yet. Send direct.
+    if (!_ad2_cmdQ_task) {
+        _ad2_write(cmd.data);
+        return;
+    }
 
-        if (g_ad2_mode == 'C') {
-            uart_write_bytes((uart_port_t)g_ad2_client_handle, buf.c_str(), buf.length());
-        } else if (g_ad2_mode == 'S') {
-            // the handle is a socket fd use send()
-            send(g_ad2_client_handle, buf.c_str(), buf.length(), 0);
-        } else {
-            ESP_LOGE(TAG, "invalid ad2 connection mode");
-        }
+    xSemaphoreTake(_ad2_cmdQ_mutex, portMAX_DELAY);
+    // Only the last queued command is compared so a merge never moves a
+    // command past a different one. ARM DISARM ARM must stay armed.
+    // The address is part of the command so only the same partition matches.
+    bool merged = cmd.merge && _ad2_cmdQ.size() &&
+                  _ad2_cmdQ.back().merge && _ad2_cmdQ.back().data == cmd.data;
+    if (merged) {
+        _ad2_cmdQ_stats.coalesced++;
+    } else if (_ad2_cmdQ.size() >= AD2_CMDQ_SIZE) {
+        _ad2_cmdQ_stats.dropped++;
+        ESP_LOGE(TAG, "AD2* command queue full. Command dropped.");
     } else {
-        ESP_LOGE(TAG, "invalid handle in send_to_ad2");
-        return;
+        _ad2_cmdQ.push_back(cmd);
+        _ad2_cmdQ_stats.queued++;
+        _ad2_cmdQ_stats.depth = _ad2_cmdQ.size();
+        if (_ad2_cmdQ_stats.depth > _ad2_cmdQ_stats.max_depth) {
+            _ad2_cmdQ_stats.max_depth = _ad2_cmdQ_stats.depth;
+        }
     }
+    xSemaphoreGive(_ad2_cmdQ_mutex);
+
+    xTaskNotify(_ad2_cmdQ_task, AD2_CMDQ_NOTIFY_NEW, eSetBits);
 }
 
 /**
@@ -1736,135 +1965,6 @@ cJSON *ad2_get_partition_zone_alerts_json(AD2PartitionState *s)
     return _zone_alerts;
 }
 
-#define HTTP_SEND_QUEUE_SIZE 20  // More? Less?
-#define HTTP_SEND_RATE_LIMIT 200 // 5/s seems like a reasonable value to start with.
-static QueueHandle_t _http_sendQ = NULL;
-
-typedef struct sendQ_event_data {
-    esp_http_client_config_t *client_config;
-    ad2_http_sendQ_ready_cb_t ready;
-    ad2_http_sendQ_done_cb_t done;
-} sendQ_event_data_t;
-
-/**
- * @brief HTTP sendQ consumer
- *
- * @param [in]pvParameters void *
- */
-static void _http_sendQ_consumer_task(void *pvParameters)
-{
-    esp_err_t err;
-
-    while (1) {
-        if (_http_sendQ == NULL) {
-            break;
-        }
-        if (!g_StopMainTask && hal_get_network_connected()) {
-            sendQ_event_data_t event_data;
-            if (xQueueReceive(_http_sendQ, &event_data, portMAX_DELAY)) {
-#if defined(AD2_STACK_REPORT)
-                ESP_LOGI(TAG, "_http_sendQ_consumer_task stack free %d", uxTaskGetStackHighWaterMark(NULL));
-#endif
-
-                // Initialize a new http client using the client_config..
-                esp_http_client_handle_t http_client;
-                http_client = esp_http_client_init(event_data.client_config);
-
-                // Set the user agent.
-                esp_chip_info_t chip_info;
-                esp_chip_info(&chip_info);
-
-                // Set user agent no including version info.
-                std::string ua = "AD2IoT-HTTP-Client/NOPE (ESP32-r" + std::to_string(chip_info.revision) + ")";
-                esp_http_client_set_header(http_client, "User-Agent", ua.c_str());
-
-                // notify compoenet we are about to send and allow to
-                // update connection details including post data etc.
-                event_data.ready(http_client, event_data.client_config);
-
-                // Allow for multiple requests on a single connection.
-                // TODO: sanity checking. Put back in sendQ for others to get some time? Memory.
-                do {
-                    // start the connection
-                    err = esp_http_client_perform(http_client);
-
-                    // Notify client the request finished and the results.
-                    // If it wants to preform again it will return false;
-                    if (event_data.done(err, http_client, event_data.client_config)) {
-                        break;
-                    }
-                } while (err == ESP_OK);
-
-                // free the client
-                esp_http_client_cleanup(http_client);
-
-                // sleep our rate limit. Not exactly the rate not factoring in
-                // client connection time but close enough for now.
-                vTaskDelay(HTTP_SEND_RATE_LIMIT / portTICK_PERIOD_MS);
-            } else {
-                // sleep for a bit then check the queue again.
-                vTaskDelay(100 / portTICK_PERIOD_MS);
-            }
-        }
-        // sleep for a bit then check the queue again.
-        vTaskDelay(100 / portTICK_PERIOD_MS);
-    }
-    ESP_LOGW(TAG, "http sendQ ending. HTTP request delivery halted.");
-    vTaskDelete(NULL);
-}
-
-/**
- * @brief Initialize and start the HTTP request send queue.
- * Allows for components to POST requests to server ASYNC and serialized with each other.
- * This prevents memory exhaustion at the cost of a potential slower delivery time.
- *
- * @note TODO: Add retry logic. Will take some brain time on this. It would not be good
- * to deliver a message out of order yet we need to let other components deliver and not be
- * blocked. Need a queue per component. Maybe have each component manage an internal queue
- * and if one delivery fails let the component decide how to deal with it.
- *
- */
-void ad2_init_http_sendQ()
-{
-    // Init the queue.
-    if (_http_sendQ == NULL) {
-        _http_sendQ = xQueueCreate(HTTP_SEND_QUEUE_SIZE, sizeof(sendQ_event_data_t));
-    }
-
-    // Start the queue consumer task. Keep the stack as small as possible.
-    // 20210815SM: 1444 bytes stack free
-    xTaskCreate(_http_sendQ_consumer_task, "AD2 sendQ", 1024 * 8, NULL, tskIDLE_PRIORITY + 1, NULL);
-}
-
-/**
- * @brief Add a http client config to the queue
- *
- * @param [in]client_config esp_http_client_config_t *
- * @param [in]ready_cb ad2_http_sendQ_ready_cb_t: Called before esp_http_client_perform()
- * @param [in]done_cb ad2_http_sendQ_done_cb_t: Called before esp_http_client_cleanup()
- *
- */
-bool ad2_add_http_sendQ(esp_http_client_config_t *client_config, ad2_http_sendQ_ready_cb_t ready_cb, ad2_http_sendQ_done_cb_t done_cb)
-{
-    // Save queue data into a structure for storage in the sendQ
-    sendQ_event_data_t event_data = {
-        .client_config = client_config,
-        .ready = ready_cb,
-        .done = done_cb
-    };
-
-    if (_http_sendQ) {
-        // Copy the container into the sendQ
-        if (xQueueSend(_http_sendQ, (void *)&event_data, (TickType_t)0) != pdPASS) {
-            return false;
-        }
-        return true;
-    } else {
-        ESP_LOGE(TAG, "Invalid queue handle");
-        return false;
-    }
-}
-
 /**
  * @brief return the ad2 configured network mode value
  *
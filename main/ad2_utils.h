@@ -30,6 +30,25 @@
 // Debugging config
 //#define DEBUG_CONFIG
 
+/**
+ * AD2* keypad command queue counters.
+ */
+typedef struct ad2_cmdQ_stats {
+    uint32_t queued;            ///< commands added to the queue.
+    uint32_t sent;              ///< commands written to the AD2*.
+    uint32_t coalesced;         ///< commands merged with the same command queued just before.
+    uint32_t dropped;           ///< commands dropped with the queue full.
+    uint32_t write_errors;      ///< commands the transport failed to write.
+    uint32_t acked;             ///< keypresses acknowledged with "!Sending...done".
+    uint32_t ack_timeouts;      ///< keypresses with no acknowledgement.
+    uint32_t depth;             ///< current queue depth.
+    uint32_t max_depth;         ///< high water queue depth.
+    uint32_t last_latency_ms;   ///< queue to completion time of the last command.
+    uint32_t max_latency_ms;    ///< max queue to completion time.
+    uint64_t total_latency_ms;  ///< sum for the average.
+    uint32_t latency_count;     ///< commands in total_latency_ms.
+} ad2_cmdQ_stats_t;
+
 // Communication with AD2* device / host
 void ad2_fw_update(const char *arg);
 void ad2_config_update(const char *arg);
@@ -47,7 +66,9 @@ void ad2_aux_alarm(int partId);
 void ad2_exit_now(int partId);
 void ad2_bypass_zone(std::string &code, int partId, uint8_t zone);
 void ad2_bypass_zone(int codeId, int partId, uint8_t zone);
-void ad2_send(std::string &buf);
+void ad2_send(std::string &buf, bool raw = false, bool merge = false);
+void ad2_init_cmdQ();
+void ad2_get_cmdQ_stats(ad2_cmdQ_stats_t *stats);
 AD2PartitionState *ad2_get_partition_state(int partId);
 cJSON *ad2_get_ad2iot_device_info_json();
 cJSON *ad2_get_partition_state_json(AD2PartitionState *);
@@ -69,7 +90,6 @@ std::string ad2_string_vasnprintf(const char *fmt, size_t size, va_list args);
 int ad2_copy_nth_arg(std::string &dest, const char* src, int n, bool remaining = false);
 void ad2_tokenize(std::string const &str, const char* delim, std::vector<std::string> &out);
 std::string ad2_make_basic_auth_string(const std::string& user, const std::string& password);
-std::string ad2_urlencode(const std::string str);
 void ad2_genUUID(uint8_t n, std::string& ret);
 void ad2_lcase(std::string &str);
 void ad2_ucase(std::string &str);
@@ -175,19 +195,14 @@ void ad2_set_config_key_string(
 
 #define CFG_SECTION_MAIN ""
 
+/// Config change callback. Called with the section and full key after a set or remove.
+typedef void (*ad2_config_change_cb_t)(const char *section, const char *key);
+void ad2_register_config_change(const char *section, ad2_config_change_cb_t cb);
+
 // persistent configuration load/save
 void ad2_load_persistent_config();
 void ad2_save_persistent_config();
 
-// ASYNC serialized http request api for components.
-
-/// ad2_http async http request callback. Called before esp_http_client_perform()
-typedef void (*ad2_http_sendQ_ready_cb_t)(esp_http_client_handle_t, esp_http_client_config_t*);
-/// ad2_http async http request callback. Called before after esp_http_client_cleanup()
-typedef bool (*ad2_http_sendQ_done_cb_t)(esp_err_t, esp_http_client_handle_t, esp_http_client_config_t*);
-void ad2_init_http_sendQ();
-bool ad2_add_http_sendQ(esp_http_client_config_t*, ad2_http_sendQ_ready_cb_t, ad2_http_sendQ_done_cb_t);
-
 
 #endif /* _AD2_UTILS_H */
 
@@ -71,6 +71,11 @@ static const char *TAG = "AD2_IoT";
 #include "pushover.h"
 #endif
 
+// webhook support
+#if CONFIG_AD2IOT_WEBHOOK_CLIENT
+#include "webhook.h"
+#endif
+
 // web server UI support
 #if CONFIG_AD2IOT_WEBSERVER_UI
 #include "webUI.h"
@@ -106,11 +111,11 @@ SemaphoreHandle_t g_ad2_console_mutex = nullptr;
 // global AlarmDecoder parser class instance
 AlarmDecoderParser AD2Parse;
 
-// global AD2 device connection fd/id <socket or uart id>
-int g_ad2_client_handle = -1;
+// global AD2 device protocol source transport.
+AD2Transport *g_ad2_transport = nullptr;
 
-// global ad2 connection mode ['S'ocket | 'C'om port]
-uint8_t g_ad2_mode = 0;
+// global AD2 device protocol stream capture.
+AD2Capture g_ad2_capture;
 
 // global ad2 network EventGroup
 EventGroupHandle_t g_ad2_net_event_group = nullptr;
@@ -693,274 +698,105 @@ static void ad2_app_main_task(void *pvParameters)
 }
 
 /**
- * @brief ad2uart client task
- * process messages from local UART connected to the AD2*
- * device.
+ * @brief Send the AD2* startup sequence on a newly opened transport.
  *
  * @note Hardware uart may have noise during flashing or rebooting.
  * To help we will send down a bunch of line breaks to force the AD2*
- * into run mode. This is not necessary with socket connected AD2*.
+ * into run mode.
  *
- * @param [in]pvParameters currently not used NULL.
+ * @param [in]t AD2Transport * open transport.
  */
-static void ad2uart_client_task(void *pvParameters)
+static void _ad2_source_send_init(AD2Transport *t)
 {
-    uint8_t rx_buffer[AD2_UART_RX_BUFF_SIZE];
-
     // send break to AD2* be sure we are in run mode.
-    std::string breakline = "\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n";
-    uart_write_bytes((uart_port_t)g_ad2_client_handle, breakline.c_str(), breakline.length());
-
-    // send a 'V" and a 'C' command to get version and configuration from the AD2*.
-    std::string cmdline = "V\r\n\r\nC\r\n\r\n\r\n";
-    uart_write_bytes((uart_port_t)g_ad2_client_handle, cmdline.c_str(), cmdline.length());
-
-    while (1) {
-        // do not process if main halted or network disconnected.
-        // TODO: Cleanup continue to make it less network dependent.
-        if (g_init_done && !g_StopMainTask && hal_get_network_connected()) {
-            memset(rx_buffer, 0, AD2_UART_RX_BUFF_SIZE);
-
-            // Read data from the UART
-            int len = uart_read_bytes((uart_port_t)g_ad2_client_handle, rx_buffer, AD2_UART_RX_BUFF_SIZE - 1, 5 / portTICK_PERIOD_MS);
-            if (len == -1) {
-                // An error happend. Sleep for a bit and try again?
-                vTaskDelay(5000 / portTICK_PERIOD_MS);
-            }
-            if (len>0) {
-                AD2Parse.put(rx_buffer, len);
-            }
-        }
-        vTaskDelay(10 / portTICK_PERIOD_MS);
-    }
-    vTaskDelete(NULL);
-}
-
-/**
- * ser2sock_client_task private helper.
- *
- */
-bool _ser2sock_client_connect(const char *args)
-{
-    // load the host and port params from the mode args.
-    std::string buf = args;
-    int res;
-
-    // Storage for parsed Host & Port to connect to.
-    int port = -1;
-    std::string host;
-    int addr_family = 0;
-    int size;
-#if CONFIG_LWIP_IPV6
-    bool isv6 = false;
-    struct sockaddr_in6 dest_addr6 = {};
-    dest_addr6.sin6_family = AF_INET6;
-#endif
-    struct sockaddr_in dest_addr = {};
-
-    std::regex rgx;
-    std::smatch matches;
-#if CONFIG_LWIP_IPV6
-    // test for IPv6 host:port RFC 3986, section 3.2.2: Host. Must be surrounded by square braces.
-    rgx = "^\\[(.*)\\]:(.*)$";
-    if (std::regex_search(buf, matches, rgx)) {
-        host = matches[1].str();
-        port = std::atoi(matches[2].str().c_str());
-        isv6 = true;
-    } else
-#endif
-    {
-        // Test for IPv4:PORT
-        rgx = "^(.*):(.*)$";
-        if (std::regex_search(buf, matches, rgx)) {
-            host = matches[1].str();
-            port = std::atoi(matches[2].str().c_str());
-        }
-    }
-
-    // no valid address parsed sleep and restart.
-    if (port == -1) {
-        ESP_LOGE(TAG, "Error parsing host:port from settings '%s'. Sleeping for 30 seconds.", buf.c_str());
-        // sleep a long time maybe the config will be updated live.
-        vTaskDelay(30000 / portTICK_PERIOD_MS);
-        return false;
-    }
-
-    ESP_LOGI(TAG, "Connecting to ser2sock host '%s' on port %i", host.c_str(), port);
-
-    // detect IPv4 vs IPv6 host address see RFC 3986, section 3.2.2: Host
-#if CONFIG_LWIP_IPV6
-    if (isv6) {
-        //res = inet_pton(AF_INET6, host.c_str(), &dest_addr6.sin6_addr);
-        dest_addr6.sin6_port = htons(port);
-        addr_family = AF_INET6;
-        size = sizeof(struct sockaddr_in6);
-    } else
-#endif
-    {
-        dest_addr.sin_addr.s_addr = inet_addr(host.c_str());
-        dest_addr.sin_family = AF_INET;
-        dest_addr.sin_port = htons(port);
-        addr_family = AF_INET;
-        size = sizeof(struct sockaddr_in);
-    }
-
-    g_ad2_client_handle =  socket(addr_family, SOCK_STREAM, IPPROTO_TCP);
-    if (g_ad2_client_handle < 0) {
-        ESP_LOGE(TAG, "ser2sock client unable to create socket: errno %d", errno);
-        return false;
-    }
-    ESP_LOGI(TAG, "ser2sock client socket created, connecting to host %s on port %d", host.c_str(), port);
-
-#if CONFIG_LWIP_IPV6
-    if (isv6) {
-        res = connect(g_ad2_client_handle, (struct sockaddr *)&dest_addr6, size);
-    } else
-#endif
-    {
-        res = connect(g_ad2_client_handle, (struct sockaddr *)&dest_addr, size);
-    }
-
-    if (res != 0) {
-        ESP_LOGE(TAG, "ser2sock client socket unable to connect: errno %d", errno);
-        close(g_ad2_client_handle);
-        g_ad2_client_handle = -1;
-        return false;
-    }
-    ESP_LOGI(TAG, "ser2sock client successfully connected");
-
-    // set socket non blocking.
-    fcntl(g_ad2_client_handle, F_SETFL, O_NONBLOCK);
-
-    // send break to AD2* be sure we are in run mode.
-    buf = "\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n";
-    send((uart_port_t)g_ad2_client_handle, buf.c_str(), buf.length(), 0);
+    std::string buf = "\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n\r\n";
+    t->write((const uint8_t *)buf.c_str(), buf.length());
 
     // send a 'V" and a 'C' command to get version and configuration from the AD2*.
     buf = "V\r\n\r\nC\r\n\r\n\r\n";
-    send((uart_port_t)g_ad2_client_handle, buf.c_str(), buf.length(), 0);
-
-    return true;
+    t->write((const uint8_t *)buf.c_str(), buf.length());
 }
 
-
 /**
- * @brief ser2sock client task
- * Connects and stays connected to ser2sock server to receive
- * AD2* protocol messages from an alarm system.
+ * @brief AD2* protocol source task
+ * Opens and stays connected to the configured ad2source transport
+ * and feeds the received AD2* protocol stream into the parser.
  *
- * @param [in]pvParameters currently not used NULL.
+ * @param [in]pvParameters AD2Transport * transport to read.
  */
-static void ser2sock_client_task(void *pvParameters)
+static void ad2_source_task(void *pvParameters)
 {
+    AD2Transport *t = (AD2Transport *)pvParameters;
+    uint8_t rx_buffer[AD2_SOURCE_RX_BUFF_SIZE];
 
     while (1) {
-        if (hal_get_network_connected()) {
-
-            if (_ser2sock_client_connect((const char *)pvParameters)) {
-                while (1) {
-                    // do not process if main halted.
-                    if (g_init_done && !g_StopMainTask) {
-                        uint8_t rx_buffer[128];
-                        int len = recv(g_ad2_client_handle, rx_buffer, sizeof(rx_buffer) - 1, 0);
-                        // test if error occurred
-                        if (len < 0) {
-                            if ( errno != EAGAIN ) {
-                                ESP_LOGE(TAG, "ser2sock client recv failed: errno %d", errno);
-                                break;
-                            }
-                        }
-                        // Data received
-                        else {
-                            // Parse data from AD2* and report back to host.
-                            rx_buffer[len] = 0; // Null-terminate whatever we received and treat like a string
-                            AD2Parse.put(rx_buffer, len);
-                        }
-                    }
-                    if (!hal_get_network_connected()) {
-                        break;
-                    }
-                    vTaskDelay(10 / portTICK_PERIOD_MS);
-#if defined(AD2_STACK_REPORT)
-#define S2S_EXTRA_INFO_EVERY 1000
-                    static int extra_info = S2S_EXTRA_INFO_EVERY;
-                    if(!--extra_info) {
-                        extra_info = S2S_EXTRA_INFO_EVERY;
-                        ESP_LOGI(TAG, "ser2sock_client stack free %d", uxTaskGetStackHighWaterMark(NULL));
-                    }
-#endif
-                }
+        // wait for the network if the transport needs it. A connection
+        // from before the network went down is stale so close it and
+        // open a new one when the network is back.
+        if (t->requiresNetwork() && !hal_get_network_connected()) {
+            if (t->isOpen()) {
+                ESP_LOGW(TAG, "ad2source %s network down. Closing.", t->name());
+                t->close();
+            }
+            vTaskDelay(10 / portTICK_PERIOD_MS);
+            continue;
+        }
+
+        // (re)open the transport.
+        if (!t->isOpen()) {
+            if (!t->open()) {
+                ESP_LOGE(TAG, "ad2source %s open failed. Retry in 3 seconds.", t->name());
+                vTaskDelay(3000 / portTICK_PERIOD_MS);
+                continue;
             }
+            _ad2_source_send_init(t);
+        }
 
-            ESP_LOGE(TAG, "ser2sock client shutting down socket and restarting in 3 seconds.");
-            if (g_ad2_client_handle != -1) {
-                shutdown(g_ad2_client_handle, 0);
-                close(g_ad2_client_handle);
-                g_ad2_client_handle = -1;
+        // do not process if main halted or network disconnected.
+        // TODO: Cleanup continue to make it less network dependent.
+        if (g_init_done && !g_StopMainTask && hal_get_network_connected()) {
+            // Blocks until data arrives. Event driven transports wake on EOL.
+            int len = t->read(rx_buffer, sizeof(rx_buffer), 100);
+            if (len < 0) {
+                ESP_LOGE(TAG, "ad2source %s read failed. Restarting in 3 seconds.", t->name());
+                t->close();
+                vTaskDelay(3000 / portTICK_PERIOD_MS);
+            } else if (len > 0) {
+                AD2Parse.put(rx_buffer, len);
             }
+        } else {
+            vTaskDelay(10 / portTICK_PERIOD_MS);
+        }
 #if defined(AD2_STACK_REPORT)
-            ESP_LOGI(TAG, "ser2sock_client stack free %d", uxTaskGetStackHighWaterMark(NULL));
-#endif
-            vTaskDelay(3000 / portTICK_PERIOD_MS);
+#define SRC_EXTRA_INFO_EVERY 1000
+        static int extra_info = SRC_EXTRA_INFO_EVERY;
+        if(!--extra_info) {
+            extra_info = SRC_EXTRA_INFO_EVERY;
+            ESP_LOGI(TAG, "ad2source stack free %d", uxTaskGetStackHighWaterMark(NULL));
         }
-        vTaskDelay(10 / portTICK_PERIOD_MS);
+#endif
     }
     vTaskDelete(NULL);
 }
 
 /**
- * @brief Start ser2sock client task
+ * @brief Start the AD2* protocol source task.
  */
-void init_ser2sock_client(const char *args)
+void init_ad2_source_client()
 {
-    xTaskCreate(ser2sock_client_task, "AD2 ser2sock RX", 1024*8, (void*)strdup(args), tskIDLE_PRIORITY+2, NULL);
-}
+    ad2_printf_host(true, "%s: Initialize AD2 source client using %s transport", TAG, g_ad2_transport->name());
 
-/**
- *  @brief Initialize the uart connected to the AD2 device
- */
-void init_ad2_uart_client(const char *args)
-{
-    // load the GPIO pin TX:RX from the mode args.
-    std::string port_pins = args;
-
-    g_ad2_client_handle = UART_NUM_2;
-    std::vector<std::string> out;
-    ad2_tokenize(port_pins, ":", out);
-    ad2_printf_host(true, "%s: Initialize AD2 UART client using txpin(%s) rxpin(%s)", TAG, out[0].c_str(),out[1].c_str());
-    int tx_pin = atoi(out[0].c_str());
-    int rx_pin = atoi(out[1].c_str());
-
-    // Configure parameters of an UART driver,
-    uart_config_t* uart_config = (uart_config_t*)calloc(sizeof(uart_config_t), 1);
-
-    uart_config->baud_rate = 115200;
-    uart_config->data_bits = UART_DATA_8_BITS;
-    uart_config->parity    = UART_PARITY_DISABLE;
-    uart_config->stop_bits = UART_STOP_BITS_1;
-    uart_config->flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
-    uart_config->rx_flow_ctrl_thresh = 1;
-
-    // esp_restart causes issues with UART2 don't set config if reset switch pushed.
-    // https://github.com/espressif/esp-idf/issues/5274
-    if (esp_reset_reason() != ESP_RST_SW) {
-        uart_param_config((uart_port_t)g_ad2_client_handle, uart_config);
+    // Local hardware is opened now so it is ready for the startup CLI.
+    if (!g_ad2_transport->requiresNetwork()) {
+        if (g_ad2_transport->open()) {
+            _ad2_source_send_init(g_ad2_transport);
+        }
     }
 
-    uart_set_pin((uart_port_t)g_ad2_client_handle,
-                 tx_pin,   // TX
-                 rx_pin,   // RX
-                 UART_PIN_NO_CHANGE, // RTS
-                 UART_PIN_NO_CHANGE);// CTS
-
-    uart_driver_install((uart_port_t)g_ad2_client_handle, MAX_UART_CMD_SIZE * 2, 0, 0, NULL, ESP_INTR_FLAG_LOWMED);
-    free(uart_config);
-
     // Main AlarmDecoderParser:
     // 20210815SM: 1220 bytes stack free.
     // 20211201SM: expand to 8k. Main task for everything.
-    xTaskCreate(ad2uart_client_task, "AD2 GPIO COM RX", 1024*8, (void *)AF_INET, tskIDLE_PRIORITY+2, NULL);
-
+    xTaskCreate(ad2_source_task, "AD2 source RX", 1024*8, (void *)g_ad2_transport, tskIDLE_PRIORITY+2, NULL);
 }
 
 
@@ -1114,6 +950,11 @@ extern "C" {
         pushover_register_cmds();
 #endif
 
+#if CONFIG_AD2IOT_WEBHOOK_CLIENT
+        // Register WEBHOOK CLI commands.
+        webhook_register_cmds();
+#endif
+
 #if CONFIG_AD2IOT_WEBSERVER_UI
         // Initialize WEB SEVER USER INTERFACE
         webui_register_cmds();
@@ -1150,28 +991,38 @@ extern "C" {
         // Create stream for parsing.
         std::istringstream ss(ad2_mode_string);
 
-        // Load AD2 connection type Com|Socket from mode string
+        // Load AD2 connection type Com|Socket|File from mode string
         std::string temp_mode;
         std::getline(ss, temp_mode, ' ');
-        g_ad2_mode = temp_mode[0];
 
         // Load the connection args from the stream.
         std::string ad2_mode_args;
-        std::getline(ss, ad2_mode_args, ' ');
+        std::getline(ss, ad2_mode_args);
 
-        // If the hardware is local UART start it now.
-        if (g_ad2_mode == 'C') {
-            init_ad2_uart_client(ad2_mode_args.c_str());
+        // Create the transport for the AD2* protocol source.
+        if (temp_mode.length()) {
+            g_ad2_transport = ad2_transport_create(temp_mode[0], ad2_mode_args);
+            if (g_ad2_transport) {
+                g_ad2_transport->setCapture(&g_ad2_capture);
+            }
+        }
+
+        // Start the AD2* command queue before any source can send.
+        ad2_init_cmdQ();
+
+        // If the source is local hardware start it now.
+        if (g_ad2_transport && !g_ad2_transport->requiresNetwork()) {
+            init_ad2_source_client();
         }
 
         // Start the CLI.
         // Press "..."" to halt startup and stay if a safe mode command line only.
         cli_main();
 
-        if (g_ad2_mode == 'S') {
+        if (g_ad2_transport && g_ad2_transport->requiresNetwork()) {
             ad2_printf_host(true, "Delaying start of ad2source SOCKET after network is up.");
-        } else if(g_ad2_mode != 'C') {
-            ESP_LOGI(TAG, "Unknown ad2source mode '%c'", g_ad2_mode);
+        } else if(!g_ad2_transport) {
+            ESP_LOGI(TAG, "Unknown ad2source mode '%s'", ad2_mode_string.c_str());
             ad2_printf_host(true, "AlarmDecoder protocol source mode NOT configured. Configure using ad2source command.");
         }
 
@@ -1253,6 +1104,10 @@ extern "C" {
         // Initialize pushover client
         pushover_init();
 #endif
+#if CONFIG_AD2IOT_WEBHOOK_CLIENT
+        // Initialize webhook client
+        webhook_init();
+#endif
 #if CONFIG_AD2IOT_WEBSERVER_UI
         // Initialize WEB SEVER USER INTERFACE
         webui_init();
@@ -1281,8 +1136,8 @@ extern "C" {
         xTaskCreate(ad2_app_main_task, "AD2 main", 1024*4, NULL, tskIDLE_PRIORITY+1, NULL);
 
         // If the AD2* is a socket connection we can hopefully start it now.
-        if (g_ad2_mode == 'S') {
-            init_ser2sock_client(ad2_mode_args.c_str());
+        if (g_ad2_transport && g_ad2_transport->requiresNetwork()) {
+            init_ad2_source_client();
         }
 
 #if CONFIG_AD2IOT_SER2SOCKD
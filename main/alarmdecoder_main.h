@@ -46,15 +46,28 @@
 
 // Common utils
 #include "ad2_utils.h"
+#include "ad2_encode.h"
+
+// HTTP request send queue
+#include "ad2_sendq.h"
 
 // HAL
 #include "device_control.h"
 
+// AD2* protocol source transports
+#include "ad2_transport.h"
+
+// Shared virtual switches
+#include "ad2_switches.h"
+
 #include "ad2_uart_cli.h"
 
 // global thread control
 extern int g_StopMainTask;
 
+// true once all components are initialized
+extern int g_init_done;
+
 // global critical section handle
 extern portMUX_TYPE spinlock;
 
@@ -64,11 +77,9 @@ extern SemaphoreHandle_t g_ad2_console_mutex;
 // global AlarmDecoder parser class instance
 extern AlarmDecoderParser AD2Parse;
 
-// global AD2 device connection fd/id <socket or uart id>
-extern int g_ad2_client_handle;
-
-// global ad2 connection mode ['S'ocket | 'C'om port]
-extern uint8_t g_ad2_mode;
+// global AD2 device protocol source transport.
+extern AD2Transport *g_ad2_transport;
+extern AD2Capture g_ad2_capture;
 
 // global ad2 connection mode args
 extern std::string g_ad2_mode_args;